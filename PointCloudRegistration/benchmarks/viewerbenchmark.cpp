@@ -0,0 +1,390 @@
+/**
+ * @brief 点云查看器渲染基准
+ *
+ * 在离屏表面上创建PointCloudViewer(不显示窗口，没有GPU时可以使用Mesa llvmpipe软件渲染)，
+ * 对不同规模的合成点云按固定的相机路径逐帧绘制，以JSON输出帧时间分位数和上传耗时，
+ * 便于在持续集成中比较不同版本的渲染性能。
+ *
+ * 用法: viewer_benchmark [--points 1,10,50] [--frames 120] [--width 1280] [--height 720]
+ *                        [--budget 2] [--output result.json]
+ *
+ * 未设置QT_QPA_PLATFORM时使用offscreen平台插件；该插件不支持OpenGL时可以在xvfb-run下以xcb平台运行。
+ */
+#include <QApplication>
+#include <QCommandLineParser>
+#include <QElapsedTimer>
+#include <QEventLoop>
+#include <QFile>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QOpenGLContext>
+#include <QOpenGLFunctions>
+#include <QTimer>
+#include <QDebug>
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <memory>
+#include "widgets/pointcloudviewer.h"
+#include "core/parallel.h"
+
+namespace {
+
+// 合成点云的范围(米)和坐标偏移(模拟投影坐标系下的大坐标)
+constexpr double CLOUD_EXTENT = 2000.0;
+const Eigen::Vector3d CLOUD_OFFSET(500000.0, 4200000.0, 100.0);
+
+// 等待后台构建和上传时的轮询间隔，以及两次轮询绘制之间的最小间隔(毫秒)
+constexpr int POLL_INTERVAL_MS = 20;
+constexpr int POLL_FRAME_INTERVAL_MS = 250;
+constexpr int READY_TIMEOUT_MS = 600000;
+
+// 相机停止后等待下一次细化的最长时间，超过即认为细化结束
+constexpr int REFINE_WAIT_MS = 500;
+constexpr int MAX_REFINE_FRAMES = 64;
+
+/**
+ * @brief 单帧的测量结果
+ */
+struct FrameSample {
+    double frameMs;         // grabFramebuffer的耗时，包括绘制、等待GPU完成和读回像素
+    double paintMs;         // paintGL的CPU耗时
+    double gpuMs;           // GPU计时(滞后一帧，不支持时为-1)
+    size_t pointsDrawn;
+};
+
+// 按序号生成的伪随机数(splitmix64)，各线程独立生成同一个点云
+uint64_t hashIndex(uint64_t x)
+{
+    uint64_t z = x + 0x9e3779b97f4a7c15ULL;
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+    return z ^ (z >> 31);
+}
+
+double unitValue(uint64_t hash)
+{
+    return (hash >> 11) * (1.0 / 9007199254740992.0);
+}
+
+// 起伏地形上均匀分布的点，同样的点数总是生成同样的点云
+std::unique_ptr<PointCloud> generateCloud(size_t count)
+{
+    std::unique_ptr<PointCloud> cloud(new PointCloud());
+    cloud->points.resize(count);
+    std::vector<Parallel::Range> ranges = Parallel::splitRange(count, 1 << 18);
+    Parallel::forEach(ranges, [&](const Parallel::Range& range) {
+        for (size_t i = range.begin; i < range.end; ++i) {
+            const double u = unitValue(hashIndex(3 * i)) * CLOUD_EXTENT;
+            const double v = unitValue(hashIndex(3 * i + 1)) * CLOUD_EXTENT;
+            const double noise = unitValue(hashIndex(3 * i + 2)) - 0.5;
+            const double height = 30.0 * std::sin(u / 150.0) * std::cos(v / 210.0)
+                                  + 5.0 * std::sin(u / 17.0 + v / 23.0) + noise;
+            cloud->points[i] = Point3D(u + CLOUD_OFFSET.x(), v + CLOUD_OFFSET.y(), height + CLOUD_OFFSET.z());
+        }
+    });
+    cloud->computeBounds();
+    return cloud;
+}
+
+// 运行事件循环一段时间(后台构建和上传线程的完成回调在这里执行)
+void runEvents(int ms)
+{
+    QEventLoop loop;
+    QTimer::singleShot(ms, &loop, &QEventLoop::quit);
+    loop.exec();
+}
+
+FrameSample renderFrame(PointCloudViewer& viewer)
+{
+    // 查看器不显示，grabFramebuffer在离屏帧缓冲中同步绘制一帧
+    QElapsedTimer timer;
+    timer.start();
+    viewer.grabFramebuffer();
+    FrameSample sample;
+    sample.frameMs = timer.nsecsElapsed() / 1e6;
+    
+    const PointCloudViewer::RenderStats stats = viewer.renderStats();
+    sample.paintMs = stats.frameTimeMs;
+    sample.gpuMs = stats.gpuTimeMs;
+    sample.pointsDrawn = stats.pointsDrawn;
+    
+    // 与界面中一样在两帧之间处理事件
+    QCoreApplication::processEvents();
+    return sample;
+}
+
+// 最近秩分位数、均值和最大值
+QJsonObject summarize(std::vector<double> values)
+{
+    QJsonObject summary;
+    if (values.empty()) {
+        return summary;
+    }
+    std::sort(values.begin(), values.end());
+    auto percentile = [&](double q) {
+        const size_t rank = static_cast<size_t>(std::ceil(q * values.size()));
+        return values[std::min(values.size(), std::max<size_t>(rank, 1)) - 1];
+    };
+    double sum = 0.0;
+    for (double value : values) {
+        sum += value;
+    }
+    summary["count"] = static_cast<qint64>(values.size());
+    summary["mean"] = sum / values.size();
+    summary["p50"] = percentile(0.50);
+    summary["p90"] = percentile(0.90);
+    summary["p95"] = percentile(0.95);
+    summary["p99"] = percentile(0.99);
+    summary["max"] = values.back();
+    return summary;
+}
+
+QJsonObject summarizePath(const QString& name, const std::vector<FrameSample>& samples, double elapsedMs)
+{
+    std::vector<double> frameMs, paintMs, gpuMs;
+    double pointsDrawn = 0.0;
+    for (const FrameSample& sample : samples) {
+        frameMs.push_back(sample.frameMs);
+        paintMs.push_back(sample.paintMs);
+        if (sample.gpuMs >= 0.0) {
+            gpuMs.push_back(sample.gpuMs);
+        }
+        pointsDrawn += sample.pointsDrawn;
+    }
+    
+    QJsonObject path;
+    path["name"] = name;
+    path["frames"] = static_cast<qint64>(samples.size());
+    path["elapsed_ms"] = elapsedMs;
+    path["frame_ms"] = summarize(frameMs);
+    path["paint_ms"] = summarize(paintMs);
+    path["gpu_ms"] = gpuMs.empty() ? QJsonValue() : QJsonValue(summarize(gpuMs));
+    path["points_drawn_mean"] = samples.empty() ? 0.0 : pointsDrawn / samples.size();
+    path["points_drawn_last"] = samples.empty() ? 0 : static_cast<qint64>(samples.back().pointsDrawn);
+    return path;
+}
+
+void sendMouse(PointCloudViewer& viewer, QEvent::Type type, const QPoint& pos, Qt::MouseButton button)
+{
+    const Qt::MouseButtons buttons = type == QEvent::MouseButtonRelease ? Qt::NoButton : Qt::MouseButtons(button);
+    QMouseEvent event(type, QPointF(pos), type == QEvent::MouseMove ? Qt::NoButton : button, buttons, Qt::NoModifier);
+    QCoreApplication::sendEvent(&viewer, &event);
+}
+
+// 按住button拖动，每帧移动step像素，returnHalfway时走完一半后折返
+QJsonObject runDragPath(PointCloudViewer& viewer, const QString& name, Qt::MouseButton button,
+                        const QPoint& step, bool returnHalfway, int frames)
+{
+    viewer.resetView();
+    QPoint pos(viewer.width() / 2, viewer.height() / 2);
+    sendMouse(viewer, QEvent::MouseButtonPress, pos, button);
+    
+    std::vector<FrameSample> samples;
+    QElapsedTimer elapsed;
+    elapsed.start();
+    for (int frame = 0; frame < frames; ++frame) {
+        const bool back = returnHalfway && frame >= frames / 2;
+        pos += back ? -step : step;
+        sendMouse(viewer, QEvent::MouseMove, pos, button);
+        samples.push_back(renderFrame(viewer));
+    }
+    const double elapsedMs = elapsed.nsecsElapsed() / 1e6;
+    sendMouse(viewer, QEvent::MouseButtonRelease, pos, button);
+    return summarizePath(name, samples, elapsedMs);
+}
+
+// 滚轮放大一半帧数，再缩小回来
+QJsonObject runZoomPath(PointCloudViewer& viewer, int frames)
+{
+    viewer.resetView();
+    const QPointF center(viewer.width() / 2.0, viewer.height() / 2.0);
+    
+    std::vector<FrameSample> samples;
+    QElapsedTimer elapsed;
+    elapsed.start();
+    for (int frame = 0; frame < frames; ++frame) {
+        const int delta = frame < frames / 2 ? 120 : -120;
+        QWheelEvent event(center, center, QPoint(), QPoint(0, delta), Qt::NoButton, Qt::NoModifier,
+                          Qt::NoScrollPhase, false);
+        QCoreApplication::sendEvent(&viewer, &event);
+        samples.push_back(renderFrame(viewer));
+    }
+    return summarizePath("zoom", samples, elapsed.nsecsElapsed() / 1e6);
+}
+
+// 相机静止后由细化定时器逐步增加预算，记录每次细化的一帧，直到不再细化
+QJsonObject runSettlePath(PointCloudViewer& viewer)
+{
+    viewer.resetView();
+    std::vector<FrameSample> samples;
+    QElapsedTimer elapsed;
+    elapsed.start();
+    samples.push_back(renderFrame(viewer));
+    double settledMs = elapsed.nsecsElapsed() / 1e6;
+    
+    while (static_cast<int>(samples.size()) < MAX_REFINE_FRAMES) {
+        bool timedOut = false;
+        QTimer guard;
+        guard.setSingleShot(true);
+        QObject::connect(&guard, &QTimer::timeout, [&timedOut]() { timedOut = true; });
+        guard.start(REFINE_WAIT_MS);
+        QCoreApplication::processEvents(QEventLoop::WaitForMoreEvents);
+        if (timedOut) {
+            break;
+        }
+        samples.push_back(renderFrame(viewer));
+        settledMs = elapsed.nsecsElapsed() / 1e6;
+    }
+    return summarizePath("settle", samples, settledMs);
+}
+
+QJsonObject runCloud(size_t count, const QSize& viewport, size_t budget, int frames, QJsonObject& renderer)
+{
+    QJsonObject run;
+    run["points"] = static_cast<qint64>(count);
+    
+    QElapsedTimer timer;
+    timer.start();
+    std::unique_ptr<PointCloud> cloud = generateCloud(count);
+    run["generate_ms"] = timer.nsecsElapsed() / 1e6;
+    
+    // 每种规模使用新的查看器，上传统计和显存互不影响
+    std::unique_ptr<PointCloudViewer> viewer(new PointCloudViewer());
+    viewer->resize(viewport);
+    viewer->setPointBudget(budget);
+    viewer->grabFramebuffer();
+    if (!viewer->isValid()) {
+        run["error"] = "无法创建OpenGL上下文";
+        return run;
+    }
+    if (renderer.isEmpty()) {
+        viewer->makeCurrent();
+        QOpenGLFunctions* gl = viewer->context()->functions();
+        renderer["vendor"] = QString::fromLatin1(reinterpret_cast<const char*>(gl->glGetString(GL_VENDOR)));
+        renderer["renderer"] = QString::fromLatin1(reinterpret_cast<const char*>(gl->glGetString(GL_RENDERER)));
+        renderer["version"] = QString::fromLatin1(reinterpret_cast<const char*>(gl->glGetString(GL_VERSION)));
+        viewer->doneCurrent();
+    }
+    
+    // 第一帧同步转换并上传整体或抽稀的预览，之后等待后台的细节层次构建和节点上传完成
+    timer.restart();
+    viewer->setTargetCloud(cloud.get());
+    const FrameSample first = renderFrame(*viewer);
+    run["first_frame_ms"] = first.frameMs;
+    
+    auto ready = [&]() {
+        const PointCloudViewer::RenderStats stats = viewer->renderStats();
+        return stats.pointsResident == count && (count <= LODOctree::NODE_CAPACITY || stats.chunksResident > 1);
+    };
+    QElapsedTimer sinceFrame;
+    sinceFrame.start();
+    while (!ready() && timer.elapsed() < READY_TIMEOUT_MS) {
+        runEvents(POLL_INTERVAL_MS);
+        
+        // 没有上传线程时节点在绘制时上传
+        if (sinceFrame.elapsed() >= POLL_FRAME_INTERVAL_MS) {
+            renderFrame(*viewer);
+            sinceFrame.restart();
+        }
+    }
+    if (!ready()) {
+        run["error"] = "等待细节层次上传超时";
+        return run;
+    }
+    run["ready_ms"] = timer.nsecsElapsed() / 1e6;
+    
+    const PointCloudViewer::RenderStats stats = viewer->renderStats();
+    QJsonObject upload;
+    upload["bytes"] = static_cast<qint64>(stats.uploadedBytes);
+    upload["time_ms"] = stats.uploadTimeMs;
+    upload["bandwidth_mbps"] = stats.uploadBandwidthMBps();
+    run["upload"] = upload;
+    run["gpu_buffer_bytes"] = static_cast<qint64>(stats.gpuBufferBytes);
+    run["chunks"] = static_cast<qint64>(stats.chunksResident);
+    
+    // 旋转一周、平移后折返、缩放后还原，最后静止细化
+    const int orbitStep = std::max(1, 720 / frames);    // 每像素旋转0.5度
+    QJsonArray paths;
+    paths.append(runDragPath(*viewer, "orbit", Qt::LeftButton, QPoint(orbitStep, 0), false, frames));
+    paths.append(runDragPath(*viewer, "pan", Qt::RightButton, QPoint(8, 0), true, frames));
+    paths.append(runZoomPath(*viewer, frames));
+    paths.append(runSettlePath(*viewer));
+    run["paths"] = paths;
+    
+    // 先销毁查看器(释放显存)，再释放它引用的点云
+    viewer.reset();
+    return run;
+}
+
+} // namespace
+
+int main(int argc, char *argv[])
+{
+    // 不打开窗口，默认使用离屏平台
+    if (qEnvironmentVariableIsEmpty("QT_QPA_PLATFORM")) {
+        qputenv("QT_QPA_PLATFORM", "offscreen");
+    }
+    QApplication app(argc, argv);
+    QApplication::setApplicationName("viewer_benchmark");
+    
+    QCommandLineParser parser;
+    parser.setApplicationDescription("PointCloudViewer渲染基准");
+    parser.addHelpOption();
+    QCommandLineOption pointsOption("points", "合成点云的点数(百万)，逗号分隔", "list", "1,10,50");
+    QCommandLineOption framesOption("frames", "每条相机路径的帧数", "n", "120");
+    QCommandLineOption widthOption("width", "视口宽度", "px", "1280");
+    QCommandLineOption heightOption("height", "视口高度", "px", "720");
+    QCommandLineOption budgetOption("budget", "每帧点数预算(百万)", "millions", "2");
+    QCommandLineOption outputOption("output", "结果文件，默认输出到标准输出", "file");
+    parser.addOptions({pointsOption, framesOption, widthOption, heightOption, budgetOption, outputOption});
+    parser.process(app);
+    
+    const int frames = std::max(2, parser.value(framesOption).toInt());
+    const QSize viewport(std::max(16, parser.value(widthOption).toInt()),
+                         std::max(16, parser.value(heightOption).toInt()));
+    const size_t budget = static_cast<size_t>(std::max(0.01, parser.value(budgetOption).toDouble()) * 1e6);
+    
+    QJsonObject renderer;
+    QJsonArray runs;
+    for (const QString& item : parser.value(pointsOption).split(',', Qt::SkipEmptyParts)) {
+        const double millions = item.trimmed().toDouble();
+        if (millions <= 0.0) {
+            qWarning() << "忽略无效的点数:" << item;
+            continue;
+        }
+        const size_t count = static_cast<size_t>(millions * 1e6);
+        qInfo() << "基准:" << count << "个点";
+        runs.append(runCloud(count, viewport, budget, frames, renderer));
+    }
+    
+    QJsonObject result;
+    result["renderer"] = renderer;
+    result["viewport"] = QJsonArray{viewport.width(), viewport.height()};
+    result["point_budget"] = static_cast<qint64>(budget);
+    result["frames_per_path"] = frames;
+    result["runs"] = runs;
+    const QByteArray json = QJsonDocument(result).toJson();
+    
+    if (parser.isSet(outputOption)) {
+        QFile file(parser.value(outputOption));
+        if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+            qCritical() << "无法写入结果文件:" << file.fileName();
+            return 1;
+        }
+        file.write(json);
+    } else {
+        QFile out;
+        out.open(stdout, QIODevice::WriteOnly);
+        out.write(json);
+    }
+    
+    // 任何规模失败(例如没有OpenGL)时返回非零，便于持续集成判断
+    for (const QJsonValue& run : runs) {
+        if (run.toObject().contains("error")) {
+            return 1;
+        }
+    }
+    return renderer.isEmpty() ? 1 : 0;
+}
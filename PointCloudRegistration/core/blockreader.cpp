@@ -0,0 +1,349 @@
+#include "blockreader.h"
+#include <vector>
+#include <mutex>
+#include <condition_variable>
+#include <algorithm>
+#include <thread>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+#ifdef PCR_WITH_LIBURING
+#include <liburing.h>
+#endif
+
+BlockReader::BlockReader(size_t queueDepth)
+    : m_queueDepth(std::max<size_t>(queueDepth, 1))
+#ifdef _WIN32
+    , m_handle(INVALID_HANDLE_VALUE)
+#else
+    , m_fd(-1)
+#endif
+{
+}
+
+BlockReader::~BlockReader()
+{
+    close();
+}
+
+const char* BlockReader::backend()
+{
+#ifdef PCR_WITH_LIBURING
+    return "io_uring";
+#else
+    return "pread";
+#endif
+}
+
+#ifdef _WIN32
+
+bool BlockReader::open(const std::string& filename)
+{
+    close();
+    
+    int wlen = MultiByteToWideChar(CP_UTF8, 0, filename.c_str(), -1, nullptr, 0);
+    std::wstring wname(wlen > 0 ? wlen - 1 : 0, L'\0');
+    if (wlen > 0) {
+        MultiByteToWideChar(CP_UTF8, 0, filename.c_str(), -1, &wname[0], wlen);
+    }
+    
+    HANDLE file = CreateFileW(wname.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr,
+                              OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+    if (file == INVALID_HANDLE_VALUE) {
+        return false;
+    }
+    m_handle = file;
+    return true;
+}
+
+void BlockReader::close()
+{
+    if (m_handle != INVALID_HANDLE_VALUE) {
+        CloseHandle(m_handle);
+        m_handle = INVALID_HANDLE_VALUE;
+    }
+}
+
+bool BlockReader::isOpen() const
+{
+    return m_handle != INVALID_HANDLE_VALUE;
+}
+
+bool BlockReader::readAt(uint64_t offset, size_t length, char* out) const
+{
+    // 同步句柄上带偏移的ReadFile相当于pread，单次长度受DWORD限制
+    while (length > 0) {
+        OVERLAPPED overlapped = {};
+        overlapped.Offset = static_cast<DWORD>(offset);
+        overlapped.OffsetHigh = static_cast<DWORD>(offset >> 32);
+        DWORD request = static_cast<DWORD>(std::min<size_t>(length, 1u << 30));
+        DWORD bytes = 0;
+        if (!ReadFile(m_handle, out, request, &bytes, &overlapped) || bytes == 0) {
+            return false;
+        }
+        offset += bytes;
+        out += bytes;
+        length -= bytes;
+    }
+    return true;
+}
+
+#else
+
+bool BlockReader::open(const std::string& filename)
+{
+    close();
+    m_fd = ::open(filename.c_str(), O_RDONLY);
+    if (m_fd < 0) {
+        return false;
+    }
+#ifdef POSIX_FADV_SEQUENTIAL
+    posix_fadvise(m_fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+#endif
+    return true;
+}
+
+void BlockReader::close()
+{
+    if (m_fd >= 0) {
+        ::close(m_fd);
+        m_fd = -1;
+    }
+}
+
+bool BlockReader::isOpen() const
+{
+    return m_fd >= 0;
+}
+
+bool BlockReader::readAt(uint64_t offset, size_t length, char* out) const
+{
+    while (length > 0) {
+        ssize_t bytes = ::pread(m_fd, out, length, static_cast<off_t>(offset));
+        if (bytes <= 0) {
+            return false;
+        }
+        offset += static_cast<uint64_t>(bytes);
+        out += bytes;
+        length -= static_cast<size_t>(bytes);
+    }
+    return true;
+}
+
+#endif
+
+bool BlockReader::read(uint64_t offset, uint64_t length, size_t blockSize, const Consumer& consume)
+{
+    if (!isOpen() || blockSize == 0) {
+        return false;
+    }
+    if (length == 0) {
+        return true;
+    }
+    
+    bool supported = false;
+    bool ok = readUring(offset, length, blockSize, consume, supported);
+    return supported ? ok : readThreaded(offset, length, blockSize, consume);
+}
+
+bool BlockReader::readThreaded(uint64_t offset, uint64_t length, size_t blockSize, const Consumer& consume)
+{
+    const size_t numBlocks = static_cast<size_t>((length + blockSize - 1) / blockSize);
+    const size_t depth = std::min(m_queueDepth, numBlocks);
+    std::vector<std::vector<char>> buffers(depth, std::vector<char>(static_cast<size_t>(
+        std::min<uint64_t>(blockSize, length))));
+    auto blockLength = [&](size_t block) {
+        return static_cast<size_t>(std::min<uint64_t>(blockSize, length - uint64_t(block) * blockSize));
+    };
+    
+    // 读取线程最多领先处理线程depth个块，每个块占用一个缓冲区。
+    // 读取线程单独创建而不用全局线程池：调用者通常本身就在线程池中(后台加载、建立索引)，
+    // 线程池已满时排队的读取任务永远得不到执行，处理线程会一直等待
+    std::mutex mutex;
+    std::condition_variable changed;
+    size_t produced = 0;
+    size_t consumed = 0;
+    bool failed = false;
+    bool stopped = false;
+    
+    std::thread producer([&]() {
+        for (size_t block = 0; block < numBlocks; ++block) {
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                changed.wait(lock, [&]() { return stopped || block < consumed + depth; });
+                if (stopped) {
+                    return;
+                }
+            }
+            
+            bool ok = readAt(offset + uint64_t(block) * blockSize, blockLength(block), buffers[block % depth].data());
+            
+            std::lock_guard<std::mutex> lock(mutex);
+            if (!ok) {
+                failed = true;
+                changed.notify_all();
+                return;
+            }
+            produced = block + 1;
+            changed.notify_all();
+        }
+    });
+    
+    bool complete = true;
+    for (size_t block = 0; block < numBlocks; ++block) {
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            changed.wait(lock, [&]() { return failed || block < produced; });
+            if (block >= produced) {
+                complete = false;
+                break;
+            }
+        }
+        
+        bool more = consume(buffers[block % depth].data(), offset + uint64_t(block) * blockSize, blockLength(block));
+        
+        std::lock_guard<std::mutex> lock(mutex);
+        consumed = block + 1;
+        if (!more) {
+            stopped = true;
+            complete = false;
+        }
+        changed.notify_all();
+        if (!more) {
+            break;
+        }
+    }
+    
+    producer.join();
+    return complete;
+}
+
+#ifdef PCR_WITH_LIBURING
+
+bool BlockReader::readUring(uint64_t offset, uint64_t length, size_t blockSize, const Consumer& consume,
+                            bool& supported)
+{
+    const size_t numBlocks = static_cast<size_t>((length + blockSize - 1) / blockSize);
+    const size_t depth = std::min(m_queueDepth, numBlocks);
+    
+    io_uring ring;
+    if (io_uring_queue_init(static_cast<unsigned>(depth), &ring, 0) < 0) {
+        supported = false;
+        return false;
+    }
+    supported = true;
+    
+    // 每个槽位对应一个缓冲区，记录其中正在读取的块和已读入的字节数
+    struct Slot {
+        std::vector<char> buffer;
+        uint64_t offset = 0;
+        size_t length = 0;
+        size_t done = 0;
+        bool ready = false;
+    };
+    std::vector<Slot> slots(depth);
+    size_t inFlight = 0;
+    
+    auto submit = [&](Slot& slot) {
+        io_uring_sqe* sqe = io_uring_get_sqe(&ring);
+        if (!sqe) {
+            return false;
+        }
+        io_uring_prep_read(sqe, m_fd, slot.buffer.data() + slot.done, static_cast<unsigned>(slot.length - slot.done),
+                           slot.offset + slot.done);
+        io_uring_sqe_set_data(sqe, &slot);
+        ++inFlight;
+        return true;
+    };
+    
+    auto start = [&](size_t block) {
+        Slot& slot = slots[block % depth];
+        slot.offset = offset + uint64_t(block) * blockSize;
+        slot.length = static_cast<size_t>(std::min<uint64_t>(blockSize, length - uint64_t(block) * blockSize));
+        slot.buffer.resize(slot.length);
+        slot.done = 0;
+        slot.ready = false;
+        return submit(slot);
+    };
+    
+    bool ok = true;
+    for (size_t block = 0; block < depth && ok; ++block) {
+        ok = start(block);
+    }
+    ok = ok && io_uring_submit(&ring) >= 0;
+    
+    // 完成顺序可能与提交顺序不同，按块顺序等待当前块就绪后再处理
+    for (size_t block = 0; ok && block < numBlocks; ++block) {
+        Slot& current = slots[block % depth];
+        while (ok && !current.ready) {
+            io_uring_cqe* cqe = nullptr;
+            if (io_uring_wait_cqe(&ring, &cqe) < 0) {
+                ok = false;
+                break;
+            }
+            Slot* slot = static_cast<Slot*>(io_uring_cqe_get_data(cqe));
+            int result = cqe->res;
+            io_uring_cqe_seen(&ring, cqe);
+            --inFlight;
+            
+            if (result <= 0) {
+                ok = false;
+                break;
+            }
+            slot->done += static_cast<size_t>(result);
+            if (slot->done < slot->length) {
+                // 短读：继续读取剩余部分
+                ok = submit(*slot) && io_uring_submit(&ring) >= 0;
+            } else {
+                slot->ready = true;
+            }
+        }
+        if (!ok) {
+            break;
+        }
+        
+        if (!consume(current.buffer.data(), current.offset, current.length)) {
+            ok = false;
+            break;
+        }
+        
+        if (block + depth < numBlocks) {
+            ok = start(block + depth) && io_uring_submit(&ring) >= 0;
+        }
+    }
+    
+    // 退出前等待仍在进行的读请求，之后才能释放缓冲区
+    while (inFlight > 0) {
+        io_uring_cqe* cqe = nullptr;
+        if (io_uring_wait_cqe(&ring, &cqe) < 0) {
+            break;
+        }
+        io_uring_cqe_seen(&ring, cqe);
+        --inFlight;
+    }
+    io_uring_queue_exit(&ring);
+    return ok;
+}
+
+#else
+
+bool BlockReader::readUring(uint64_t offset, uint64_t length, size_t blockSize, const Consumer& consume,
+                            bool& supported)
+{
+    (void)offset;
+    (void)length;
+    (void)blockSize;
+    (void)consume;
+    supported = false;
+    return false;
+}
+
+#endif
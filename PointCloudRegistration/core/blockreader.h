@@ -0,0 +1,68 @@
+#ifndef BLOCKREADER_H
+#define BLOCKREADER_H
+
+#include <string>
+#include <functional>
+#include <cstddef>
+#include <cstdint>
+
+/**
+ * @brief 顺序分块读取文件的异步流水线
+ *
+ * 把文件区间按固定大小切分成块，读取阶段最多提前读入queueDepth个块，
+ * 调用线程处理当前块(通常是交给线程池并行解码)的同时磁盘继续读取后续的块。
+ * 编译时定义PCR_WITH_LIBURING时用io_uring一次提交所有空闲缓冲区的读请求，
+ * 否则(或io_uring初始化失败时)由一个后台线程依次pread/ReadFile。
+ */
+class BlockReader
+{
+public:
+    /**
+     * @brief 块就绪时在调用线程中的回调
+     *
+     * 参数为块数据、块在文件中的偏移和块长度，数据只在回调期间有效。返回false时停止读取。
+     */
+    using Consumer = std::function<bool(const char* data, uint64_t offset, size_t length)>;
+    
+    /**
+     * @param queueDepth 同时在读或等待处理的块数(至少为1，1表示读取和处理交替进行)
+     */
+    explicit BlockReader(size_t queueDepth = 2);
+    ~BlockReader();
+    
+    BlockReader(const BlockReader&) = delete;
+    BlockReader& operator=(const BlockReader&) = delete;
+    
+    bool open(const std::string& filename);
+    void close();
+    bool isOpen() const;
+    
+    size_t queueDepth() const { return m_queueDepth; }
+    
+    /**
+     * @brief 按顺序读取[offset, offset + length)并逐块回调
+     * @param offset 起始字节偏移
+     * @param length 字节数
+     * @param blockSize 每块字节数(最后一块可能较短)
+     * @param consume 块回调
+     * @return 是否读完整个区间(读取出错或回调要求停止时为false)
+     */
+    bool read(uint64_t offset, uint64_t length, size_t blockSize, const Consumer& consume);
+    
+    // 编译时选择的读取方式("io_uring"或"pread")，io_uring初始化失败时运行期仍会退回pread
+    static const char* backend();
+
+private:
+    bool readThreaded(uint64_t offset, uint64_t length, size_t blockSize, const Consumer& consume);
+    bool readUring(uint64_t offset, uint64_t length, size_t blockSize, const Consumer& consume, bool& supported);
+    bool readAt(uint64_t offset, size_t length, char* out) const;
+    
+    size_t m_queueDepth;
+#ifdef _WIN32
+    void* m_handle;
+#else
+    int m_fd;
+#endif
+};
+
+#endif // BLOCKREADER_H
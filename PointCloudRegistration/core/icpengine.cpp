@@ -9,7 +9,9 @@ ICPEngine::ICPEngine(QObject *parent)
     , m_source(nullptr)
     , m_target(nullptr)
     , m_shouldStop(false)
+    , m_indexedTarget(nullptr)
 {
+    qRegisterMetaType<IterationResult>("IterationResult");
 }
 
 ICPEngine::~ICPEngine()
@@ -59,6 +61,19 @@ void ICPEngine::registerPointClouds(PointCloud* source, const PointCloud* target
     runICP();
 }
 
+std::shared_ptr<const Octree> ICPEngine::targetIndex(const PointCloud* target) const
+{
+    std::lock_guard<std::mutex> lock(m_indexMutex);
+    return target && target == m_indexedTarget ? m_targetIndex : nullptr;
+}
+
+void ICPEngine::releaseTargetIndex()
+{
+    std::lock_guard<std::mutex> lock(m_indexMutex);
+    m_targetIndex.reset();
+    m_indexedTarget = nullptr;
+}
+
 void ICPEngine::stop()
 {
     m_shouldStop = true;
@@ -116,17 +131,38 @@ Eigen::Matrix4d ICPEngine::computeBestFitTransform(const Eigen::MatrixXd& A, con
 
 void ICPEngine::runICP()
 {
-    emit logMessage("构建目标点云八叉树索引...");
+    // 目标点云和八叉树参数不变时复用上一次配准建立的八叉树
+    std::shared_ptr<const Octree> index;
+    {
+        std::lock_guard<std::mutex> lock(m_indexMutex);
+        if (m_indexedTarget == m_target && m_indexParams.octreeMaxPoints == m_params.octreeMaxPoints
+            && m_indexParams.octreeMaxDepth == m_params.octreeMaxDepth) {
+            index = m_targetIndex;
+        }
+    }
     
-    // 构建八叉树
-    Octree octree(m_target->points, m_params.octreeMaxPoints, m_params.octreeMaxDepth);
+    if (index) {
+        emit logMessage("复用目标点云八叉树索引");
+    } else {
+        emit logMessage("构建目标点云八叉树索引...");
     
-    emit logMessage("八叉树构建完成!");
+        // 构建八叉树
+        index = std::make_shared<const Octree>(m_target->points, m_params.octreeMaxPoints, m_params.octreeMaxDepth);
+        {
+            std::lock_guard<std::mutex> lock(m_indexMutex);
+            m_targetIndex = index;
+            m_indexedTarget = m_target;
+            m_indexParams = m_params;
+        }
+        
+        emit logMessage("八叉树构建完成!");
+    }
+    const Octree& octree = *index;
     
     // 测试八叉树查询
     if (!m_source->points.empty() && !m_target->points.empty()) {
         Point3D test_query = m_source->points[0];
-        int test_idx = octree.findNearest(test_query);
+        size_t test_idx = octree.findNearest(test_query);
         const Point3D& test_result = m_target->points[test_idx];
         double test_dist = computeDistance(test_query, test_result);
         emit logMessage(QString("八叉树测试: 查询点(%1,%2,%3) -> 最近点[%4](%5,%6,%7), 距离=%8")
@@ -136,13 +172,13 @@ void ICPEngine::runICP()
                        .arg(test_dist, 0, 'f', 3));
     }
     
-    int row = static_cast<int>(m_source->size());
+    const Eigen::Index row = static_cast<Eigen::Index>(m_source->size());
     
     // 转换为Eigen矩阵
     Eigen::MatrixXd src = Eigen::MatrixXd::Ones(4, row);
     Eigen::MatrixXd src3d = Eigen::MatrixXd::Ones(3, row);
     
-    for (int i = 0; i < row; i++) {
+    for (Eigen::Index i = 0; i < row; i++) {
         src3d(0, i) = m_source->points[i].x;
         src3d(1, i) = m_source->points[i].y;
         src3d(2, i) = m_source->points[i].z;
@@ -156,6 +192,11 @@ void ICPEngine::runICP()
     double prev_error = 1e10;
     int no_improvement_count = 0;
     
+    // 距离缓冲在迭代间复用，结束后可以直接作为残差导出
+    std::vector<double> distances(row);
+    double threshold = 0.0;
+    bool distancesStale = false;      // 距离算出后又应用了变换(达到最大迭代次数时循环在此状态下结束)
+    
     for (int iter = 0; iter < m_params.maxIterations; iter++) {
         if (m_shouldStop) {
             emit logMessage("配准已停止");
@@ -166,16 +207,16 @@ void ICPEngine::runICP()
         emit logMessage(QString("迭代 %1/%2 ...").arg(iter + 1).arg(m_params.maxIterations));
         
         // 步骤1: 使用八叉树找到最近点对应
-        std::vector<int> correspondences(row);
+        std::vector<size_t> correspondences(row);
         Eigen::MatrixXd dst_matched = Eigen::MatrixXd::Ones(3, row);
         
-        for (int i = 0; i < row; i++) {
+        for (Eigen::Index i = 0; i < row; i++) {
             Point3D query;
             query.x = src3d(0, i);
             query.y = src3d(1, i);
             query.z = src3d(2, i);
             
-            int nearest_idx = octree.findNearest(query);
+            size_t nearest_idx = octree.findNearest(query);
             correspondences[i] = nearest_idx;
             
             dst_matched(0, i) = m_target->points[nearest_idx].x;
@@ -184,19 +225,19 @@ void ICPEngine::runICP()
         }
         
         // 步骤2: 计算所有点对的距离
-        std::vector<double> distances(row);
+        distancesStale = false;
         double min_distance = std::numeric_limits<double>::max();
         double max_distance = 0;
         int problem_count = 0;
         
-        for (int i = 0; i < row; i++) {
+        for (Eigen::Index i = 0; i < row; i++) {
             Point3D p_src;
             p_src.x = src3d(0, i);
             p_src.y = src3d(1, i);
             p_src.z = src3d(2, i);
             
-            int nearest_idx = correspondences[i];
-            if (nearest_idx < 0 || nearest_idx >= static_cast<int>(m_target->points.size())) {
+            size_t nearest_idx = correspondences[i];
+            if (nearest_idx >= m_target->points.size()) {
                 emit logMessage(QString("警告: 索引越界 i=%1, nearest_idx=%2").arg(i).arg(nearest_idx));
                 problem_count++;
                 distances[i] = std::numeric_limits<double>::max();
@@ -246,7 +287,6 @@ void ICPEngine::runICP()
         
         // 使用3-sigma原则设置距离阈值剔除离群点
         // 第一次迭代时,如果标准差很小(点云很密集),使用更大的阈值
-        double threshold;
         if (iter == 0) {
             // 第一次迭代:使用较宽松的阈值,防止过度剔除
             threshold = mean_dist + std::max(m_params.sigmaMultiplier * std_dev, mean_dist * 0.5);
@@ -260,19 +300,19 @@ void ICPEngine::runICP()
                        .arg(threshold, 0, 'f', 6));
         
         // 统计有效点对
-        std::vector<int> valid_indices;
-        for (int i = 0; i < row; i++) {
+        std::vector<Eigen::Index> valid_indices;
+        for (Eigen::Index i = 0; i < row; i++) {
             if (distances[i] <= threshold) {
                 valid_indices.push_back(i);
             }
         }
         
-        int valid_count = static_cast<int>(valid_indices.size());
-        int outlier_count = row - valid_count;
+        Eigen::Index valid_count = static_cast<Eigen::Index>(valid_indices.size());
+        Eigen::Index outlier_count = row - valid_count;
         
         // 只用有效点计算RMSE
         double sum_sq = 0;
-        for (int idx : valid_indices) {
+        for (Eigen::Index idx : valid_indices) {
             sum_sq += distances[idx] * distances[idx];
         }
         double mean_error = (valid_count > 0) ? std::sqrt(sum_sq / valid_count) : 0;
@@ -294,8 +334,8 @@ void ICPEngine::runICP()
                 IterationResult iterResult;
                 iterResult.iteration = iter + 1;
                 iterResult.rmse = mean_error;
-                iterResult.validPoints = valid_count;
-                iterResult.outlierPoints = outlier_count;
+                iterResult.validPoints = static_cast<size_t>(valid_count);
+                iterResult.outlierPoints = static_cast<size_t>(outlier_count);
                 iterResult.transform = T_cumulative;
                 
                 m_result.iterationHistory.push_back(iterResult);
@@ -325,8 +365,8 @@ void ICPEngine::runICP()
         Eigen::MatrixXd src_valid(3, valid_count);
         Eigen::MatrixXd dst_valid(3, valid_count);
         
-        for (int i = 0; i < valid_count; i++) {
-            int idx = valid_indices[i];
+        for (Eigen::Index i = 0; i < valid_count; i++) {
+            Eigen::Index idx = valid_indices[i];
             src_valid(0, i) = src3d(0, idx);
             src_valid(1, i) = src3d(1, idx);
             src_valid(2, i) = src3d(2, idx);
@@ -344,13 +384,14 @@ void ICPEngine::runICP()
         // 应用变换
         src = T * src;
         src3d = src.topRows(3);
+        distancesStale = true;
         
         // 记录迭代结果
         IterationResult iterResult;
         iterResult.iteration = iter + 1;
         iterResult.rmse = mean_error;
-        iterResult.validPoints = valid_count;
-        iterResult.outlierPoints = outlier_count;
+        iterResult.validPoints = static_cast<size_t>(valid_count);
+        iterResult.outlierPoints = static_cast<size_t>(outlier_count);
         iterResult.transform = T_cumulative;
         
         // 计算旋转角度和平移距离
@@ -368,7 +409,7 @@ void ICPEngine::runICP()
     }
     
     // 将结果写回源点云
-    for (int i = 0; i < row; i++) {
+    for (Eigen::Index i = 0; i < row; i++) {
         m_source->points[i].x = src3d(0, i);
         m_source->points[i].y = src3d(1, i);
         m_source->points[i].z = src3d(2, i);
@@ -386,6 +427,22 @@ void ICPEngine::runICP()
     m_result.totalIterations = static_cast<int>(m_result.iterationHistory.size());
     m_result.finalRMSE = m_result.iterationHistory.empty() ? 0.0 : m_result.iterationHistory.back().rmse;
     
+    // 移交距离缓冲。收敛或误差增加时缓冲已对应最终位置；达到最大迭代次数时最后一次变换在搜索之后，
+    // 需要按最终位置再做一遍最近邻搜索(代价与一次迭代的对应搜索相同，仅在导出残差时发生)
+    if (m_params.exportResiduals) {
+        if (distancesStale) {
+            for (Eigen::Index i = 0; i < row; i++) {
+                Point3D query;
+                query.x = src3d(0, i);
+                query.y = src3d(1, i);
+                query.z = src3d(2, i);
+                distances[i] = computeDistance(query, m_target->points[octree.findNearest(query)]);
+            }
+        }
+        m_result.residuals = std::make_shared<const std::vector<double>>(std::move(distances));
+        m_result.residualThreshold = threshold;
+    }
+    
     emit logMessage("========== 配准完成 ==========");
     emit logMessage(QString("总迭代次数: %1").arg(m_result.totalIterations));
     emit logMessage(QString("最终RMSE: %1").arg(m_result.finalRMSE, 0, 'f', 6));
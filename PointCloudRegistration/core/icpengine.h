@@ -4,9 +4,14 @@
 #include <QObject>
 #include <QThread>
 #include <vector>
+#include <atomic>
+#include <memory>
+#include <mutex>
 #include "pointcloud.h"
 #include "Eigen/Eigen"
 
+class Octree;
+
 /**
  * @brief ICP配准参数
  */
@@ -16,6 +21,7 @@ struct ICPParameters {
     double sigmaMultiplier = 3.0;     // 3-sigma阈值倍数
     int octreeMaxPoints = 10;         // 八叉树每节点最大点数
     int octreeMaxDepth = 20;          // 八叉树最大深度
+    bool exportResiduals = false;     // 导出最终变换下的点对距离(ICPResult::residuals)
 };
 
 /**
@@ -24,13 +30,16 @@ struct ICPParameters {
 struct IterationResult {
     int iteration;                    // 迭代次数
     double rmse;                      // RMSE值
-    int validPoints;                  // 有效点对数
-    int outlierPoints;                // 离群点数
+    size_t validPoints;               // 有效点对数
+    size_t outlierPoints;             // 离群点数
     Eigen::Matrix4d transform;        // 累积变换矩阵
     double rotationAngle;             // 旋转角度（度）
     double translationDistance;       // 平移距离
 };
 
+// 迭代结果由工作线程中的信号排队送达界面(实时显示配准过程)
+Q_DECLARE_METATYPE(IterationResult)
+
 /**
  * @brief ICP配准结果
  */
@@ -41,6 +50,12 @@ struct ICPResult {
     double finalR[3][3];              // 最终旋转矩阵
     double finalT[3];                 // 最终平移向量
     std::vector<IterationResult> iterationHistory;  // 迭代历史
+    
+    // 最终变换下每个源点到最近目标点的距离(与源点云同序，exportResiduals为false时为空)。
+    // 直接接管引擎的距离缓冲，共享而不复制。迭代在收敛或误差增加时结束，缓冲已对应最终变换；
+    // 达到最大迭代次数时引擎按最终位置多做一遍最近邻搜索
+    std::shared_ptr<const std::vector<double>> residuals;
+    double residualThreshold;         // 最后一次迭代的离群点阈值，超过的点未参与配准
 };
 
 /**
@@ -62,11 +77,16 @@ public:
     
     // 配准接口
     void registerPointClouds(PointCloud* source, const PointCloud* target);
-    void stop();
+    void stop();        // 线程安全，在下一次迭代开始前停止
     
     // 获取结果
     ICPResult getResult() const { return m_result; }
     
+    // 目标点云的最近点索引：目标点云和八叉树参数不变时在多次配准间复用，也共享给拾取等查询。
+    // 只返回为target建立的索引，没有时为nullptr(线程安全)
+    std::shared_ptr<const Octree> targetIndex(const PointCloud* target) const;
+    void releaseTargetIndex();      // 目标点云释放或修改前调用
+    
 signals:
     void started();
     void progressUpdated(int iteration, int total, double rmse);
@@ -83,7 +103,13 @@ private:
     PointCloud* m_source;
     const PointCloud* m_target;
     ICPResult m_result;
-    bool m_shouldStop;
+    std::atomic<bool> m_shouldStop;     // 由界面线程设置，配准线程读取
+    
+    // 上一次配准建立的目标点云索引及其对应的点云和参数
+    mutable std::mutex m_indexMutex;
+    std::shared_ptr<const Octree> m_targetIndex;
+    const PointCloud* m_indexedTarget;
+    ICPParameters m_indexParams;
 };
 
 #endif // ICPENGINE_H
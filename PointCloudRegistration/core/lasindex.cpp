@@ -0,0 +1,514 @@
+#include "lasindex.h"
+#include "laspointformats.h"
+#include "parallel.h"
+#include <fstream>
+#include <iostream>
+#include <algorithm>
+#include <unordered_map>
+#include <unordered_set>
+#include <cmath>
+#include <cstring>
+#include <filesystem>
+
+namespace {
+
+// 旁路索引文件标识和版本
+const char SIDECAR_MAGIC[8] = {'P', 'C', 'R', 'L', 'I', 'D', 'X', '\0'};
+constexpr uint32_t SIDECAR_VERSION = 3;
+
+// 旁路索引头部(标识之后)和单元表每个条目的字节数
+constexpr size_t SIDECAR_HEADER_SIZE = 4 + 4 + 8 + 8 + 8 + 4 * 8 + 8;
+constexpr size_t SIDECAR_CELL_SIZE = 4 * 4 + 8 + 8;
+
+// 单元键中每个坐标占20位，层级不能超过16
+constexpr int INDEX_MAX_DEPTH = 16;
+
+// 自动选择深度时最深层每个单元的目标点数(按地表近似二维分布估算)
+constexpr size_t INDEX_CELL_POINTS = 65536;
+
+// 分配层级的最小单位(连续记录数)，块内记录同层，单元中的记录段随之变长
+constexpr uint64_t INDEX_LEVEL_BLOCK = 256;
+
+// 生成索引时每批解码的点数，以及每个并行任务的最小点数
+constexpr size_t INDEX_BATCH = size_t(1) << 22;
+constexpr size_t INDEX_MIN_CHUNK = 65536;
+
+// COPC信息VLR，其中记录了根层级页在文件中的位置
+const char* const COPC_USER_ID = "copc";
+constexpr uint16_t COPC_INFO_RECORD_ID = 1;
+constexpr size_t COPC_INFO_SIZE = 160;
+constexpr size_t COPC_ENTRY_SIZE = 32;
+
+using LASFormat::readField;
+
+uint64_t packKey(int level, int x, int y, int z)
+{
+    return (static_cast<uint64_t>(level) << 60) | (static_cast<uint64_t>(x) << 40)
+         | (static_cast<uint64_t>(y) << 20) | static_cast<uint64_t>(z);
+}
+
+LASSpatialIndex::Cell unpackKey(uint64_t key)
+{
+    LASSpatialIndex::Cell cell;
+    cell.level = static_cast<int>(key >> 60);
+    cell.x = static_cast<int>((key >> 40) & 0xFFFFF);
+    cell.y = static_cast<int>((key >> 20) & 0xFFFFF);
+    cell.z = static_cast<int>(key & 0xFFFFF);
+    return cell;
+}
+
+uint64_t splitmix64(uint64_t x)
+{
+    x += 0x9E3779B97F4A7C15ull;
+    x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ull;
+    x = (x ^ (x >> 27)) * 0x94D049BB133111EBull;
+    return x ^ (x >> 31);
+}
+
+/**
+ * @brief 按记录所在块序号的哈希分配层级
+ *
+ * 哈希值每多两个前导零降低一层，第l层被选中的概率是第l+1层的1/4，
+ * 与地表点云中每层占用单元数的增长(约4倍)相抵，各层单元的点数大致相当。
+ */
+int levelOf(uint64_t record, int depth)
+{
+    uint64_t h = splitmix64(record / INDEX_LEVEL_BLOCK);
+    int zeros = 0;
+    while (zeros < 2 * depth && !(h & (uint64_t(1) << 63))) {
+        h <<= 1;
+        ++zeros;
+    }
+    return depth - zeros / 2;
+}
+
+// 把一条记录或一段记录追加到有序的记录段列表，与末尾相邻时直接延长
+void appendRun(std::vector<LASRecordRun>& runs, const LASRecordRun& run)
+{
+    if (!runs.empty() && runs.back().first + runs.back().count == run.first) {
+        runs.back().count += run.count;
+    } else {
+        runs.push_back(run);
+    }
+}
+
+template<typename T>
+void appendValue(std::vector<char>& buffer, const T& value)
+{
+    const char* bytes = reinterpret_cast<const char*>(&value);
+    buffer.insert(buffer.end(), bytes, bytes + sizeof(T));
+}
+
+// 无符号变长整数，每字节7位，最高位表示后面还有字节
+void appendVarint(std::vector<char>& buffer, uint64_t value)
+{
+    while (value >= 0x80) {
+        buffer.push_back(static_cast<char>((value & 0x7F) | 0x80));
+        value >>= 7;
+    }
+    buffer.push_back(static_cast<char>(value));
+}
+
+bool readVarint(const char*& data, const char* end, uint64_t& value)
+{
+    value = 0;
+    for (int shift = 0; shift < 64 && data < end; shift += 7) {
+        uint8_t byte = static_cast<uint8_t>(*data++);
+        value |= static_cast<uint64_t>(byte & 0x7F) << shift;
+        if (!(byte & 0x80)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+ * @brief 带越界检查的顺序读取器
+ */
+class BufferReader
+{
+public:
+    BufferReader(const char* data, size_t size) : m_data(data), m_size(size), m_offset(0) {}
+    
+    template<typename T>
+    bool read(T& value) {
+        if (m_size - m_offset < sizeof(T)) {
+            return false;
+        }
+        value = readField<T>(m_data + m_offset);
+        m_offset += sizeof(T);
+        return true;
+    }
+    
+    size_t remaining() const { return m_size - m_offset; }
+
+private:
+    const char* m_data;
+    size_t m_size;
+    size_t m_offset;
+};
+
+// 文件的修改时间(无法获取时为0)。刚体变换后重新导出的文件大小和点数不变，需要它判断索引是否过期
+int64_t modifiedTime(const std::string& filename)
+{
+    std::error_code error;
+    auto modified = std::filesystem::last_write_time(std::filesystem::u8path(filename), error);
+    return error ? 0 : static_cast<int64_t>(modified.time_since_epoch().count());
+}
+
+} // namespace
+
+LASSpatialIndex::LASSpatialIndex()
+    : m_center(Eigen::Vector3d::Zero())
+    , m_halfSize(0.0)
+    , m_depth(0)
+    , m_sourceSize(0)
+    , m_sourceTime(0)
+    , m_pointCount(0)
+    , m_runsBase(0)
+{
+}
+
+std::string LASSpatialIndex::sidecarPath(const std::string& lasFilename)
+{
+    return lasFilename + ".lasidx";
+}
+
+void LASSpatialIndex::setRootCube(const LASHeader& h)
+{
+    Eigen::Vector3d minCorner(h.min_x, h.min_y, h.min_z);
+    Eigen::Vector3d maxCorner(h.max_x, h.max_y, h.max_z);
+    m_center = (minCorner + maxCorner) * 0.5;
+    
+    // 略微放大，保证落在边界上的点仍在根节点内
+    double extent = (maxCorner - minCorner).maxCoeff();
+    m_halfSize = std::max(extent * 0.5 * (1.0 + 1e-9), 1e-9);
+}
+
+uint64_t LASSpatialIndex::cellKey(const Point3D& p, int level) const
+{
+    const int cells = 1 << level;
+    const double cellSize = 2.0 * m_halfSize / cells;
+    
+    auto coordinate = [&](double value, double center) {
+        int c = static_cast<int>(std::floor((value - (center - m_halfSize)) / cellSize));
+        return std::min(std::max(c, 0), cells - 1);
+    };
+    
+    return packKey(level, coordinate(p.x, m_center.x()), coordinate(p.y, m_center.y()),
+                   coordinate(p.z, m_center.z()));
+}
+
+Eigen::AlignedBox3d LASSpatialIndex::cellBounds(const Cell& cell) const
+{
+    const double cellSize = 2.0 * m_halfSize / (1 << cell.level);
+    Eigen::Vector3d minCorner = m_center - Eigen::Vector3d::Constant(m_halfSize)
+                              + Eigen::Vector3d(cell.x, cell.y, cell.z) * cellSize;
+    return Eigen::AlignedBox3d(minCorner, minCorner + Eigen::Vector3d::Constant(cellSize));
+}
+
+bool LASSpatialIndex::loadCOPC(const LASFile& file)
+{
+    m_cells.clear();
+    m_depth = 0;
+    m_sidecar.close();
+    
+    const LASVariableRecord* info = file.findVariableRecord(COPC_USER_ID, COPC_INFO_RECORD_ID);
+    if (!info || info->length < COPC_INFO_SIZE || !file.header().compressed) {
+        return false;
+    }
+    
+    m_center = Eigen::Vector3d(readField<double>(info->data), readField<double>(info->data + 8),
+                               readField<double>(info->data + 16));
+    m_halfSize = readField<double>(info->data + 24);
+    uint64_t rootOffset = readField<uint64_t>(info->data + 40);
+    uint64_t rootSize = readField<uint64_t>(info->data + 48);
+    
+    // 节点条目: VoxelKey(level, x, y, z), 块的文件偏移, 块字节数, 点数(-1表示子层级页)
+    struct Node {
+        Cell cell;
+        uint64_t offset;
+        uint64_t pointCount;
+    };
+    std::vector<Node> nodes;
+    std::vector<std::pair<uint64_t, uint64_t>> pages = {{rootOffset, rootSize}};
+    std::unordered_set<uint64_t> visited;
+    
+    while (!pages.empty()) {
+        auto page = pages.back();
+        pages.pop_back();
+        if (page.first > file.fileSize() || page.second > file.fileSize() - page.first
+            || !visited.insert(page.first).second) {
+            std::cerr << "COPC层级页无效" << std::endl;
+            return false;
+        }
+        
+        const char* entry = file.data() + page.first;
+        for (uint64_t i = 0; i < page.second / COPC_ENTRY_SIZE; ++i, entry += COPC_ENTRY_SIZE) {
+            Cell cell;
+            cell.level = readField<int32_t>(entry);
+            cell.x = readField<int32_t>(entry + 4);
+            cell.y = readField<int32_t>(entry + 8);
+            cell.z = readField<int32_t>(entry + 12);
+            uint64_t offset = readField<uint64_t>(entry + 16);
+            int32_t byteSize = readField<int32_t>(entry + 24);
+            int32_t pointCount = readField<int32_t>(entry + 28);
+            
+            if (pointCount == -1) {
+                pages.push_back({offset, static_cast<uint64_t>(std::max(byteSize, 0))});
+            } else if (pointCount > 0) {
+                nodes.push_back({cell, offset, static_cast<uint64_t>(pointCount)});
+            }
+        }
+    }
+    
+    // 节点的压缩块在文件中按偏移顺序排列，前缀和即为每个节点第一个点的序号
+    std::sort(nodes.begin(), nodes.end(),
+              [](const Node& a, const Node& b) { return a.offset < b.offset; });
+    
+    uint64_t first = 0;
+    m_cells.reserve(nodes.size());
+    for (Node& node : nodes) {
+        node.cell.runs.push_back({first, node.pointCount});
+        first += node.pointCount;
+        m_depth = std::max(m_depth, node.cell.level);
+        m_cells.push_back(std::move(node.cell));
+    }
+    
+    return !m_cells.empty();
+}
+
+bool LASSpatialIndex::build(const LASFile& file, int depth)
+{
+    const size_t n = file.pointCount();
+    if (n == 0) {
+        std::cerr << "文件中没有点，无法生成索引" << std::endl;
+        return false;
+    }
+    
+    if (depth <= 0) {
+        depth = 1;
+        while (depth < INDEX_MAX_DEPTH && (n >> (2 * depth)) > INDEX_CELL_POINTS) {
+            ++depth;
+        }
+    }
+    m_depth = std::min(depth, INDEX_MAX_DEPTH);
+    m_sourceSize = file.fileSize();
+    m_sourceTime = modifiedTime(file.filename());
+    m_pointCount = n;
+    setRootCube(file.header());
+    m_cells.clear();
+    m_sidecar.close();
+    
+    std::unordered_map<uint64_t, size_t> cellIndex;
+    PointCloud batch;
+    LASReadOptions options;
+    options.maxPoints = INDEX_BATCH;
+    
+    for (options.first = 0; options.first < n; options.first += INDEX_BATCH) {
+        if (!file.readPoints(batch, options)) {
+            return false;
+        }
+        
+        // 每个分块在局部表中累积记录段，再按分块顺序合并，保证记录段有序
+        using LocalCells = std::unordered_map<uint64_t, std::vector<LASRecordRun>>;
+        std::vector<Parallel::Range> ranges = Parallel::splitRange(batch.size(), INDEX_MIN_CHUNK);
+        std::vector<LocalCells> local(ranges.size());
+        
+        Parallel::forEach(ranges, [&](const Parallel::Range& range) {
+            LocalCells& cells = local[range.index];
+            uint64_t lastKey = ~uint64_t(0);
+            std::vector<LASRecordRun>* runs = nullptr;
+            
+            for (size_t i = range.begin; i < range.end; ++i) {
+                uint64_t record = options.first + i;
+                uint64_t key = cellKey(batch.points[i], levelOf(record, m_depth));
+                if (key != lastKey) {
+                    runs = &cells[key];
+                    lastKey = key;
+                }
+                appendRun(*runs, {record, 1});
+            }
+        });
+        
+        for (const LocalCells& cells : local) {
+            for (const auto& entry : cells) {
+                auto it = cellIndex.find(entry.first);
+                if (it == cellIndex.end()) {
+                    it = cellIndex.emplace(entry.first, m_cells.size()).first;
+                    m_cells.push_back(unpackKey(entry.first));
+                }
+                std::vector<LASRecordRun>& runs = m_cells[it->second].runs;
+                for (const LASRecordRun& run : entry.second) {
+                    appendRun(runs, run);
+                }
+            }
+        }
+    }
+    
+    return true;
+}
+
+bool LASSpatialIndex::save(const std::string& path) const
+{
+    // 各单元的记录段编码为(与上一段末尾的间隔, 点数)的变长整数对，拼接成记录段区
+    std::vector<char> encoded;
+    std::vector<std::pair<uint64_t, uint64_t>> spans;
+    spans.reserve(m_cells.size());
+    for (const Cell& cell : m_cells) {
+        const uint64_t begin = encoded.size();
+        uint64_t end = 0;
+        for (const LASRecordRun& run : cell.runs) {
+            appendVarint(encoded, run.first - end);
+            appendVarint(encoded, run.count);
+            end = run.first + run.count;
+        }
+        spans.push_back({begin, encoded.size() - begin});
+    }
+    
+    // 头部和定长的单元表在前，加载时只需读取这一部分
+    std::vector<char> buffer(SIDECAR_MAGIC, SIDECAR_MAGIC + sizeof(SIDECAR_MAGIC));
+    appendValue(buffer, SIDECAR_VERSION);
+    appendValue(buffer, static_cast<uint32_t>(m_depth));
+    appendValue(buffer, m_sourceSize);
+    appendValue(buffer, m_sourceTime);
+    appendValue(buffer, m_pointCount);
+    appendValue(buffer, m_center.x());
+    appendValue(buffer, m_center.y());
+    appendValue(buffer, m_center.z());
+    appendValue(buffer, m_halfSize);
+    appendValue(buffer, static_cast<uint64_t>(m_cells.size()));
+    
+    for (size_t c = 0; c < m_cells.size(); ++c) {
+        const Cell& cell = m_cells[c];
+        appendValue(buffer, static_cast<int32_t>(cell.level));
+        appendValue(buffer, static_cast<int32_t>(cell.x));
+        appendValue(buffer, static_cast<int32_t>(cell.y));
+        appendValue(buffer, static_cast<int32_t>(cell.z));
+        appendValue(buffer, spans[c].first);
+        appendValue(buffer, spans[c].second);
+    }
+    
+    std::ofstream out(path, std::ios::binary);
+    out.write(buffer.data(), static_cast<std::streamsize>(buffer.size()));
+    out.write(encoded.data(), static_cast<std::streamsize>(encoded.size()));
+    return static_cast<bool>(out);
+}
+
+bool LASSpatialIndex::loadSidecar(const LASFile& file)
+{
+    m_cells.clear();
+    m_depth = 0;
+    m_sidecar.close();
+    
+    const std::string path = sidecarPath(file.filename());
+    if (!m_sidecar.open(path)) {
+        return false;
+    }
+    
+    if (m_sidecar.size() < sizeof(SIDECAR_MAGIC)
+        || std::memcmp(m_sidecar.data(), SIDECAR_MAGIC, sizeof(SIDECAR_MAGIC)) != 0) {
+        m_sidecar.close();
+        return false;
+    }
+    
+    BufferReader reader(m_sidecar.data() + sizeof(SIDECAR_MAGIC), m_sidecar.size() - sizeof(SIDECAR_MAGIC));
+    uint32_t version = 0, depth = 0;
+    uint64_t sourceSize = 0, pointCount = 0, numCells = 0;
+    int64_t sourceTime = 0;
+    double cx = 0, cy = 0, cz = 0;
+    bool ok = reader.read(version) && reader.read(depth) && reader.read(sourceSize) && reader.read(sourceTime)
+           && reader.read(pointCount) && reader.read(cx) && reader.read(cy) && reader.read(cz)
+           && reader.read(m_halfSize) && reader.read(numCells);
+    
+    if (!ok || version != SIDECAR_VERSION || sourceSize != file.fileSize()
+        || sourceTime != modifiedTime(file.filename()) || pointCount != file.pointCount()) {
+        std::cerr << "空间索引与文件不匹配，已忽略: " << path << std::endl;
+        m_sidecar.close();
+        return false;
+    }
+    
+    m_center = Eigen::Vector3d(cx, cy, cz);
+    m_depth = static_cast<int>(depth);
+    m_sourceSize = sourceSize;
+    m_sourceTime = sourceTime;
+    m_pointCount = pointCount;
+    
+    // 单元表之后是记录段区，各单元的编码范围必须落在其中
+    ok = numCells <= reader.remaining() / SIDECAR_CELL_SIZE;
+    m_runsBase = sizeof(SIDECAR_MAGIC) + SIDECAR_HEADER_SIZE + (ok ? numCells * SIDECAR_CELL_SIZE : 0);
+    const uint64_t runsBytes = m_sidecar.size() - m_runsBase;
+    m_cells.reserve(ok ? static_cast<size_t>(numCells) : 0);
+    
+    for (uint64_t c = 0; ok && c < numCells; ++c) {
+        Cell cell;
+        int32_t level = 0, x = 0, y = 0, z = 0;
+        ok = reader.read(level) && reader.read(x) && reader.read(y) && reader.read(z)
+          && reader.read(cell.encodedOffset) && reader.read(cell.encodedSize)
+          && cell.encodedOffset <= runsBytes && cell.encodedSize <= runsBytes - cell.encodedOffset;
+        cell.level = level;
+        cell.x = x;
+        cell.y = y;
+        cell.z = z;
+        m_cells.push_back(std::move(cell));
+    }
+    
+    if (!ok) {
+        std::cerr << "空间索引文件已损坏: " << path << std::endl;
+        m_cells.clear();
+        m_sidecar.close();
+        return false;
+    }
+    
+    return true;
+}
+
+bool LASSpatialIndex::decodeRuns(const Cell& cell, std::vector<LASRecordRun>& runs) const
+{
+    if (!cell.runs.empty() || !m_sidecar.isOpen()) {
+        runs.insert(runs.end(), cell.runs.begin(), cell.runs.end());
+        return true;
+    }
+    
+    const char* data = m_sidecar.data() + m_runsBase + cell.encodedOffset;
+    const char* end = data + cell.encodedSize;
+    uint64_t position = 0;
+    while (data < end) {
+        uint64_t gap = 0, count = 0;
+        if (!readVarint(data, end, gap) || !readVarint(data, end, count)
+            || gap > m_pointCount - position || count > m_pointCount - position - gap) {
+            return false;
+        }
+        runs.push_back({position + gap, count});
+        position += gap + count;
+    }
+    return true;
+}
+
+std::vector<LASRecordRun> LASSpatialIndex::query(const Eigen::AlignedBox3d& bbox, int maxDepth) const
+{
+    std::vector<LASRecordRun> runs;
+    for (const Cell& cell : m_cells) {
+        if (maxDepth >= 0 && cell.level > maxDepth) {
+            continue;
+        }
+        if (!cellBounds(cell).intersects(bbox)) {
+            continue;
+        }
+        if (!decodeRuns(cell, runs)) {
+            std::cerr << "空间索引中的记录段已损坏" << std::endl;
+            return {};
+        }
+    }
+    
+    // 按文件顺序读取，相邻的段合并为一次连续解码
+    std::sort(runs.begin(), runs.end(),
+              [](const LASRecordRun& a, const LASRecordRun& b) { return a.first < b.first; });
+    
+    std::vector<LASRecordRun> merged;
+    merged.reserve(runs.size());
+    for (const LASRecordRun& run : runs) {
+        appendRun(merged, run);
+    }
+    return merged;
+}
@@ -0,0 +1,92 @@
+#ifndef LASINDEX_H
+#define LASINDEX_H
+
+#include <string>
+#include <vector>
+#include <cstdint>
+#include "lasio.h"
+#include "mappedfile.h"
+
+/**
+ * @brief LAS/LAZ文件的八叉树空间索引
+ *
+ * 每个单元对应八叉树的一个节点，记录落在该节点中的点记录段。索引有两种来源:
+ * - COPC文件自带的层级EVLR，每个节点是一个独立的LAZ压缩块；
+ * - 普通LAS/LAZ文件的旁路索引(.lasidx)，由build生成。连续记录每256条组成一块，
+ *   按块序号的哈希分配层级，第l层的点数约为第l+1层的1/4，浅层节点组成均匀的稀疏采样，
+ *   与COPC的层级语义一致。块内的记录在文件中相邻，采集顺序下通常在空间上也相邻，
+ *   每个单元的记录因此组成少数长段。
+ *
+ * 旁路索引中单元表定长，各单元的记录段按差值变长编码。加载时只映射文件并读入单元表，
+ * 查询时只解码与包围盒相交且不深于给定层级的单元的记录段。
+ */
+class LASSpatialIndex
+{
+public:
+    struct Cell {
+        int level;
+        int x, y, z;                        // 节点在该层级网格中的坐标
+        std::vector<LASRecordRun> runs;     // 按记录序号升序(从旁路索引加载的单元为空，查询时再解码)
+        uint64_t encodedOffset = 0;         // 旁路索引中该单元编码后的记录段在记录段区的位置和字节数
+        uint64_t encodedSize = 0;
+    };
+    
+    LASSpatialIndex();
+    
+    // 旁路索引文件路径
+    static std::string sidecarPath(const std::string& lasFilename);
+    
+    /**
+     * @brief 从COPC信息VLR和层级EVLR加载
+     * @return 文件是否为有效的COPC文件
+     */
+    bool loadCOPC(const LASFile& file);
+    
+    /**
+     * @brief 加载文件旁的.lasidx索引(只读入单元表，记录段在查询时从映射区解码)
+     * @return 索引是否存在且与文件匹配(文件大小、修改时间和点数)
+     */
+    bool loadSidecar(const LASFile& file);
+    
+    /**
+     * @brief 扫描文件生成索引
+     * @param file 已打开的LAS/LAZ文件
+     * @param depth 最深层级(0表示按点数自动选择)
+     * @return 是否成功
+     */
+    bool build(const LASFile& file, int depth);
+    
+    bool save(const std::string& path) const;
+    
+    /**
+     * @brief 查询与包围盒相交的记录段
+     * @param bbox 查询包围盒
+     * @param maxDepth 最深层级(负数表示不限制)
+     * @return 按记录序号排序并合并相邻段后的记录段
+     */
+    std::vector<LASRecordRun> query(const Eigen::AlignedBox3d& bbox, int maxDepth) const;
+    
+    // 单元的空间范围
+    Eigen::AlignedBox3d cellBounds(const Cell& cell) const;
+    
+    int depth() const { return m_depth; }
+    size_t cellCount() const { return m_cells.size(); }
+    const std::vector<Cell>& cells() const { return m_cells; }
+
+private:
+    void setRootCube(const LASHeader& header);
+    uint64_t cellKey(const Point3D& p, int level) const;
+    bool decodeRuns(const Cell& cell, std::vector<LASRecordRun>& runs) const;
+    
+    Eigen::Vector3d m_center;       // 根节点立方体中心
+    double m_halfSize;              // 根节点立方体半边长
+    int m_depth;
+    uint64_t m_sourceSize;          // 建立索引时的文件大小、修改时间和点数，用于判断索引是否过期
+    int64_t m_sourceTime;
+    uint64_t m_pointCount;
+    std::vector<Cell> m_cells;
+    MappedFile m_sidecar;           // 加载的旁路索引，m_runsBase为其中记录段区的起始偏移
+    uint64_t m_runsBase;
+};
+
+#endif // LASINDEX_H
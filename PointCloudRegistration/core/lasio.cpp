@@ -1,120 +1,703 @@
 #include "lasio.h"
+#include "laspointformats.h"
+#include "lazcodec.h"
+#include "lasindex.h"
+#include "lassampler.h"
+#include "blockreader.h"
+#include "pointcloudcache.h"
+#include "parallel.h"
 #include <fstream>
 #include <iostream>
 #include <cstring>
 #include <functional>
+#include <algorithm>
+#include <mutex>
+#include <atomic>
+#include <cstdio>
 
-bool LASIO::readLAS(const std::string& filename, PointCloud& cloud, size_t maxPoints)
+namespace {
+
+// LAS 1.2 公共头部的最小长度，以及LAS 1.3/1.4扩展头部的长度
+const size_t LAS_MIN_HEADER_SIZE = 227;
+const size_t LAS13_HEADER_SIZE = 235;
+const size_t LAS14_HEADER_SIZE = 375;
+
+// 写入头部的生成软件名
+const char* const GENERATING_SOFTWARE = "PointCloudRegistration";
+
+// VLR和EVLR记录头的长度
+const size_t VLR_HEADER_SIZE = 54;
+const size_t EVLR_HEADER_SIZE = 60;
+
+// 每个解码任务的最小点数
+constexpr size_t DECODE_MIN_CHUNK = 262144;
+
+// 流水线读取时每块的字节数，以及块内每个解码任务的最小点数
+constexpr size_t PIPELINE_BLOCK_BYTES = size_t(16) << 20;
+constexpr size_t PIPELINE_MIN_CHUNK = 32768;
+
+// 写入时每批编码的点数，以及每个编码任务的最小点数
+constexpr size_t WRITE_BATCH_POINTS = size_t(1) << 20;
+constexpr size_t ENCODE_MIN_CHUNK = 65536;
+
+// 额外字节描述VLR(LAS规范)，额外字节不写出时一并去掉
+const char* const LASF_SPEC_USER_ID = "LASF_Spec";
+constexpr uint16_t EXTRA_BYTES_RECORD_ID = 4;
+
+using LASFormat::readField;
+
+// 按点格式选择解码器并检查记录长度
+bool selectFormat(const LASHeader& h, LASFormat::FormatInfo& format)
 {
-    std::ifstream file(filename, std::ios::binary);
-    if (!file.is_open()) {
-        std::cerr << "无法打开文件: " << filename << std::endl;
+    format = LASFormat::formatInfo(h.point_format);
+    if (!format.decoder) {
+        std::cerr << "不支持的点格式: " << static_cast<int>(h.point_format) << std::endl;
+        return false;
+    }
+    if (h.point_record_length < format.recordLength) {
+        std::cerr << "点记录长度 " << h.point_record_length << " 小于格式 "
+                  << static_cast<int>(h.point_format) << " 的要求" << std::endl;
+        return false;
+    }
+    return true;
+}
+
+/**
+ * @brief 通过读取流水线顺序访问[first, first + count)的点记录
+ *
+ * 读取阶段提前读入最多queueDepth个块，func(records, index, n)在调用线程中处理当前块，
+ * 其中records为第index条起的n条完整记录。块按整条记录切分。
+ */
+template<typename Func>
+bool forEachRecordBlock(const LASFile& file, size_t first, size_t count, size_t blockRecords,
+                        size_t queueDepth, Func func)
+{
+    const size_t recordLength = file.header().point_record_length;
+    BlockReader reader(queueDepth);
+    if (!reader.open(file.filename())) {
+        std::cerr << "无法打开文件: " << file.filename() << std::endl;
         return false;
     }
     
-    // 设置更大的I/O缓冲区(1MB)以提高读取速度
-    const int IO_BUFFER_SIZE = 1024 * 1024;
-    std::vector<char> io_buffer(IO_BUFFER_SIZE);
-    file.rdbuf()->pubsetbuf(io_buffer.data(), IO_BUFFER_SIZE);
+    const uint64_t begin = file.header().offset_to_data + uint64_t(first) * recordLength;
+    bool ok = reader.read(begin, uint64_t(count) * recordLength, std::max<size_t>(blockRecords, 1) * recordLength,
+                          [&](const char* data, uint64_t offset, size_t length) {
+        func(data, first + static_cast<size_t>((offset - begin) / recordLength), length / recordLength);
+        return true;
+    });
+    if (!ok) {
+        std::cerr << "读取点数据失败: " << file.filename() << std::endl;
+    }
+    return ok;
+}
+
+template<typename T>
+void writeField(char* data, T value)
+{
+    std::memcpy(data, &value, sizeof(T));
+}
+
+/**
+ * @brief 按点云的来源编码和当前坐标范围确定写出的头部和VLR
+ *
+ * 来源偏移下的整数坐标超出32位范围时(例如配准后平移很大)，改用包围盒最小值作为偏移。
+ */
+bool makeWriteHeader(const PointCloud& cloud, LASHeader& h,
+                     std::vector<PointCloudEncoding::VariableRecord>& vlrs)
+{
+    const PointCloudEncoding defaults;
+    const PointCloudEncoding& e = cloud.encoding ? *cloud.encoding : defaults;
+    const size_t n = cloud.points.size();
     
-    // 读取LAS文件头(227字节 - LAS 1.2标准)
-    char header[227];
-    file.read(header, 227);
+    // 没有来源编码时选择能容纳已有属性的最小格式
+    uint8_t format = e.pointFormat;
+    if (!cloud.encoding) {
+        bool hasTime = cloud.gpsTime.size() == n;
+        bool hasRGB = cloud.rgb.size() == n;
+        format = hasRGB ? (hasTime ? 3 : 2) : (hasTime ? 1 : 0);
+    }
     
-    if (!file) {
+    LASFormat::FormatInfo info = LASFormat::formatInfo(format);
+    if (!info.encoder) {
+        std::cerr << "不支持写入点格式: " << static_cast<int>(format) << std::endl;
+        return false;
+    }
+    
+    uint16_t extraBytes = (e.extraBytesSize > 0 && cloud.extraBytes.size() == n * e.extraBytesSize)
+                        ? e.extraBytesSize : 0;
+    
+    vlrs.clear();
+    size_t vlrBytes = 0;
+    for (const PointCloudEncoding::VariableRecord& vlr : e.variableRecords) {
+        bool isExtraBytesVLR = vlr.userId == LASF_SPEC_USER_ID && vlr.recordId == EXTRA_BYTES_RECORD_ID;
+        if ((isExtraBytesVLR && extraBytes == 0) || vlr.data.size() > UINT16_MAX) {
+            continue;
+        }
+        vlrs.push_back(vlr);
+        vlrBytes += VLR_HEADER_SIZE + vlr.data.size();
+    }
+    
+    Eigen::AlignedBox3d box = cloud.boundingBox();
+    Eigen::Vector3d scale = e.scale;
+    Eigen::Vector3d offset = cloud.encoding ? e.offset : box.min();
+    
+    if (!LASFormat::fitsInt32(box, scale, offset)) {
+        offset = box.min();
+        if (!LASFormat::fitsInt32(box, scale, offset)) {
+            std::cerr << "坐标范围超出缩放因子可表示的范围" << std::endl;
+            return false;
+        }
+        std::cerr << "警告: 坐标超出原偏移的表示范围，改用最小值作为偏移" << std::endl;
+    }
+    
+    h = LASHeader();
+    h.version_major = 1;
+    h.version_minor = std::min<uint8_t>(std::max<uint8_t>(e.versionMinor, 2), 4);
+    if (format >= 6 || n > UINT32_MAX) {
+        h.version_minor = 4;
+    }
+    
+    // 不写出波形数据包，格式6-10要求坐标系使用WKT
+    h.global_encoding = e.globalEncoding & ~uint16_t(0x0006);
+    if (format >= 6) {
+        h.global_encoding |= 0x0010;
+    }
+    
+    h.header_size = static_cast<uint16_t>(h.version_minor >= 4 ? LAS14_HEADER_SIZE
+                                        : h.version_minor == 3 ? LAS13_HEADER_SIZE : LAS_MIN_HEADER_SIZE);
+    h.num_variable_records = static_cast<uint32_t>(vlrs.size());
+    h.offset_to_data = static_cast<uint32_t>(h.header_size + vlrBytes);
+    h.point_format = format;
+    h.point_record_length = static_cast<uint16_t>(info.recordLength + extraBytes);
+    h.num_point_records = n;
+    h.x_scale = scale.x();
+    h.y_scale = scale.y();
+    h.z_scale = scale.z();
+    h.x_offset = offset.x();
+    h.y_offset = offset.y();
+    h.z_offset = offset.z();
+    h.min_x = box.min().x();
+    h.max_x = box.max().x();
+    h.min_y = box.min().y();
+    h.max_y = box.max().y();
+    h.min_z = box.min().z();
+    h.max_z = box.max().z();
+    return true;
+}
+
+/**
+ * @brief 序列化头部和VLR为磁盘布局(长度为offset_to_data)
+ */
+std::vector<char> encodeHeader(const LASHeader& h, const std::vector<PointCloudEncoding::VariableRecord>& vlrs)
+{
+    std::vector<char> data(h.offset_to_data, 0);
+    char* header = data.data();
+    
+    std::memcpy(header, "LASF", 4);
+    writeField<uint16_t>(header + 6, h.global_encoding);
+    header[24] = static_cast<char>(h.version_major);
+    header[25] = static_cast<char>(h.version_minor);
+    std::strncpy(header + 58, GENERATING_SOFTWARE, 31);
+    writeField<uint16_t>(header + 94, h.header_size);
+    writeField<uint32_t>(header + 96, h.offset_to_data);
+    writeField<uint32_t>(header + 100, h.num_variable_records);
+    header[104] = static_cast<char>(h.point_format);
+    writeField<uint16_t>(header + 105, h.point_record_length);
+    
+    // 旧版32位点数，格式6-10或超出范围时按LAS 1.4规定填0
+    bool legacyCount = h.point_format < 6 && h.num_point_records <= UINT32_MAX;
+    writeField<uint32_t>(header + 107, legacyCount ? static_cast<uint32_t>(h.num_point_records) : 0);
+    
+    writeField<double>(header + 131, h.x_scale);
+    writeField<double>(header + 139, h.y_scale);
+    writeField<double>(header + 147, h.z_scale);
+    writeField<double>(header + 155, h.x_offset);
+    writeField<double>(header + 163, h.y_offset);
+    writeField<double>(header + 171, h.z_offset);
+    writeField<double>(header + 179, h.max_x);
+    writeField<double>(header + 187, h.min_x);
+    writeField<double>(header + 195, h.max_y);
+    writeField<double>(header + 203, h.min_y);
+    writeField<double>(header + 211, h.max_z);
+    writeField<double>(header + 219, h.min_z);
+    
+    // LAS 1.4 64位点数 (offset 247-254)
+    if (h.header_size >= LAS14_HEADER_SIZE) {
+        writeField<uint64_t>(header + 247, h.num_point_records);
+    }
+    
+    char* vlr = header + h.header_size;
+    for (const PointCloudEncoding::VariableRecord& record : vlrs) {
+        std::strncpy(vlr + 2, record.userId.c_str(), 16);
+        writeField<uint16_t>(vlr + 18, record.recordId);
+        writeField<uint16_t>(vlr + 20, static_cast<uint16_t>(record.data.size()));
+        std::strncpy(vlr + 22, record.description.c_str(), 32);
+        std::memcpy(vlr + VLR_HEADER_SIZE, record.data.data(), record.data.size());
+        vlr += VLR_HEADER_SIZE + record.data.size();
+    }
+    
+    return data;
+}
+
+} // namespace
+
+LASFile::LASFile()
+    : m_pointCount(0)
+{
+}
+
+bool LASFile::open(const std::string& filename)
+{
+    close();
+    
+    if (!m_file.open(filename)) {
+        std::cerr << "无法打开文件: " << filename << std::endl;
+        return false;
+    }
+    
+    if (!parseHeader() || !parseVariableRecords()) {
+        close();
+        return false;
+    }
+    
+    m_filename = filename;
+    return true;
+}
+
+void LASFile::close()
+{
+    m_file.close();
+    m_filename.clear();
+    m_header = LASHeader();
+    m_variableRecords.clear();
+    m_pointCount = 0;
+}
+
+bool LASFile::parseHeader()
+{
+    if (m_file.size() < LAS_MIN_HEADER_SIZE) {
         std::cerr << "无法读取文件头" << std::endl;
-        file.close();
         return false;
     }
     
+    const char* header = m_file.data();
+    
     // 验证签名
     if (std::strncmp(header, "LASF", 4) != 0) {
         std::cerr << "不是有效的LAS文件" << std::endl;
-        file.close();
         return false;
     }
     
-    // 从头部提取关键信息(使用指针直接访问,避免结构体对齐问题)
-    uint32_t offset_to_data = *reinterpret_cast<uint32_t*>(header + 96);
-    uint32_t num_point_records = *reinterpret_cast<uint32_t*>(header + 107);
-    uint16_t point_record_length = *reinterpret_cast<uint16_t*>(header + 105);
+    m_header.version_major = readField<uint8_t>(header + 24);
+    m_header.version_minor = readField<uint8_t>(header + 25);
+    m_header.global_encoding = readField<uint16_t>(header + 6);
+    m_header.header_size = readField<uint16_t>(header + 94);
+    m_header.offset_to_data = readField<uint32_t>(header + 96);
+    m_header.num_variable_records = readField<uint32_t>(header + 100);
+    // 高两位是LAZ压缩标志，低六位才是点格式
+    uint8_t format_byte = readField<uint8_t>(header + 104);
+    m_header.point_format = format_byte & 0x3F;
+    m_header.compressed = (format_byte & 0xC0) != 0;
+    m_header.point_record_length = readField<uint16_t>(header + 105);
+    m_header.num_point_records = readField<uint32_t>(header + 107);
     
-    // 获取缩放因子和偏移量
-    double x_scale = *reinterpret_cast<double*>(header + 131);
-    double y_scale = *reinterpret_cast<double*>(header + 139);
-    double z_scale = *reinterpret_cast<double*>(header + 147);
-    double x_offset = *reinterpret_cast<double*>(header + 155);
-    double y_offset = *reinterpret_cast<double*>(header + 163);
-    double z_offset = *reinterpret_cast<double*>(header + 171);
+    // LAS 1.4: 64位点数，格式6-10的旧版32位点数字段必须为0
+    bool isLAS14 = m_header.version_major == 1 && m_header.version_minor >= 4;
+    if (isLAS14 && m_header.header_size >= LAS14_HEADER_SIZE && m_file.size() >= LAS14_HEADER_SIZE) {
+        m_header.start_of_first_evlr = readField<uint64_t>(header + 235);
+        m_header.num_evlr = readField<uint32_t>(header + 243);
+        uint64_t extended_count = readField<uint64_t>(header + 247);
+        if (extended_count > 0) {
+            m_header.num_point_records = extended_count;
+        }
+    }
     
-    std::cout << "LAS文件信息:" << std::endl;
-    std::cout << "  点数: " << num_point_records << std::endl;
-    std::cout << "  点记录长度: " << point_record_length << std::endl;
-    std::cout << "  缩放因子: (" << x_scale << ", " << y_scale << ", " << z_scale << ")" << std::endl;
-    std::cout << "  偏移量: (" << x_offset << ", " << y_offset << ", " << z_offset << ")" << std::endl;
+    m_header.x_scale = readField<double>(header + 131);
+    m_header.y_scale = readField<double>(header + 139);
+    m_header.z_scale = readField<double>(header + 147);
+    m_header.x_offset = readField<double>(header + 155);
+    m_header.y_offset = readField<double>(header + 163);
+    m_header.z_offset = readField<double>(header + 171);
+    m_header.max_x = readField<double>(header + 179);
+    m_header.min_x = readField<double>(header + 187);
+    m_header.max_y = readField<double>(header + 195);
+    m_header.min_y = readField<double>(header + 203);
+    m_header.max_z = readField<double>(header + 211);
+    m_header.min_z = readField<double>(header + 219);
+    
+    if (m_header.point_record_length < 12 || m_header.offset_to_data > m_file.size()) {
+        std::cerr << "LAS文件头参数无效" << std::endl;
+        return false;
+    }
+    
+    // 压缩记录的长度不固定，点数只能以头部为准
+    if (m_header.compressed) {
+        m_pointCount = static_cast<size_t>(m_header.num_point_records);
+        return true;
+    }
+    
+    // 文件被截断时只读取完整的记录
+    size_t available = (m_file.size() - m_header.offset_to_data) / m_header.point_record_length;
+    m_pointCount = static_cast<size_t>(std::min<uint64_t>(m_header.num_point_records, available));
+    if (m_pointCount < m_header.num_point_records) {
+        std::cerr << "警告: 文件不完整，仅包含 " << m_pointCount << " / "
+                  << m_header.num_point_records << " 个点记录" << std::endl;
+    }
+    
+    return true;
+}
+
+bool LASFile::parseVariableRecords()
+{
+    const char* data = m_file.data();
+    const size_t size = m_file.size();
+    
+    // 解析一条记录头，越界时返回false
+    auto parseRecord = [&](size_t& offset, bool extended) {
+        size_t headerSize = extended ? EVLR_HEADER_SIZE : VLR_HEADER_SIZE;
+        if (offset + headerSize > size) {
+            return false;
+        }
+        
+        LASVariableRecord record;
+        const char* user_id = data + offset + 2;
+        record.user_id.assign(user_id, strnlen(user_id, 16));
+        record.record_id = readField<uint16_t>(data + offset + 18);
+        const char* description = data + offset + (extended ? 28 : 22);
+        record.description.assign(description, strnlen(description, 32));
+        record.length = extended ? readField<uint64_t>(data + offset + 20)
+                                 : readField<uint16_t>(data + offset + 20);
+        record.extended = extended;
+        offset += headerSize;
+        
+        if (record.length > size - offset) {
+            return false;
+        }
+        record.data = data + offset;
+        offset += static_cast<size_t>(record.length);
+        m_variableRecords.push_back(record);
+        return true;
+    };
+    
+    size_t offset = m_header.header_size;
+    for (uint32_t i = 0; i < m_header.num_variable_records; ++i) {
+        if (!parseRecord(offset, false)) {
+            std::cerr << "变长记录越界" << std::endl;
+            return false;
+        }
+    }
+    
+    // EVLR位于点数据之后，损坏时只忽略它们而不影响点读取
+    offset = static_cast<size_t>(std::min<uint64_t>(m_header.start_of_first_evlr, size));
+    for (uint32_t i = 0; i < m_header.num_evlr && m_header.start_of_first_evlr > 0; ++i) {
+        if (!parseRecord(offset, true)) {
+            std::cerr << "警告: 扩展变长记录越界，已忽略" << std::endl;
+            break;
+        }
+    }
+    
+    return true;
+}
+
+const LASVariableRecord* LASFile::findVariableRecord(const std::string& user_id, uint16_t record_id) const
+{
+    for (const LASVariableRecord& record : m_variableRecords) {
+        if (record.user_id == user_id && record.record_id == record_id) {
+            return &record;
+        }
+    }
+    return nullptr;
+}
+
+size_t LASFile::readCount(const LASReadOptions& options) const
+{
+    size_t first = options.first;
+    size_t stride = std::max<size_t>(options.stride, 1);
+    size_t available = (first < m_pointCount) ? (m_pointCount - first + stride - 1) / stride : 0;
+    return (options.maxPoints > 0) ? std::min(options.maxPoints, available) : available;
+}
+
+uint16_t LASFile::extraBytesSize() const
+{
+    LASFormat::FormatInfo format = LASFormat::formatInfo(m_header.point_format);
+    return m_header.point_record_length > format.recordLength
+        ? static_cast<uint16_t>(m_header.point_record_length - format.recordLength) : 0;
+}
+
+std::shared_ptr<const PointCloudEncoding> LASFile::encoding() const
+{
+    auto encoding = std::make_shared<PointCloudEncoding>();
+    encoding->versionMinor = m_header.version_minor;
+    encoding->globalEncoding = m_header.global_encoding;
+    encoding->pointFormat = m_header.point_format;
+    encoding->recordFieldsSize = LASFormat::formatInfo(m_header.point_format).recordFieldsSize();
+    encoding->extraBytesSize = extraBytesSize();
+    encoding->scale = Eigen::Vector3d(m_header.x_scale, m_header.y_scale, m_header.z_scale);
+    encoding->offset = Eigen::Vector3d(m_header.x_offset, m_header.y_offset, m_header.z_offset);
     
-    // 跳转到点数据开始位置
-    file.seekg(offset_to_data, std::ios::beg);
+    // 压缩参数和COPC层级描述的是原文件的存储方式，重新写出后不再有效
+    for (const LASVariableRecord& record : m_variableRecords) {
+        if (record.extended || record.user_id == "laszip encoded" || record.user_id == "copc") {
+            continue;
+        }
+        PointCloudEncoding::VariableRecord vlr;
+        vlr.userId = record.user_id;
+        vlr.recordId = record.record_id;
+        vlr.description = record.description;
+        vlr.data.assign(record.data, record.data + record.length);
+        encoding->variableRecords.push_back(std::move(vlr));
+    }
     
-    // 确定要读取的点数
-    size_t numToRead = num_point_records;
-    if (maxPoints > 0 && maxPoints < numToRead) {
-        numToRead = maxPoints;
+    return encoding;
+}
+
+bool LASFile::decodeRange(const LASFormat::DecodeTarget& out, size_t first, size_t count, size_t stride) const
+{
+    stride = std::max<size_t>(stride, 1);
+    if (!isOpen() || (count > 0 && first + (count - 1) * stride >= m_pointCount)) {
+        return false;
+    }
+    if (count == 0) {
+        return true;
     }
     
+    if (m_header.compressed) {
+        return LAZCodec::decodeRange(*this, out, first, count, stride);
+    }
+    
+    LASFormat::FormatInfo format;
+    if (!selectFormat(m_header, format)) {
+        return false;
+    }
+    format.decoder(recordData(first), stride * m_header.point_record_length, count, m_header, out);
+    return true;
+}
+
+unsigned LASFile::availableAttributes() const
+{
+    return LASFormat::formatInfo(m_header.point_format).attributes;
+}
+
+bool LASFile::readPoints(PointCloud& cloud, const LASReadOptions& options) const
+{
     cloud.clear();
-    cloud.points.reserve(numToRead);
+    if (!isOpen()) {
+        return false;
+    }
     
-    std::cout << "开始批量读取点数据..." << std::endl;
+    if (options.sampling != LASSampling::Head && options.maxPoints > 0 && options.maxPoints < m_pointCount) {
+        return readSample(cloud, options);
+    }
     
-    // 批量读取点数据 - 每次读取10000个点
-    const int BATCH_SIZE = 10000;
-    std::vector<char> buffer(BATCH_SIZE * point_record_length);
+    if (m_header.compressed) {
+        return LAZCodec::readPoints(*this, cloud, options);
+    }
     
-    int read_count = 0;
-    int last_progress = 0;
+    // 每个文件只选择一次解码器
+    LASFormat::FormatInfo format;
+    if (!selectFormat(m_header, format)) {
+        return false;
+    }
     
-    for (size_t batch_start = 0; batch_start < numToRead; batch_start += BATCH_SIZE) {
-        int points_to_read = std::min(BATCH_SIZE, static_cast<int>(numToRead - batch_start));
-        int bytes_to_read = points_to_read * point_record_length;
-        
-        // 一次性读取一批点
-        file.read(buffer.data(), bytes_to_read);
+    size_t first = options.first;
+    size_t stride = std::max<size_t>(options.stride, 1);
+    size_t numToRead = readCount(options);
+    unsigned attributes = options.attributes & format.attributes;
+    
+    if (numToRead > 0 && stride == 1 && options.readQueueDepth > 0) {
+        LASFormat::DecodeTarget output = LASFormat::prepareTarget(cloud, numToRead, attributes,
+                                                                  extraBytesSize(), format.recordFieldsSize());
+        const size_t recordLength = m_header.point_record_length;
+        size_t decoded = 0;
         
-        if (!file && !file.eof()) {
-            std::cerr << "警告: 读取批次时失败,已读取 " << read_count << " 个点" << std::endl;
-            break;
+        // 下一块在后台读取的同时，当前块切分后由线程池并行解码
+        bool ok = forEachRecordBlock(*this, first, numToRead, PIPELINE_BLOCK_BYTES / recordLength,
+                                     options.readQueueDepth, [&](const char* records, size_t index, size_t n) {
+            std::vector<Parallel::Range> ranges = Parallel::splitRange(n, PIPELINE_MIN_CHUNK);
+            Parallel::forEach(ranges, [&](const Parallel::Range& range) {
+                LASFormat::DecodeTarget target = output.at(index - first + range.begin);
+                format.decoder(records + range.begin * recordLength, recordLength, range.end - range.begin,
+                               m_header, target);
+            });
+            
+            decoded += n;
+            if (options.progress) {
+                options.progress(decoded, numToRead);
+            }
+            if (options.chunkDecoded) {
+                reportChunks(options.chunkDecoded, index - first, index - first + n);
+            }
+        });
+        if (!ok) {
+            cloud.clear();
+            return false;
         }
+    } else if (numToRead > 0) {
+        size_t spanBegin = m_header.offset_to_data + first * m_header.point_record_length;
+        size_t spanBytes = ((numToRead - 1) * stride + 1) * m_header.point_record_length;
+        advise(spanBegin, spanBytes,
+               stride == 1 ? MappedFile::Access::Sequential : MappedFile::Access::Random);
+        
+        LASFormat::DecodeTarget output = LASFormat::prepareTarget(cloud, numToRead, attributes,
+                                                                  extraBytesSize(), format.recordFieldsSize());
         
-        // 解析批次中的点
-        for (int i = 0; i < points_to_read; i++) {
-            int offset = i * point_record_length;
-            int32_t x = *reinterpret_cast<int32_t*>(buffer.data() + offset);
-            int32_t y = *reinterpret_cast<int32_t*>(buffer.data() + offset + 4);
-            int32_t z = *reinterpret_cast<int32_t*>(buffer.data() + offset + 8);
+        // 每个分块解码到输出中互不重叠的区间，线程间无需同步
+        std::vector<Parallel::Range> ranges = Parallel::splitRange(numToRead, DECODE_MIN_CHUNK);
+        std::mutex progressMutex;
+        size_t decoded = 0;
+        const size_t step = stride * m_header.point_record_length;
+        
+        Parallel::forEach(ranges, [&](const Parallel::Range& range) {
+            size_t i = range.begin;
+            LASFormat::DecodeTarget target = output.at(i);
             
-            Point3D p;
-            p.x = x * x_scale + x_offset;
-            p.y = y * y_scale + y_offset;
-            p.z = z * z_scale + z_offset;
+            format.decoder(recordData(first + i * stride), step, range.end - range.begin, m_header, target);
             
-            cloud.points.push_back(p);
-            read_count++;
-        }
+            if (options.chunkDecoded) {
+                reportChunks(options.chunkDecoded, range.begin, range.end);
+            }
+            if (options.progress) {
+                std::lock_guard<std::mutex> lock(progressMutex);
+                decoded += range.end - range.begin;
+                options.progress(decoded, numToRead);
+            }
+        });
+    }
+    
+    cloud.encoding = encoding();
+    cloud.computeBounds();
+    return true;
+}
+
+bool LASFile::readSample(PointCloud& cloud, const LASReadOptions& options) const
+{
+    // 跨步读取直接使用映射区(或LAZ解压器)的跨步解码，只访问被选中的记录所在的页
+    if (options.sampling == LASSampling::Stride) {
+        LASReadOptions strided = options;
+        strided.sampling = LASSampling::Head;
+        strided.first = 0;
+        strided.stride = (m_pointCount + options.maxPoints - 1) / options.maxPoints;
+        return readPoints(cloud, strided);
+    }
+    
+    std::vector<LASRecordRun> runs = (options.sampling == LASSampling::Random)
+        ? LASSampler::randomRecords(m_pointCount, options.maxPoints)
+        : LASSampler::voxelRecords(*this, options.maxPoints, options.progress);
+    if (runs.empty()) {
+        cloud.clear();
+        return false;
+    }
+    return readRuns(cloud, runs, options);
+}
+
+bool LASFile::readRuns(PointCloud& cloud, const std::vector<LASRecordRun>& runs,
+                       const LASReadOptions& options) const
+{
+    cloud.clear();
+    if (!isOpen()) {
+        return false;
+    }
+    
+    if (m_header.compressed) {
+        return LAZCodec::readRuns(*this, cloud, runs, options);
+    }
+    
+    LASFormat::FormatInfo format;
+    if (!selectFormat(m_header, format)) {
+        return false;
+    }
+    
+    std::vector<LASRecordRun> clipped = LASFormat::clipRuns(runs, m_pointCount);
+    std::vector<size_t> offsets = LASFormat::runOffsets(clipped);
+    const size_t total = offsets.back();
+    const unsigned attributes = options.attributes & format.attributes;
+    
+    if (total > 0) {
+        LASFormat::DecodeTarget output = LASFormat::prepareTarget(cloud, total, attributes,
+                                                                  extraBytesSize(), format.recordFieldsSize());
+        
+        std::vector<Parallel::Range> ranges = Parallel::splitRange(total, DECODE_MIN_CHUNK);
+        std::mutex progressMutex;
+        size_t decoded = 0;
         
-        // 显示进度(每50000个点显示一次)
-        int progress = (read_count / 50000) * 50000;
-        if (progress > last_progress && progress > 0) {
-            std::cout << "  已读取 " << read_count << " / " << numToRead << " 个点 ("
-                     << (read_count * 100 / numToRead) << "%)" << std::endl;
-            last_progress = progress;
+        Parallel::forEach(ranges, [&](const Parallel::Range& range) {
+            LASFormat::forEachRunPiece(clipped, offsets, range.begin, range.end,
+                                       [&](uint64_t record, size_t count, size_t out) {
+                format.decoder(recordData(record), m_header.point_record_length, count, m_header, output.at(out));
+            });
+            
+            if (options.chunkDecoded) {
+                reportChunks(options.chunkDecoded, range.begin, range.end);
+            }
+            if (options.progress) {
+                std::lock_guard<std::mutex> lock(progressMutex);
+                decoded += range.end - range.begin;
+                options.progress(decoded, total);
+            }
+        });
+    }
+    
+    cloud.encoding = encoding();
+    cloud.computeBounds();
+    return true;
+}
+
+bool LASIO::readLAS(const std::string& filename, PointCloud& cloud, size_t maxPoints,
+                    const LASProgressCallback& progress)
+{
+    LASReadOptions options;
+    options.maxPoints = maxPoints;
+    options.sampling = LASSampling::Stride;
+    options.progress = progress;
+    return readLAS(filename, cloud, options);
+}
+
+bool LASIO::readLAS(const std::string& filename, PointCloud& cloud, const LASReadOptions& options)
+{
+    LASFile file;
+    if (!file.open(filename)) {
+        return false;
+    }
+    
+    const LASHeader& h = file.header();
+    std::cout << "LAS文件信息:" << std::endl;
+    std::cout << "  点数: " << h.num_point_records << std::endl;
+    std::cout << "  点格式: " << static_cast<int>(h.point_format)
+              << (h.compressed ? " (LAZ压缩)" : "") << std::endl;
+    std::cout << "  点记录长度: " << h.point_record_length << std::endl;
+    std::cout << "  缩放因子: (" << h.x_scale << ", " << h.y_scale << ", " << h.z_scale << ")" << std::endl;
+    std::cout << "  偏移量: (" << h.x_offset << ", " << h.y_offset << ", " << h.z_offset << ")" << std::endl;
+    
+    // 整体读取时优先使用缓存，缓存只记录文件格式能提供的属性
+    const bool whole = options.first == 0 && options.stride == 1
+                    && (options.maxPoints == 0 || options.maxPoints >= file.pointCount());
+    const unsigned attributes = options.attributes & file.availableAttributes();
+    if (whole && options.useCache && PointCloudCache::load(filename, cloud, attributes)
+        && cloud.size() == file.pointCount()) {
+        cloud.encoding = file.encoding();
+        std::cout << "从缓存加载 " << cloud.points.size() << " 个点: " << PointCloudCache::cachePath(filename)
+                  << std::endl;
+        if (options.chunkDecoded) {
+            reportChunks(options.chunkDecoded, 0, cloud.size());
+        }
+        if (options.progress) {
+            options.progress(cloud.size(), cloud.size());
         }
+        return true;
     }
     
-    file.close();
+    // 直接从映射区(或LAZ压缩块)多线程解码到预分配的点数组
+    if (!file.readPoints(cloud, options)) {
+        return false;
+    }
     
-    // 计算边界
-    cloud.computeBounds();
+    if (whole && options.useCache && !cloud.empty()) {
+        if (PointCloudCache::save(filename, cloud, attributes)) {
+            std::cout << "点云缓存已写入 " << PointCloudCache::cachePath(filename) << std::endl;
+        } else {
+            std::cerr << "无法写入点云缓存: " << PointCloudCache::cachePath(filename) << std::endl;
+        }
+    }
     
     std::cout << "成功读取 " << cloud.points.size() << " 个点" << std::endl;
     std::cout << "边界: X[" << cloud.minX << ", " << cloud.maxX << "]" << std::endl;
@@ -124,177 +707,343 @@ bool LASIO::readLAS(const std::string& filename, PointCloud& cloud, size_t maxPo
     return true;
 }
 
-bool LASIO::writeLAS(const std::string& filename, const PointCloud& cloud)
+bool LASIO::readRegion(const std::string& filename, PointCloud& cloud, const Eigen::AlignedBox3d& bbox,
+                       int maxDepth, const LASReadOptions& options)
 {
-    if (cloud.empty()) {
-        std::cerr << "点云为空，无法写入" << std::endl;
+    cloud.clear();
+    LASFile file;
+    if (!file.open(filename)) {
         return false;
     }
     
-    std::ofstream file(filename, std::ios::binary);
-    if (!file.is_open()) {
-        std::cerr << "无法创建文件: " << filename << std::endl;
-        return false;
+    std::vector<LASRecordRun> runs;
+    LASSpatialIndex index;
+    if (index.loadCOPC(file) || index.loadSidecar(file)) {
+        runs = index.query(bbox, maxDepth);
+        uint64_t selected = 0;
+        for (const LASRecordRun& run : runs) {
+            selected += run.count;
+        }
+        std::cout << "空间索引选中 " << selected << " / " << file.pointCount() << " 个点" << std::endl;
+    } else {
+        std::cout << "未找到空间索引，读取整个文件后裁剪" << std::endl;
+        runs.push_back({0, file.pointCount()});
     }
     
-    // 创建227字节的LAS 1.2头部
-    char header[227];
-    std::memset(header, 0, 227);
-    
-    // 文件签名
-    std::strncpy(header, "LASF", 4);
-    
-    // 版本号 (offset 24-25)
-    header[24] = 1;  // major
-    header[25] = 2;  // minor
+    // 裁剪会移动点，读取时不逐块报告，裁剪后分段报告全部点
+    LASReadOptions runOptions = options;
+    runOptions.chunkDecoded = nullptr;
+    if (!file.readRuns(cloud, runs, runOptions)) {
+        return false;
+    }
     
-    // 头部大小 (offset 94-95)
-    *reinterpret_cast<uint16_t*>(header + 94) = 227;
+    cloud.crop(bbox);
+    if (options.chunkDecoded && !cloud.empty()) {
+        reportChunks(options.chunkDecoded, 0, cloud.size());
+    }
+    std::cout << "区域内共 " << cloud.points.size() << " 个点" << std::endl;
+    return true;
+}
+
+bool LASIO::buildSpatialIndex(const std::string& filename, int depth)
+{
+    LASFile file;
+    if (!file.open(filename)) {
+        return false;
+    }
     
-    // 点数据偏移 (offset 96-99)
-    *reinterpret_cast<uint32_t*>(header + 96) = 227;
+    LASSpatialIndex index;
+    if (!index.build(file, depth)) {
+        return false;
+    }
     
-    // 点格式 (offset 104)
-    header[104] = 0;
+    std::string path = LASSpatialIndex::sidecarPath(filename);
+    if (!index.save(path)) {
+        std::cerr << "无法写入索引文件: " << path << std::endl;
+        return false;
+    }
     
-    // 点记录长度 (offset 105-106)
-    *reinterpret_cast<uint16_t*>(header + 105) = 20;
+    std::cout << "空间索引已写入 " << path << " (深度 " << index.depth() << ", "
+              << index.cellCount() << " 个单元)" << std::endl;
+    return true;
+}
+
+bool LASIO::writeLAS(const std::string& filename, const PointCloud& cloud)
+{
+    if (cloud.empty()) {
+        std::cerr << "点云为空，无法写入" << std::endl;
+        return false;
+    }
     
-    // 点数 (offset 107-110)
-    *reinterpret_cast<uint32_t*>(header + 107) = static_cast<uint32_t>(cloud.points.size());
+    LASHeader h;
+    std::vector<PointCloudEncoding::VariableRecord> vlrs;
+    if (!makeWriteHeader(cloud, h, vlrs)) {
+        return false;
+    }
     
-    // 缩放因子
-    *reinterpret_cast<double*>(header + 131) = 0.001;  // x_scale
-    *reinterpret_cast<double*>(header + 139) = 0.001;  // y_scale
-    *reinterpret_cast<double*>(header + 147) = 0.001;  // z_scale
+    if (LAZCodec::isLAZFilename(filename)) {
+        return LAZCodec::write(filename, cloud, h, vlrs);
+    }
     
-    // 偏移量
-    *reinterpret_cast<double*>(header + 155) = cloud.minX;  // x_offset
-    *reinterpret_cast<double*>(header + 163) = cloud.minY;  // y_offset
-    *reinterpret_cast<double*>(header + 171) = cloud.minZ;  // z_offset
+    std::ofstream file(filename, std::ios::binary);
+    if (!file.is_open()) {
+        std::cerr << "无法创建文件: " << filename << std::endl;
+        return false;
+    }
     
-    // 边界
-    *reinterpret_cast<double*>(header + 179) = cloud.maxX;
-    *reinterpret_cast<double*>(header + 187) = cloud.minX;
-    *reinterpret_cast<double*>(header + 195) = cloud.maxY;
-    *reinterpret_cast<double*>(header + 203) = cloud.minY;
-    *reinterpret_cast<double*>(header + 211) = cloud.maxZ;
-    *reinterpret_cast<double*>(header + 219) = cloud.minZ;
+    std::vector<char> head = encodeHeader(h, vlrs);
+    file.write(head.data(), static_cast<std::streamsize>(head.size()));
     
-    // 写入头部
-    file.write(header, 227);
+    // 每批记录由线程池并行编码到一个大缓冲区，编码下一批的同时写出当前批
+    const LASFormat::FormatInfo format = LASFormat::formatInfo(h.point_format);
+    const LASFormat::EncodeSource source = LASFormat::encodeSource(
+        cloud, h.point_record_length - format.recordLength, format.recordFieldsSize());
+    const size_t numPoints = cloud.points.size();
     
-    // 写入点数据
-    double x_scale = 0.001;
-    double y_scale = 0.001;
-    double z_scale = 0.001;
+    auto encodeBatch = [&](size_t begin, std::vector<char>& buffer) {
+        size_t count = std::min(WRITE_BATCH_POINTS, numPoints - begin);
+        buffer.resize(count * h.point_record_length);
+        std::vector<Parallel::Range> ranges = Parallel::splitRange(count, ENCODE_MIN_CHUNK);
+        Parallel::forEach(ranges, [&](const Parallel::Range& range) {
+            format.encoder(buffer.data() + range.begin * h.point_record_length, range.end - range.begin, h,
+                           source.at(begin + range.begin));
+        });
+    };
     
-    for (const auto& p : cloud.points) {
-        int32_t x = static_cast<int32_t>((p.x - cloud.minX) / x_scale);
-        int32_t y = static_cast<int32_t>((p.y - cloud.minY) / y_scale);
-        int32_t z = static_cast<int32_t>((p.z - cloud.minZ) / z_scale);
+    std::vector<char> current, next;
+    encodeBatch(0, current);
+    for (size_t begin = 0; begin < numPoints && file; begin += WRITE_BATCH_POINTS) {
+        size_t nextBegin = begin + WRITE_BATCH_POINTS;
+        QFuture<void> pending;
+        if (nextBegin < numPoints) {
+            pending = QtConcurrent::run([&encodeBatch, &next, nextBegin]() { encodeBatch(nextBegin, next); });
+        }
         
-        file.write(reinterpret_cast<const char*>(&x), sizeof(int32_t));
-        file.write(reinterpret_cast<const char*>(&y), sizeof(int32_t));
-        file.write(reinterpret_cast<const char*>(&z), sizeof(int32_t));
+        file.write(current.data(), static_cast<std::streamsize>(current.size()));
         
-        // 写入其他字段（填充0）
-        char padding[8] = {0};
-        file.write(padding, 8);
+        pending.waitForFinished();
+        std::swap(current, next);
     }
     
     file.close();
+    if (!file) {
+        std::cerr << "写入文件失败: " << filename << std::endl;
+        return false;
+    }
     
-    std::cout << "成功写入 " << cloud.points.size() << " 个点到 " << filename << std::endl;
+    std::cout << "成功写入 " << numPoints << " 个点到 " << filename
+              << " (点格式 " << static_cast<int>(h.point_format) << ")" << std::endl;
     return true;
 }
 
-size_t LASIO::readLASBatch(const std::string& filename, 
-                           size_t batch_size,
-                           std::function<void(const std::vector<Point3D>&)> process_func)
+bool LASIO::transformLAS(const std::string& inputFile, const std::string& outputFile,
+                         const Eigen::Affine3d& transform, const LASProgressCallback& progress)
 {
-    std::ifstream file(filename, std::ios::binary);
-    if (!file.is_open()) {
-        std::cerr << "无法打开文件: " << filename << std::endl;
-        return 0;
+    LASFile file;
+    if (!file.open(inputFile)) {
+        return false;
     }
     
-    // 设置I/O缓冲区
-    const int IO_BUFFER_SIZE = 1024 * 1024;
-    std::vector<char> io_buffer(IO_BUFFER_SIZE);
-    file.rdbuf()->pubsetbuf(io_buffer.data(), IO_BUFFER_SIZE);
+    LASHeader h = file.header();
+    Eigen::Vector3d scale(h.x_scale, h.y_scale, h.z_scale);
+    Eigen::Vector3d offset(h.x_offset, h.y_offset, h.z_offset);
     
-    // 读取LAS文件头
-    char header[227];
-    file.read(header, 227);
+    // 原包围盒8个角点变换后的范围包含所有变换后的点，用它判断原偏移是否仍然可用。
+    // 头部边界可能过期，写出时仍逐块检查实际的点
+    Eigen::AlignedBox3d bounds(Eigen::Vector3d(h.min_x, h.min_y, h.min_z), Eigen::Vector3d(h.max_x, h.max_y, h.max_z));
+    Eigen::AlignedBox3d transformedBounds;
+    for (int corner = 0; corner < 8; ++corner) {
+        transformedBounds.extend(transform * bounds.corner(static_cast<Eigen::AlignedBox3d::CornerType>(corner)));
+    }
+    if (!LASFormat::fitsInt32(transformedBounds, scale, offset)) {
+        offset = transformedBounds.min();
+        if (!LASFormat::fitsInt32(transformedBounds, scale, offset)) {
+            std::cerr << "变换后的坐标范围超出缩放因子可表示的范围" << std::endl;
+            return false;
+        }
+    }
     
-    if (!file || std::strncmp(header, "LASF", 4) != 0) {
-        std::cerr << "不是有效的LAS文件" << std::endl;
-        file.close();
-        return 0;
+    if (h.compressed || LAZCodec::isLAZFilename(outputFile)) {
+        return LAZCodec::transformFile(file, outputFile, transform, offset, progress);
     }
     
-    // 提取头部信息
-    uint32_t offset_to_data = *reinterpret_cast<uint32_t*>(header + 96);
-    uint32_t num_point_records = *reinterpret_cast<uint32_t*>(header + 107);
-    uint16_t point_record_length = *reinterpret_cast<uint16_t*>(header + 105);
+    std::ofstream out(outputFile, std::ios::binary);
+    if (!out.is_open()) {
+        std::cerr << "无法创建文件: " << outputFile << std::endl;
+        return false;
+    }
     
-    double x_scale = *reinterpret_cast<double*>(header + 131);
-    double y_scale = *reinterpret_cast<double*>(header + 139);
-    double z_scale = *reinterpret_cast<double*>(header + 147);
-    double x_offset = *reinterpret_cast<double*>(header + 155);
-    double y_offset = *reinterpret_cast<double*>(header + 163);
-    double z_offset = *reinterpret_cast<double*>(header + 171);
+    // 头部和VLR原样写出，偏移和边界在最后回填
+    out.write(file.data(), h.offset_to_data);
     
-    // 跳转到点数据
-    file.seekg(offset_to_data, std::ios::beg);
+    LASHeader outHeader = h;
+    outHeader.x_offset = offset.x();
+    outHeader.y_offset = offset.y();
+    outHeader.z_offset = offset.z();
     
-    size_t total_read = 0;
-    std::vector<Point3D> batch;
-    batch.reserve(batch_size);
+    const size_t numPoints = file.pointCount();
+    const size_t recordLength = h.point_record_length;
     
-    // 使用批量读取缓冲区
-    const int READ_BUFFER_SIZE = 10000;
-    std::vector<char> read_buffer(READ_BUFFER_SIZE * point_record_length);
+    // 复制一批原始记录，只并行改写每条记录开头的XYZ，其余字节保持不变。
+    // 变换后超出32位表示范围的块不写入并标记溢出，导出失败
+    std::atomic<bool> overflow(false);
+    auto transformBatch = [&](size_t begin, std::vector<char>& buffer, Eigen::AlignedBox3d& batchBounds) {
+        size_t count = std::min(WRITE_BATCH_POINTS, numPoints - begin);
+        buffer.assign(file.recordData(begin), file.recordData(begin) + count * recordLength);
+        file.advise(h.offset_to_data + begin * recordLength, count * recordLength, MappedFile::Access::Release);
+        
+        std::vector<Parallel::Range> ranges = Parallel::splitRange(count, ENCODE_MIN_CHUNK);
+        std::vector<Eigen::AlignedBox3d> rangeBounds(ranges.size());
+        Parallel::forEach(ranges, [&](const Parallel::Range& range) {
+            Point3D block[LASFormat::XYZ_BLOCK_SIZE];
+            for (size_t i = range.begin; i < range.end; i += LASFormat::XYZ_BLOCK_SIZE) {
+                size_t n = std::min(LASFormat::XYZ_BLOCK_SIZE, range.end - i);
+                char* record = buffer.data() + i * recordLength;
+                LASFormat::decodeXYZ(record, recordLength, n, h, block);
+                
+                Eigen::Map<Eigen::Matrix<double, 3, Eigen::Dynamic>> points(&block[0].x, 3, static_cast<Eigen::Index>(n));
+                points = (transform.linear() * points).colwise() + transform.translation();
+                const Eigen::AlignedBox3d blockBounds(points.rowwise().minCoeff(), points.rowwise().maxCoeff());
+                if (!LASFormat::fitsInt32(blockBounds, scale, offset)) {
+                    overflow = true;
+                    return;
+                }
+                rangeBounds[range.index].extend(blockBounds);
+                
+                LASFormat::encodeXYZ(block, n, outHeader, record, recordLength);
+            }
+        });
+        
+        batchBounds.setEmpty();
+        for (const Eigen::AlignedBox3d& box : rangeBounds) {
+            batchBounds.extend(box);
+        }
+    };
     
-    for (uint32_t batch_start = 0; batch_start < num_point_records; batch_start += READ_BUFFER_SIZE) {
-        int points_to_read = std::min(READ_BUFFER_SIZE, static_cast<int>(num_point_records - batch_start));
-        int bytes_to_read = points_to_read * point_record_length;
+    std::vector<char> current, next;
+    Eigen::AlignedBox3d currentBounds, nextBounds, total;
+    if (numPoints > 0) {
+        transformBatch(0, current, currentBounds);
+    }
+    for (size_t begin = 0; begin < numPoints && out && !overflow; begin += WRITE_BATCH_POINTS) {
+        size_t nextBegin = begin + WRITE_BATCH_POINTS;
+        QFuture<void> pending;
+        if (nextBegin < numPoints) {
+            pending = QtConcurrent::run([&transformBatch, &next, &nextBounds, nextBegin]() {
+                transformBatch(nextBegin, next, nextBounds);
+            });
+        }
         
-        file.read(read_buffer.data(), bytes_to_read);
+        out.write(current.data(), static_cast<std::streamsize>(current.size()));
+        total.extend(currentBounds);
         
-        if (!file && !file.eof()) {
-            break;
+        pending.waitForFinished();
+        std::swap(current, next);
+        std::swap(currentBounds, nextBounds);
+        if (progress) {
+            progress(std::min(nextBegin, numPoints), numPoints);
         }
+    }
+    if (overflow) {
+        out.close();
+        std::remove(outputFile.c_str());
+        std::cerr << "变换后的坐标超出偏移的32位表示范围(头部边界与点不符): " << inputFile << std::endl;
+        return false;
+    }
+    
+    // 点数据之后的EVLR等内容原样复制(点数据长度不变，EVLR的起始偏移依然有效)
+    size_t tail = h.offset_to_data + numPoints * recordLength;
+    if (tail < file.fileSize()) {
+        out.write(file.data() + tail, static_cast<std::streamsize>(file.fileSize() - tail));
+    }
+    
+    // 回填偏移和边界
+    if (numPoints > 0) {
+        char patch[72];
+        double values[9] = {offset.x(), offset.y(), offset.z(),
+                            total.max().x(), total.min().x(), total.max().y(),
+                            total.min().y(), total.max().z(), total.min().z()};
+        std::memcpy(patch, values, sizeof(patch));
+        out.seekp(155);
+        out.write(patch, sizeof(patch));
+    }
+    
+    out.close();
+    if (!out) {
+        std::cerr << "写入文件失败: " << outputFile << std::endl;
+        return false;
+    }
+    
+    std::cout << "已将变换应用到 " << numPoints << " 个点并写入 " << outputFile << std::endl;
+    return true;
+}
+
+size_t LASIO::readLASBatch(const std::string& filename, 
+                           size_t batch_size,
+                           std::function<void(const std::vector<Point3D>&)> process_func,
+                           size_t queue_depth)
+{
+    LASFile file;
+    if (!file.open(filename) || batch_size == 0) {
+        return 0;
+    }
+    
+    size_t numPoints = file.pointCount();
+    const LASHeader& h = file.header();
+    
+    // LAZ文件按批解压，每批内部仍按压缩块并行，回调处理当前批时后台解压下一批
+    if (h.compressed) {
+        size_t total_read = 0;
+        PointCloud current, next;
+        auto decompress = [&file, batch_size](size_t first, PointCloud& batch) {
+            LASReadOptions options;
+            options.first = first;
+            options.maxPoints = batch_size;
+            return file.readPoints(batch, options);
+        };
         
-        // 解析读取的数据
-        for (int i = 0; i < points_to_read; i++) {
-            int offset = i * point_record_length;
-            int32_t x = *reinterpret_cast<int32_t*>(read_buffer.data() + offset);
-            int32_t y = *reinterpret_cast<int32_t*>(read_buffer.data() + offset + 4);
-            int32_t z = *reinterpret_cast<int32_t*>(read_buffer.data() + offset + 8);
-            
-            Point3D p;
-            p.x = x * x_scale + x_offset;
-            p.y = y * y_scale + y_offset;
-            p.z = z * z_scale + z_offset;
+        bool ok = decompress(0, current);
+        for (size_t first = 0; ok && first < numPoints; first += batch_size) {
+            const size_t nextFirst = first + batch_size;
+            const bool hasNext = nextFirst < numPoints;
+            bool nextOk = false;
+            QFuture<void> pending;
+            if (hasNext && queue_depth > 1) {
+                pending = QtConcurrent::run([&]() { nextOk = decompress(nextFirst, next); });
+            }
             
-            batch.push_back(p);
+            process_func(current.points);
+            total_read += current.points.size();
             
-            if (batch.size() >= batch_size) {
-                process_func(batch);
-                total_read += batch.size();
-                batch.clear();
+            if (!hasNext) {
+                break;
+            }
+            if (queue_depth > 1) {
+                pending.waitForFinished();
+            } else {
+                nextOk = decompress(nextFirst, next);
             }
+            ok = nextOk;
+            std::swap(current, next);
         }
+        return total_read;
     }
     
-    // 处理剩余数据
-    if (!batch.empty()) {
+    size_t total_read = 0;
+    std::vector<Point3D> batch;
+    
+    // 每批对应流水线中的一块，回调处理当前批时后续的批已在读取
+    forEachRecordBlock(file, 0, numPoints, batch_size, queue_depth, [&](const char* records, size_t, size_t count) {
+        batch.resize(count);
+        std::vector<Parallel::Range> ranges = Parallel::splitRange(count, PIPELINE_MIN_CHUNK);
+        Parallel::forEach(ranges, [&](const Parallel::Range& range) {
+            LASFormat::decodeXYZ(records + range.begin * h.point_record_length, h.point_record_length,
+                                 range.end - range.begin, h, batch.data() + range.begin);
+        });
+        
         process_func(batch);
-        total_read += batch.size();
-    }
+        total_read += count;
+    });
     
-    file.close();
     return total_read;
 }
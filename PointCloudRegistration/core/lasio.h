@@ -2,8 +2,248 @@
 #define LASIO_H
 
 #include <string>
+#include <vector>
 #include <functional>
+#include <cstdint>
 #include "pointcloud.h"
+#include "mappedfile.h"
+
+/**
+ * @brief 读取进度回调
+ *
+ * 参数为已解码点数和总点数。回调可能在工作线程中被调用，但调用之间是串行的。
+ */
+using LASProgressCallback = std::function<void(size_t decoded, size_t total)>;
+
+/**
+ * @brief 分块解码回调
+ *
+ * 参数为输出点云中刚解码完成的区间[begin, end)，之后这些点不再改变，可以在读取结束前使用
+ * (例如边加载边显示)。最终点云中的每个点恰好报告一次，读取失败时已报告的点作废。
+ * 回调可能在多个工作线程中并发调用。
+ */
+using LASChunkCallback = std::function<void(size_t begin, size_t end)>;
+
+// 每次报告的最大点数：接收者可能复制报告的点(例如流式显示)，较大的区间分段报告
+constexpr size_t LAS_CHUNK_REPORT_POINTS = size_t(1) << 20;
+
+/**
+ * @brief 把区间[begin, end)按不超过LAS_CHUNK_REPORT_POINTS的分段依次报告
+ */
+inline void reportChunks(const LASChunkCallback& callback, size_t begin, size_t end)
+{
+    while (begin < end) {
+        const size_t next = end - begin > LAS_CHUNK_REPORT_POINTS ? begin + LAS_CHUNK_REPORT_POINTS : end;
+        callback(begin, next);
+        begin = next;
+    }
+}
+
+/**
+ * @brief 可选解码的点属性（按位组合，XYZ总是解码）
+ */
+namespace LASAttribute {
+enum : unsigned {
+    XYZ            = 0,
+    Intensity      = 1u << 0,
+    RGB            = 1u << 1,
+    GPSTime        = 1u << 2,
+    Classification = 1u << 3,
+    ExtraBytes     = 1u << 4,   // 记录中标准字段之后的额外字节
+    RecordFields   = 1u << 5,   // 坐标之后全部标准字段的原始字节(回波、扫描角、用户数据、点源ID、近红外等)，写回时原样保留
+    All            = Intensity | RGB | GPSTime | Classification | ExtraBytes | RecordFields
+};
+}
+
+/**
+ * @brief 限制点数(maxPoints)时选取记录的方式
+ */
+enum class LASSampling {
+    Head,       // 从first开始按stride顺序读取，读满maxPoints为止
+    Stride,     // 整个文件等间隔跨步读取maxPoints个点
+    Random,     // 整个文件均匀随机采样maxPoints个点
+    Voxel       // 体素滤波，每个体素保留一个点，点数不超过maxPoints
+};
+
+/**
+ * @brief 读取选项
+ */
+struct LASReadOptions {
+    size_t first = 0;                           // 第一条记录的序号
+    size_t maxPoints = 0;                       // 最多读取的点数 (0表示读取到文件末尾)
+    size_t stride = 1;                          // 记录间隔（1表示连续读取）
+    LASSampling sampling = LASSampling::Head;   // 非Head时忽略first和stride，对整个文件采样
+    size_t readQueueDepth = 2;                  // 连续读取时流水线的块队列深度(0表示直接从映射区解码)
+    unsigned attributes = LASAttribute::XYZ;    // 需要解码的属性，格式中没有的属性会被忽略
+    bool useCache = true;                       // 整体读取时使用并更新文件旁的.pcrcache缓存(LASIO::readLAS和PointCloudIO::read)
+    LASProgressCallback progress;               // 每个分块完成后的进度回调(可为空)
+    LASChunkCallback chunkDecoded;              // 每个分块完成后报告其输出区间(可为空)
+};
+
+namespace LASFormat {
+struct DecodeTarget;
+}
+
+/**
+ * @brief LAS文件头部信息（解析后的字段，非磁盘布局）
+ */
+struct LASHeader {
+    uint8_t version_major = 0;
+    uint8_t version_minor = 0;
+    uint16_t global_encoding = 0;
+    uint16_t header_size = 0;
+    uint32_t offset_to_data = 0;
+    uint32_t num_variable_records = 0;
+    uint8_t point_format = 0;
+    uint16_t point_record_length = 0;   // 未压缩记录长度
+    bool compressed = false;            // LAZ压缩(点格式字节的高位标志)
+    uint64_t num_point_records = 0;     // LAS 1.4扩展头部中的64位点数优先
+    uint64_t start_of_first_evlr = 0;   // LAS 1.4
+    uint32_t num_evlr = 0;              // LAS 1.4
+    double x_scale = 1.0;
+    double y_scale = 1.0;
+    double z_scale = 1.0;
+    double x_offset = 0.0;
+    double y_offset = 0.0;
+    double z_offset = 0.0;
+    double max_x = 0.0;
+    double min_x = 0.0;
+    double max_y = 0.0;
+    double min_y = 0.0;
+    double max_z = 0.0;
+    double min_z = 0.0;
+};
+
+/**
+ * @brief 一段连续的点记录
+ */
+struct LASRecordRun {
+    uint64_t first;     // 第一条记录的序号
+    uint64_t count;     // 记录数
+};
+
+/**
+ * @brief 变长记录(VLR)或LAS 1.4扩展变长记录(EVLR)
+ */
+struct LASVariableRecord {
+    std::string user_id;
+    uint16_t record_id = 0;
+    std::string description;
+    const char* data = nullptr;     // 映射区中的记录负载
+    uint64_t length = 0;            // 负载字节数
+    bool extended = false;          // 是否为EVLR
+};
+
+/**
+ * @brief 内存映射的LAS文件
+ *
+ * 打开时映射整个文件并解析头部，点记录直接从映射区解码到调用者预分配的输出中，
+ * 同一个映射可以反复用于整体、部分或跨步读取，无需中间缓冲区拷贝。
+ */
+class LASFile
+{
+public:
+    LASFile();
+    
+    /**
+     * @brief 打开并映射LAS文件，解析头部
+     * @param filename 文件路径
+     * @return 是否成功
+     */
+    bool open(const std::string& filename);
+    void close();
+    
+    bool isOpen() const { return m_file.isOpen(); }
+    const std::string& filename() const { return m_filename; }
+    const LASHeader& header() const { return m_header; }
+    
+    // 所有VLR和EVLR(按文件中的顺序)
+    const std::vector<LASVariableRecord>& variableRecords() const { return m_variableRecords; }
+    
+    // 按user_id和record_id查找变长记录，不存在时返回nullptr
+    const LASVariableRecord* findVariableRecord(const std::string& user_id, uint16_t record_id) const;
+    
+    // 对文件区域给出访问模式提示
+    void advise(size_t offset, size_t length, MappedFile::Access access) const {
+        m_file.advise(offset, length, access);
+    }
+    
+    // 映射的整个文件内容
+    const char* data() const { return m_file.data(); }
+    size_t fileSize() const { return m_file.size(); }
+    
+    // 文件中实际可读的点记录数(未压缩文件按文件大小截断过的头部点数)
+    size_t pointCount() const { return m_pointCount; }
+    
+    // 按读取选项计算实际会读取的点数
+    size_t readCount(const LASReadOptions& options) const;
+    
+    // 第index条点记录的原始字节(仅适用于未压缩文件)
+    const char* recordData(size_t index) const {
+        return m_file.data() + m_header.offset_to_data + index * m_header.point_record_length;
+    }
+    
+    /**
+     * @brief 在调用线程中把从first起跨步的count条记录解码到调用者给出的输出位置
+     *
+     * 不分配内存也不启动并行任务，供调用者把多个文件的记录直接解码到同一个点云的不同区间。
+     * 输出中为空的指针对应的属性不解码，点格式中没有的属性保持原值；
+     * 输出的额外字节长度必须与extraBytesSize()一致，标准字段长度必须与点格式一致。LAZ文件交给LAZCodec::decodeRange。
+     * @param out 输出位置，至少容纳count个点
+     * @param first 第一条记录的序号
+     * @param count 解码的点数
+     * @param stride 记录间隔（1表示连续读取）
+     * @return 是否成功
+     */
+    bool decodeRange(const LASFormat::DecodeTarget& out, size_t first, size_t count, size_t stride = 1) const;
+    
+    // 当前点格式可以提供的属性
+    unsigned availableAttributes() const;
+    
+    // 每条记录在标准字段之后的额外字节数
+    uint16_t extraBytesSize() const;
+    
+    // 写回时沿用的编码参数(点格式、缩放、偏移和VLR)
+    std::shared_ptr<const PointCloudEncoding> encoding() const;
+    
+    /**
+     * @brief 读取部分或跨步的点到点云(会清空原有数据)
+     *
+     * 按点格式选择一次编译期特化的解码器，记录区间被切分成若干块，
+     * 由线程池并行解码到输出中互不重叠的区间。只解码options.attributes中请求的属性。
+     * 连续读取时通过BlockReader流水线读取，解码当前块的同时后台读取后续的块。
+     * LAZ文件交给LAZCodec按压缩块并行解压。设置了maxPoints且采样方式不是Head时，
+     * 先由LASSampler选出记录，再只解码被选中的记录。
+     * @param cloud 输出点云对象
+     * @param options 读取范围、属性和进度回调
+     * @return 是否成功
+     */
+    bool readPoints(PointCloud& cloud, const LASReadOptions& options = LASReadOptions()) const;
+    
+    /**
+     * @brief 按记录段读取点到点云(会清空原有数据)
+     *
+     * 各段按顺序拼接到输出中，段内容按总点数切分后并行解码。
+     * 只使用options中的attributes和progress，范围和跨步参数被忽略。
+     * @param cloud 输出点云对象
+     * @param runs 记录段(超出文件的部分会被截掉)
+     * @param options 需要的属性和进度回调
+     * @return 是否成功
+     */
+    bool readRuns(PointCloud& cloud, const std::vector<LASRecordRun>& runs,
+                  const LASReadOptions& options = LASReadOptions()) const;
+
+private:
+    bool parseHeader();
+    bool parseVariableRecords();
+    bool readSample(PointCloud& cloud, const LASReadOptions& options) const;
+    
+    MappedFile m_file;
+    std::string m_filename;
+    LASHeader m_header;
+    std::vector<LASVariableRecord> m_variableRecords;
+    size_t m_pointCount;
+};
 
 /**
  * @brief LAS文件输入输出工具类
@@ -12,69 +252,94 @@ class LASIO
 {
 public:
     /**
-     * @brief 读取LAS文件
+     * @brief 读取LAS或LAZ文件(按头部的压缩标志区分)
+     * @param filename 文件路径
+     * @param cloud 输出点云对象
+     * @param maxPoints 最大读取点数 (0表示读取所有点)，超过时对整个文件等间隔跨步采样
+     * @param progress 分块解码进度回调(可为空)
+     * @return 是否成功
+     */
+    static bool readLAS(const std::string& filename, PointCloud& cloud, size_t maxPoints = 0,
+                        const LASProgressCallback& progress = nullptr);
+    
+    /**
+     * @brief 按选项读取LAS文件(范围、跨步和需要的属性)
+     *
+     * 读取整个文件且options.useCache为true时，先尝试从PointCloudCache加载，
+     * 缓存缺失或过期则解码文件并重新写出缓存。
+     * @param filename 文件路径
+     * @param cloud 输出点云对象
+     * @param options 读取选项
+     * @return 是否成功
+     */
+    static bool readLAS(const std::string& filename, PointCloud& cloud, const LASReadOptions& options);
+    
+    /**
+     * @brief 只读取与包围盒相交区域的点
+     *
+     * COPC文件使用其八叉树层级，普通LAS/LAZ文件使用buildSpatialIndex生成的旁路索引，
+     * 只解码与包围盒相交的节点，再裁剪掉盒外的点。两者都没有时退化为整体读取后裁剪。
      * @param filename 文件路径
      * @param cloud 输出点云对象
-     * @param maxPoints 最大读取点数 (0表示读取所有点)
+     * @param bbox 查询包围盒
+     * @param maxDepth 最深读取的八叉树层级(0为根节点，负数表示不限制)，层级越浅点越稀疏
+     * @param options 需要的属性和进度回调(范围和跨步参数被忽略)
+     * @return 是否成功
+     */
+    static bool readRegion(const std::string& filename, PointCloud& cloud, const Eigen::AlignedBox3d& bbox,
+                           int maxDepth = -1, const LASReadOptions& options = LASReadOptions());
+    
+    /**
+     * @brief 为普通LAS/LAZ文件生成空间旁路索引(文件名后加.lasidx)
+     * @param filename LAS文件路径
+     * @param depth 索引最深层级(0表示按点数自动选择)
      * @return 是否成功
      */
-    static bool readLAS(const std::string& filename, PointCloud& cloud, size_t maxPoints = 0);
+    static bool buildSpatialIndex(const std::string& filename, int depth = 0);
     
     /**
-     * @brief 写入LAS文件
+     * @brief 写入LAS文件，扩展名为.laz时写入LAZ压缩文件
+     *
+     * 点云带有来源编码时沿用其点格式、缩放、偏移、额外字节和VLR，否则按已有属性选择格式0-3，
+     * 缩放0.001。记录按大块并行编码到内存缓冲区，编码下一块的同时写出上一块，每块只写一次。
+     * 坐标超出来源偏移的32位范围时改用点云最小值作为偏移。
      * @param filename 文件路径
      * @param cloud 输入点云对象
      * @return 是否成功
      */
     static bool writeLAS(const std::string& filename, const PointCloud& cloud);
     
+    /**
+     * @brief 把刚体变换应用到整个LAS/LAZ文件并写出新文件(流式处理，内存占用与文件大小无关)
+     *
+     * 每批复制一段原始记录，只改写其中的XYZ，其余字节、头部、VLR和EVLR原样保留，
+     * 最后回填头部的边界。变换后坐标超出原偏移的32位范围时改用新的偏移；偏移按头部边界选取，
+     * 头部边界过期导致实际的点超出范围时删除输出并返回失败。
+     * LAZ输入或.laz输出通过LASzip逐点处理。
+     * @param inputFile 原始文件(通常是全分辨率源点云)
+     * @param outputFile 输出文件
+     * @param transform 变换矩阵
+     * @param progress 进度回调(可为空)
+     * @return 是否成功
+     */
+    static bool transformLAS(const std::string& inputFile, const std::string& outputFile,
+                             const Eigen::Affine3d& transform, const LASProgressCallback& progress = nullptr);
+    
     /**
      * @brief 批量读取LAS文件
+     *
+     * 每批是读取流水线中的一块：回调处理当前批时，后续最多queue_depth - 1批已在后台读取
+     * (LAZ文件在后台解压下一批)。
      * @param filename 文件路径
      * @param batch_size 每批读取的点数
      * @param process_func 处理每批数据的函数
+     * @param queue_depth 流水线的块队列深度(1表示读取与回调交替进行)
      * @return 总共读取的点数
      */
-    static size_t readLASBatch(const std::string& filename, 
+    static size_t readLASBatch(const std::string& filename,
                                size_t batch_size,
-                               std::function<void(const std::vector<Point3D>&)> process_func);
-
-private:
-    // LAS文件头部结构（简化版）
-    struct LASHeader {
-        char signature[4];
-        uint16_t file_source_id;
-        uint16_t global_encoding;
-        uint32_t project_id1;
-        uint16_t project_id2;
-        uint16_t project_id3;
-        uint64_t project_id4;
-        uint8_t version_major;
-        uint8_t version_minor;
-        char system_id[32];
-        char software[32];
-        uint16_t creation_day;
-        uint16_t creation_year;
-        uint16_t header_size;
-        uint32_t offset_to_data;
-        uint32_t num_variable_records;
-        uint8_t point_format;
-        uint16_t point_record_length;
-        uint32_t num_point_records;
-        uint32_t num_points_by_return[5];
-        double x_scale;
-        double y_scale;
-        double z_scale;
-        double x_offset;
-        double y_offset;
-        double z_offset;
-        double max_x;
-        double min_x;
-        double max_y;
-        double min_y;
-        double max_z;
-        double min_z;
-    };
+                               std::function<void(const std::vector<Point3D>&)> process_func,
+                               size_t queue_depth = 2);
 };
 
 #endif // LASIO_H
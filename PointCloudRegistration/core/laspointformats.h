@@ -0,0 +1,510 @@
+#ifndef LASPOINTFORMATS_H
+#define LASPOINTFORMATS_H
+
+#include <cstdint>
+#include <cstring>
+#include <cmath>
+#include <algorithm>
+#include <vector>
+#include "lasio.h"
+
+/**
+ * @brief LAS点记录格式0-10的字段布局与解码器
+ *
+ * 每种格式的字段偏移在编译期确定，解码器按格式实例化，打开文件时只选择一次。
+ * 每个属性单独按列解码，循环体内没有按记录的格式或属性判断。
+ */
+namespace LASFormat {
+
+// 从可能未对齐的地址读取小端字段
+template<typename T>
+inline T readField(const char* data)
+{
+    T value;
+    std::memcpy(&value, data, sizeof(T));
+    return value;
+}
+
+// 按缩放和偏移把坐标四舍五入为记录中的整数
+inline int32_t quantize(double value, double scale, double offset)
+{
+    return static_cast<int32_t>(std::llround((value - offset) / scale));
+}
+
+// 包围盒内的坐标按给定缩放和偏移量化后是否都在32位整数范围内
+inline bool fitsInt32(const Eigen::AlignedBox3d& box, const Eigen::Vector3d& scale, const Eigen::Vector3d& offset)
+{
+    Eigen::Array3d lo = (box.min() - offset).array() / scale.array();
+    Eigen::Array3d hi = (box.max() - offset).array() / scale.array();
+    return (lo >= static_cast<double>(INT32_MIN)).all() && (hi <= static_cast<double>(INT32_MAX)).all();
+}
+
+// 坐标之后的标准字段(回波、分类、扫描角、用户数据、点源ID等)从记录偏移12开始
+constexpr int RECORD_FIELDS_OFFSET = 12;
+
+/**
+ * @brief 字段布局，偏移为-1表示该格式不含此字段
+ */
+struct LegacyLayout {              // 格式0-5
+    static constexpr int intensity = 12;
+    static constexpr int returns = 14;
+    static constexpr uint8_t singleReturn = 0x09;     // 第1次回波，共1次(各3位)
+    static constexpr int classification = 15;
+    static constexpr uint8_t classificationMask = 0x1F;
+};
+
+struct ExtendedLayout {            // 格式6-10 (LAS 1.4)
+    static constexpr int intensity = 12;
+    static constexpr int returns = 14;
+    static constexpr uint8_t singleReturn = 0x11;     // 第1次回波，共1次(各4位)
+    static constexpr int classification = 16;
+    static constexpr uint8_t classificationMask = 0xFF;
+};
+
+template<int Format> struct Layout;
+
+template<> struct Layout<0> : LegacyLayout {
+    static constexpr int gpsTime = -1, rgb = -1, nir = -1, wavePacket = -1, recordLength = 20;
+};
+template<> struct Layout<1> : LegacyLayout {
+    static constexpr int gpsTime = 20, rgb = -1, nir = -1, wavePacket = -1, recordLength = 28;
+};
+template<> struct Layout<2> : LegacyLayout {
+    static constexpr int gpsTime = -1, rgb = 20, nir = -1, wavePacket = -1, recordLength = 26;
+};
+template<> struct Layout<3> : LegacyLayout {
+    static constexpr int gpsTime = 20, rgb = 28, nir = -1, wavePacket = -1, recordLength = 34;
+};
+template<> struct Layout<4> : LegacyLayout {
+    static constexpr int gpsTime = 20, rgb = -1, nir = -1, wavePacket = 28, recordLength = 57;
+};
+template<> struct Layout<5> : LegacyLayout {
+    static constexpr int gpsTime = 20, rgb = 28, nir = -1, wavePacket = 34, recordLength = 63;
+};
+template<> struct Layout<6> : ExtendedLayout {
+    static constexpr int gpsTime = 22, rgb = -1, nir = -1, wavePacket = -1, recordLength = 30;
+};
+template<> struct Layout<7> : ExtendedLayout {
+    static constexpr int gpsTime = 22, rgb = 30, nir = -1, wavePacket = -1, recordLength = 36;
+};
+template<> struct Layout<8> : ExtendedLayout {
+    static constexpr int gpsTime = 22, rgb = 30, nir = 36, wavePacket = -1, recordLength = 38;
+};
+template<> struct Layout<9> : ExtendedLayout {
+    static constexpr int gpsTime = 22, rgb = -1, nir = -1, wavePacket = 30, recordLength = 59;
+};
+template<> struct Layout<10> : ExtendedLayout {
+    static constexpr int gpsTime = 22, rgb = 30, nir = 36, wavePacket = 38, recordLength = 67;
+};
+
+/**
+ * @brief 解码输出位置，为空的指针表示不需要该属性
+ */
+static_assert(sizeof(PointColor) == 3 * sizeof(uint16_t), "PointColor must match the LAS RGB layout");
+
+struct DecodeTarget {
+    Point3D* xyz = nullptr;
+    uint16_t* intensity = nullptr;
+    PointColor* rgb = nullptr;
+    double* gpsTime = nullptr;
+    uint8_t* classification = nullptr;
+    uint8_t* recordFields = nullptr;
+    size_t recordFieldsSize = 0;
+    uint8_t* extraBytes = nullptr;
+    size_t extraBytesSize = 0;
+    
+    // 偏移到第i个点的输出位置
+    DecodeTarget at(size_t i) const {
+        DecodeTarget t;
+        t.xyz = xyz + i;
+        t.intensity = intensity ? intensity + i : nullptr;
+        t.rgb = rgb ? rgb + i : nullptr;
+        t.gpsTime = gpsTime ? gpsTime + i : nullptr;
+        t.classification = classification ? classification + i : nullptr;
+        t.recordFields = recordFields ? recordFields + i * recordFieldsSize : nullptr;
+        t.recordFieldsSize = recordFieldsSize;
+        t.extraBytes = extraBytes ? extraBytes + i * extraBytesSize : nullptr;
+        t.extraBytesSize = extraBytesSize;
+        return t;
+    }
+};
+
+/**
+ * @brief 编码输入，为空的指针表示该字段沿用原始标准字段(没有原始字段时写0)
+ */
+struct EncodeSource {
+    const Point3D* xyz = nullptr;
+    const uint16_t* intensity = nullptr;
+    const PointColor* rgb = nullptr;
+    const double* gpsTime = nullptr;
+    const uint8_t* classification = nullptr;
+    const uint8_t* recordFields = nullptr;
+    size_t recordFieldsSize = 0;
+    const uint8_t* extraBytes = nullptr;
+    size_t extraBytesSize = 0;
+    
+    EncodeSource at(size_t i) const {
+        EncodeSource s = *this;
+        s.xyz = xyz + i;
+        s.intensity = intensity ? intensity + i : nullptr;
+        s.rgb = rgb ? rgb + i : nullptr;
+        s.gpsTime = gpsTime ? gpsTime + i : nullptr;
+        s.classification = classification ? classification + i : nullptr;
+        s.recordFields = recordFields ? recordFields + i * recordFieldsSize : nullptr;
+        s.extraBytes = extraBytes ? extraBytes + i * extraBytesSize : nullptr;
+        return s;
+    }
+};
+
+/**
+ * @brief 按需要的属性为点云分配count个点，返回指向开头的输出位置
+ */
+inline DecodeTarget prepareTarget(PointCloud& cloud, size_t count, unsigned attributes,
+                                  size_t extraBytesSize = 0, size_t recordFieldsSize = 0)
+{
+    cloud.points.resize(count);
+    if (attributes & LASAttribute::Intensity) cloud.intensity.resize(count);
+    if (attributes & LASAttribute::RGB) cloud.rgb.resize(count);
+    if (attributes & LASAttribute::GPSTime) cloud.gpsTime.resize(count);
+    if (attributes & LASAttribute::Classification) cloud.classification.resize(count);
+    if ((attributes & LASAttribute::RecordFields) && recordFieldsSize > 0) {
+        cloud.recordFields.resize(count * recordFieldsSize);
+    }
+    if ((attributes & LASAttribute::ExtraBytes) && extraBytesSize > 0) cloud.extraBytes.resize(count * extraBytesSize);
+    
+    DecodeTarget target;
+    target.xyz = cloud.points.data();
+    target.intensity = cloud.intensity.empty() ? nullptr : cloud.intensity.data();
+    target.rgb = cloud.rgb.empty() ? nullptr : cloud.rgb.data();
+    target.gpsTime = cloud.gpsTime.empty() ? nullptr : cloud.gpsTime.data();
+    target.classification = cloud.classification.empty() ? nullptr : cloud.classification.data();
+    target.recordFields = cloud.recordFields.empty() ? nullptr : cloud.recordFields.data();
+    target.recordFieldsSize = target.recordFields ? recordFieldsSize : 0;
+    target.extraBytes = cloud.extraBytes.empty() ? nullptr : cloud.extraBytes.data();
+    target.extraBytesSize = extraBytesSize;
+    return target;
+}
+
+/**
+ * @brief 点云中可用于编码的字段(长度与点数不一致的属性视为缺失)
+ */
+inline EncodeSource encodeSource(const PointCloud& cloud, size_t extraBytesSize, size_t recordFieldsSize)
+{
+    const size_t n = cloud.points.size();
+    EncodeSource source;
+    source.xyz = cloud.points.data();
+    source.intensity = cloud.intensity.size() == n ? cloud.intensity.data() : nullptr;
+    source.rgb = cloud.rgb.size() == n ? cloud.rgb.data() : nullptr;
+    source.gpsTime = cloud.gpsTime.size() == n ? cloud.gpsTime.data() : nullptr;
+    source.classification = cloud.classification.size() == n ? cloud.classification.data() : nullptr;
+    if (recordFieldsSize > 0 && cloud.recordFields.size() == n * recordFieldsSize) {
+        source.recordFields = cloud.recordFields.data();
+        source.recordFieldsSize = recordFieldsSize;
+    }
+    if (extraBytesSize > 0 && cloud.extraBytes.size() == n * extraBytesSize) {
+        source.extraBytes = cloud.extraBytes.data();
+        source.extraBytesSize = extraBytesSize;
+    }
+    return source;
+}
+
+// 向量化转换时单次处理的记录数
+constexpr size_t XYZ_BLOCK_SIZE = 256;
+
+/**
+ * @brief 解码XYZ（所有格式都位于记录开头）
+ *
+ * 先把记录中的整数坐标收集到栈上的小块，再整块做向量化的 int -> double 缩放和平移。
+ */
+inline void decodeXYZ(const char* record, size_t step, size_t count, const LASHeader& h, Point3D* out)
+{
+    using RawBlock = Eigen::Array<int32_t, 3, Eigen::Dynamic, Eigen::ColMajor, 3,
+                                  static_cast<int>(XYZ_BLOCK_SIZE)>;
+    using PointBlock = Eigen::Map<Eigen::Matrix<double, 3, Eigen::Dynamic>>;
+    
+    const Eigen::Array3d scale(h.x_scale, h.y_scale, h.z_scale);
+    const Eigen::Array3d offset(h.x_offset, h.y_offset, h.z_offset);
+    
+    RawBlock raw;
+    for (size_t begin = 0; begin < count; begin += XYZ_BLOCK_SIZE) {
+        Eigen::Index n = static_cast<Eigen::Index>(std::min(XYZ_BLOCK_SIZE, count - begin));
+        raw.resize(3, n);
+        for (Eigen::Index i = 0; i < n; ++i, record += step) {
+            std::memcpy(raw.col(i).data(), record, 3 * sizeof(int32_t));
+        }
+        
+        PointBlock block(&out[begin].x, 3, n);
+        block = ((raw.cast<double>().colwise() * scale).colwise() + offset).matrix();
+    }
+}
+
+/**
+ * @brief 编码XYZ，按文件头的缩放和偏移四舍五入为整数
+ */
+inline void encodeXYZ(const Point3D* in, size_t count, const LASHeader& h, char* record, size_t step)
+{
+    using RawBlock = Eigen::Array<int32_t, 3, Eigen::Dynamic, Eigen::ColMajor, 3,
+                                  static_cast<int>(XYZ_BLOCK_SIZE)>;
+    using ConstPointBlock = Eigen::Map<const Eigen::Matrix<double, 3, Eigen::Dynamic>>;
+    
+    const Eigen::Array3d scale(h.x_scale, h.y_scale, h.z_scale);
+    const Eigen::Array3d offset(h.x_offset, h.y_offset, h.z_offset);
+    
+    RawBlock raw;
+    for (size_t begin = 0; begin < count; begin += XYZ_BLOCK_SIZE) {
+        Eigen::Index n = static_cast<Eigen::Index>(std::min(XYZ_BLOCK_SIZE, count - begin));
+        ConstPointBlock block(&in[begin].x, 3, n);
+        raw = ((block.array().colwise() - offset).colwise() / scale).round().cast<int32_t>();
+        for (Eigen::Index i = 0; i < n; ++i, record += step) {
+            std::memcpy(record, raw.col(i).data(), 3 * sizeof(int32_t));
+        }
+    }
+}
+
+// 解码固定偏移处的一列标量字段
+template<typename T, int Offset>
+inline void decodeColumn(const char* record, size_t step, size_t count, T* out)
+{
+    for (size_t i = 0; i < count; ++i, record += step) {
+        out[i] = readField<T>(record + Offset);
+    }
+}
+
+/**
+ * @brief 按格式解码一段记录
+ * @param record 第一条记录的地址
+ * @param step 相邻两条被解码记录之间的字节数
+ * @param count 记录数
+ * @param h 文件头(缩放和偏移)
+ * @param out 输出位置
+ */
+template<int Format>
+void decodeRecords(const char* record, size_t step, size_t count, const LASHeader& h, const DecodeTarget& out)
+{
+    using L = Layout<Format>;
+    
+    decodeXYZ(record, step, count, h, out.xyz);
+    
+    if (out.intensity) {
+        decodeColumn<uint16_t, L::intensity>(record, step, count, out.intensity);
+    }
+    
+    if (out.classification) {
+        const char* r = record;
+        for (size_t i = 0; i < count; ++i, r += step) {
+            out.classification[i] = static_cast<uint8_t>(r[L::classification]) & L::classificationMask;
+        }
+    }
+    
+    if constexpr (L::gpsTime >= 0) {
+        if (out.gpsTime) {
+            decodeColumn<double, L::gpsTime>(record, step, count, out.gpsTime);
+        }
+    }
+    
+    if constexpr (L::rgb >= 0) {
+        if (out.rgb) {
+            const char* r = record;
+            for (size_t i = 0; i < count; ++i, r += step) {
+                std::memcpy(&out.rgb[i], r + L::rgb, sizeof(PointColor));
+            }
+        }
+    }
+    
+    if (out.recordFields) {
+        const char* r = record + RECORD_FIELDS_OFFSET;
+        for (size_t i = 0; i < count; ++i, r += step) {
+            std::memcpy(out.recordFields + i * out.recordFieldsSize, r, out.recordFieldsSize);
+        }
+    }
+    
+    if (out.extraBytes) {
+        const char* r = record + L::recordLength;
+        for (size_t i = 0; i < count; ++i, r += step) {
+            std::memcpy(out.extraBytes + i * out.extraBytesSize, r, out.extraBytesSize);
+        }
+    }
+}
+
+/**
+ * @brief 截掉记录段中超出文件的部分(丢弃空段)
+ */
+inline std::vector<LASRecordRun> clipRuns(const std::vector<LASRecordRun>& runs, uint64_t pointCount)
+{
+    std::vector<LASRecordRun> clipped;
+    clipped.reserve(runs.size());
+    for (const LASRecordRun& run : runs) {
+        if (run.first < pointCount && run.count > 0) {
+            clipped.push_back({run.first, std::min(run.count, pointCount - run.first)});
+        }
+    }
+    return clipped;
+}
+
+/**
+ * @brief 各记录段在输出中的起始位置(末尾元素为总点数)
+ */
+inline std::vector<size_t> runOffsets(const std::vector<LASRecordRun>& runs)
+{
+    std::vector<size_t> offsets(runs.size() + 1, 0);
+    for (size_t r = 0; r < runs.size(); ++r) {
+        offsets[r + 1] = offsets[r] + static_cast<size_t>(runs[r].count);
+    }
+    return offsets;
+}
+
+/**
+ * @brief 把输出区间[begin, end)映射回记录段，对每一片调用 func(第一条记录, 点数, 输出位置)
+ */
+template<typename Func>
+void forEachRunPiece(const std::vector<LASRecordRun>& runs, const std::vector<size_t>& offsets,
+                     size_t begin, size_t end, Func func)
+{
+    size_t r = static_cast<size_t>(std::upper_bound(offsets.begin(), offsets.end(), begin) - offsets.begin()) - 1;
+    while (begin < end && r < runs.size()) {
+        size_t pieceEnd = std::min(end, offsets[r + 1]);
+        if (pieceEnd > begin) {
+            func(runs[r].first + (begin - offsets[r]), pieceEnd - begin, begin);
+            begin = pieceEnd;
+        }
+        ++r;
+    }
+}
+
+// 编码固定偏移处的一列标量字段
+template<typename T, int Offset>
+inline void encodeColumn(const T* in, size_t count, char* record, size_t step)
+{
+    for (size_t i = 0; i < count; ++i, record += step) {
+        std::memcpy(record + Offset, &in[i], sizeof(T));
+    }
+}
+
+/**
+ * @brief 按格式编码一段连续记录(记录长度取h.point_record_length)
+ *
+ * 有原始标准字段时先原样写回，再用点云中的坐标和属性列覆盖对应字段，分类只替换分类号，
+ * 保留旧格式同一字节中的合成/关键点/保留标志。不写出波形数据，波形数据包字段写0。
+ * 没有原始字段时其余字段写0，回波号和回波数写为1/1。
+ */
+template<int Format>
+void encodeRecords(char* record, size_t count, const LASHeader& h, const EncodeSource& in)
+{
+    using L = Layout<Format>;
+    constexpr size_t fieldsSize = L::recordLength - RECORD_FIELDS_OFFSET;
+    const size_t step = h.point_record_length;
+    
+    std::memset(record, 0, count * step);
+    encodeXYZ(in.xyz, count, h, record, step);
+    
+    char* r = record;
+    if (in.recordFields && in.recordFieldsSize == fieldsSize) {
+        for (size_t i = 0; i < count; ++i, r += step) {
+            std::memcpy(r + RECORD_FIELDS_OFFSET, in.recordFields + i * fieldsSize, fieldsSize);
+            if constexpr (L::wavePacket >= 0) {
+                std::memset(r + L::wavePacket, 0, L::recordLength - L::wavePacket);
+            }
+        }
+    } else {
+        for (size_t i = 0; i < count; ++i, r += step) {
+            r[L::returns] = static_cast<char>(L::singleReturn);
+        }
+    }
+    
+    if (in.intensity) {
+        encodeColumn<uint16_t, L::intensity>(in.intensity, count, record, step);
+    }
+    
+    if (in.classification) {
+        r = record;
+        for (size_t i = 0; i < count; ++i, r += step) {
+            uint8_t flags = static_cast<uint8_t>(r[L::classification]) & ~L::classificationMask;
+            r[L::classification] = static_cast<char>(flags | (in.classification[i] & L::classificationMask));
+        }
+    }
+    
+    if constexpr (L::gpsTime >= 0) {
+        if (in.gpsTime) {
+            encodeColumn<double, L::gpsTime>(in.gpsTime, count, record, step);
+        }
+    }
+    
+    if constexpr (L::rgb >= 0) {
+        if (in.rgb) {
+            encodeColumn<PointColor, L::rgb>(in.rgb, count, record, step);
+        }
+    }
+    
+    if (in.extraBytes && L::recordLength + in.extraBytesSize <= step) {
+        r = record;
+        for (size_t i = 0; i < count; ++i, r += step) {
+            std::memcpy(r + L::recordLength, in.extraBytes + i * in.extraBytesSize, in.extraBytesSize);
+        }
+    }
+}
+
+using RecordDecoder = void (*)(const char*, size_t, size_t, const LASHeader&, const DecodeTarget&);
+using RecordEncoder = void (*)(char*, size_t, const LASHeader&, const EncodeSource&);
+
+/**
+ * @brief 格式描述：编解码器、最小记录长度、可提供的属性和各字段的偏移
+ */
+struct FormatInfo {
+    RecordDecoder decoder = nullptr;
+    RecordEncoder encoder = nullptr;
+    uint16_t recordLength = 0;
+    unsigned attributes = LASAttribute::XYZ;
+    int gpsTime = -1;
+    int rgb = -1;
+    int nir = -1;
+    int wavePacket = -1;
+    
+    // 坐标之后标准字段的字节数(点云recordFields中每点的长度)
+    uint16_t recordFieldsSize() const {
+        return recordLength > RECORD_FIELDS_OFFSET ? static_cast<uint16_t>(recordLength - RECORD_FIELDS_OFFSET) : 0;
+    }
+};
+
+template<int Format>
+FormatInfo makeFormatInfo()
+{
+    using L = Layout<Format>;
+    FormatInfo info;
+    info.decoder = &decodeRecords<Format>;
+    info.encoder = &encodeRecords<Format>;
+    info.recordLength = static_cast<uint16_t>(L::recordLength);
+    info.attributes = LASAttribute::Intensity | LASAttribute::Classification | LASAttribute::RecordFields
+                    | LASAttribute::ExtraBytes;
+    if (L::gpsTime >= 0) info.attributes |= LASAttribute::GPSTime;
+    if (L::rgb >= 0) info.attributes |= LASAttribute::RGB;
+    info.gpsTime = L::gpsTime;
+    info.rgb = L::rgb;
+    info.nir = L::nir;
+    info.wavePacket = L::wavePacket;
+    return info;
+}
+
+/**
+ * @brief 查询点格式，不支持的格式返回decoder为空的描述
+ */
+inline FormatInfo formatInfo(uint8_t format)
+{
+    switch (format) {
+    case 0:  return makeFormatInfo<0>();
+    case 1:  return makeFormatInfo<1>();
+    case 2:  return makeFormatInfo<2>();
+    case 3:  return makeFormatInfo<3>();
+    case 4:  return makeFormatInfo<4>();
+    case 5:  return makeFormatInfo<5>();
+    case 6:  return makeFormatInfo<6>();
+    case 7:  return makeFormatInfo<7>();
+    case 8:  return makeFormatInfo<8>();
+    case 9:  return makeFormatInfo<9>();
+    case 10: return makeFormatInfo<10>();
+    default: return FormatInfo();
+    }
+}
+
+} // namespace LASFormat
+
+#endif // LASPOINTFORMATS_H
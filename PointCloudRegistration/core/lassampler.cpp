@@ -0,0 +1,214 @@
+#include "lassampler.h"
+#include "parallel.h"
+#include <algorithm>
+#include <random>
+#include <numeric>
+#include <cmath>
+
+namespace {
+
+// 随机采样时每段的最小记录数
+constexpr size_t RANDOM_MIN_CHUNK = size_t(1) << 20;
+
+// 体素滤波每批解码的点数，以及每个并行任务的最小点数
+constexpr size_t VOXEL_BATCH = size_t(1) << 20;
+constexpr size_t VOXEL_MIN_CHUNK = 65536;
+
+// 体素键中每个坐标占21位；体素数超过目标时边长放大的倍数
+constexpr int VOXEL_KEY_BITS = 21;
+constexpr int64_t VOXEL_KEY_MAX = (int64_t(1) << VOXEL_KEY_BITS) - 1;
+constexpr double VOXEL_GROWTH = 1.25;
+
+// 把升序的记录序号合并为记录段
+void appendRecords(std::vector<LASRecordRun>& runs, const std::vector<uint64_t>& records)
+{
+    for (uint64_t record : records) {
+        if (!runs.empty() && runs.back().first + runs.back().count == record) {
+            ++runs.back().count;
+        } else {
+            runs.push_back({record, 1});
+        }
+    }
+}
+
+/**
+ * @brief 固定原点和边长的体素网格
+ */
+struct VoxelGrid {
+    Eigen::Vector3d origin;
+    double size;
+    
+    uint64_t key(const Point3D& p) const {
+        auto cell = [this](double value, double start) {
+            int64_t index = static_cast<int64_t>(std::floor((value - start) / size));
+            return static_cast<uint64_t>(std::min(std::max(index, int64_t(0)), VOXEL_KEY_MAX));
+        };
+        return (cell(p.x, origin.x()) << (2 * VOXEL_KEY_BITS)) | (cell(p.y, origin.y()) << VOXEL_KEY_BITS)
+             | cell(p.z, origin.z());
+    }
+};
+
+// 体素中的一条候选记录，按(键, 记录序号)排序后每个键的第一条即为代表点
+struct Voxel {
+    uint64_t key;
+    uint64_t record;
+    Point3D point;
+    
+    bool operator<(const Voxel& other) const {
+        return key != other.key ? key < other.key : record < other.record;
+    }
+};
+
+// 排序并对每个体素只保留记录序号最小的一条
+void keepFirstPerVoxel(std::vector<Voxel>& voxels)
+{
+    std::sort(voxels.begin(), voxels.end());
+    voxels.erase(std::unique(voxels.begin(), voxels.end(),
+                             [](const Voxel& a, const Voxel& b) { return a.key == b.key; }),
+                 voxels.end());
+}
+
+} // namespace
+
+std::vector<LASRecordRun> LASSampler::randomRecords(uint64_t pointCount, size_t count, uint64_t seed)
+{
+    std::vector<LASRecordRun> runs;
+    if (pointCount == 0 || count == 0) {
+        return runs;
+    }
+    if (count >= pointCount) {
+        runs.push_back({0, pointCount});
+        return runs;
+    }
+    
+    // 按段长分配名额，取整余下的名额依次补给前面的段
+    std::vector<Parallel::Range> ranges = Parallel::splitRange(pointCount, RANDOM_MIN_CHUNK);
+    std::vector<size_t> quota(ranges.size());
+    size_t assigned = 0;
+    for (const Parallel::Range& range : ranges) {
+        quota[range.index] = static_cast<size_t>(
+            static_cast<double>(count) * static_cast<double>(range.end - range.begin) / static_cast<double>(pointCount));
+        quota[range.index] = std::min(quota[range.index], range.end - range.begin);
+        assigned += quota[range.index];
+    }
+    for (size_t i = 0; assigned < count && i < ranges.size(); ++i) {
+        if (quota[i] < ranges[i].end - ranges[i].begin) {
+            ++quota[i];
+            ++assigned;
+        }
+    }
+    
+    std::vector<std::vector<uint64_t>> selected(ranges.size());
+    Parallel::forEach(ranges, [&](const Parallel::Range& range) {
+        const size_t k = quota[range.index];
+        if (k == 0) {
+            return;
+        }
+        
+        std::vector<uint64_t>& reservoir = selected[range.index];
+        reservoir.resize(k);
+        std::iota(reservoir.begin(), reservoir.end(), static_cast<uint64_t>(range.begin));
+        
+        // Algorithm L：按几何分布直接计算下一条被替换进蓄水池的记录，跳过的记录无需访问
+        std::mt19937_64 rng(seed ^ (0x9E3779B97F4A7C15ull * (range.index + 1)));
+        auto random = [&rng]() { return (static_cast<double>(rng() >> 11) + 0.5) * 0x1.0p-53; };
+        
+        double w = std::exp(std::log(random()) / static_cast<double>(k));
+        uint64_t i = range.begin + k - 1;
+        for (;;) {
+            double skip = std::floor(std::log(random()) / std::log1p(-w));
+            if (!(skip < static_cast<double>(range.end - 1 - i))) {
+                break;
+            }
+            i += static_cast<uint64_t>(skip) + 1;
+            reservoir[rng() % k] = i;
+            w *= std::exp(std::log(random()) / static_cast<double>(k));
+        }
+        
+        std::sort(reservoir.begin(), reservoir.end());
+    });
+    
+    for (const std::vector<uint64_t>& records : selected) {
+        appendRecords(runs, records);
+    }
+    return runs;
+}
+
+std::vector<LASRecordRun> LASSampler::voxelRecords(const LASFile& file, size_t count,
+                                                   const LASProgressCallback& progress)
+{
+    std::vector<LASRecordRun> runs;
+    const size_t n = file.pointCount();
+    if (n == 0 || count == 0) {
+        return runs;
+    }
+    
+    // 初始边长按地表近似二维分布估算：两条最长边围成的面积上放置count个体素
+    const LASHeader& h = file.header();
+    Eigen::Vector3d extent(h.max_x - h.min_x, h.max_y - h.min_y, h.max_z - h.min_z);
+    extent = extent.cwiseMax(0.0);
+    std::sort(extent.data(), extent.data() + 3);
+    
+    VoxelGrid grid;
+    grid.origin = Eigen::Vector3d(h.min_x, h.min_y, h.min_z);
+    grid.size = std::sqrt(std::max(extent[2] * extent[1], extent[2] * extent[2]) / static_cast<double>(count));
+    grid.size = std::max({grid.size, extent[2] / static_cast<double>(VOXEL_KEY_MAX), 1e-9});
+    
+    std::vector<Voxel> voxels;
+    PointCloud batch;
+    LASReadOptions options;
+    options.maxPoints = VOXEL_BATCH;
+    
+    for (options.first = 0; options.first < n; options.first += VOXEL_BATCH) {
+        if (!file.readPoints(batch, options)) {
+            return {};
+        }
+        
+        // 每个分块先跳过与前一点同体素的点(扫描数据在空间上连续)，再排序去重
+        std::vector<Parallel::Range> ranges = Parallel::splitRange(batch.size(), VOXEL_MIN_CHUNK);
+        std::vector<std::vector<Voxel>> local(ranges.size());
+        
+        Parallel::forEach(ranges, [&](const Parallel::Range& range) {
+            std::vector<Voxel>& cells = local[range.index];
+            uint64_t lastKey = ~uint64_t(0);
+            for (size_t i = range.begin; i < range.end; ++i) {
+                uint64_t key = grid.key(batch.points[i]);
+                if (key != lastKey) {
+                    cells.push_back({key, options.first + i, batch.points[i]});
+                    lastKey = key;
+                }
+            }
+            keepFirstPerVoxel(cells);
+        });
+        
+        for (const std::vector<Voxel>& cells : local) {
+            voxels.insert(voxels.end(), cells.begin(), cells.end());
+        }
+        keepFirstPerVoxel(voxels);
+        
+        // 体素过多时放大边长，把已有体素重新归并到更粗的网格。
+        // 第一次按体积比例一步放大到接近目标，之后逐步放大
+        double growth = std::max(VOXEL_GROWTH, std::cbrt(static_cast<double>(voxels.size()) / count));
+        while (voxels.size() > count) {
+            grid.size *= growth;
+            growth = VOXEL_GROWTH;
+            for (Voxel& voxel : voxels) {
+                voxel.key = grid.key(voxel.point);
+            }
+            keepFirstPerVoxel(voxels);
+        }
+        
+        if (progress) {
+            progress(std::min(options.first + VOXEL_BATCH, n), n);
+        }
+    }
+    
+    std::vector<uint64_t> records;
+    records.reserve(voxels.size());
+    for (const Voxel& voxel : voxels) {
+        records.push_back(voxel.record);
+    }
+    std::sort(records.begin(), records.end());
+    appendRecords(runs, records);
+    return runs;
+}
@@ -0,0 +1,43 @@
+#ifndef LASSAMPLER_H
+#define LASSAMPLER_H
+
+#include <vector>
+#include <cstdint>
+#include "lasio.h"
+
+/**
+ * @brief 加载时的点记录采样
+ *
+ * 只决定读取哪些记录，结果以记录段的形式交给LASFile::readRuns一次解码，
+ * 所需内存与目标点数成正比，与文件大小无关。
+ */
+class LASSampler
+{
+public:
+    /**
+     * @brief 均匀随机采样
+     *
+     * 记录区间切分成若干段，按段长分配名额，每段并行运行蓄水池采样(Algorithm L)，
+     * 只在记录序号上跳跃，不解码未被选中的记录。
+     * @param pointCount 文件中的记录数
+     * @param count 目标点数
+     * @param seed 随机种子(相同种子得到相同的采样)
+     * @return 按记录序号升序的记录段
+     */
+    static std::vector<LASRecordRun> randomRecords(uint64_t pointCount, size_t count, uint64_t seed = 0);
+    
+    /**
+     * @brief 流式体素滤波，每个被占据的体素保留一条记录
+     *
+     * 按批只解码XYZ，批内各分块并行排序去重后再合并。体素数超过目标点数时
+     * 放大体素边长并合并已有体素，因此每批处理后保留的体素数不超过目标点数。
+     * @param file 已打开的LAS/LAZ文件
+     * @param count 目标点数(结果不超过该值)
+     * @param progress 扫描进度回调(可为空)
+     * @return 按记录序号升序的记录段，读取失败时为空
+     */
+    static std::vector<LASRecordRun> voxelRecords(const LASFile& file, size_t count,
+                                                  const LASProgressCallback& progress = nullptr);
+};
+
+#endif // LASSAMPLER_H
@@ -0,0 +1,698 @@
+#include "lazcodec.h"
+#include "laspointformats.h"
+#include "parallel.h"
+#include <iostream>
+#include <algorithm>
+#include <cctype>
+#include <mutex>
+#include <array>
+#include <cstring>
+#include <cstdio>
+
+#ifdef PCR_WITH_LASZIP
+#include <laszip/laszip_api.h>
+#endif
+
+bool LAZCodec::isAvailable()
+{
+#ifdef PCR_WITH_LASZIP
+    return true;
+#else
+    return false;
+#endif
+}
+
+bool LAZCodec::isLAZFilename(const std::string& filename)
+{
+    if (filename.size() < 4) {
+        return false;
+    }
+    std::string ext = filename.substr(filename.size() - 4);
+    std::transform(ext.begin(), ext.end(), ext.begin(),
+                   [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+    return ext == ".laz";
+}
+
+#ifdef PCR_WITH_LASZIP
+
+namespace {
+
+// 每个解压任务的最小点数，LASzip默认压缩块为50000点
+constexpr size_t LAZ_MIN_CHUNK = 200000;
+
+// 写入时每批量化的点数
+constexpr size_t LAZ_WRITE_BLOCK = 1 << 20;
+
+// LASzip在VLR中记录压缩参数，块大小位于负载偏移12处，全1表示可变块大小
+const char* const LASZIP_USER_ID = "laszip encoded";
+constexpr uint16_t LASZIP_RECORD_ID = 22204;
+constexpr uint32_t LASZIP_VARIABLE_CHUNK = 0xFFFFFFFFu;
+
+// COPC信息VLR中的八叉树范围在变换后失效
+const char* const COPC_USER_ID = "copc";
+constexpr uint16_t COPC_INFO_RECORD_ID = 1;
+
+// 变换时每隔多少点报告一次进度
+constexpr size_t TRANSFORM_PROGRESS_INTERVAL = 1 << 20;
+
+/**
+ * @brief 一个LASzip读写器句柄，析构时关闭并释放
+ */
+class LASzipHandle
+{
+public:
+    LASzipHandle() : m_handle(nullptr), m_reading(false), m_writing(false) {
+        laszip_create(&m_handle);
+    }
+    
+    ~LASzipHandle() {
+        if (m_reading) laszip_close_reader(m_handle);
+        if (m_writing) laszip_close_writer(m_handle);
+        if (m_handle) laszip_destroy(m_handle);
+    }
+    
+    LASzipHandle(const LASzipHandle&) = delete;
+    LASzipHandle& operator=(const LASzipHandle&) = delete;
+    
+    bool openReader(const std::string& filename) {
+        laszip_BOOL is_compressed = 0;
+        m_reading = m_handle && laszip_open_reader(m_handle, filename.c_str(), &is_compressed) == 0;
+        return m_reading;
+    }
+    
+    bool openWriter(const std::string& filename, bool compress = true) {
+        m_writing = m_handle && laszip_open_writer(m_handle, filename.c_str(), compress ? 1 : 0) == 0;
+        return m_writing;
+    }
+    
+    // 关闭写入器(写出块表)，返回是否成功
+    bool closeWriter() {
+        m_writing = false;
+        return laszip_close_writer(m_handle) == 0;
+    }
+    
+    laszip_POINTER get() const { return m_handle; }
+    
+    std::string error() const {
+        laszip_CHAR* message = nullptr;
+        if (m_handle) laszip_get_error(m_handle, &message);
+        return message ? message : "未知错误";
+    }
+
+private:
+    laszip_POINTER m_handle;
+    bool m_reading;
+    bool m_writing;
+};
+
+/**
+ * @brief 把输出区间的边界对齐到压缩块边界
+ *
+ * 每个工作线程定位到区间起点时只需从所在块的开头解压，
+ * 区间从块边界开始可以避免相邻线程重复解压同一块的前缀。
+ */
+std::vector<Parallel::Range> alignToChunks(const std::vector<Parallel::Range>& ranges, size_t first,
+                                           size_t stride, size_t numToRead, size_t chunkSize)
+{
+    if (chunkSize == 0) {
+        return ranges;
+    }
+    
+    auto snap = [&](size_t index) {
+        size_t record = first + index * stride;
+        size_t aligned = (record + chunkSize - 1) / chunkSize * chunkSize;
+        size_t snapped = (aligned - first + stride - 1) / stride;
+        return std::min(snapped, numToRead);
+    };
+    
+    std::vector<Parallel::Range> aligned;
+    size_t begin = 0;
+    for (const Parallel::Range& range : ranges) {
+        size_t end = (range.end == numToRead) ? numToRead : snap(range.end);
+        if (end > begin) {
+            aligned.push_back({aligned.size(), begin, end});
+            begin = end;
+        }
+    }
+    return aligned;
+}
+
+// 压缩块的点数(可变块大小或缺少LASzip VLR时为0)
+size_t lazChunkSize(const LASFile& file)
+{
+    if (const LASVariableRecord* vlr = file.findVariableRecord(LASZIP_USER_ID, LASZIP_RECORD_ID)) {
+        if (vlr->length >= 16) {
+            uint32_t size = LASFormat::readField<uint32_t>(vlr->data + 12);
+            return (size == LASZIP_VARIABLE_CHUNK) ? 0 : size;
+        }
+    }
+    return 0;
+}
+
+/**
+ * @brief 把LASzip的点字段按记录布局写成坐标之后的标准字段(与未压缩文件的recordFields相同)
+ */
+void packFields(const laszip_point& p, const LASFormat::FormatInfo& format, bool extended, uint8_t* fields)
+{
+    auto at = [fields](int recordOffset) { return fields + (recordOffset - LASFormat::RECORD_FIELDS_OFFSET); };
+    std::memcpy(at(12), &p.intensity, sizeof(uint16_t));
+    if (extended) {
+        *at(14) = static_cast<uint8_t>(p.extended_return_number | (p.extended_number_of_returns << 4));
+        *at(15) = static_cast<uint8_t>(p.extended_classification_flags | (p.extended_scanner_channel << 4)
+                                       | (p.scan_direction_flag << 6) | (p.edge_of_flight_line << 7));
+        *at(16) = p.extended_classification;
+        *at(17) = p.user_data;
+        std::memcpy(at(18), &p.extended_scan_angle, sizeof(int16_t));
+        std::memcpy(at(20), &p.point_source_ID, sizeof(uint16_t));
+    } else {
+        *at(14) = static_cast<uint8_t>(p.return_number | (p.number_of_returns << 3)
+                                       | (p.scan_direction_flag << 6) | (p.edge_of_flight_line << 7));
+        *at(15) = static_cast<uint8_t>(p.classification | (p.synthetic_flag << 5) | (p.keypoint_flag << 6)
+                                       | (p.withheld_flag << 7));
+        *at(16) = static_cast<uint8_t>(p.scan_angle_rank);
+        *at(17) = p.user_data;
+        std::memcpy(at(18), &p.point_source_ID, sizeof(uint16_t));
+    }
+    if (format.gpsTime >= 0) std::memcpy(at(format.gpsTime), &p.gps_time, sizeof(double));
+    if (format.rgb >= 0) std::memcpy(at(format.rgb), p.rgb, 3 * sizeof(uint16_t));
+    if (format.nir >= 0) std::memcpy(at(format.nir), &p.rgb[3], sizeof(uint16_t));
+    if (format.wavePacket >= 0) std::memcpy(at(format.wavePacket), p.wave_packet, sizeof(p.wave_packet));
+}
+
+/**
+ * @brief 按记录布局的标准字段设置LASzip的点字段(packFields的逆过程，不写波形数据包)
+ *
+ * 格式6-10由LASzip检查旧字段与扩展字段一致：旧分类为0或等于扩展分类，旧标志等于扩展标志的低3位。
+ */
+void unpackFields(const uint8_t* fields, const LASFormat::FormatInfo& format, bool extended, laszip_point& p)
+{
+    auto at = [fields](int recordOffset) { return fields + (recordOffset - LASFormat::RECORD_FIELDS_OFFSET); };
+    std::memcpy(&p.intensity, at(12), sizeof(uint16_t));
+    // 偏移14为回波，15在格式6-10中是分类标志和扫描标志，在旧格式中是分类号和分类标志
+    const uint8_t returns = *at(14);
+    const uint8_t flags = *at(15);
+    p.user_data = *at(17);
+    if (extended) {
+        p.scan_direction_flag = (flags >> 6) & 1;
+        p.edge_of_flight_line = (flags >> 7) & 1;
+        p.extended_return_number = returns & 0x0F;
+        p.extended_number_of_returns = returns >> 4;
+        p.extended_classification_flags = flags & 0x0F;
+        p.extended_scanner_channel = (flags >> 4) & 0x03;
+        p.extended_classification = *at(16);
+        std::memcpy(&p.extended_scan_angle, at(18), sizeof(int16_t));
+        std::memcpy(&p.point_source_ID, at(20), sizeof(uint16_t));
+        p.return_number = std::min<int>(p.extended_return_number, 7);
+        p.number_of_returns = std::min<int>(p.extended_number_of_returns, 7);
+        p.classification = p.extended_classification < 32 ? p.extended_classification : 0;
+        p.synthetic_flag = flags & 1;
+        p.keypoint_flag = (flags >> 1) & 1;
+        p.withheld_flag = (flags >> 2) & 1;
+    } else {
+        p.return_number = returns & 0x07;
+        p.number_of_returns = (returns >> 3) & 0x07;
+        p.scan_direction_flag = (returns >> 6) & 1;
+        p.edge_of_flight_line = (returns >> 7) & 1;
+        p.classification = flags & 0x1F;
+        p.synthetic_flag = (flags >> 5) & 1;
+        p.keypoint_flag = (flags >> 6) & 1;
+        p.withheld_flag = (flags >> 7) & 1;
+        p.scan_angle_rank = static_cast<int8_t>(*at(16));
+        std::memcpy(&p.point_source_ID, at(18), sizeof(uint16_t));
+    }
+    if (format.gpsTime >= 0) std::memcpy(&p.gps_time, at(format.gpsTime), sizeof(double));
+    if (format.rgb >= 0) std::memcpy(p.rgb, at(format.rgb), 3 * sizeof(uint16_t));
+    if (format.nir >= 0) std::memcpy(&p.rgb[3], at(format.nir), sizeof(uint16_t));
+}
+
+// 把LASzip解出的一个点写到第i个输出位置
+inline void storePoint(const laszip_point& p, const LASHeader& h, const LASFormat::FormatInfo& format,
+                       bool extended, const LASFormat::DecodeTarget& out, size_t i)
+{
+    out.xyz[i].x = p.X * h.x_scale + h.x_offset;
+    out.xyz[i].y = p.Y * h.y_scale + h.y_offset;
+    out.xyz[i].z = p.Z * h.z_scale + h.z_offset;
+    if (out.intensity) out.intensity[i] = p.intensity;
+    if (out.classification) out.classification[i] = extended ? p.extended_classification : p.classification;
+    if (out.gpsTime) out.gpsTime[i] = p.gps_time;
+    if (out.rgb) out.rgb[i] = {p.rgb[0], p.rgb[1], p.rgb[2]};
+    if (out.recordFields) packFields(p, format, extended, out.recordFields + i * out.recordFieldsSize);
+    if (out.extraBytes && p.extra_bytes && static_cast<size_t>(p.num_extra_bytes) >= out.extraBytesSize) {
+        std::memcpy(out.extraBytes + i * out.extraBytesSize, p.extra_bytes, out.extraBytesSize);
+    }
+}
+
+} // namespace
+
+bool LAZCodec::readPoints(const LASFile& file, PointCloud& cloud, const LASReadOptions& options)
+{
+    cloud.clear();
+    const LASHeader& h = file.header();
+    
+    LASFormat::FormatInfo format = LASFormat::formatInfo(h.point_format);
+    if (!format.decoder) {
+        std::cerr << "不支持的点格式: " << static_cast<int>(h.point_format) << std::endl;
+        return false;
+    }
+    
+    const size_t chunkSize = lazChunkSize(file);
+    const size_t first = options.first;
+    const size_t stride = std::max<size_t>(options.stride, 1);
+    const size_t numToRead = file.readCount(options);
+    const unsigned attributes = options.attributes & format.attributes;
+    
+    if (numToRead > 0) {
+        LASFormat::DecodeTarget output = LASFormat::prepareTarget(cloud, numToRead, attributes,
+                                                                  file.extraBytesSize(), format.recordFieldsSize());
+        
+        std::vector<Parallel::Range> ranges = alignToChunks(
+            Parallel::splitRange(numToRead, std::max(LAZ_MIN_CHUNK / stride, size_t(1))),
+            first, stride, numToRead, chunkSize);
+        
+        std::mutex mutex;
+        size_t decoded = 0;
+        bool ok = true;
+        
+        // 每个线程使用独立的解压器，定位到区间起点后顺序解压
+        Parallel::forEach(ranges, [&](const Parallel::Range& range) {
+            bool rangeOk = decodeRange(file, output.at(range.begin), first + range.begin * stride,
+                                       range.end - range.begin, stride);
+            
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                if (!rangeOk) {
+                    ok = false;
+                    return;
+                }
+                decoded += range.end - range.begin;
+                if (options.progress) {
+                    options.progress(decoded, numToRead);
+                }
+            }
+            
+            // 在锁外报告，接收者可能等待或复制这些点，不阻塞其它解压线程
+            if (options.chunkDecoded) {
+                reportChunks(options.chunkDecoded, range.begin, range.end);
+            }
+        });
+        
+        if (!ok) {
+            cloud.clear();
+            return false;
+        }
+    }
+    
+    cloud.encoding = file.encoding();
+    cloud.computeBounds();
+    return true;
+}
+
+bool LAZCodec::decodeRange(const LASFile& file, const LASFormat::DecodeTarget& out, size_t first, size_t count,
+                           size_t stride)
+{
+    const LASHeader& h = file.header();
+    const LASFormat::FormatInfo format = LASFormat::formatInfo(h.point_format);
+    const bool extended = h.point_format >= 6;
+    const size_t chunkSize = lazChunkSize(file);
+    stride = std::max<size_t>(stride, 1);
+    
+    LASzipHandle reader;
+    laszip_point* point = nullptr;
+    bool ok = reader.openReader(file.filename())
+           && laszip_get_point_pointer(reader.get(), &point) == 0
+           && laszip_seek_point(reader.get(), static_cast<laszip_I64>(first)) == 0;
+    
+    for (size_t i = 0; ok && i < count; ++i) {
+        if (laszip_read_point(reader.get()) != 0) {
+            ok = false;
+            break;
+        }
+        storePoint(*point, h, format, extended, out, i);
+        
+        if (i + 1 == count) {
+            break;
+        }
+        
+        // 跨步读取：间隔超过一个块时直接定位，否则顺序跳过
+        if (stride > 1) {
+            size_t next = first + (i + 1) * stride;
+            if (chunkSize > 0 && stride - 1 >= chunkSize) {
+                ok = laszip_seek_point(reader.get(), static_cast<laszip_I64>(next)) == 0;
+            } else {
+                for (size_t skip = 1; ok && skip < stride; ++skip) {
+                    ok = laszip_read_point(reader.get()) == 0;
+                }
+            }
+        }
+    }
+    
+    if (!ok) {
+        std::cerr << "LAZ解压失败: " << file.filename() << ": " << reader.error() << std::endl;
+    }
+    return ok;
+}
+
+bool LAZCodec::readRuns(const LASFile& file, PointCloud& cloud, const std::vector<LASRecordRun>& runs,
+                        const LASReadOptions& options)
+{
+    cloud.clear();
+    const LASHeader& h = file.header();
+    
+    LASFormat::FormatInfo format = LASFormat::formatInfo(h.point_format);
+    if (!format.decoder) {
+        std::cerr << "不支持的点格式: " << static_cast<int>(h.point_format) << std::endl;
+        return false;
+    }
+    
+    std::vector<LASRecordRun> clipped = LASFormat::clipRuns(runs, file.pointCount());
+    std::vector<size_t> offsets = LASFormat::runOffsets(clipped);
+    const size_t total = offsets.back();
+    const unsigned attributes = options.attributes & format.attributes;
+    const bool extended = h.point_format >= 6;
+    
+    if (total > 0) {
+        LASFormat::DecodeTarget output = LASFormat::prepareTarget(cloud, total, attributes,
+                                                                  file.extraBytesSize(), format.recordFieldsSize());
+        
+        std::vector<Parallel::Range> ranges = Parallel::splitRange(total, LAZ_MIN_CHUNK);
+        std::mutex mutex;
+        size_t decoded = 0;
+        bool ok = true;
+        
+        // 每个线程一个解压器，逐段定位后顺序解压
+        Parallel::forEach(ranges, [&](const Parallel::Range& range) {
+            LASzipHandle reader;
+            laszip_point* point = nullptr;
+            bool rangeOk = reader.openReader(file.filename())
+                        && laszip_get_point_pointer(reader.get(), &point) == 0;
+            
+            LASFormat::forEachRunPiece(clipped, offsets, range.begin, range.end,
+                                       [&](uint64_t record, size_t count, size_t out) {
+                rangeOk = rangeOk && laszip_seek_point(reader.get(), static_cast<laszip_I64>(record)) == 0;
+                for (size_t i = 0; rangeOk && i < count; ++i) {
+                    rangeOk = laszip_read_point(reader.get()) == 0;
+                    if (rangeOk) {
+                        storePoint(*point, h, format, extended, output, out + i);
+                    }
+                }
+            });
+            
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                if (!rangeOk) {
+                    if (ok) {
+                        std::cerr << "LAZ解压失败: " << reader.error() << std::endl;
+                    }
+                    ok = false;
+                    return;
+                }
+                decoded += range.end - range.begin;
+                if (options.progress) {
+                    options.progress(decoded, total);
+                }
+            }
+            
+            // 在锁外报告，不阻塞其它解压线程
+            if (options.chunkDecoded) {
+                reportChunks(options.chunkDecoded, range.begin, range.end);
+            }
+        });
+        
+        if (!ok) {
+            cloud.clear();
+            return false;
+        }
+    }
+    
+    cloud.encoding = file.encoding();
+    cloud.computeBounds();
+    return true;
+}
+
+bool LAZCodec::write(const std::string& filename, const PointCloud& cloud, const LASHeader& h,
+                     const std::vector<PointCloudEncoding::VariableRecord>& variableRecords)
+{
+    LASzipHandle writer;
+    laszip_header* header = nullptr;
+    if (!writer.get() || laszip_get_header_pointer(writer.get(), &header) != 0) {
+        std::cerr << "无法创建LAZ写入器" << std::endl;
+        return false;
+    }
+    
+    header->global_encoding = h.global_encoding;
+    header->version_major = h.version_major;
+    header->version_minor = h.version_minor;
+    header->header_size = h.header_size;
+    header->offset_to_point_data = h.header_size;
+    header->point_data_format = h.point_format;
+    header->point_data_record_length = h.point_record_length;
+    header->number_of_point_records = (h.point_format < 6 && h.num_point_records <= UINT32_MAX)
+                                    ? static_cast<laszip_U32>(h.num_point_records) : 0;
+    header->extended_number_of_point_records = h.num_point_records;
+    header->x_scale_factor = h.x_scale;
+    header->y_scale_factor = h.y_scale;
+    header->z_scale_factor = h.z_scale;
+    header->x_offset = h.x_offset;
+    header->y_offset = h.y_offset;
+    header->z_offset = h.z_offset;
+    header->max_x = h.max_x;
+    header->min_x = h.min_x;
+    header->max_y = h.max_y;
+    header->min_y = h.min_y;
+    header->max_z = h.max_z;
+    header->min_z = h.min_z;
+    
+    // VLR由LASzip追加在头部之后，点数据偏移随之更新
+    for (const PointCloudEncoding::VariableRecord& vlr : variableRecords) {
+        if (laszip_add_vlr(writer.get(), vlr.userId.c_str(), vlr.recordId,
+                           static_cast<laszip_U16>(vlr.data.size()), vlr.description.c_str(),
+                           reinterpret_cast<const laszip_U8*>(vlr.data.data())) != 0) {
+            std::cerr << "无法写入VLR: " << writer.error() << std::endl;
+            return false;
+        }
+    }
+    
+    laszip_point* point = nullptr;
+    if (!writer.openWriter(filename) || laszip_get_point_pointer(writer.get(), &point) != 0) {
+        std::cerr << "无法创建文件: " << filename << " (" << writer.error() << ")" << std::endl;
+        return false;
+    }
+    
+    const LASFormat::FormatInfo format = LASFormat::formatInfo(h.point_format);
+    const LASFormat::EncodeSource source = LASFormat::encodeSource(
+        cloud, h.point_record_length - format.recordLength, format.recordFieldsSize());
+    const bool extended = h.point_format >= 6;
+    const size_t numPoints = cloud.points.size();
+    
+    // 量化整块点，多线程执行，与上一块的压缩交替进行
+    using Quantized = std::vector<std::array<int32_t, 3>>;
+    auto quantize = [&](size_t begin, Quantized& out) {
+        size_t count = std::min(LAZ_WRITE_BLOCK, numPoints - begin);
+        out.resize(count);
+        std::vector<Parallel::Range> ranges = Parallel::splitRange(count, 65536);
+        Parallel::forEach(ranges, [&](const Parallel::Range& range) {
+            for (size_t i = range.begin; i < range.end; ++i) {
+                const Point3D& p = cloud.points[begin + i];
+                out[i] = {LASFormat::quantize(p.x, h.x_scale, h.x_offset),
+                          LASFormat::quantize(p.y, h.y_scale, h.y_offset),
+                          LASFormat::quantize(p.z, h.z_scale, h.z_offset)};
+            }
+        });
+    };
+    
+    Quantized current, next;
+    quantize(0, current);
+    for (size_t begin = 0; begin < numPoints; begin += LAZ_WRITE_BLOCK) {
+        size_t nextBegin = begin + LAZ_WRITE_BLOCK;
+        QFuture<void> pending;
+        if (nextBegin < numPoints) {
+            pending = QtConcurrent::run([&quantize, &next, nextBegin]() { quantize(nextBegin, next); });
+        }
+        
+        // LASzip的压缩器是有状态的顺序流，只能在一个线程中写入
+        bool ok = true;
+        for (size_t i = 0; i < current.size() && ok; ++i) {
+            size_t index = begin + i;
+            point->X = current[i][0];
+            point->Y = current[i][1];
+            point->Z = current[i][2];
+            if (source.recordFields) {
+                unpackFields(source.recordFields + index * source.recordFieldsSize, format, extended, *point);
+            } else if (extended) {
+                point->extended_return_number = 1;
+                point->extended_number_of_returns = 1;
+            } else {
+                point->return_number = 1;
+                point->number_of_returns = 1;
+            }
+            if (source.intensity) point->intensity = source.intensity[index];
+            if (source.classification) {
+                uint8_t classification = source.classification[index];
+                point->extended_classification = classification;
+                point->classification = (extended && classification >= 32) ? 0 : classification & 0x1F;
+            }
+            if (source.gpsTime) point->gps_time = source.gpsTime[index];
+            if (source.rgb) {
+                point->rgb[0] = source.rgb[index].r;
+                point->rgb[1] = source.rgb[index].g;
+                point->rgb[2] = source.rgb[index].b;
+            }
+            if (source.extraBytes && point->extra_bytes
+                && static_cast<size_t>(point->num_extra_bytes) >= source.extraBytesSize) {
+                std::memcpy(point->extra_bytes, source.extraBytes + index * source.extraBytesSize,
+                            source.extraBytesSize);
+            }
+            ok = laszip_write_point(writer.get()) == 0;
+        }
+        
+        pending.waitForFinished();
+        if (!ok) {
+            std::cerr << "LAZ压缩失败: " << writer.error() << std::endl;
+            return false;
+        }
+        std::swap(current, next);
+    }
+    
+    if (!writer.closeWriter()) {
+        std::cerr << "LAZ文件写入失败: " << writer.error() << std::endl;
+        return false;
+    }
+    
+    std::cout << "成功写入 " << numPoints << " 个点到 " << filename
+              << " (LAZ, 点格式 " << static_cast<int>(h.point_format) << ")" << std::endl;
+    return true;
+}
+
+bool LAZCodec::transformFile(const LASFile& file, const std::string& outputFile, const Eigen::Affine3d& transform,
+                             const Eigen::Vector3d& offset, const LASProgressCallback& progress)
+{
+    LASzipHandle reader;
+    laszip_header* inHeader = nullptr;
+    laszip_point* inPoint = nullptr;
+    if (!reader.openReader(file.filename())
+        || laszip_get_header_pointer(reader.get(), &inHeader) != 0
+        || laszip_get_point_pointer(reader.get(), &inPoint) != 0) {
+        std::cerr << "无法打开文件: " << file.filename() << " (" << reader.error() << ")" << std::endl;
+        return false;
+    }
+    
+    // 沿用原头部和VLR(LASzip自己的压缩参数VLR在读取时已被剔除)，只替换偏移
+    LASzipHandle writer;
+    laszip_header* outHeader = nullptr;
+    laszip_point* outPoint = nullptr;
+    if (!writer.get() || laszip_set_header(writer.get(), inHeader) != 0
+        || laszip_get_header_pointer(writer.get(), &outHeader) != 0) {
+        std::cerr << "无法创建LAZ写入器: " << writer.error() << std::endl;
+        return false;
+    }
+    outHeader->x_offset = offset.x();
+    outHeader->y_offset = offset.y();
+    outHeader->z_offset = offset.z();
+    if (file.findVariableRecord(COPC_USER_ID, COPC_INFO_RECORD_ID)) {
+        laszip_remove_vlr(writer.get(), COPC_USER_ID, COPC_INFO_RECORD_ID);
+    }
+    
+    if (!writer.openWriter(outputFile, isLAZFilename(outputFile))
+        || laszip_get_point_pointer(writer.get(), &outPoint) != 0) {
+        std::cerr << "无法创建文件: " << outputFile << " (" << writer.error() << ")" << std::endl;
+        return false;
+    }
+    
+    const LASHeader& h = file.header();
+    const size_t numPoints = file.pointCount();
+    const Eigen::Vector3d scale(h.x_scale, h.y_scale, h.z_scale);
+    
+    // LASzip的解压和压缩都是顺序流，逐点复制所有字段后只替换XYZ，边界由点清单统计。
+    // 头部边界可能过期，逐点检查变换后的坐标是否在32位表示范围内
+    for (size_t i = 0; i < numPoints; ++i) {
+        if (laszip_read_point(reader.get()) != 0) {
+            std::cerr << "LAZ解压失败: " << reader.error() << std::endl;
+            return false;
+        }
+        
+        Eigen::Vector3d p = transform * Eigen::Vector3d(inPoint->X * h.x_scale + h.x_offset,
+                                                        inPoint->Y * h.y_scale + h.y_offset,
+                                                        inPoint->Z * h.z_scale + h.z_offset);
+        if (!LASFormat::fitsInt32(Eigen::AlignedBox3d(p, p), scale, offset)) {
+            writer.closeWriter();
+            std::remove(outputFile.c_str());
+            std::cerr << "变换后的坐标超出偏移的32位表示范围(头部边界与点不符): " << file.filename() << std::endl;
+            return false;
+        }
+        if (laszip_set_point(writer.get(), inPoint) != 0) {
+            std::cerr << "LAZ压缩失败: " << writer.error() << std::endl;
+            return false;
+        }
+        outPoint->X = LASFormat::quantize(p.x(), h.x_scale, offset.x());
+        outPoint->Y = LASFormat::quantize(p.y(), h.y_scale, offset.y());
+        outPoint->Z = LASFormat::quantize(p.z(), h.z_scale, offset.z());
+        
+        if (laszip_write_point(writer.get()) != 0 || laszip_update_inventory(writer.get()) != 0) {
+            std::cerr << "LAZ压缩失败: " << writer.error() << std::endl;
+            return false;
+        }
+        
+        if (progress && ((i + 1) % TRANSFORM_PROGRESS_INTERVAL == 0 || i + 1 == numPoints)) {
+            progress(i + 1, numPoints);
+        }
+    }
+    
+    if (!writer.closeWriter()) {
+        std::cerr << "文件写入失败: " << outputFile << " (" << writer.error() << ")" << std::endl;
+        return false;
+    }
+    
+    std::cout << "已将变换应用到 " << numPoints << " 个点并写入 " << outputFile << std::endl;
+    return true;
+}
+
+#else
+
+bool LAZCodec::readPoints(const LASFile& file, PointCloud& cloud, const LASReadOptions& options)
+{
+    (void)options;
+    cloud.clear();
+    std::cerr << "未启用LAZ支持(编译时未找到LASzip)，无法读取: " << file.filename() << std::endl;
+    return false;
+}
+
+bool LAZCodec::decodeRange(const LASFile& file, const LASFormat::DecodeTarget& out, size_t first, size_t count,
+                           size_t stride)
+{
+    (void)out;
+    (void)first;
+    (void)count;
+    (void)stride;
+    std::cerr << "未启用LAZ支持(编译时未找到LASzip)，无法读取: " << file.filename() << std::endl;
+    return false;
+}
+
+bool LAZCodec::readRuns(const LASFile& file, PointCloud& cloud, const std::vector<LASRecordRun>& runs,
+                        const LASReadOptions& options)
+{
+    (void)runs;
+    return readPoints(file, cloud, options);
+}
+
+bool LAZCodec::write(const std::string& filename, const PointCloud& cloud, const LASHeader& header,
+                     const std::vector<PointCloudEncoding::VariableRecord>& variableRecords)
+{
+    (void)cloud;
+    (void)header;
+    (void)variableRecords;
+    std::cerr << "未启用LAZ支持(编译时未找到LASzip)，无法写入: " << filename << std::endl;
+    return false;
+}
+
+bool LAZCodec::transformFile(const LASFile& file, const std::string& outputFile, const Eigen::Affine3d& transform,
+                             const Eigen::Vector3d& offset, const LASProgressCallback& progress)
+{
+    (void)outputFile;
+    (void)transform;
+    (void)offset;
+    (void)progress;
+    std::cerr << "未启用LAZ支持(编译时未找到LASzip)，无法处理: " << file.filename() << std::endl;
+    return false;
+}
+
+#endif
@@ -0,0 +1,76 @@
+#ifndef LAZCODEC_H
+#define LAZCODEC_H
+
+#include <string>
+#include "lasio.h"
+
+/**
+ * @brief LAZ压缩点云的读写
+ *
+ * 基于LASzip库(编译时定义PCR_WITH_LASZIP才启用)。LAZ把点记录分成独立压缩的块，
+ * 读取时每个工作线程打开自己的解压器，定位到按块对齐的区间并行解压，
+ * 直接写入预分配的点云，不产生临时LAS文件。
+ */
+class LAZCodec
+{
+public:
+    // 是否编译了LAZ支持
+    static bool isAvailable();
+    
+    // 文件名是否以.laz结尾(不区分大小写)
+    static bool isLAZFilename(const std::string& filename);
+    
+    /**
+     * @brief 从已打开的LAZ文件读取点(选项语义与LASFile::readPoints相同)
+     * @param file 已打开且头部带压缩标志的文件
+     * @param cloud 输出点云对象
+     * @param options 读取范围、属性和进度回调
+     * @return 是否成功
+     */
+    static bool readPoints(const LASFile& file, PointCloud& cloud, const LASReadOptions& options);
+    
+    /**
+     * @brief 在调用线程中把从first起跨步的count条记录解压到给定的输出位置
+     *
+     * 只使用一个解压器，定位到first后顺序解压(语义与LASFile::decodeRange相同)。
+     * @return 是否成功(失败时已输出错误信息)
+     */
+    static bool decodeRange(const LASFile& file, const LASFormat::DecodeTarget& out, size_t first, size_t count,
+                            size_t stride = 1);
+    
+    /**
+     * @brief 从已打开的LAZ文件按记录段读取点(语义与LASFile::readRuns相同)
+     *
+     * COPC的每个八叉树节点正好是一个压缩块，按节点给出的记录段只解压被选中的块。
+     */
+    static bool readRuns(const LASFile& file, PointCloud& cloud, const std::vector<LASRecordRun>& runs,
+                         const LASReadOptions& options);
+    
+    /**
+     * @brief 写入LAZ文件
+     * @param filename 文件路径
+     * @param cloud 输入点云对象
+     * @param header 写出的头部(由LASIO::writeLAS按点云的来源编码确定)
+     * @param variableRecords 原样写出的VLR
+     * @return 是否成功
+     */
+    static bool write(const std::string& filename, const PointCloud& cloud, const LASHeader& header,
+                      const std::vector<PointCloudEncoding::VariableRecord>& variableRecords);
+    
+    /**
+     * @brief 逐点解压、变换XYZ并重新写出(LASIO::transformLAS的LAZ路径)
+     *
+     * 头部、VLR和点的其他字段原样沿用，输出扩展名为.laz时压缩，否则写未压缩LAS。
+     * COPC信息VLR被移除，因为其八叉树范围在变换后不再成立。
+     * @param file 已打开的输入文件
+     * @param outputFile 输出文件
+     * @param transform 变换矩阵
+     * @param offset 输出使用的坐标偏移
+     * @param progress 进度回调(可为空)
+     * @return 是否成功
+     */
+    static bool transformFile(const LASFile& file, const std::string& outputFile, const Eigen::Affine3d& transform,
+                              const Eigen::Vector3d& offset, const LASProgressCallback& progress);
+};
+
+#endif // LAZCODEC_H
@@ -0,0 +1,275 @@
+#include "lodoctree.h"
+#include "parallel.h"
+#include <algorithm>
+#include <array>
+#include <limits>
+#include <numeric>
+#include <queue>
+#include <random>
+
+namespace {
+
+// 节点抽样网格每轴的格数(2^7)，每格最多选一个点，占用标记用位图
+constexpr int GRID_BITS = 7;
+constexpr uint32_t GRID_SIZE = 1u << GRID_BITS;
+constexpr size_t GRID_CELLS = size_t(1) << (3 * GRID_BITS);
+
+// 最大层数，大量重合的点也不会无限细分
+constexpr uint8_t MAX_LEVEL = 24;
+
+// 重排顶点时每个任务的最少节点数
+constexpr size_t GATHER_MIN_NODES = 16;
+
+// 打乱点序用的固定种子，同一点云每次得到相同的层次
+constexpr unsigned SHUFFLE_SEED = 20240611u;
+
+// 投影半径小于该像素数(直径不到一个像素)的节点不绘制
+constexpr float MIN_VISIBLE_PIXELS = 0.5f;
+
+// 坐标在节点网格中的格号
+uint32_t cellIndex(float value, float lower, float scale)
+{
+    const float cell = (value - lower) * scale;
+    if (cell <= 0.0f) {
+        return 0;
+    }
+    return std::min(static_cast<uint32_t>(cell), GRID_SIZE - 1);
+}
+
+// 父立方体的第octant个子立方体(位0/1/2分别表示x/y/z的上半部分)
+Eigen::AlignedBox3f octantBox(const Eigen::AlignedBox3f& box, int octant)
+{
+    const Eigen::Vector3f center = box.center();
+    Eigen::AlignedBox3f child = box;
+    for (int axis = 0; axis < 3; ++axis) {
+        if (octant & (1 << axis)) {
+            child.min()[axis] = center[axis];
+        } else {
+            child.max()[axis] = center[axis];
+        }
+    }
+    return child;
+}
+
+/**
+ * @brief 在节点内抽样：每个网格单元的第一个点留在节点中，其余按八分体交给子节点
+ *
+ * 输入点序已经随机打乱，达到节点容量后剩余的点也不会偏向扫描顺序靠前的区域。
+ */
+void sampleNode(const std::vector<float>& vertices, const LODNode& node, std::vector<uint32_t>& points,
+                std::array<std::vector<uint32_t>, 8>& children, std::vector<uint8_t>& occupied)
+{
+    if (points.size() <= LODOctree::NODE_CAPACITY || node.level >= MAX_LEVEL) {
+        return;
+    }
+    
+    occupied.assign(GRID_CELLS / 8, 0);
+    const Eigen::Vector3f lower = node.bounds.min();
+    const Eigen::Vector3f center = node.bounds.center();
+    const float scale = GRID_SIZE / std::max(node.bounds.sizes().maxCoeff(), std::numeric_limits<float>::min());
+    
+    std::vector<uint32_t> own;
+    own.reserve(LODOctree::NODE_CAPACITY);
+    for (uint32_t i : points) {
+        const float* p = &vertices[3 * static_cast<size_t>(i)];
+        if (own.size() < LODOctree::NODE_CAPACITY) {
+            const size_t key = (static_cast<size_t>(cellIndex(p[0], lower.x(), scale)) << (2 * GRID_BITS))
+                             | (static_cast<size_t>(cellIndex(p[1], lower.y(), scale)) << GRID_BITS)
+                             | cellIndex(p[2], lower.z(), scale);
+            uint8_t& bits = occupied[key >> 3];
+            const uint8_t mask = static_cast<uint8_t>(1u << (key & 7));
+            if (!(bits & mask)) {
+                bits |= mask;
+                own.push_back(i);
+                continue;
+            }
+        }
+        const int octant = (p[0] >= center.x() ? 1 : 0) | (p[1] >= center.y() ? 2 : 0) | (p[2] >= center.z() ? 4 : 0);
+        children[octant].push_back(i);
+    }
+    points.swap(own);
+}
+
+} // namespace
+
+ViewFrustum::ViewFrustum(const Eigen::Matrix4f& clip)
+{
+    // 裁剪坐标满足 -w <= x,y,z <= w，每个不等式对应一个平面(左右、下上、近远)
+    for (int axis = 0; axis < 3; ++axis) {
+        m_planes[2 * axis] = (clip.row(3) + clip.row(axis)).transpose();
+        m_planes[2 * axis + 1] = (clip.row(3) - clip.row(axis)).transpose();
+    }
+}
+
+bool ViewFrustum::intersects(const Eigen::AlignedBox3f& box) const
+{
+    // 包围盒在法向方向上最靠前的角点在某个平面外侧时，整个盒子都在视锥体外
+    for (const Eigen::Vector4f& plane : m_planes) {
+        const Eigen::Vector3f corner((plane.x() >= 0.0f ? box.max() : box.min()).x(),
+                                     (plane.y() >= 0.0f ? box.max() : box.min()).y(),
+                                     (plane.z() >= 0.0f ? box.max() : box.min()).z());
+        if (plane.head<3>().dot(corner) + plane.w() < 0.0f) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool LODOctree::build(std::vector<float>& vertices, std::vector<uint32_t>* permutation)
+{
+    m_nodes.clear();
+    const size_t n = vertices.size() / 3;
+    if (n == 0) {
+        return true;
+    }
+    if (n > std::numeric_limits<uint32_t>::max()) {
+        return false;
+    }
+    
+    // 根节点取包含所有点的立方体，各层子节点的格子大小一致
+    Eigen::AlignedBox3f box;
+    for (size_t i = 0; i < n; ++i) {
+        box.extend(Eigen::Vector3f(vertices[3 * i], vertices[3 * i + 1], vertices[3 * i + 2]));
+    }
+    const float size = std::max(box.sizes().maxCoeff(), 1e-6f);
+    box.max() = box.min() + Eigen::Vector3f::Constant(size);
+    
+    std::vector<uint32_t> order(n);
+    std::iota(order.begin(), order.end(), 0u);
+    std::shuffle(order.begin(), order.end(), std::mt19937(SHUFFLE_SEED));
+    
+    struct PendingNode {
+        uint32_t node;
+        std::vector<uint32_t> points;
+    };
+    
+    m_nodes.emplace_back();
+    m_nodes.front().bounds = box;
+    std::vector<std::vector<uint32_t>> nodePoints(1);
+    std::vector<PendingNode> pending;
+    pending.push_back({0, std::move(order)});
+    
+    // 逐层构建，同一层的节点互不相关，可以并行抽样和划分
+    while (!pending.empty()) {
+        std::vector<std::array<std::vector<uint32_t>, 8>> childPoints(pending.size());
+        std::vector<Parallel::Range> ranges = Parallel::splitRange(pending.size(), 1);
+        Parallel::forEach(ranges, [&](const Parallel::Range& range) {
+            std::vector<uint8_t> occupied;
+            for (size_t k = range.begin; k < range.end; ++k) {
+                sampleNode(vertices, m_nodes[pending[k].node], pending[k].points, childPoints[k], occupied);
+            }
+        });
+        
+        std::vector<PendingNode> next;
+        for (size_t k = 0; k < pending.size(); ++k) {
+            const uint32_t parent = pending[k].node;
+            nodePoints[parent] = std::move(pending[k].points);
+            for (int octant = 0; octant < 8; ++octant) {
+                if (childPoints[k][octant].empty()) {
+                    continue;
+                }
+                LODNode child;
+                child.bounds = octantBox(m_nodes[parent].bounds, octant);
+                child.level = static_cast<uint8_t>(m_nodes[parent].level + 1);
+                const uint32_t index = static_cast<uint32_t>(m_nodes.size());
+                m_nodes[parent].children[octant] = static_cast<int32_t>(index);
+                m_nodes.push_back(child);
+                nodePoints.emplace_back();
+                next.push_back({index, std::move(childPoints[k][octant])});
+            }
+        }
+        pending.swap(next);
+    }
+    
+    // 节点按广度优先编号，粗层的点排在顶点数组前部
+    uint32_t first = 0;
+    for (size_t k = 0; k < m_nodes.size(); ++k) {
+        m_nodes[k].first = first;
+        m_nodes[k].count = static_cast<uint32_t>(nodePoints[k].size());
+        first += m_nodes[k].count;
+    }
+    
+    std::vector<float> reordered(n * 3);
+    if (permutation) {
+        permutation->resize(n);
+    }
+    std::vector<Parallel::Range> ranges = Parallel::splitRange(m_nodes.size(), GATHER_MIN_NODES);
+    Parallel::forEach(ranges, [&](const Parallel::Range& range) {
+        for (size_t k = range.begin; k < range.end; ++k) {
+            float* out = &reordered[3 * static_cast<size_t>(m_nodes[k].first)];
+            if (permutation) {
+                std::copy(nodePoints[k].begin(), nodePoints[k].end(), permutation->begin() + m_nodes[k].first);
+            }
+            for (uint32_t i : nodePoints[k]) {
+                const float* p = &vertices[3 * static_cast<size_t>(i)];
+                *out++ = p[0];
+                *out++ = p[1];
+                *out++ = p[2];
+            }
+        }
+    });
+    vertices.swap(reordered);
+    return true;
+}
+
+std::vector<uint32_t> LODOctree::select(const Eigen::Matrix4f& modelView, const Eigen::Matrix4f& projection,
+                                        float viewportHeight, size_t budget, float minPixels,
+                                        bool* truncated) const
+{
+    std::vector<uint32_t> selected;
+    if (truncated) {
+        *truncated = false;
+    }
+    if (m_nodes.empty()) {
+        return selected;
+    }
+    
+    // 距离d处长度l投影为 l*pixelScale/d 像素，projection(1,1) = 1/tan(垂直视角/2)
+    const ViewFrustum frustum(projection * modelView);
+    const float pixelScale = 0.5f * viewportHeight * projection(1, 1);
+    
+    // 按投影半径(像素)排序的候选节点，投影越大越先绘制；父节点不可见时子节点也不可见
+    using Candidate = std::pair<float, uint32_t>;
+    std::priority_queue<Candidate> candidates;
+    auto push = [&](uint32_t index) {
+        const LODNode& node = m_nodes[index];
+        if (!frustum.intersects(node.bounds)) {
+            return;
+        }
+        const Eigen::Vector3f center = (modelView * node.bounds.center().homogeneous()).head<3>();
+        const float radius = 0.5f * node.bounds.diagonal().norm();
+        const float depth = -center.z();
+        // 相机位于节点包围球内时视为无穷大
+        const float pixels = depth > radius ? pixelScale * radius / depth : std::numeric_limits<float>::max();
+        if (pixels < MIN_VISIBLE_PIXELS) {
+            return;
+        }
+        candidates.push({pixels, index});
+    };
+    push(0);
+    
+    size_t points = 0;
+    while (!candidates.empty()) {
+        const Candidate candidate = candidates.top();
+        const LODNode& node = m_nodes[candidate.second];
+        if (points + node.count > budget) {
+            if (truncated) {
+                *truncated = true;
+            }
+            break;
+        }
+        candidates.pop();
+        selected.push_back(candidate.second);
+        points += node.count;
+        
+        if (candidate.first < minPixels) {
+            continue;
+        }
+        for (int32_t child : node.children) {
+            if (child >= 0) {
+                push(static_cast<uint32_t>(child));
+            }
+        }
+    }
+    return selected;
+}
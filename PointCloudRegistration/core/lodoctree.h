@@ -0,0 +1,79 @@
+#ifndef LODOCTREE_H
+#define LODOCTREE_H
+
+#include <vector>
+#include <cstdint>
+#include "Eigen/Geometry"
+
+/**
+ * @brief 细节层次八叉树的节点
+ */
+struct LODNode {
+    Eigen::AlignedBox3f bounds;     // 节点立方体(与顶点坐标相同的坐标系)
+    uint32_t first = 0;             // 节点的点在重排后顶点数组中的起始位置
+    uint32_t count = 0;             // 节点自身保存的点数(不含子节点)
+    int32_t children[8] = {-1, -1, -1, -1, -1, -1, -1, -1};
+    uint8_t level = 0;
+};
+
+/**
+ * @brief 视锥体，六个裁剪平面由投影矩阵与模型视图矩阵的乘积提取
+ */
+class ViewFrustum
+{
+public:
+    explicit ViewFrustum(const Eigen::Matrix4f& clip);
+    
+    // 包围盒是否与视锥体相交(保守判断，视锥棱角附近的盒子可能被判为相交)
+    bool intersects(const Eigen::AlignedBox3f& box) const;
+    
+private:
+    Eigen::Vector4f m_planes[6];    // 法向指向视锥体内部，平面方程为 n·p + d >= 0
+};
+
+/**
+ * @brief 用于渲染的细节层次八叉树(与Potree的层次结构类似)
+ *
+ * 每个节点在自己的立方体内按网格抽取至多NODE_CAPACITY个分布均匀的点，其余的点交给子节点，
+ * 父节点就是其子树的稀疏预览，父子节点一起绘制时密度逐级增加。构建时把顶点按节点重排
+ * (广度优先，粗层在前)，每个节点对应顶点数组中的一段连续区间，整个点云仍只需一个顶点缓冲。
+ * 绘制时跳过视锥体外和投影不到一个像素的节点，其余按投影到屏幕上的大小从大到小选取，
+ * 直到用完点数预算。每个节点可以单独上传为一个顶点缓冲，作为视锥裁剪的分块。
+ */
+class LODOctree
+{
+public:
+    // 每个节点最多保存的点数
+    static constexpr uint32_t NODE_CAPACITY = 16384;
+    
+    /**
+     * @brief 构建八叉树并按节点重排顶点(耗时操作，适合在后台线程调用)
+     * @param vertices 交错存放的xyz坐标，构建后按节点顺序重排
+     * @param permutation 输出(可为空)：重排后每个顶点在原数组中的序号，用于按同样的顺序排列逐点属性
+     * @return 是否成功(点数超过32位索引范围时为false，顶点保持不变)
+     */
+    bool build(std::vector<float>& vertices, std::vector<uint32_t>* permutation = nullptr);
+    
+    void clear() { m_nodes.clear(); }
+    bool empty() const { return m_nodes.empty(); }
+    const std::vector<LODNode>& nodes() const { return m_nodes; }
+    
+    /**
+     * @brief 按可见性和投影大小选取需要绘制的节点
+     * @param modelView 顶点坐标到相机坐标的刚体变换(相机看向-z)
+     * @param projection 透视投影矩阵
+     * @param viewportHeight 视口高度(像素)
+     * @param budget 点数预算
+     * @param minPixels 投影半径小于该像素数的节点不再细分
+     * @param truncated 输出：是否因预算不足还有可见节点未被选中(可为空)
+     * @return 选中的节点序号(父节点总在子节点之前)
+     */
+    std::vector<uint32_t> select(const Eigen::Matrix4f& modelView, const Eigen::Matrix4f& projection,
+                                 float viewportHeight, size_t budget, float minPixels,
+                                 bool* truncated = nullptr) const;
+                                 
+private:
+    std::vector<LODNode> m_nodes;
+};
+
+#endif // LODOCTREE_H
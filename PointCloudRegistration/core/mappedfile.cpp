@@ -0,0 +1,178 @@
+#include "mappedfile.h"
+#include <algorithm>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+MappedFile::MappedFile()
+    : m_data(nullptr)
+    , m_size(0)
+#ifdef _WIN32
+    , m_fileHandle(INVALID_HANDLE_VALUE)
+    , m_mappingHandle(nullptr)
+#else
+    , m_fd(-1)
+#endif
+{
+}
+
+MappedFile::~MappedFile()
+{
+    close();
+}
+
+#ifdef _WIN32
+
+bool MappedFile::open(const std::string& filename)
+{
+    close();
+    
+    // 路径按UTF-8处理，转换为宽字符以支持中文路径
+    int wlen = MultiByteToWideChar(CP_UTF8, 0, filename.c_str(), -1, nullptr, 0);
+    std::wstring wname(wlen > 0 ? wlen - 1 : 0, L'\0');
+    if (wlen > 0) {
+        MultiByteToWideChar(CP_UTF8, 0, filename.c_str(), -1, &wname[0], wlen);
+    }
+    
+    HANDLE file = CreateFileW(wname.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr,
+                              OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+    if (file == INVALID_HANDLE_VALUE) {
+        return false;
+    }
+    
+    LARGE_INTEGER fileSize;
+    if (!GetFileSizeEx(file, &fileSize) || fileSize.QuadPart == 0) {
+        CloseHandle(file);
+        return false;
+    }
+    
+    HANDLE mapping = CreateFileMappingW(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (!mapping) {
+        CloseHandle(file);
+        return false;
+    }
+    
+    void* view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    if (!view) {
+        CloseHandle(mapping);
+        CloseHandle(file);
+        return false;
+    }
+    
+    m_fileHandle = file;
+    m_mappingHandle = mapping;
+    m_data = static_cast<const char*>(view);
+    m_size = static_cast<size_t>(fileSize.QuadPart);
+    return true;
+}
+
+void MappedFile::close()
+{
+    if (m_data) {
+        UnmapViewOfFile(m_data);
+        m_data = nullptr;
+    }
+    if (m_mappingHandle) {
+        CloseHandle(m_mappingHandle);
+        m_mappingHandle = nullptr;
+    }
+    if (m_fileHandle != INVALID_HANDLE_VALUE) {
+        CloseHandle(m_fileHandle);
+        m_fileHandle = INVALID_HANDLE_VALUE;
+    }
+    m_size = 0;
+}
+
+void MappedFile::advise(size_t offset, size_t length, Access access) const
+{
+    // Windows没有与madvise对应的顺序/随机/释放提示，仅对WillNeed做预取(Windows 8+)
+#if defined(_WIN32_WINNT) && _WIN32_WINNT >= 0x0602
+    if (!m_data || offset >= m_size || access != Access::WillNeed) {
+        return;
+    }
+    
+    WIN32_MEMORY_RANGE_ENTRY entry;
+    entry.VirtualAddress = const_cast<char*>(m_data + offset);
+    entry.NumberOfBytes = std::min(length, m_size - offset);
+    PrefetchVirtualMemory(GetCurrentProcess(), 1, &entry, 0);
+#else
+    (void)offset;
+    (void)length;
+    (void)access;
+#endif
+}
+
+#else
+
+bool MappedFile::open(const std::string& filename)
+{
+    close();
+    
+    int fd = ::open(filename.c_str(), O_RDONLY);
+    if (fd < 0) {
+        return false;
+    }
+    
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size <= 0) {
+        ::close(fd);
+        return false;
+    }
+    
+    void* addr = mmap(nullptr, static_cast<size_t>(st.st_size), PROT_READ, MAP_SHARED, fd, 0);
+    if (addr == MAP_FAILED) {
+        ::close(fd);
+        return false;
+    }
+    
+    m_fd = fd;
+    m_data = static_cast<const char*>(addr);
+    m_size = static_cast<size_t>(st.st_size);
+    return true;
+}
+
+void MappedFile::close()
+{
+    if (m_data) {
+        munmap(const_cast<char*>(m_data), m_size);
+        m_data = nullptr;
+    }
+    if (m_fd >= 0) {
+        ::close(m_fd);
+        m_fd = -1;
+    }
+    m_size = 0;
+}
+
+void MappedFile::advise(size_t offset, size_t length, Access access) const
+{
+    if (!m_data || offset >= m_size) {
+        return;
+    }
+    
+    // madvise要求起始地址按页对齐
+    static const size_t pageSize = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+    size_t alignedOffset = offset - offset % pageSize;
+    size_t alignedLength = std::min(length, m_size - offset) + (offset - alignedOffset);
+    
+    int advice = MADV_NORMAL;
+    switch (access) {
+    case Access::Sequential: advice = MADV_SEQUENTIAL; break;
+    case Access::Random:     advice = MADV_RANDOM;     break;
+    case Access::WillNeed:   advice = MADV_WILLNEED;   break;
+    case Access::Release:    advice = MADV_DONTNEED;   break;
+    }
+    
+    madvise(const_cast<char*>(m_data + alignedOffset), alignedLength, advice);
+}
+
+#endif
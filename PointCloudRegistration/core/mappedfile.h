@@ -0,0 +1,63 @@
+#ifndef MAPPEDFILE_H
+#define MAPPEDFILE_H
+
+#include <string>
+#include <cstddef>
+
+/**
+ * @brief 只读内存映射文件
+ *
+ * 将整个文件映射到进程地址空间，读取时直接访问页缓存，不经过用户态缓冲区拷贝。
+ * POSIX下使用mmap/madvise，Windows下使用CreateFileMapping/MapViewOfFile。
+ */
+class MappedFile
+{
+public:
+    /**
+     * @brief 访问模式提示
+     */
+    enum class Access {
+        Sequential,   // 顺序读取，内核加大预读并尽早回收已读页
+        Random,       // 随机/跨步读取，关闭预读
+        WillNeed,     // 即将访问，提前异步调页
+        Release       // 已处理完毕，立即释放映射的页(再次访问时从文件重新读取)
+    };
+    
+    MappedFile();
+    ~MappedFile();
+    
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+    
+    /**
+     * @brief 打开并映射文件
+     * @param filename 文件路径
+     * @return 是否成功（空文件视为失败）
+     */
+    bool open(const std::string& filename);
+    void close();
+    
+    bool isOpen() const { return m_data != nullptr; }
+    const char* data() const { return m_data; }
+    size_t size() const { return m_size; }
+    
+    /**
+     * @brief 对文件中的一段区域给出访问模式提示
+     * @param offset 起始字节偏移
+     * @param length 字节数
+     * @param access 访问模式
+     */
+    void advise(size_t offset, size_t length, Access access) const;
+
+private:
+    const char* m_data;
+    size_t m_size;
+#ifdef _WIN32
+    void* m_fileHandle;
+    void* m_mappingHandle;
+#else
+    int m_fd;
+#endif
+};
+
+#endif // MAPPEDFILE_H
@@ -39,7 +39,7 @@ double OctreeNode::minDistanceTo(const Point3D& p) const
 
 // Octree Implementation
 Octree::Octree(const std::vector<Point3D>& pts, int max_pts, int max_d)
-    : points(&pts), max_points_per_node(max_pts), max_depth(max_d), root(nullptr)
+    : points(&pts), max_points_per_node(max_pts), max_depth(max_d)
 {
     if (pts.empty()) return;
     
@@ -63,27 +63,31 @@ Octree::Octree(const std::vector<Point3D>& pts, int max_pts, int max_d)
     min_y -= eps; max_y += eps;
     min_z -= eps; max_z += eps;
     
-    // 创建根节点
-    root = new OctreeNode(min_x, max_x, min_y, max_y, min_z, max_z);
-    
-    // 建立索引列表
-    std::vector<int> all_indices(pts.size());
-    for (size_t i = 0; i < pts.size(); i++) {
-        all_indices[i] = static_cast<int>(i);
+    // 按分块建立子树，每块使用局部索引
+    for (size_t base = 0; base < pts.size(); base += TILE_CAPACITY) {
+        size_t count = std::min(TILE_CAPACITY, pts.size() - base);
+        
+        std::vector<uint32_t> tile_indices(count);
+        for (size_t i = 0; i < count; i++) {
+            tile_indices[i] = static_cast<uint32_t>(i);
+        }
+        
+        Tile tile;
+        tile.base = base;
+        tile.root = new OctreeNode(min_x, max_x, min_y, max_y, min_z, max_z);
+        buildTree(tile.root, base, tile_indices, 0);
+        tiles.push_back(tile);
     }
-    
-    // 构建树
-    buildTree(root, all_indices, 0);
 }
 
 Octree::~Octree()
 {
-    if (root) {
-        delete root;
+    for (auto& tile : tiles) {
+        delete tile.root;
     }
 }
 
-void Octree::buildTree(OctreeNode* node, const std::vector<int>& indices, int depth)
+void Octree::buildTree(OctreeNode* node, size_t base, const std::vector<uint32_t>& indices, int depth)
 {
     if (indices.size() <= static_cast<size_t>(max_points_per_node) || depth >= max_depth) {
         node->point_indices = indices;
@@ -99,9 +103,9 @@ void Octree::buildTree(OctreeNode* node, const std::vector<int>& indices, int de
     double mid_z = (node->min_z + node->max_z) / 2;
     
     // 为8个子节点分配点
-    std::vector<std::vector<int>> child_indices(8);
-    for (int idx : indices) {
-        const Point3D& p = (*points)[idx];
+    std::vector<std::vector<uint32_t>> child_indices(8);
+    for (uint32_t idx : indices) {
+        const Point3D& p = (*points)[base + idx];
         int octant = 0;
         if (p.x > mid_x) octant |= 1;
         if (p.y > mid_y) octant |= 2;
@@ -120,13 +124,13 @@ void Octree::buildTree(OctreeNode* node, const std::vector<int>& indices, int de
             double maxz = (i & 4) ? node->max_z : mid_z;
             
             node->children[i] = new OctreeNode(minx, maxx, miny, maxy, minz, maxz);
-            buildTree(node->children[i], child_indices[i], depth + 1);
+            buildTree(node->children[i], base, child_indices[i], depth + 1);
         }
     }
 }
 
-void Octree::searchNearest(OctreeNode* node, const Point3D& query, 
-                          int& best_idx, double& best_dist_sq) const
+void Octree::searchNearest(OctreeNode* node, size_t base, const Point3D& query, 
+                          size_t& best_idx, double& best_dist_sq) const
 {
     if (!node) return;
     
@@ -136,8 +140,8 @@ void Octree::searchNearest(OctreeNode* node, const Point3D& query,
     
     if (node->is_leaf) {
         // 叶节点：检查所有点
-        for (int idx : node->point_indices) {
-            const Point3D& p = (*points)[idx];
+        for (uint32_t idx : node->point_indices) {
+            const Point3D& p = (*points)[base + idx];
             double dx = p.x - query.x;
             double dy = p.y - query.y;
             double dz = p.z - query.z;
@@ -145,7 +149,7 @@ void Octree::searchNearest(OctreeNode* node, const Point3D& query,
             
             if (dist_sq < best_dist_sq) {
                 best_dist_sq = dist_sq;
-                best_idx = idx;
+                best_idx = base + idx;
             }
         }
     } else {
@@ -167,18 +171,101 @@ void Octree::searchNearest(OctreeNode* node, const Point3D& query,
                  [](const ChildDist& a, const ChildDist& b) { return a.dist < b.dist; });
         
         for (const auto& cd : child_dists) {
-            searchNearest(node->children[cd.index], query, best_idx, best_dist_sq);
+            searchNearest(node->children[cd.index], base, query, best_idx, best_dist_sq);
         }
     }
 }
 
-int Octree::findNearest(const Point3D& query) const
+size_t Octree::findNearest(const Point3D& query) const
 {
-    if (!root || points->empty()) return 0;
+    if (tiles.empty() || points->empty()) return 0;
     
-    int best_idx = 0;
+    size_t best_idx = 0;
     double best_dist_sq = std::numeric_limits<double>::max();
     
-    searchNearest(root, query, best_idx, best_dist_sq);
+    for (const auto& tile : tiles) {
+        searchNearest(tile.root, tile.base, query, best_idx, best_dist_sq);
+    }
     return best_idx;
 }
+
+void Octree::searchRay(OctreeNode* node, size_t base, const Point3D& origin, const Point3D& direction,
+                       double tanHalfAngle, size_t& best_idx, double& best_depth) const
+{
+    if (!node) return;
+    
+    // 用节点的外接球做保守判断：整个在相机后面、比当前结果更远或在圆锥外时剪枝
+    double cx = (node->min_x + node->max_x) / 2 - origin.x;
+    double cy = (node->min_y + node->max_y) / 2 - origin.y;
+    double cz = (node->min_z + node->max_z) / 2 - origin.z;
+    double ex = node->max_x - node->min_x;
+    double ey = node->max_y - node->min_y;
+    double ez = node->max_z - node->min_z;
+    double radius = std::sqrt(ex*ex + ey*ey + ez*ez) / 2;
+    double t = cx*direction.x + cy*direction.y + cz*direction.z;
+    if (t + radius <= 0 || t - radius >= best_depth) return;
+    double perp_sq = cx*cx + cy*cy + cz*cz - t*t;
+    double reach = tanHalfAngle * (t + radius) + radius;
+    if (perp_sq > reach * reach) return;
+    
+    if (node->is_leaf) {
+        for (uint32_t idx : node->point_indices) {
+            const Point3D& p = (*points)[base + idx];
+            double dx = p.x - origin.x;
+            double dy = p.y - origin.y;
+            double dz = p.z - origin.z;
+            double depth = dx*direction.x + dy*direction.y + dz*direction.z;
+            if (depth <= 0 || depth >= best_depth) continue;
+            
+            double cone = tanHalfAngle * depth;
+            if (dx*dx + dy*dy + dz*dz - depth*depth <= cone * cone) {
+                best_depth = depth;
+                best_idx = base + idx;
+            }
+        }
+    } else {
+        // 子节点按沿射线的最近距离排序，先找到的近处结果可以剪掉后面的子树
+        struct ChildDepth {
+            int index;
+            double depth;
+        };
+        ChildDepth child_depths[8];
+        int count = 0;
+        
+        for (int i = 0; i < 8; i++) {
+            OctreeNode* child = node->children[i];
+            if (child) {
+                double dx = (child->min_x + child->max_x) / 2 - origin.x;
+                double dy = (child->min_y + child->max_y) / 2 - origin.y;
+                double dz = (child->min_z + child->max_z) / 2 - origin.z;
+                child_depths[count++] = {i, dx*direction.x + dy*direction.y + dz*direction.z};
+            }
+        }
+        
+        std::sort(child_depths, child_depths + count,
+                 [](const ChildDepth& a, const ChildDepth& b) { return a.depth < b.depth; });
+        
+        for (int i = 0; i < count; i++) {
+            searchRay(node->children[child_depths[i].index], base, origin, direction,
+                      tanHalfAngle, best_idx, best_depth);
+        }
+    }
+}
+
+bool Octree::pickRay(const Point3D& origin, const Point3D& direction, double tanHalfAngle,
+                     size_t& index, double& depth) const
+{
+    if (tiles.empty() || points->empty()) return false;
+    
+    size_t best_idx = 0;
+    double best_depth = std::numeric_limits<double>::max();
+    
+    for (const auto& tile : tiles) {
+        searchRay(tile.root, tile.base, origin, direction, tanHalfAngle, best_idx, best_depth);
+    }
+    if (best_depth == std::numeric_limits<double>::max()) return false;
+    
+    index = best_idx;
+    depth = best_depth;
+    return true;
+}
@@ -3,6 +3,7 @@
 
 #include "pointcloud.h"
 #include <vector>
+#include <cstdint>
 
 /**
  * @brief 八叉树节点
@@ -10,7 +11,7 @@
 class OctreeNode {
 public:
     double min_x, max_x, min_y, max_y, min_z, max_z;
-    std::vector<int> point_indices;
+    std::vector<uint32_t> point_indices;   // 所在分块内的32位局部索引
     OctreeNode* children[8];
     bool is_leaf;
     
@@ -23,23 +24,48 @@ public:
 
 /**
  * @brief 八叉树类 - 用于加速最近邻搜索
+ * 
+ * 点数组按每块最多2^32个点切分为连续分块，每块一棵子树，节点内只存32位局部索引。
+ * 常规规模的点云只有一个分块，内存占用与32位索引相同；超大点云查询时依次搜索各分块。
  */
 class Octree {
 public:
     Octree(const std::vector<Point3D>& pts, int max_pts = 10, int max_d = 20);
     ~Octree();
     
-    int findNearest(const Point3D& query) const;
+    size_t findNearest(const Point3D& query) const;
     
+    /**
+     * @brief 沿射线拾取：在以射线为轴、顶点在射线起点的圆锥内找沿射线方向最近的点
+     * @param origin 射线起点(相机位置)
+     * @param direction 射线方向(单位向量)
+     * @param tanHalfAngle 圆锥半角的正切(屏幕上的拾取半径换算而来)
+     * @param index 输出：拾取到的点的全局索引
+     * @param depth 输出：该点在射线方向上的距离
+     * @return 圆锥内是否有点
+     */
+    bool pickRay(const Point3D& origin, const Point3D& direction, double tanHalfAngle,
+                 size_t& index, double& depth) const;
+                 
 private:
-    OctreeNode* root;
+    // 单个分块最多容纳的点数
+    static constexpr size_t TILE_CAPACITY = size_t(1) << 32;
+    
+    struct Tile {
+        size_t base;        // 分块第一个点的全局索引
+        OctreeNode* root;
+    };
+    
+    std::vector<Tile> tiles;
     const std::vector<Point3D>* points;
     int max_points_per_node;
     int max_depth;
     
-    void buildTree(OctreeNode* node, const std::vector<int>& indices, int depth);
-    void searchNearest(OctreeNode* node, const Point3D& query, 
-                      int& best_idx, double& best_dist_sq) const;
+    void buildTree(OctreeNode* node, size_t base, const std::vector<uint32_t>& indices, int depth);
+    void searchNearest(OctreeNode* node, size_t base, const Point3D& query, 
+                      size_t& best_idx, double& best_dist_sq) const;
+    void searchRay(OctreeNode* node, size_t base, const Point3D& origin, const Point3D& direction,
+                   double tanHalfAngle, size_t& best_idx, double& best_depth) const;
 };
 
 #endif // OCTREE_H
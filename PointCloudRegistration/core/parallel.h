@@ -0,0 +1,69 @@
+#ifndef PARALLEL_H
+#define PARALLEL_H
+
+#include <vector>
+#include <algorithm>
+#include <cstddef>
+#include <QThread>
+#include <QtConcurrent>
+
+/**
+ * @brief 并行区间工具
+ *
+ * 将 [0, count) 切分为若干连续区间，交给Qt全局线程池并行处理。
+ * 每个区间带有序号，便于各线程写入各自的归约槽位而无需加锁。
+ */
+namespace Parallel {
+
+struct Range {
+    size_t index;   // 区间序号
+    size_t begin;   // 起始位置(含)
+    size_t end;     // 结束位置(不含)
+};
+
+/**
+ * @brief 切分区间
+ * @param count 元素总数
+ * @param minChunk 每个区间的最小元素数，避免过细的任务拆分
+ * @return 区间列表（count为0时为空）
+ */
+inline std::vector<Range> splitRange(size_t count, size_t minChunk)
+{
+    std::vector<Range> ranges;
+    if (count == 0) {
+        return ranges;
+    }
+    
+    minChunk = std::max<size_t>(minChunk, 1);
+    size_t maxChunks = static_cast<size_t>(std::max(1, QThread::idealThreadCount())) * 4;
+    size_t numChunks = std::min(maxChunks, (count + minChunk - 1) / minChunk);
+    numChunks = std::max<size_t>(numChunks, 1);
+    
+    size_t chunkSize = (count + numChunks - 1) / numChunks;
+    ranges.reserve(numChunks);
+    for (size_t begin = 0; begin < count; begin += chunkSize) {
+        ranges.push_back({ranges.size(), begin, std::min(begin + chunkSize, count)});
+    }
+    
+    return ranges;
+}
+
+/**
+ * @brief 并行处理所有区间，阻塞直到全部完成
+ *
+ * 只有一个区间时直接在调用线程执行，省去线程池调度开销。
+ */
+template<typename Func>
+void forEach(std::vector<Range>& ranges, Func func)
+{
+    if (ranges.size() == 1) {
+        func(ranges.front());
+        return;
+    }
+    
+    QtConcurrent::blockingMap(ranges, [&func](Range& range) { func(range); });
+}
+
+} // namespace Parallel
+
+#endif // PARALLEL_H
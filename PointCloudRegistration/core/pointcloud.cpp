@@ -1,8 +1,23 @@
 #include "pointcloud.h"
+#include "parallel.h"
 #include <algorithm>
 #include <cmath>
 #include <limits>
 
+namespace {
+
+// Point3D是紧密排列的三个double，可直接映射为3xN的列主序矩阵
+static_assert(sizeof(Point3D) == 3 * sizeof(double), "Point3D must be tightly packed");
+using PointBlock = Eigen::Map<Eigen::Matrix<double, 3, Eigen::Dynamic>>;
+
+// 每个并行任务的最小点数，以及变换时单次处理的列数
+constexpr size_t PARALLEL_MIN_CHUNK = 65536;
+constexpr size_t TRANSFORM_BLOCK_SIZE = 512;
+using TransformBlock = Eigen::Matrix<double, 3, Eigen::Dynamic, Eigen::ColMajor, 3,
+                                     static_cast<int>(TRANSFORM_BLOCK_SIZE)>;
+
+} // namespace
+
 PointCloud::PointCloud()
     : color(Qt::white)
     , pointSize(2.0f)
@@ -18,6 +33,13 @@ PointCloud::~PointCloud()
 void PointCloud::clear()
 {
     points.clear();
+    intensity.clear();
+    rgb.clear();
+    gpsTime.clear();
+    classification.clear();
+    recordFields.clear();
+    extraBytes.clear();
+    encoding.reset();
     m_boundsComputed = false;
 }
 
@@ -29,18 +51,48 @@ void PointCloud::computeBounds()
         return;
     }
     
-    minX = minY = minZ = std::numeric_limits<double>::max();
-    maxX = maxY = maxZ = std::numeric_limits<double>::lowest();
+    Eigen::AlignedBox3d box = boundingBox();
+    minX = box.min().x(); maxX = box.max().x();
+    minY = box.min().y(); maxY = box.max().y();
+    minZ = box.min().z(); maxZ = box.max().z();
+    m_boundsComputed = true;
+}
+
+Eigen::AlignedBox3d PointCloud::boundingBox() const
+{
+    if (points.empty()) {
+        return Eigen::AlignedBox3d();
+    }
+    
+    std::vector<Parallel::Range> ranges = Parallel::splitRange(points.size(), PARALLEL_MIN_CHUNK);
+    std::vector<Eigen::Vector3d> chunkMin(ranges.size());
+    std::vector<Eigen::Vector3d> chunkMax(ranges.size());
+    
+    Parallel::forEach(ranges, [&](const Parallel::Range& range) {
+        Eigen::Map<const Eigen::Matrix<double, 3, Eigen::Dynamic>> block(
+            &points[range.begin].x, 3, static_cast<Eigen::Index>(range.end - range.begin));
+        chunkMin[range.index] = block.rowwise().minCoeff();
+        chunkMax[range.index] = block.rowwise().maxCoeff();
+    });
     
-    for (const auto& p : points) {
-        minX = std::min(minX, p.x);
-        maxX = std::max(maxX, p.x);
-        minY = std::min(minY, p.y);
-        maxY = std::max(maxY, p.y);
-        minZ = std::min(minZ, p.z);
-        maxZ = std::max(maxZ, p.z);
+    Eigen::AlignedBox3d box(chunkMin.front(), chunkMax.front());
+    for (size_t i = 1; i < ranges.size(); ++i) {
+        box.extend(chunkMin[i]);
+        box.extend(chunkMax[i]);
+    }
+    return box;
+}
+
+void PointCloud::setBounds(const Eigen::AlignedBox3d& box)
+{
+    if (points.empty() || box.isEmpty()) {
+        computeBounds();
+        return;
     }
     
+    minX = box.min().x(); maxX = box.max().x();
+    minY = box.min().y(); maxY = box.max().y();
+    minZ = box.min().z(); maxZ = box.max().z();
     m_boundsComputed = true;
 }
 
@@ -70,59 +122,153 @@ double PointCloud::getRadius() const
     return std::sqrt(dx*dx + dy*dy + dz*dz) / 2.0;
 }
 
-void PointCloud::applyTransform(const double R[3][3], const double t[3])
+void PointCloud::applyTransform(const Eigen::Affine3d& transform, bool updateBounds)
 {
-    for (auto& p : points) {
-        double nx = R[0][0] * p.x + R[0][1] * p.y + R[0][2] * p.z + t[0];
-        double ny = R[1][0] * p.x + R[1][1] * p.y + R[1][2] * p.z + t[1];
-        double nz = R[2][0] * p.x + R[2][1] * p.y + R[2][2] * p.z + t[2];
-        
-        p.x = nx;
-        p.y = ny;
-        p.z = nz;
+    if (points.empty()) {
+        if (updateBounds) {
+            computeBounds();
+        }
+        return;
     }
     
-    m_boundsComputed = false;
+    const Eigen::Matrix3d R = transform.linear();
+    const Eigen::Vector3d t = transform.translation();
+    
+    std::vector<Parallel::Range> ranges = Parallel::splitRange(points.size(), PARALLEL_MIN_CHUNK);
+    std::vector<Eigen::Vector3d> chunkMin(ranges.size());
+    std::vector<Eigen::Vector3d> chunkMax(ranges.size());
+    
+    Parallel::forEach(ranges, [&](const Parallel::Range& range) {
+        Eigen::Vector3d lo = Eigen::Vector3d::Constant(std::numeric_limits<double>::max());
+        Eigen::Vector3d hi = Eigen::Vector3d::Constant(std::numeric_limits<double>::lowest());
+        
+        // 按小块处理，临时矩阵留在栈上并保持在L1缓存内
+        TransformBlock transformed;
+        for (size_t begin = range.begin; begin < range.end; begin += TRANSFORM_BLOCK_SIZE) {
+            Eigen::Index n = static_cast<Eigen::Index>(std::min(TRANSFORM_BLOCK_SIZE, range.end - begin));
+            PointBlock block(&points[begin].x, 3, n);
+            
+            transformed.noalias() = R * block;
+            transformed.colwise() += t;
+            block = transformed;
+            
+            if (updateBounds) {
+                lo = lo.cwiseMin(transformed.rowwise().minCoeff());
+                hi = hi.cwiseMax(transformed.rowwise().maxCoeff());
+            }
+        }
+        
+        chunkMin[range.index] = lo;
+        chunkMax[range.index] = hi;
+    });
+    
+    if (updateBounds) {
+        storeBounds(chunkMin, chunkMax);
+    } else {
+        m_boundsComputed = false;
+    }
 }
 
-void PointCloud::applyTransformMatrix(const std::vector<std::vector<double>>& transform)
+void PointCloud::storeBounds(const std::vector<Eigen::Vector3d>& chunkMin,
+                             const std::vector<Eigen::Vector3d>& chunkMax)
 {
-    if (transform.size() != 4 || transform[0].size() != 4) {
-        return;
-    }
-    
-    for (auto& p : points) {
-        double nx = transform[0][0] * p.x + transform[0][1] * p.y + transform[0][2] * p.z + transform[0][3];
-        double ny = transform[1][0] * p.x + transform[1][1] * p.y + transform[1][2] * p.z + transform[1][3];
-        double nz = transform[2][0] * p.x + transform[2][1] * p.y + transform[2][2] * p.z + transform[2][3];
-        
-        p.x = nx;
-        p.y = ny;
-        p.z = nz;
+    Eigen::Vector3d lo = chunkMin.front();
+    Eigen::Vector3d hi = chunkMax.front();
+    for (size_t i = 1; i < chunkMin.size(); ++i) {
+        lo = lo.cwiseMin(chunkMin[i]);
+        hi = hi.cwiseMax(chunkMax[i]);
     }
     
-    m_boundsComputed = false;
+    minX = lo.x(); maxX = hi.x();
+    minY = lo.y(); maxY = hi.y();
+    minZ = lo.z(); maxZ = hi.z();
+    m_boundsComputed = true;
 }
 
-PointCloud* PointCloud::downsample(int targetSize) const
+PointCloud* PointCloud::downsample(size_t targetSize) const
 {
-    if (points.empty() || targetSize <= 0) {
+    if (points.empty() || targetSize == 0) {
         return nullptr;
     }
     
     PointCloud* sampled = new PointCloud();
     sampled->color = this->color;
     sampled->pointSize = this->pointSize;
+    sampled->encoding = this->encoding;
+    const size_t fieldsSize = encoding ? encoding->recordFieldsSize : 0;
+    const bool hasFields = fieldsSize > 0 && recordFields.size() == points.size() * fieldsSize;
+    const size_t extraSize = encoding ? encoding->extraBytesSize : 0;
+    const bool hasExtra = extraSize > 0 && extraBytes.size() == points.size() * extraSize;
     
-    if (static_cast<int>(points.size()) <= targetSize) {
+    if (points.size() <= targetSize) {
         sampled->points = this->points;
+        sampled->intensity = this->intensity;
+        sampled->rgb = this->rgb;
+        sampled->gpsTime = this->gpsTime;
+        sampled->classification = this->classification;
+        sampled->recordFields = this->recordFields;
+        sampled->extraBytes = this->extraBytes;
     } else {
         double step = static_cast<double>(points.size()) / targetSize;
-        for (int i = 0; i < targetSize; ++i) {
-            int idx = static_cast<int>(i * step);
+        for (size_t i = 0; i < targetSize; ++i) {
+            size_t idx = static_cast<size_t>(i * step);
             sampled->points.push_back(points[idx]);
+            if (!intensity.empty()) sampled->intensity.push_back(intensity[idx]);
+            if (!rgb.empty()) sampled->rgb.push_back(rgb[idx]);
+            if (!gpsTime.empty()) sampled->gpsTime.push_back(gpsTime[idx]);
+            if (!classification.empty()) sampled->classification.push_back(classification[idx]);
+            if (hasFields) {
+                sampled->recordFields.insert(sampled->recordFields.end(), recordFields.begin() + idx * fieldsSize,
+                                             recordFields.begin() + (idx + 1) * fieldsSize);
+            }
+            if (hasExtra) {
+                sampled->extraBytes.insert(sampled->extraBytes.end(), extraBytes.begin() + idx * extraSize,
+                                           extraBytes.begin() + (idx + 1) * extraSize);
+            }
         }
     }
     
     return sampled;
 }
+
+void PointCloud::crop(const Eigen::AlignedBox3d& box)
+{
+    const size_t n = points.size();
+    const size_t fieldsSize = encoding ? encoding->recordFieldsSize : 0;
+    const bool hasFields = fieldsSize > 0 && recordFields.size() == n * fieldsSize;
+    const size_t extraSize = encoding ? encoding->extraBytesSize : 0;
+    const bool hasExtra = extraSize > 0 && extraBytes.size() == n * extraSize;
+    
+    size_t kept = 0;
+    for (size_t i = 0; i < n; ++i) {
+        const Point3D& p = points[i];
+        if (!box.contains(Eigen::Vector3d(p.x, p.y, p.z))) {
+            continue;
+        }
+        if (kept != i) {
+            points[kept] = p;
+            if (!intensity.empty()) intensity[kept] = intensity[i];
+            if (!rgb.empty()) rgb[kept] = rgb[i];
+            if (!gpsTime.empty()) gpsTime[kept] = gpsTime[i];
+            if (!classification.empty()) classification[kept] = classification[i];
+            if (hasFields) {
+                std::copy(recordFields.begin() + i * fieldsSize, recordFields.begin() + (i + 1) * fieldsSize,
+                          recordFields.begin() + kept * fieldsSize);
+            }
+            if (hasExtra) {
+                std::copy(extraBytes.begin() + i * extraSize, extraBytes.begin() + (i + 1) * extraSize,
+                          extraBytes.begin() + kept * extraSize);
+            }
+        }
+        ++kept;
+    }
+    
+    points.resize(kept);
+    if (!intensity.empty()) intensity.resize(kept);
+    if (!rgb.empty()) rgb.resize(kept);
+    if (!gpsTime.empty()) gpsTime.resize(kept);
+    if (!classification.empty()) classification.resize(kept);
+    if (hasFields) recordFields.resize(kept * fieldsSize);
+    if (hasExtra) extraBytes.resize(kept * extraSize);
+    computeBounds();
+}
@@ -3,8 +3,11 @@
 
 #include <vector>
 #include <string>
+#include <cstdint>
+#include <memory>
 #include <QVector3D>
 #include <QColor>
+#include "Eigen/Geometry"
 
 /**
  * @brief 3D点结构
@@ -22,6 +25,34 @@ struct Point3D {
     }
 };
 
+/**
+ * @brief 点颜色(LAS中的16位RGB)
+ */
+struct PointColor {
+    uint16_t r, g, b;
+};
+
+/**
+ * @brief 点云来源LAS文件的编码参数，写回文件时沿用
+ */
+struct PointCloudEncoding {
+    struct VariableRecord {
+        std::string userId;
+        uint16_t recordId = 0;
+        std::string description;
+        std::vector<char> data;
+    };
+    
+    uint8_t versionMinor = 2;
+    uint16_t globalEncoding = 0;
+    uint8_t pointFormat = 0;
+    uint16_t recordFieldsSize = 0;                  // 每点坐标之后标准字段的字节数(由点格式决定)
+    uint16_t extraBytesSize = 0;                    // 每点在标准字段之后的额外字节数
+    Eigen::Vector3d scale = Eigen::Vector3d::Constant(0.001);
+    Eigen::Vector3d offset = Eigen::Vector3d::Zero();
+    std::vector<VariableRecord> variableRecords;    // 原样保留的VLR(不含LAZ/COPC等编码相关记录)
+};
+
 /**
  * @brief 点云类
  * 
@@ -41,27 +72,54 @@ public:
     // 点云数据
     std::vector<Point3D> points;
     
+    // 可选点属性(与points一一对应，未读取或文件中没有的属性为空)
+    std::vector<uint16_t> intensity;
+    std::vector<PointColor> rgb;
+    std::vector<double> gpsTime;
+    std::vector<uint8_t> classification;
+    std::vector<uint8_t> recordFields;  // 每点encoding->recordFieldsSize字节，来源记录坐标之后的标准字段
+    std::vector<uint8_t> extraBytes;    // 每点encoding->extraBytesSize字节
+    
+    // 来源文件的编码参数(不是从LAS读取时为空)
+    std::shared_ptr<const PointCloudEncoding> encoding;
+    
     // 显示属性
     QColor color;
     float pointSize;
     
     // 边界信息
     void computeBounds();
+    Eigen::AlignedBox3d boundingBox() const;   // 并行计算当前点的包围盒，不修改缓存的边界
+    void setBounds(const Eigen::AlignedBox3d& box);   // 直接设置已知的边界(例如从缓存文件读出)，不扫描点
     double minX, maxX, minY, maxY, minZ, maxZ;
     
     // 中心和缩放
     QVector3D getCenter() const;
     double getRadius() const;
     
-    // 变换操作
-    void applyTransform(const double R[3][3], const double t[3]);
-    void applyTransformMatrix(const std::vector<std::vector<double>>& transform);
+    // 变换操作（多线程 + Eigen向量化）
+    // updateBounds为true时在同一遍扫描中更新边界，无需再调用computeBounds
+    void applyTransform(const Eigen::Affine3d& transform, bool updateBounds = false);
     
     // 采样
-    PointCloud* downsample(int targetSize) const;
+    PointCloud* downsample(size_t targetSize) const;
     
+    // 删除包围盒外的点(属性数组同步压缩)并重新计算边界
+    void crop(const Eigen::AlignedBox3d& box);
+
 private:
+    void storeBounds(const std::vector<Eigen::Vector3d>& chunkMin,
+                     const std::vector<Eigen::Vector3d>& chunkMax);
+    
     bool m_boundsComputed;
 };
 
+/**
+ * @brief 加载过程中已解码完成的一段点的副本(只读，可在线程间共享)
+ */
+struct PointBatch {
+    size_t first = 0;                                   // 这段点在点云中的起始序号
+    std::shared_ptr<const std::vector<Point3D>> points;
+};
+
 #endif // POINTCLOUD_H
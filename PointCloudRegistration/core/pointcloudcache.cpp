@@ -0,0 +1,273 @@
+#include "pointcloudcache.h"
+#include "lasio.h"
+#include "mappedfile.h"
+#include "parallel.h"
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <cstring>
+
+namespace {
+
+// 缓存文件标识和版本
+const char CACHE_MAGIC[8] = {'P', 'C', 'R', 'C', 'A', 'C', 'H', 'E'};
+constexpr uint32_t CACHE_VERSION = 1;
+
+// 段起始位置的对齐字节数，映射后各数组按缓存行对齐
+constexpr uint64_t SECTION_ALIGNMENT = 64;
+
+// 并行拷贝时每个任务的最小字节数
+constexpr size_t COPY_MIN_CHUNK = size_t(4) << 20;
+
+/**
+ * @brief 缓存文件头部(磁盘布局)
+ */
+struct CacheHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t attributes;        // 缓存中包含的属性
+    uint64_t sourceSize;        // 来源文件大小
+    int64_t sourceTime;         // 来源文件修改时间(文件系统时钟的计数)
+    uint64_t pointCount;
+    double bounds[6];           // minX, minY, minZ, maxX, maxY, maxZ
+    uint32_t numSections;
+    uint32_t reserved;
+};
+
+/**
+ * @brief 段表项，id为对应的LASAttribute位(点坐标为LASAttribute::XYZ)
+ */
+struct CacheSection {
+    uint32_t id;
+    uint32_t elementSize;       // 每点字节数
+    uint64_t offset;
+    uint64_t length;
+};
+
+/**
+ * @brief 待写出的一段数组
+ */
+struct SectionData {
+    uint32_t id;
+    uint32_t elementSize;
+    const char* data;
+    uint64_t length;
+};
+
+std::filesystem::path toPath(const std::string& filename)
+{
+    return std::filesystem::u8path(filename);
+}
+
+// 来源文件的大小和修改时间
+bool sourceStamp(const std::string& sourceFile, uint64_t& size, int64_t& time)
+{
+    std::error_code error;
+    const std::filesystem::path path = toPath(sourceFile);
+    size = std::filesystem::file_size(path, error);
+    if (error) {
+        return false;
+    }
+    auto modified = std::filesystem::last_write_time(path, error);
+    if (error) {
+        return false;
+    }
+    time = static_cast<int64_t>(modified.time_since_epoch().count());
+    return true;
+}
+
+// 多线程拷贝一段连续内存
+void copyParallel(char* out, const char* in, size_t bytes)
+{
+    std::vector<Parallel::Range> ranges = Parallel::splitRange(bytes, COPY_MIN_CHUNK);
+    Parallel::forEach(ranges, [&](const Parallel::Range& range) {
+        std::memcpy(out + range.begin, in + range.begin, range.end - range.begin);
+    });
+}
+
+// 把段的内容拷贝到数组，数组按段长度调整大小
+template<typename T>
+bool copySection(std::vector<T>& out, const char* base, const CacheSection& section, size_t elementCount)
+{
+    if (section.length != elementCount * sizeof(T)) {
+        return false;
+    }
+    out.resize(elementCount);
+    copyParallel(reinterpret_cast<char*>(out.data()), base + section.offset, static_cast<size_t>(section.length));
+    return true;
+}
+
+} // namespace
+
+std::string PointCloudCache::cachePath(const std::string& sourceFile)
+{
+    return sourceFile + ".pcrcache";
+}
+
+bool PointCloudCache::load(const std::string& sourceFile, PointCloud& cloud, unsigned attributes)
+{
+    cloud.clear();
+    
+    MappedFile file;
+    if (!file.open(cachePath(sourceFile))) {
+        return false;
+    }
+    
+    CacheHeader header;
+    if (file.size() < sizeof(CacheHeader)) {
+        return false;
+    }
+    std::memcpy(&header, file.data(), sizeof(CacheHeader));
+    if (std::memcmp(header.magic, CACHE_MAGIC, sizeof(CACHE_MAGIC)) != 0 || header.version != CACHE_VERSION) {
+        return false;
+    }
+    
+    uint64_t sourceSize = 0;
+    int64_t sourceTime = 0;
+    if (!sourceStamp(sourceFile, sourceSize, sourceTime)
+        || header.sourceSize != sourceSize || header.sourceTime != sourceTime) {
+        std::cout << "点云缓存已过期: " << cachePath(sourceFile) << std::endl;
+        return false;
+    }
+    if ((attributes & ~header.attributes) != 0) {
+        return false;
+    }
+    
+    const uint64_t tableEnd = sizeof(CacheHeader) + uint64_t(header.numSections) * sizeof(CacheSection);
+    if (tableEnd > file.size()) {
+        return false;
+    }
+    std::vector<CacheSection> sections(header.numSections);
+    std::memcpy(sections.data(), file.data() + sizeof(CacheHeader), sections.size() * sizeof(CacheSection));
+    
+    auto findSection = [&](uint32_t id) -> const CacheSection* {
+        for (const CacheSection& section : sections) {
+            if (section.id == id && section.offset <= file.size() && section.length <= file.size() - section.offset) {
+                return &section;
+            }
+        }
+        return nullptr;
+    };
+    
+    const size_t n = static_cast<size_t>(header.pointCount);
+    const CacheSection* points = findSection(LASAttribute::XYZ);
+    if (!points) {
+        return false;
+    }
+    file.advise(0, file.size(), MappedFile::Access::Sequential);
+    
+    bool ok = copySection(cloud.points, file.data(), *points, n);
+    
+    // 请求的属性在缓存中没有对应的段，说明来源格式不提供该属性，保持为空
+    auto loadAttribute = [&](unsigned attribute, auto& out) {
+        const CacheSection* section = (attributes & attribute) ? findSection(attribute) : nullptr;
+        if (ok && section) {
+            ok = copySection(out, file.data(), *section, n);
+        }
+    };
+    loadAttribute(LASAttribute::Intensity, cloud.intensity);
+    loadAttribute(LASAttribute::RGB, cloud.rgb);
+    loadAttribute(LASAttribute::GPSTime, cloud.gpsTime);
+    loadAttribute(LASAttribute::Classification, cloud.classification);
+    
+    // 每点字节数由来源格式决定的段按元素大小展开
+    auto loadBytes = [&](unsigned attribute, std::vector<uint8_t>& out) {
+        const CacheSection* section = (attributes & attribute) ? findSection(attribute) : nullptr;
+        if (ok && section) {
+            ok = copySection(out, file.data(), *section, n * section->elementSize);
+        }
+    };
+    loadBytes(LASAttribute::RecordFields, cloud.recordFields);
+    loadBytes(LASAttribute::ExtraBytes, cloud.extraBytes);
+    
+    if (!ok) {
+        std::cerr << "点云缓存已损坏: " << cachePath(sourceFile) << std::endl;
+        cloud.clear();
+        return false;
+    }
+    
+    cloud.setBounds(Eigen::AlignedBox3d(Eigen::Vector3d(header.bounds[0], header.bounds[1], header.bounds[2]),
+                                        Eigen::Vector3d(header.bounds[3], header.bounds[4], header.bounds[5])));
+    return true;
+}
+
+bool PointCloudCache::save(const std::string& sourceFile, const PointCloud& cloud, unsigned attributes)
+{
+    CacheHeader header = {};
+    std::memcpy(header.magic, CACHE_MAGIC, sizeof(CACHE_MAGIC));
+    header.version = CACHE_VERSION;
+    header.attributes = attributes;
+    header.pointCount = cloud.size();
+    if (!sourceStamp(sourceFile, header.sourceSize, header.sourceTime)) {
+        return false;
+    }
+    
+    const double bounds[6] = {cloud.minX, cloud.minY, cloud.minZ, cloud.maxX, cloud.maxY, cloud.maxZ};
+    std::memcpy(header.bounds, bounds, sizeof(bounds));
+    
+    std::vector<SectionData> data;
+    auto addSection = [&](uint32_t id, const auto& values) {
+        using Value = typename std::decay_t<decltype(values)>::value_type;
+        if (!values.empty()) {
+            data.push_back({id, static_cast<uint32_t>(sizeof(Value)), reinterpret_cast<const char*>(values.data()),
+                            values.size() * sizeof(Value)});
+        }
+    };
+    addSection(LASAttribute::XYZ, cloud.points);
+    addSection(LASAttribute::Intensity, cloud.intensity);
+    addSection(LASAttribute::RGB, cloud.rgb);
+    addSection(LASAttribute::GPSTime, cloud.gpsTime);
+    addSection(LASAttribute::Classification, cloud.classification);
+    auto addBytes = [&](uint32_t id, uint16_t elementSize, const std::vector<uint8_t>& values) {
+        if (!values.empty() && elementSize > 0) {
+            data.push_back({id, elementSize, reinterpret_cast<const char*>(values.data()), values.size()});
+        }
+    };
+    if (cloud.encoding) {
+        addBytes(LASAttribute::RecordFields, cloud.encoding->recordFieldsSize, cloud.recordFields);
+        addBytes(LASAttribute::ExtraBytes, cloud.encoding->extraBytesSize, cloud.extraBytes);
+    }
+    header.numSections = static_cast<uint32_t>(data.size());
+    
+    std::vector<CacheSection> sections;
+    uint64_t offset = sizeof(CacheHeader) + data.size() * sizeof(CacheSection);
+    for (const SectionData& section : data) {
+        offset = (offset + SECTION_ALIGNMENT - 1) / SECTION_ALIGNMENT * SECTION_ALIGNMENT;
+        sections.push_back({section.id, section.elementSize, offset, section.length});
+        offset += section.length;
+    }
+    
+    const std::string path = cachePath(sourceFile);
+    const std::string temporary = path + ".tmp";
+    {
+        std::ofstream out(toPath(temporary), std::ios::binary);
+        if (!out.is_open()) {
+            return false;
+        }
+        out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        out.write(reinterpret_cast<const char*>(sections.data()),
+                  static_cast<std::streamsize>(sections.size() * sizeof(CacheSection)));
+        
+        const char padding[SECTION_ALIGNMENT] = {};
+        uint64_t position = sizeof(CacheHeader) + sections.size() * sizeof(CacheSection);
+        for (size_t i = 0; i < data.size() && out; ++i) {
+            out.write(padding, static_cast<std::streamsize>(sections[i].offset - position));
+            out.write(data[i].data, static_cast<std::streamsize>(data[i].length));
+            position = sections[i].offset + sections[i].length;
+        }
+        if (!out) {
+            out.close();
+            std::error_code error;
+            std::filesystem::remove(toPath(temporary), error);
+            return false;
+        }
+    }
+    
+    std::error_code error;
+    std::filesystem::rename(toPath(temporary), toPath(path), error);
+    if (error) {
+        std::filesystem::remove(toPath(temporary), error);
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,43 @@
+#ifndef POINTCLOUDCACHE_H
+#define POINTCLOUDCACHE_H
+
+#include <string>
+#include <cstdint>
+#include "pointcloud.h"
+
+/**
+ * @brief 整体读取点云文件后的本地二进制缓存(文件名后加.pcrcache)
+ *
+ * 点坐标和各属性数组按PointCloud中的内存布局原样存放在对齐的段中，另存包围盒，
+ * 再次加载时映射缓存文件后直接整段拷贝到点云数组，不需要解码和重新计算边界。
+ * 缓存记录来源文件的大小、修改时间和点数，任一不符即视为过期。
+ * 文件按本机字节序写出，只用于本机加速加载，不作为交换格式。
+ */
+class PointCloudCache
+{
+public:
+    // 缓存文件路径
+    static std::string cachePath(const std::string& sourceFile);
+    
+    /**
+     * @brief 从来源文件旁的缓存加载点和属性(会清空原有数据)
+     * @param sourceFile 来源点云文件
+     * @param cloud 输出点云对象(不设置encoding，由调用者从来源文件获取)
+     * @param attributes 需要的属性(LASAttribute按位组合)
+     * @return 缓存存在、未过期且包含所需属性时为true
+     */
+    static bool load(const std::string& sourceFile, PointCloud& cloud, unsigned attributes);
+    
+    /**
+     * @brief 把整体读取的点云写入来源文件旁的缓存
+     *
+     * 先写入临时文件再改名，写入失败(例如目录只读)时不影响来源文件和已有缓存。
+     * @param sourceFile 来源点云文件
+     * @param cloud 从来源文件读取的全部点
+     * @param attributes 读取时请求且文件格式提供的属性
+     * @return 是否成功
+     */
+    static bool save(const std::string& sourceFile, const PointCloud& cloud, unsigned attributes);
+};
+
+#endif // POINTCLOUDCACHE_H
@@ -0,0 +1,1004 @@
+#include "pointcloudio.h"
+#include "pointcloudcache.h"
+#include "mappedfile.h"
+#include "parallel.h"
+#include <charconv>
+#include <sstream>
+#include <iostream>
+#include <algorithm>
+#include <limits>
+#include <mutex>
+#include <cstring>
+#include <cmath>
+
+namespace {
+
+// 二进制解码时每个并行任务的最小点数，文本解析时每块的最小字节数
+constexpr size_t BINARY_MIN_CHUNK = 65536;
+constexpr size_t TEXT_MIN_CHUNK = size_t(1) << 20;
+
+// 探查时预览点分成的记录段数
+constexpr size_t PROBE_RUNS = 64;
+
+// 文本格式中不限制行数
+constexpr size_t ALL_LINES = std::numeric_limits<size_t>::max();
+
+// 这些格式能提供的可选属性
+constexpr unsigned SUPPORTED_ATTRIBUTES = LASAttribute::Intensity | LASAttribute::RGB;
+
+/**
+ * @brief 字段的存储类型
+ */
+enum class ValueType { Int8, UInt8, Int16, UInt16, Int32, UInt32, Float32, Float64 };
+
+size_t valueSize(ValueType type)
+{
+    switch (type) {
+    case ValueType::Int8:
+    case ValueType::UInt8:   return 1;
+    case ValueType::Int16:
+    case ValueType::UInt16:  return 2;
+    case ValueType::Int32:
+    case ValueType::UInt32:
+    case ValueType::Float32: return 4;
+    case ValueType::Float64: return 8;
+    }
+    return 0;
+}
+
+/**
+ * @brief 字段写入的点属性
+ */
+enum class Target { Skip, X, Y, Z, Intensity, Red, Green, Blue, PackedRGB };
+
+/**
+ * @brief 一个字段(二进制格式)或一列(文本格式)
+ *
+ * 二进制格式中第i个点的值位于base + i * stride，文本格式只使用target和type。
+ */
+struct Field {
+    Target target = Target::Skip;
+    ValueType type = ValueType::Float64;
+    const char* base = nullptr;
+    size_t stride = 0;
+};
+
+Target targetOf(std::string name)
+{
+    std::transform(name.begin(), name.end(), name.begin(),
+                   [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+    if (name == "x") return Target::X;
+    if (name == "y") return Target::Y;
+    if (name == "z") return Target::Z;
+    if (name == "intensity" || name == "scalar_intensity") return Target::Intensity;
+    if (name == "red" || name == "r" || name == "diffuse_red") return Target::Red;
+    if (name == "green" || name == "g" || name == "diffuse_green") return Target::Green;
+    if (name == "blue" || name == "b" || name == "diffuse_blue") return Target::Blue;
+    if (name == "rgb" || name == "rgba") return Target::PackedRGB;
+    return Target::Skip;
+}
+
+// 颜色分量换算到LAS的16位范围：8位整数乘257，浮点数按[0, 1]解释
+double colourScale(ValueType type)
+{
+    switch (type) {
+    case ValueType::Int8:
+    case ValueType::UInt8:   return 257.0;
+    case ValueType::Float32:
+    case ValueType::Float64: return 65535.0;
+    default:                 return 1.0;
+    }
+}
+
+uint16_t toUInt16(double value)
+{
+    return static_cast<uint16_t>(std::min(std::max(std::round(value), 0.0), 65535.0));
+}
+
+template<typename T>
+T readSwapped(const char* data, bool swap)
+{
+    char bytes[sizeof(T)];
+    std::memcpy(bytes, data, sizeof(T));
+    if (swap) {
+        std::reverse(bytes, bytes + sizeof(T));
+    }
+    T value;
+    std::memcpy(&value, bytes, sizeof(T));
+    return value;
+}
+
+double readValue(const char* data, ValueType type, bool swap)
+{
+    switch (type) {
+    case ValueType::Int8:    return readSwapped<int8_t>(data, false);
+    case ValueType::UInt8:   return readSwapped<uint8_t>(data, false);
+    case ValueType::Int16:   return readSwapped<int16_t>(data, swap);
+    case ValueType::UInt16:  return readSwapped<uint16_t>(data, swap);
+    case ValueType::Int32:   return readSwapped<int32_t>(data, swap);
+    case ValueType::UInt32:  return readSwapped<uint32_t>(data, swap);
+    case ValueType::Float32: return readSwapped<float>(data, swap);
+    case ValueType::Float64: return readSwapped<double>(data, swap);
+    }
+    return 0.0;
+}
+
+// PCD的rgb字段把0x00RRGGBB的位模式存成float(也可能是整数)
+PointColor unpackRGB(double value, ValueType type)
+{
+    uint32_t bits = 0;
+    if (type == ValueType::Float32) {
+        float f = static_cast<float>(value);
+        std::memcpy(&bits, &f, sizeof(bits));
+    } else {
+        bits = static_cast<uint32_t>(value);
+    }
+    return {static_cast<uint16_t>(((bits >> 16) & 0xFF) * 257), static_cast<uint16_t>(((bits >> 8) & 0xFF) * 257),
+            static_cast<uint16_t>((bits & 0xFF) * 257)};
+}
+
+/**
+ * @brief 一个点的解码结果
+ */
+struct PointValue {
+    Point3D point;
+    uint16_t intensity = 0;
+    PointColor rgb = {0, 0, 0};
+    
+    void assign(Target target, ValueType type, double value) {
+        switch (target) {
+        case Target::X:         point.x = value; break;
+        case Target::Y:         point.y = value; break;
+        case Target::Z:         point.z = value; break;
+        case Target::Intensity: intensity = toUInt16(value); break;
+        case Target::Red:       rgb.r = toUInt16(value * colourScale(type)); break;
+        case Target::Green:     rgb.g = toUInt16(value * colourScale(type)); break;
+        case Target::Blue:      rgb.b = toUInt16(value * colourScale(type)); break;
+        case Target::PackedRGB: rgb = unpackRGB(value, type); break;
+        case Target::Skip:      break;
+        }
+    }
+};
+
+// 按字段和请求的属性决定输出哪些属性数组
+void selectOutputs(const std::vector<Field>& fields, unsigned attributes, bool& intensity, bool& rgb)
+{
+    intensity = false;
+    rgb = false;
+    for (const Field& field : fields) {
+        intensity |= field.target == Target::Intensity;
+        rgb |= field.target == Target::Red || field.target == Target::Green || field.target == Target::Blue
+            || field.target == Target::PackedRGB;
+    }
+    intensity = intensity && (attributes & LASAttribute::Intensity);
+    rgb = rgb && (attributes & LASAttribute::RGB);
+}
+
+bool hasXYZ(const std::vector<Field>& fields)
+{
+    auto has = [&](Target target) {
+        return std::any_of(fields.begin(), fields.end(), [target](const Field& f) { return f.target == target; });
+    };
+    return has(Target::X) && has(Target::Y) && has(Target::Z);
+}
+
+/**
+ * @brief 直接从映射区并行解码二进制字段
+ */
+void decodeBinary(const std::vector<Field>& fields, bool swap, size_t count, PointCloud& cloud,
+                  const LASReadOptions& options)
+{
+    bool withIntensity = false, withRGB = false;
+    selectOutputs(fields, options.attributes, withIntensity, withRGB);
+    
+    cloud.points.resize(count);
+    if (withIntensity) cloud.intensity.resize(count);
+    if (withRGB) cloud.rgb.resize(count);
+    
+    std::vector<Field> used;
+    std::copy_if(fields.begin(), fields.end(), std::back_inserter(used),
+                 [](const Field& f) { return f.target != Target::Skip; });
+    
+    std::mutex progressMutex;
+    size_t decoded = 0;
+    std::vector<Parallel::Range> ranges = Parallel::splitRange(count, BINARY_MIN_CHUNK);
+    Parallel::forEach(ranges, [&](const Parallel::Range& range) {
+        for (size_t i = range.begin; i < range.end; ++i) {
+            PointValue value;
+            for (const Field& field : used) {
+                value.assign(field.target, field.type, readValue(field.base + i * field.stride, field.type, swap));
+            }
+            cloud.points[i] = value.point;
+            if (withIntensity) cloud.intensity[i] = value.intensity;
+            if (withRGB) cloud.rgb[i] = value.rgb;
+        }
+        
+        if (options.chunkDecoded) {
+            reportChunks(options.chunkDecoded, range.begin, range.end);
+        }
+        if (options.progress) {
+            std::lock_guard<std::mutex> lock(progressMutex);
+            decoded += range.end - range.begin;
+            options.progress(decoded, count);
+        }
+    });
+}
+
+bool isSeparator(char c)
+{
+    return c == ' ' || c == '\t' || c == ',' || c == ';' || c == '\r';
+}
+
+/**
+ * @brief 解析一行文本，列按fields的顺序对应
+ * @return 所需的列都能解析为数字时为true
+ */
+bool parseLine(const char* p, const char* end, const std::vector<Field>& fields, size_t usedColumns,
+               PointValue& value)
+{
+    for (size_t column = 0; column < usedColumns; ++column) {
+        while (p < end && isSeparator(*p)) {
+            ++p;
+        }
+        if (p == end) {
+            return false;
+        }
+        
+        const Field& field = fields[column];
+        if (field.target == Target::Skip) {
+            while (p < end && !isSeparator(*p)) {
+                ++p;
+            }
+            continue;
+        }
+        
+        if (*p == '+') {
+            ++p;
+        }
+        double number = 0.0;
+        std::from_chars_result result = std::from_chars(p, end, number);
+        if (result.ec != std::errc() || (result.ptr < end && !isSeparator(*result.ptr))) {
+            return false;
+        }
+        value.assign(field.target, field.type, number);
+        p = result.ptr;
+    }
+    return true;
+}
+
+/**
+ * @brief 一块文本中解析出的点
+ */
+struct TextPart {
+    std::vector<Point3D> points;
+    std::vector<uint16_t> intensity;
+    std::vector<PointColor> rgb;
+};
+
+/**
+ * @brief 按行边界切分文本并行解析
+ *
+ * 只解析行号在[skipLines, skipLines + maxLines)内的行(PLY中vertex之前的元素和之后的面)，
+ * 不限制行数时跳过行计数。无法解析的行被忽略。各块的结果最后并行拼接到点云中。
+ */
+void parseText(const char* begin, const char* end, const std::vector<Field>& fields, size_t skipLines,
+               size_t maxLines, PointCloud& cloud, const LASReadOptions& options)
+{
+    bool withIntensity = false, withRGB = false;
+    selectOutputs(fields, options.attributes, withIntensity, withRGB);
+    
+    size_t usedColumns = 0;
+    for (size_t column = 0; column < fields.size(); ++column) {
+        if (fields[column].target != Target::Skip) {
+            usedColumns = column + 1;
+        }
+    }
+    
+    // 块边界移动到下一个换行符之后，保证每块都由完整的行组成
+    const size_t total = static_cast<size_t>(end - begin);
+    std::vector<Parallel::Range> ranges = Parallel::splitRange(total, TEXT_MIN_CHUNK);
+    std::vector<const char*> bounds(ranges.size() + 1, end);
+    bounds[0] = begin;
+    for (size_t i = 1; i < ranges.size(); ++i) {
+        const char* p = std::max(begin + ranges[i].begin, bounds[i - 1]);
+        const char* newline = static_cast<const char*>(std::memchr(p, '\n', static_cast<size_t>(end - p)));
+        bounds[i] = newline ? newline + 1 : end;
+    }
+    
+    // 需要按行号筛选时先并行统计每块的行数
+    const bool limited = skipLines > 0 || maxLines != ALL_LINES;
+    std::vector<size_t> firstLine(ranges.size(), 0);
+    if (limited) {
+        std::vector<size_t> lines(ranges.size(), 0);
+        Parallel::forEach(ranges, [&](const Parallel::Range& range) {
+            lines[range.index] = static_cast<size_t>(std::count(bounds[range.index], bounds[range.index + 1], '\n'));
+        });
+        for (size_t i = 1; i < ranges.size(); ++i) {
+            firstLine[i] = firstLine[i - 1] + lines[i - 1];
+        }
+    }
+    const size_t lastLine = maxLines == ALL_LINES ? ALL_LINES : skipLines + maxLines;
+    
+    std::mutex progressMutex;
+    size_t parsed = 0;
+    std::vector<TextPart> parts(ranges.size());
+    Parallel::forEach(ranges, [&](const Parallel::Range& range) {
+        TextPart& part = parts[range.index];
+        const char* p = bounds[range.index];
+        const char* chunkEnd = bounds[range.index + 1];
+        size_t line = firstLine[range.index];
+        
+        while (p < chunkEnd && line < lastLine) {
+            const char* newline = static_cast<const char*>(std::memchr(p, '\n', static_cast<size_t>(chunkEnd - p)));
+            const char* lineEnd = newline ? newline : chunkEnd;
+            
+            PointValue value;
+            if (line >= skipLines && parseLine(p, lineEnd, fields, usedColumns, value)) {
+                part.points.push_back(value.point);
+                if (withIntensity) part.intensity.push_back(value.intensity);
+                if (withRGB) part.rgb.push_back(value.rgb);
+            }
+            p = newline ? newline + 1 : chunkEnd;
+            ++line;
+        }
+        
+        if (options.progress) {
+            std::lock_guard<std::mutex> lock(progressMutex);
+            parsed += static_cast<size_t>(bounds[range.index + 1] - bounds[range.index]);
+            options.progress(parsed, total);
+        }
+    });
+    
+    std::vector<size_t> offsets(parts.size() + 1, 0);
+    for (size_t i = 0; i < parts.size(); ++i) {
+        offsets[i + 1] = offsets[i] + parts[i].points.size();
+    }
+    cloud.points.resize(offsets.back());
+    if (withIntensity) cloud.intensity.resize(offsets.back());
+    if (withRGB) cloud.rgb.resize(offsets.back());
+    
+    Parallel::forEach(ranges, [&](const Parallel::Range& range) {
+        TextPart& part = parts[range.index];
+        const size_t offset = offsets[range.index];
+        std::copy(part.points.begin(), part.points.end(), cloud.points.begin() + offset);
+        if (withIntensity) std::copy(part.intensity.begin(), part.intensity.end(), cloud.intensity.begin() + offset);
+        if (withRGB) std::copy(part.rgb.begin(), part.rgb.end(), cloud.rgb.begin() + offset);
+        part = TextPart();
+        if (options.chunkDecoded && offsets[range.index + 1] > offset) {
+            reportChunks(options.chunkDecoded, offset, offsets[range.index + 1]);
+        }
+    });
+}
+
+/**
+ * @brief 文件头部按行解析，返回头部之后的数据起点
+ * @param data 文件内容
+ * @param size 文件大小
+ * @param isLast 判断当前行是否为头部最后一行
+ * @param lines 输出头部各行(不含换行符)
+ * @return 数据起点，头部不完整时为nullptr
+ */
+template<typename Predicate>
+const char* readHeaderLines(const char* data, size_t size, Predicate isLast, std::vector<std::string>& lines)
+{
+    const char* p = data;
+    const char* end = data + size;
+    while (p < end) {
+        const char* newline = static_cast<const char*>(std::memchr(p, '\n', static_cast<size_t>(end - p)));
+        if (!newline) {
+            return nullptr;
+        }
+        std::string line(p, newline);
+        if (!line.empty() && line.back() == '\r') {
+            line.pop_back();
+        }
+        lines.push_back(line);
+        p = newline + 1;
+        if (isLast(line)) {
+            return p;
+        }
+    }
+    return nullptr;
+}
+
+bool plyType(const std::string& name, ValueType& type)
+{
+    static const std::pair<const char*, ValueType> types[] = {
+        {"char", ValueType::Int8},     {"int8", ValueType::Int8},
+        {"uchar", ValueType::UInt8},   {"uint8", ValueType::UInt8},
+        {"short", ValueType::Int16},   {"int16", ValueType::Int16},
+        {"ushort", ValueType::UInt16}, {"uint16", ValueType::UInt16},
+        {"int", ValueType::Int32},     {"int32", ValueType::Int32},
+        {"uint", ValueType::UInt32},   {"uint32", ValueType::UInt32},
+        {"float", ValueType::Float32}, {"float32", ValueType::Float32},
+        {"double", ValueType::Float64}, {"float64", ValueType::Float64},
+    };
+    for (const auto& entry : types) {
+        if (name == entry.first) {
+            type = entry.second;
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+ * @brief PLY元素及其属性
+ */
+struct PlyProperty {
+    std::string name;
+    ValueType type = ValueType::Float32;
+    bool list = false;
+    ValueType countType = ValueType::UInt8;
+};
+
+struct PlyElement {
+    std::string name;
+    uint64_t count = 0;
+    std::vector<PlyProperty> properties;
+};
+
+// 二进制PLY中跳过一个元素的全部实例，返回之后的位置，越界时为nullptr
+const char* skipPlyElement(const PlyElement& element, const char* p, const char* end, bool swap)
+{
+    size_t fixedSize = 0;
+    bool hasList = false;
+    for (const PlyProperty& property : element.properties) {
+        hasList |= property.list;
+        fixedSize += valueSize(property.type);
+    }
+    if (!hasList) {
+        return element.count <= static_cast<uint64_t>(end - p) / std::max<size_t>(fixedSize, 1)
+            ? p + element.count * fixedSize : nullptr;
+    }
+    
+    for (uint64_t i = 0; i < element.count; ++i) {
+        for (const PlyProperty& property : element.properties) {
+            size_t length = valueSize(property.type);
+            if (property.list) {
+                if (static_cast<size_t>(end - p) < valueSize(property.countType)) {
+                    return nullptr;
+                }
+                double items = readValue(p, property.countType, swap);
+                p += valueSize(property.countType);
+                length = static_cast<size_t>(std::max(items, 0.0)) * valueSize(property.type);
+            }
+            if (static_cast<size_t>(end - p) < length) {
+                return nullptr;
+            }
+            p += length;
+        }
+    }
+    return p;
+}
+
+/**
+ * @brief PCD字段
+ */
+struct PcdField {
+    std::string name;
+    size_t size = 4;
+    char type = 'F';
+    size_t count = 1;
+};
+
+bool pcdType(const PcdField& field, ValueType& type)
+{
+    switch (field.type) {
+    case 'I':
+        if (field.size == 1) { type = ValueType::Int8; return true; }
+        if (field.size == 2) { type = ValueType::Int16; return true; }
+        if (field.size == 4) { type = ValueType::Int32; return true; }
+        return false;
+    case 'U':
+        if (field.size == 1) { type = ValueType::UInt8; return true; }
+        if (field.size == 2) { type = ValueType::UInt16; return true; }
+        if (field.size == 4) { type = ValueType::UInt32; return true; }
+        return false;
+    case 'F':
+        if (field.size == 4) { type = ValueType::Float32; return true; }
+        if (field.size == 8) { type = ValueType::Float64; return true; }
+        return false;
+    default:
+        return false;
+    }
+}
+
+/**
+ * @brief LZF解压(PCD binary_compressed使用的格式)
+ * @return 输入完整且恰好填满输出时为true
+ */
+bool lzfDecompress(const uint8_t* in, size_t inLength, uint8_t* out, size_t outLength)
+{
+    const uint8_t* ip = in;
+    const uint8_t* inEnd = in + inLength;
+    uint8_t* op = out;
+    uint8_t* outEnd = out + outLength;
+    
+    while (ip < inEnd) {
+        size_t control = *ip++;
+        if (control < 32) {
+            // 字面量：之后control + 1个字节原样复制
+            size_t length = control + 1;
+            if (length > static_cast<size_t>(inEnd - ip) || length > static_cast<size_t>(outEnd - op)) {
+                return false;
+            }
+            std::memcpy(op, ip, length);
+            op += length;
+            ip += length;
+        } else {
+            // 回溯引用：从已输出的数据中复制，源和目标可能重叠，只能逐字节复制
+            size_t length = control >> 5;
+            if (length == 7) {
+                if (ip == inEnd) {
+                    return false;
+                }
+                length += *ip++;
+            }
+            if (ip == inEnd) {
+                return false;
+            }
+            size_t distance = ((control & 0x1F) << 8) + *ip++ + 1;
+            length += 2;
+            if (distance > static_cast<size_t>(op - out) || length > static_cast<size_t>(outEnd - op)) {
+                return false;
+            }
+            const uint8_t* ref = op - distance;
+            for (size_t i = 0; i < length; ++i) {
+                *op++ = *ref++;
+            }
+        }
+    }
+    return op == outEnd;
+}
+
+// 按maxPoints等间隔保留点(原地压缩)
+void keepEvenly(PointCloud& cloud, size_t maxPoints)
+{
+    if (maxPoints == 0 || cloud.size() <= maxPoints) {
+        return;
+    }
+    
+    const double step = static_cast<double>(cloud.size()) / static_cast<double>(maxPoints);
+    for (size_t i = 0; i < maxPoints; ++i) {
+        size_t index = static_cast<size_t>(static_cast<double>(i) * step);
+        cloud.points[i] = cloud.points[index];
+        if (!cloud.intensity.empty()) cloud.intensity[i] = cloud.intensity[index];
+        if (!cloud.rgb.empty()) cloud.rgb[i] = cloud.rgb[index];
+    }
+    cloud.points.resize(maxPoints);
+    if (!cloud.intensity.empty()) cloud.intensity.resize(maxPoints);
+    if (!cloud.rgb.empty()) cloud.rgb.resize(maxPoints);
+    cloud.points.shrink_to_fit();
+    cloud.computeBounds();
+}
+
+std::string lowerExtension(const std::string& filename)
+{
+    size_t dot = filename.find_last_of('.');
+    size_t slash = filename.find_last_of("/\\");
+    if (dot == std::string::npos || (slash != std::string::npos && dot < slash)) {
+        return std::string();
+    }
+    std::string ext = filename.substr(dot + 1);
+    std::transform(ext.begin(), ext.end(), ext.begin(),
+                   [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+    return ext;
+}
+
+} // namespace
+
+PointCloudIO::Format PointCloudIO::formatOf(const std::string& filename)
+{
+    const std::string ext = lowerExtension(filename);
+    if (ext == "las" || ext == "laz") return Format::LAS;
+    if (ext == "ply") return Format::PLY;
+    if (ext == "pcd") return Format::PCD;
+    if (ext == "xyz" || ext == "txt" || ext == "csv" || ext == "pts") return Format::XYZ;
+    return Format::Unknown;
+}
+
+const char* PointCloudIO::fileFilter()
+{
+    return "Point Cloud Files (*.las *.laz *.ply *.pcd *.xyz *.txt *.csv *.pts);;"
+           "LAS Files (*.las *.laz);;PLY Files (*.ply);;PCD Files (*.pcd);;"
+           "Text Files (*.xyz *.txt *.csv *.pts);;All Files (*.*)";
+}
+
+bool PointCloudIO::read(const std::string& filename, PointCloud& cloud, const LASReadOptions& options)
+{
+    const Format format = formatOf(filename);
+    if (format == Format::LAS) {
+        return LASIO::readLAS(filename, cloud, options);
+    }
+    if (format == Format::Unknown) {
+        std::cerr << "不支持的点云文件格式: " << filename << std::endl;
+        return false;
+    }
+    
+    // 整个文件解析后再抽稀，因此缓存总是对应整个文件
+    const unsigned attributes = options.attributes & SUPPORTED_ATTRIBUTES;
+    
+    // 解析时逐块报告已完成的区间；抽稀会移动点，此时和读取缓存时一样在最后分段报告全部点
+    LASReadOptions decodeOptions = options;
+    if (options.maxPoints > 0) {
+        decodeOptions.chunkDecoded = nullptr;
+    }
+    bool reported = false;
+    
+    if (options.useCache && PointCloudCache::load(filename, cloud, attributes)) {
+        std::cout << "从缓存加载 " << cloud.points.size() << " 个点: " << PointCloudCache::cachePath(filename)
+                  << std::endl;
+    } else {
+        bool ok = false;
+        switch (format) {
+        case Format::PLY: ok = readPLY(filename, cloud, decodeOptions); break;
+        case Format::PCD: ok = readPCD(filename, cloud, decodeOptions); break;
+        case Format::XYZ: ok = readXYZ(filename, cloud, decodeOptions); break;
+        default: break;
+        }
+        reported = static_cast<bool>(decodeOptions.chunkDecoded);
+        if (!ok) {
+            cloud.clear();
+            return false;
+        }
+        
+        cloud.computeBounds();
+        if (options.useCache && !cloud.empty() && !PointCloudCache::save(filename, cloud, attributes)) {
+            std::cerr << "无法写入点云缓存: " << PointCloudCache::cachePath(filename) << std::endl;
+        }
+    }
+    
+    keepEvenly(cloud, options.maxPoints);
+    if (!reported && options.chunkDecoded && !cloud.empty()) {
+        reportChunks(options.chunkDecoded, 0, cloud.size());
+    }
+    std::cout << "成功读取 " << cloud.points.size() << " 个点" << std::endl;
+    return !cloud.empty();
+}
+
+bool PointCloudIO::probe(const std::string& filename, PointCloudSummary& summary, PointCloud& preview,
+                         size_t previewPoints)
+{
+    summary = PointCloudSummary();
+    preview.clear();
+    if (formatOf(filename) != Format::LAS) {
+        return false;
+    }
+    
+    LASFile file;
+    if (!file.open(filename)) {
+        return false;
+    }
+    
+    const LASHeader& h = file.header();
+    summary.format = "LAS " + std::to_string(h.version_major) + "." + std::to_string(h.version_minor)
+                   + " 点格式" + std::to_string(h.point_format) + (h.compressed ? " (LAZ压缩)" : "");
+    summary.pointCount = h.num_point_records;
+    summary.bounds = Eigen::AlignedBox3d(Eigen::Vector3d(h.min_x, h.min_y, h.min_z),
+                                         Eigen::Vector3d(h.max_x, h.max_y, h.max_z));
+    
+    // 等间隔取若干段连续记录，段数固定，每段只触及映射区中很小的一块
+    const uint64_t n = file.pointCount();
+    std::vector<LASRecordRun> runs;
+    if (previewPoints >= n) {
+        runs.push_back({0, n});
+    } else if (previewPoints > 0) {
+        const uint64_t numRuns = std::min<uint64_t>(PROBE_RUNS, previewPoints);
+        const uint64_t runLength = previewPoints / numRuns;
+        for (uint64_t i = 0; i < numRuns; ++i) {
+            runs.push_back({i * (n - runLength) / std::max<uint64_t>(numRuns - 1, 1), runLength});
+        }
+    }
+    
+    file.advise(0, file.fileSize(), MappedFile::Access::Random);
+    return file.readRuns(preview, runs);
+}
+
+bool PointCloudIO::readPLY(const std::string& filename, PointCloud& cloud, const LASReadOptions& options)
+{
+    cloud.clear();
+    MappedFile file;
+    if (!file.open(filename)) {
+        std::cerr << "无法打开文件: " << filename << std::endl;
+        return false;
+    }
+    
+    std::vector<std::string> lines;
+    const char* data = readHeaderLines(file.data(), file.size(),
+                                       [](const std::string& line) { return line == "end_header"; }, lines);
+    if (!data || lines.empty() || lines.front() != "ply") {
+        std::cerr << "不是有效的PLY文件: " << filename << std::endl;
+        return false;
+    }
+    
+    std::string encoding;
+    std::vector<PlyElement> elements;
+    for (const std::string& line : lines) {
+        std::istringstream stream(line);
+        std::string keyword;
+        stream >> keyword;
+        if (keyword == "format") {
+            stream >> encoding;
+        } else if (keyword == "element") {
+            PlyElement element;
+            stream >> element.name >> element.count;
+            elements.push_back(element);
+        } else if (keyword == "property" && !elements.empty()) {
+            PlyProperty property;
+            std::string type;
+            stream >> type;
+            bool ok = true;
+            if (type == "list") {
+                std::string countType;
+                property.list = true;
+                stream >> countType >> type;
+                ok = plyType(countType, property.countType);
+            }
+            ok = ok && plyType(type, property.type);
+            stream >> property.name;
+            if (!ok) {
+                std::cerr << "不支持的PLY属性类型: " << line << std::endl;
+                return false;
+            }
+            elements.back().properties.push_back(property);
+        }
+    }
+    
+    const bool ascii = encoding == "ascii";
+    const bool swap = encoding == "binary_big_endian";
+    if (!ascii && !swap && encoding != "binary_little_endian") {
+        std::cerr << "不支持的PLY编码: " << encoding << std::endl;
+        return false;
+    }
+    
+    auto vertex = std::find_if(elements.begin(), elements.end(),
+                               [](const PlyElement& element) { return element.name == "vertex"; });
+    if (vertex == elements.end()) {
+        std::cerr << "PLY文件中没有vertex元素: " << filename << std::endl;
+        return false;
+    }
+    
+    std::vector<Field> fields;
+    size_t recordSize = 0;
+    for (const PlyProperty& property : vertex->properties) {
+        if (property.list) {
+            std::cerr << "不支持vertex元素中的列表属性: " << property.name << std::endl;
+            return false;
+        }
+        Field field;
+        field.target = targetOf(property.name);
+        field.type = property.type;
+        field.stride = recordSize;      // 先记录字段偏移，确定记录长度后再换算
+        recordSize += valueSize(property.type);
+        fields.push_back(field);
+    }
+    if (!hasXYZ(fields)) {
+        std::cerr << "PLY顶点缺少x/y/z属性: " << filename << std::endl;
+        return false;
+    }
+    
+    const char* end = file.data() + file.size();
+    const size_t count = static_cast<size_t>(vertex->count);
+    std::cout << "PLY文件: " << count << " 个顶点 (" << encoding << ")" << std::endl;
+    
+    if (ascii) {
+        // 文本中每个元素实例占一行，vertex之前的元素按行数跳过
+        size_t skipLines = 0;
+        for (auto element = elements.begin(); element != vertex; ++element) {
+            skipLines += static_cast<size_t>(element->count);
+        }
+        parseText(data, end, fields, skipLines, count, cloud, options);
+        return true;
+    }
+    
+    file.advise(static_cast<size_t>(data - file.data()), static_cast<size_t>(end - data),
+                MappedFile::Access::Sequential);
+    for (auto element = elements.begin(); element != vertex && data; ++element) {
+        data = skipPlyElement(*element, data, end, swap);
+    }
+    if (!data || count > static_cast<size_t>(end - data) / std::max<size_t>(recordSize, 1)) {
+        std::cerr << "PLY文件数据不完整: " << filename << std::endl;
+        return false;
+    }
+    
+    for (Field& field : fields) {
+        field.base = data + field.stride;
+        field.stride = recordSize;
+    }
+    decodeBinary(fields, swap, count, cloud, options);
+    return true;
+}
+
+bool PointCloudIO::readPCD(const std::string& filename, PointCloud& cloud, const LASReadOptions& options)
+{
+    cloud.clear();
+    MappedFile file;
+    if (!file.open(filename)) {
+        std::cerr << "无法打开文件: " << filename << std::endl;
+        return false;
+    }
+    
+    std::vector<std::string> lines;
+    const char* data = readHeaderLines(file.data(), file.size(),
+                                       [](const std::string& line) { return line.compare(0, 4, "DATA") == 0; },
+                                       lines);
+    if (!data) {
+        std::cerr << "不是有效的PCD文件: " << filename << std::endl;
+        return false;
+    }
+    
+    std::vector<PcdField> pcdFields;
+    size_t width = 0, height = 1, points = 0;
+    std::string encoding;
+    for (const std::string& line : lines) {
+        std::istringstream stream(line);
+        std::string keyword;
+        stream >> keyword;
+        if (keyword == "FIELDS" || keyword == "COLUMNS") {
+            std::string name;
+            while (stream >> name) {
+                pcdFields.push_back({name, 4, 'F', 1});
+            }
+        } else if (keyword == "SIZE") {
+            for (PcdField& field : pcdFields) stream >> field.size;
+        } else if (keyword == "TYPE") {
+            for (PcdField& field : pcdFields) stream >> field.type;
+        } else if (keyword == "COUNT") {
+            for (PcdField& field : pcdFields) stream >> field.count;
+        } else if (keyword == "WIDTH") {
+            stream >> width;
+        } else if (keyword == "HEIGHT") {
+            stream >> height;
+        } else if (keyword == "POINTS") {
+            stream >> points;
+        } else if (keyword == "DATA") {
+            stream >> encoding;
+        }
+    }
+    const size_t count = points > 0 ? points : width * height;
+    
+    // 文本中COUNT大于1的字段占多列，二进制中占size * count字节，只取第一个分量
+    std::vector<Field> fields;
+    std::vector<Field> columns;
+    size_t recordSize = 0;
+    for (const PcdField& pcdField : pcdFields) {
+        Field field;
+        field.target = targetOf(pcdField.name);
+        if (field.target != Target::Skip && !pcdType(pcdField, field.type)) {
+            std::cerr << "不支持的PCD字段类型: " << pcdField.name << std::endl;
+            return false;
+        }
+        field.stride = recordSize;
+        recordSize += pcdField.size * pcdField.count;
+        fields.push_back(field);
+        
+        columns.push_back(field);
+        for (size_t i = 1; i < pcdField.count; ++i) {
+            columns.push_back(Field());
+        }
+    }
+    if (!hasXYZ(fields)) {
+        std::cerr << "PCD文件缺少x/y/z字段: " << filename << std::endl;
+        return false;
+    }
+    
+    const char* end = file.data() + file.size();
+    std::cout << "PCD文件: " << count << " 个点 (" << encoding << ")" << std::endl;
+    
+    if (encoding == "ascii") {
+        parseText(data, end, columns, 0, count, cloud, options);
+        return true;
+    }
+    
+    if (encoding == "binary") {
+        if (count > static_cast<size_t>(end - data) / std::max<size_t>(recordSize, 1)) {
+            std::cerr << "PCD文件数据不完整: " << filename << std::endl;
+            return false;
+        }
+        file.advise(static_cast<size_t>(data - file.data()), static_cast<size_t>(end - data),
+                    MappedFile::Access::Sequential);
+        for (Field& field : fields) {
+            field.base = data + field.stride;
+            field.stride = recordSize;
+        }
+        decodeBinary(fields, false, count, cloud, options);
+        return true;
+    }
+    
+    if (encoding == "binary_compressed") {
+        // 压缩数据前是压缩后和解压后的字节数，解压后按字段依次存放所有点的值
+        if (end - data < 8) {
+            std::cerr << "PCD文件数据不完整: " << filename << std::endl;
+            return false;
+        }
+        uint32_t compressedSize = 0, uncompressedSize = 0;
+        std::memcpy(&compressedSize, data, 4);
+        std::memcpy(&uncompressedSize, data + 4, 4);
+        if (compressedSize > static_cast<size_t>(end - data) - 8 || uncompressedSize != count * recordSize) {
+            std::cerr << "PCD压缩数据长度不匹配: " << filename << std::endl;
+            return false;
+        }
+        
+        std::vector<char> buffer(uncompressedSize);
+        if (!lzfDecompress(reinterpret_cast<const uint8_t*>(data + 8), compressedSize,
+                           reinterpret_cast<uint8_t*>(buffer.data()), buffer.size())) {
+            std::cerr << "PCD压缩数据已损坏: " << filename << std::endl;
+            return false;
+        }
+        
+        for (size_t i = 0; i < fields.size(); ++i) {
+            const size_t fieldSize = pcdFields[i].size * pcdFields[i].count;
+            fields[i].base = buffer.data() + fields[i].stride * count;
+            fields[i].stride = fieldSize;
+        }
+        decodeBinary(fields, false, count, cloud, options);
+        return true;
+    }
+    
+    std::cerr << "不支持的PCD数据编码: " << encoding << std::endl;
+    return false;
+}
+
+bool PointCloudIO::readXYZ(const std::string& filename, PointCloud& cloud, const LASReadOptions& options)
+{
+    cloud.clear();
+    MappedFile file;
+    if (!file.open(filename)) {
+        std::cerr << "无法打开文件: " << filename << std::endl;
+        return false;
+    }
+    
+    const char* begin = file.data();
+    const char* end = begin + file.size();
+    
+    // 第一条至少有三个数字的行决定列数(跳过表头和PTS的点数行)
+    size_t numColumns = 0;
+    for (const char* p = begin; p < end && numColumns < 3;) {
+        const char* newline = static_cast<const char*>(std::memchr(p, '\n', static_cast<size_t>(end - p)));
+        const char* lineEnd = newline ? newline : end;
+        numColumns = 0;
+        const char* q = p;
+        for (;;) {
+            while (q < lineEnd && isSeparator(*q)) {
+                ++q;
+            }
+            if (q == lineEnd) {
+                break;
+            }
+            double number = 0.0;
+            std::from_chars_result result = std::from_chars(*q == '+' ? q + 1 : q, lineEnd, number);
+            if (result.ec != std::errc()) {
+                break;
+            }
+            ++numColumns;
+            q = result.ptr;
+        }
+        p = newline ? newline + 1 : end;
+    }
+    if (numColumns < 3) {
+        std::cerr << "文本中没有找到x y z坐标: " << filename << std::endl;
+        return false;
+    }
+    
+    std::vector<Field> fields(3);
+    fields[0].target = Target::X;
+    fields[1].target = Target::Y;
+    fields[2].target = Target::Z;
+    if (numColumns == 4 || numColumns >= 7) {
+        fields.push_back(Field());
+        fields.back().target = Target::Intensity;
+    }
+    if (numColumns >= 6) {
+        for (Target target : {Target::Red, Target::Green, Target::Blue}) {
+            fields.push_back(Field());
+            fields.back().target = target;
+            fields.back().type = ValueType::UInt8;
+        }
+    }
+    std::cout << "文本点云: 每行 " << numColumns << " 列" << std::endl;
+    
+    file.advise(0, file.size(), MappedFile::Access::Sequential);
+    parseText(begin, end, fields, 0, ALL_LINES, cloud, options);
+    return true;
+}
@@ -0,0 +1,82 @@
+#ifndef POINTCLOUDIO_H
+#define POINTCLOUDIO_H
+
+#include <string>
+#include "lasio.h"
+
+/**
+ * @brief 只读头部和少量记录得到的文件概况
+ */
+struct PointCloudSummary {
+    std::string format;             // 例如"LAS 1.4 点格式6 (LAZ压缩)"
+    uint64_t pointCount = 0;        // 头部记录的点数
+    Eigen::AlignedBox3d bounds;     // 头部记录的包围盒
+};
+
+/**
+ * @brief 按扩展名选择读取器的点云加载入口
+ *
+ * LAS/LAZ交给LASIO，另外支持:
+ * - PLY: ascii、binary_little_endian和binary_big_endian，读取vertex元素；
+ * - PCD: ascii、binary和binary_compressed(LZF压缩、按字段存放)；
+ * - XYZ/TXT/CSV/PTS文本: 每行x y z，4列时第4列为强度，6列时后3列为RGB，
+ *   7列及以上时依次为强度和RGB(文本颜色按8位解释)，无法解析的行(表头、点数行)被跳过。
+ *
+ * 文件整体映射到内存。二进制数据直接从映射区按字段并行解码；文本数据按行边界切分成块，
+ * 每块用std::from_chars并行解析。读取的属性限于XYZ、强度和RGB，结果不带来源编码，
+ * 写回LAS时按已有属性选择点格式。
+ */
+class PointCloudIO
+{
+public:
+    /**
+     * @brief 支持的文件格式
+     */
+    enum class Format {
+        Unknown,
+        LAS,    // .las和.laz
+        PLY,
+        PCD,
+        XYZ     // .xyz、.txt、.csv和.pts
+    };
+    
+    // 按扩展名判断格式(不区分大小写)
+    static Format formatOf(const std::string& filename);
+    
+    // 文件对话框使用的过滤器
+    static const char* fileFilter();
+    
+    /**
+     * @brief 读取点云文件(会清空原有数据)
+     *
+     * LAS/LAZ的选项语义与LASIO::readLAS相同。其他格式读取整个文件(整体读取时同样使用
+     * PointCloudCache)，之后按maxPoints等间隔保留点，first、stride和采样方式被忽略；
+     * 进度回调的参数是已解析的点数(文本格式为字节数)和总数。
+     * @param filename 文件路径
+     * @param cloud 输出点云对象
+     * @param options 读取选项
+     * @return 是否成功
+     */
+    static bool read(const std::string& filename, PointCloud& cloud,
+                     const LASReadOptions& options = LASReadOptions());
+    
+    /**
+     * @brief 快速探查文件：解析头部并读取稀疏的预览点
+     *
+     * 预览点取自整个文件上等间隔的若干段连续记录，每段只涉及一次小范围读取，
+     * 耗时与文件大小基本无关。目前支持LAS/LAZ，其他格式返回false。
+     * @param filename 文件路径
+     * @param summary 输出的文件概况
+     * @param preview 输出的预览点(只有XYZ)
+     * @param previewPoints 预览点数
+     * @return 是否成功
+     */
+    static bool probe(const std::string& filename, PointCloudSummary& summary, PointCloud& preview,
+                      size_t previewPoints = 8192);
+    
+    static bool readPLY(const std::string& filename, PointCloud& cloud, const LASReadOptions& options);
+    static bool readPCD(const std::string& filename, PointCloud& cloud, const LASReadOptions& options);
+    static bool readXYZ(const std::string& filename, PointCloud& cloud, const LASReadOptions& options);
+};
+
+#endif // POINTCLOUDIO_H
@@ -0,0 +1,295 @@
+#include "tiledataset.h"
+#include "laspointformats.h"
+#include "parallel.h"
+#include <filesystem>
+#include <iostream>
+#include <algorithm>
+#include <cctype>
+#include <mutex>
+
+namespace {
+
+// 合并加载时每个解码任务的点数，小分块整体作为一个任务
+constexpr size_t TILE_JOB_POINTS = 262144;
+
+// 是否为LAS/LAZ文件(按扩展名，不区分大小写)
+bool isTileFile(const std::filesystem::path& path)
+{
+    std::string ext = path.extension().u8string();
+    std::transform(ext.begin(), ext.end(), ext.begin(),
+                   [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+    return ext == ".las" || ext == ".laz";
+}
+
+// 展开目录，得到分块文件列表
+std::vector<std::string> expandPaths(const std::vector<std::string>& paths)
+{
+    std::vector<std::string> files;
+    for (const std::string& path : paths) {
+        std::error_code error;
+        const std::filesystem::path p = std::filesystem::u8path(path);
+        if (!std::filesystem::is_directory(p, error)) {
+            files.push_back(path);
+            continue;
+        }
+        
+        std::vector<std::string> entries;
+        for (const auto& entry : std::filesystem::directory_iterator(p, error)) {
+            if (entry.is_regular_file(error) && isTileFile(entry.path())) {
+                entries.push_back(entry.path().u8string());
+            }
+        }
+        if (error) {
+            std::cerr << "无法读取目录: " << path << std::endl;
+        }
+        std::sort(entries.begin(), entries.end());
+        files.insert(files.end(), entries.begin(), entries.end());
+    }
+    return files;
+}
+
+// 每点占用的内存字节数
+size_t bytesPerPoint(unsigned attributes, size_t recordFieldsSize, size_t extraBytesSize)
+{
+    size_t bytes = sizeof(Point3D);
+    if (attributes & LASAttribute::Intensity) bytes += sizeof(uint16_t);
+    if (attributes & LASAttribute::RGB) bytes += sizeof(PointColor);
+    if (attributes & LASAttribute::GPSTime) bytes += sizeof(double);
+    if (attributes & LASAttribute::Classification) bytes += sizeof(uint8_t);
+    if (attributes & LASAttribute::RecordFields) bytes += recordFieldsSize;
+    if (attributes & LASAttribute::ExtraBytes) bytes += extraBytesSize;
+    return bytes;
+}
+
+// 跨步stride时一个分块读取的点数
+size_t stridedCount(uint64_t pointCount, size_t stride)
+{
+    return static_cast<size_t>((pointCount + stride - 1) / stride);
+}
+
+} // namespace
+
+size_t TileDataset::add(const std::string& path)
+{
+    return add(std::vector<std::string>{path});
+}
+
+size_t TileDataset::add(const std::vector<std::string>& paths)
+{
+    const std::vector<std::string> files = expandPaths(paths);
+    std::vector<TileInfo> tiles(files.size());
+    std::vector<char> parsed(files.size(), 0);
+    
+    // 打开文件只映射并解析头部，数百个分块也可以很快完成
+    std::vector<Parallel::Range> ranges = Parallel::splitRange(files.size(), 1);
+    Parallel::forEach(ranges, [&](const Parallel::Range& range) {
+        for (size_t i = range.begin; i < range.end; ++i) {
+            LASFile file;
+            if (!file.open(files[i])) {
+                continue;
+            }
+            const LASHeader& h = file.header();
+            TileInfo& tile = tiles[i];
+            tile.filename = files[i];
+            tile.pointCount = file.pointCount();
+            tile.bounds = Eigen::AlignedBox3d(Eigen::Vector3d(h.min_x, h.min_y, h.min_z),
+                                              Eigen::Vector3d(h.max_x, h.max_y, h.max_z));
+            tile.pointFormat = h.point_format;
+            tile.extraBytesSize = file.extraBytesSize();
+            tile.attributes = file.availableAttributes();
+            parsed[i] = 1;
+        }
+    });
+    
+    size_t added = 0;
+    for (size_t i = 0; i < files.size(); ++i) {
+        if (parsed[i]) {
+            m_tiles.push_back(std::move(tiles[i]));
+            ++added;
+        } else {
+            std::cerr << "跳过无法解析的分块: " << files[i] << std::endl;
+        }
+    }
+    return added;
+}
+
+uint64_t TileDataset::pointCount() const
+{
+    uint64_t count = 0;
+    for (const TileInfo& tile : m_tiles) {
+        count += tile.pointCount;
+    }
+    return count;
+}
+
+Eigen::AlignedBox3d TileDataset::bounds() const
+{
+    Eigen::AlignedBox3d box;
+    for (const TileInfo& tile : m_tiles) {
+        box.extend(tile.bounds);
+    }
+    return box;
+}
+
+std::vector<size_t> TileDataset::select(const Eigen::AlignedBox3d& bbox) const
+{
+    std::vector<size_t> selected;
+    for (size_t i = 0; i < m_tiles.size(); ++i) {
+        if (m_tiles[i].pointCount > 0 && (bbox.isEmpty() || bbox.intersects(m_tiles[i].bounds))) {
+            selected.push_back(i);
+        }
+    }
+    return selected;
+}
+
+bool TileDataset::load(PointCloud& cloud, const TileLoadOptions& options) const
+{
+    cloud.clear();
+    
+    const std::vector<size_t> selected = select(options.bbox);
+    if (selected.empty()) {
+        std::cerr << "数据集中没有与包围盒相交的分块" << std::endl;
+        return false;
+    }
+    
+    // 只读取至少一个分块能提供的属性，原始标准字段和额外字节要求所有分块格式和长度一致
+    unsigned available = 0;
+    bool sameFormat = true;
+    const TileInfo& front = m_tiles[selected.front()];
+    for (size_t t : selected) {
+        const TileInfo& tile = m_tiles[t];
+        available |= tile.attributes;
+        sameFormat = sameFormat && tile.pointFormat == front.pointFormat
+                  && tile.extraBytesSize == front.extraBytesSize;
+    }
+    unsigned attributes = options.attributes & available;
+    if (!sameFormat) {
+        attributes &= ~static_cast<unsigned>(LASAttribute::RecordFields);
+    }
+    if (!sameFormat || front.extraBytesSize == 0) {
+        attributes &= ~static_cast<unsigned>(LASAttribute::ExtraBytes);
+    }
+    const size_t fieldsSize = (attributes & LASAttribute::RecordFields)
+                            ? LASFormat::formatInfo(front.pointFormat).recordFieldsSize() : 0;
+    const size_t extraSize = (attributes & LASAttribute::ExtraBytes) ? front.extraBytesSize : 0;
+    
+    // 超过内存上限时增大跨步，直到各分块读取的点数之和不超过预算
+    uint64_t availablePoints = 0;
+    for (size_t t : selected) {
+        availablePoints += m_tiles[t].pointCount;
+    }
+    size_t stride = 1;
+    if (options.memoryLimit > 0) {
+        const uint64_t budget = std::max<uint64_t>(options.memoryLimit / bytesPerPoint(attributes, fieldsSize, extraSize), 1);
+        if (availablePoints > budget) {
+            stride = static_cast<size_t>((availablePoints + budget - 1) / budget);
+            for (;; ++stride) {
+                uint64_t count = 0;
+                for (size_t t : selected) {
+                    count += stridedCount(m_tiles[t].pointCount, stride);
+                }
+                if (count <= budget) {
+                    break;
+                }
+            }
+        }
+    }
+    
+    // 各分块在合并点云中的起始位置(末尾元素为总点数)
+    std::vector<size_t> offsets(selected.size() + 1, 0);
+    for (size_t i = 0; i < selected.size(); ++i) {
+        offsets[i + 1] = offsets[i] + stridedCount(m_tiles[selected[i]].pointCount, stride);
+    }
+    const size_t total = offsets.back();
+    
+    std::vector<LASFile> files(selected.size());
+    std::vector<char> opened(selected.size(), 0);
+    std::vector<Parallel::Range> fileRanges = Parallel::splitRange(selected.size(), 1);
+    Parallel::forEach(fileRanges, [&](const Parallel::Range& range) {
+        for (size_t i = range.begin; i < range.end; ++i) {
+            // 分块在添加后被修改时点数会不一致，按头部重新检查
+            opened[i] = files[i].open(m_tiles[selected[i]].filename)
+                     && files[i].pointCount() == m_tiles[selected[i]].pointCount;
+            if (opened[i]) {
+                files[i].advise(0, files[i].fileSize(),
+                                stride == 1 ? MappedFile::Access::Sequential : MappedFile::Access::Random);
+            }
+        }
+    });
+    for (size_t i = 0; i < selected.size(); ++i) {
+        if (!opened[i]) {
+            std::cerr << "分块已不可读或已被修改: " << m_tiles[selected[i]].filename << std::endl;
+            return false;
+        }
+    }
+    
+    std::cout << "数据集: 选中 " << selected.size() << " / " << m_tiles.size() << " 个分块，读取 "
+              << total << " / " << availablePoints << " 个点";
+    if (stride > 1) {
+        std::cout << " (内存上限跨步 " << stride << ")";
+    }
+    std::cout << std::endl;
+    
+    // 所有分块切成小段统一交给线程池，小分块之间也能并行
+    std::vector<Parallel::Range> jobs;
+    std::vector<size_t> jobTile;
+    for (size_t i = 0; i < selected.size(); ++i) {
+        for (size_t begin = offsets[i]; begin < offsets[i + 1]; begin += TILE_JOB_POINTS) {
+            jobs.push_back({jobs.size(), begin, std::min(begin + TILE_JOB_POINTS, offsets[i + 1])});
+            jobTile.push_back(i);
+        }
+    }
+    
+    LASFormat::DecodeTarget output = LASFormat::prepareTarget(cloud, total, attributes, extraSize, fieldsSize);
+    
+    // 裁剪会移动点，此时在最后分段报告全部点
+    const bool crop = options.cropToBox && !options.bbox.isEmpty();
+    const bool reportJobs = options.chunkDecoded && !crop;
+    std::mutex progressMutex;
+    size_t decoded = 0;
+    bool ok = true;
+    
+    Parallel::forEach(jobs, [&](const Parallel::Range& job) {
+        const size_t i = jobTile[job.index];
+        const size_t first = (job.begin - offsets[i]) * stride;
+        bool jobOk = files[i].decodeRange(output.at(job.begin), first, job.end - job.begin, stride);
+        
+        {
+            std::lock_guard<std::mutex> lock(progressMutex);
+            if (!jobOk) {
+                if (ok) {
+                    std::cerr << "分块解码失败: " << files[i].filename() << std::endl;
+                }
+                ok = false;
+                return;
+            }
+            decoded += job.end - job.begin;
+            if (options.progress) {
+                options.progress(decoded, total);
+            }
+        }
+        
+        // 在锁外报告，接收者可能等待或复制这些点，不阻塞其它解码任务
+        if (reportJobs) {
+            reportChunks(options.chunkDecoded, job.begin, job.end);
+        }
+    });
+    
+    if (!ok) {
+        cloud.clear();
+        return false;
+    }
+    
+    if (sameFormat) {
+        cloud.encoding = files.front().encoding();
+    }
+    if (crop) {
+        cloud.crop(options.bbox);
+        if (options.chunkDecoded && !cloud.empty()) {
+            reportChunks(options.chunkDecoded, 0, cloud.size());
+        }
+    } else {
+        cloud.computeBounds();
+    }
+    return true;
+}
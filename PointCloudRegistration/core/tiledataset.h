@@ -0,0 +1,86 @@
+#ifndef TILEDATASET_H
+#define TILEDATASET_H
+
+#include <string>
+#include <vector>
+#include <cstdint>
+#include "lasio.h"
+
+/**
+ * @brief 数据集中的一个LAS/LAZ分块(只解析头部得到)
+ */
+struct TileInfo {
+    std::string filename;
+    uint64_t pointCount = 0;                    // 文件中实际可读的点数
+    Eigen::AlignedBox3d bounds;                 // 头部记录的包围盒
+    uint8_t pointFormat = 0;
+    uint16_t extraBytesSize = 0;
+    unsigned attributes = LASAttribute::XYZ;    // 点格式可以提供的属性
+};
+
+/**
+ * @brief 数据集加载选项
+ */
+struct TileLoadOptions {
+    Eigen::AlignedBox3d bbox;                   // 只加载头部包围盒与之相交的分块(空盒表示全部分块)
+    bool cropToBox = false;                     // 是否再删除包围盒外的点
+    size_t memoryLimit = 0;                     // 合并点云的内存上限(字节，0表示不限制)
+    unsigned attributes = LASAttribute::XYZ;    // 需要解码的属性，各分块格式都没有的属性被忽略
+    LASProgressCallback progress;               // 参数为已解码点数和总点数(可为空)
+    LASChunkCallback chunkDecoded;              // 参数为合并点云中已解码完成的区间(可为空)
+};
+
+/**
+ * @brief 由多个LAS/LAZ分块文件组成的数据集(例如按航带或网格切分的移动测量数据)
+ *
+ * 添加文件时只并行解析各分块的头部，记录点数和包围盒。加载时按包围盒筛选分块，
+ * 根据各分块点数一次分配合并点云的数组，再把所有分块切成小段交给线程池，
+ * 每段直接从映射区(或LAZ解压器)解码到合并点云中属于它的区间，不经过中间点云。
+ * 超过内存上限时对所有分块使用同一个跨步，保持点在整个数据集上的均匀分布。
+ */
+class TileDataset
+{
+public:
+    /**
+     * @brief 添加分块：目录时添加其中所有.las/.laz文件(不递归，按文件名排序)，否则添加文件本身
+     * @param path 文件或目录路径
+     * @return 成功解析头部的分块数
+     */
+    size_t add(const std::string& path);
+    
+    /**
+     * @brief 添加多个文件或目录(并行解析头部)
+     * @return 成功解析头部的分块数
+     */
+    size_t add(const std::vector<std::string>& paths);
+    
+    void clear() { m_tiles.clear(); }
+    bool empty() const { return m_tiles.empty(); }
+    
+    const std::vector<TileInfo>& tiles() const { return m_tiles; }
+    
+    // 所有分块的点数之和
+    uint64_t pointCount() const;
+    
+    // 所有分块头部包围盒的并集
+    Eigen::AlignedBox3d bounds() const;
+    
+    // 头部包围盒与bbox相交的分块序号(空盒时返回全部分块)
+    std::vector<size_t> select(const Eigen::AlignedBox3d& bbox) const;
+    
+    /**
+     * @brief 把选中的分块合并加载到一个点云(会清空原有数据)
+     *
+     * 各分块点格式和额外字节长度相同时沿用第一个分块的编码参数，否则不带来源编码，
+     * 额外字节只在所有分块长度一致时读取。
+     * @param cloud 输出点云对象
+     * @param options 筛选包围盒、内存上限、需要的属性和进度回调
+     * @return 是否成功(没有选中任何分块时为false)
+     */
+    bool load(PointCloud& cloud, const TileLoadOptions& options = TileLoadOptions()) const;
+
+private:
+    std::vector<TileInfo> m_tiles;
+};
+
+#endif // TILEDATASET_H
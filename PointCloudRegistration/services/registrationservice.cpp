@@ -1,19 +1,59 @@
 #include "registrationservice.h"
 #include "core/lasio.h"
+#include "core/pointcloudio.h"
+#include "core/tiledataset.h"
+#include "core/octree.h"
 #include <QFileInfo>
 #include <QDebug>
 #include <QtConcurrent>
+#include <QSemaphore>
+#include <algorithm>
+
+namespace {
+
+// 拾取索引叶节点的点数：比配准用的八叉树大，节点少、建立快，单次拾取仍远小于1毫秒
+constexpr int PICK_INDEX_LEAF_POINTS = 32;
+constexpr int PICK_INDEX_MAX_DEPTH = 20;
+
+// 流式加载时同时在途(已发出、查看器尚未上传完)的分块副本数，解码快于上传时工作线程等待，副本不会堆积
+constexpr int MAX_BATCHES_IN_FLIGHT = 4;
+
+// 复制点云中已解码完成的一段，没有空闲名额时等待，副本释放时归还名额
+PointBatch copyBatch(const PointCloud& cloud, size_t begin, size_t end, const std::shared_ptr<QSemaphore>& inFlight)
+{
+    inFlight->acquire();
+    PointBatch batch;
+    batch.first = begin;
+    batch.points.reset(new std::vector<Point3D>(cloud.points.begin() + begin, cloud.points.begin() + end),
+                       [inFlight](const std::vector<Point3D>* points) {
+        delete points;
+        inFlight->release();
+    });
+    return batch;
+}
+
+} // namespace
 
 RegistrationService::RegistrationService(QObject *parent)
     : QObject(parent)
     , m_sourceCloud(nullptr)
     , m_targetCloud(nullptr)
     , m_originalSourceCloud(nullptr)
+    , m_sourcePreview(nullptr)
+    , m_targetPreview(nullptr)
     , m_isRegistering(false)
     , m_sourceWatcher(nullptr)
     , m_targetWatcher(nullptr)
     , m_registrationWatcher(nullptr)
+    , m_exportWatcher(nullptr)
+    , m_pickIndexWatcher(nullptr)
+    , m_pickSourceCloud(nullptr)
+    , m_pickTargetCloud(nullptr)
+    , m_pickIndexPending(false)
 {
+    qRegisterMetaType<PointBatch>("PointBatch");
+    qRegisterMetaType<Eigen::AlignedBox3d>("Eigen::AlignedBox3d");
+    
     m_icpEngine = new ICPEngine(this);
     
     // 连接ICP引擎信号
@@ -36,36 +76,126 @@ RegistrationService::RegistrationService(QObject *parent)
     m_registrationWatcher = new QFutureWatcher<void>(this);
     connect(m_registrationWatcher, &QFutureWatcher<void>::finished,
             this, &RegistrationService::onRegistrationFinished);
+    
+    // 创建异步导出的Watcher
+    m_exportWatcher = new QFutureWatcher<bool>(this);
+    connect(m_exportWatcher, &QFutureWatcher<bool>::finished,
+            this, &RegistrationService::onExportFinished);
+    
+    // 后台建立拾取索引的Watcher
+    m_pickIndexWatcher = new QFutureWatcher<PickIndexes>(this);
+    connect(m_pickIndexWatcher, &QFutureWatcher<PickIndexes>::finished,
+            this, &RegistrationService::onPickIndexFinished);
 }
 
 RegistrationService::~RegistrationService()
 {
+    m_pickIndexWatcher->waitForFinished();
     if (m_sourceCloud) delete m_sourceCloud;
     if (m_targetCloud) delete m_targetCloud;
     if (m_originalSourceCloud) delete m_originalSourceCloud;
+    if (m_sourcePreview) delete m_sourcePreview;
+    if (m_targetPreview) delete m_targetPreview;
 }
 
-bool RegistrationService::loadSourceCloud(const QString& filename, size_t maxPoints)
+bool RegistrationService::probeCloud(const QString& filename, PointCloud*& preview, PointCloudSummary& summary)
+{
+    if (preview) {
+        delete preview;
+        preview = nullptr;
+    }
+    summary = PointCloudSummary();
+    
+    PointCloud* cloud = new PointCloud();
+    if (!PointCloudIO::probe(filename.toStdString(), summary, *cloud)) {
+        delete cloud;
+        return false;
+    }
+    preview = cloud;
+    return true;
+}
+
+bool RegistrationService::probeSourceCloud(const QString& filename)
 {
     if (m_sourceWatcher->isRunning()) {
         emit cloudLoadError("源点云正在加载中,请稍候...");
         return false;
     }
     
-    if (m_sourceCloud) {
-        delete m_sourceCloud;
-        m_sourceCloud = nullptr;
+    clearSourceCloud();
+    m_sourceFile = filename;
+    if (!probeCloud(filename, m_sourcePreview, m_sourceSummary)) {
+        return false;
+    }
+    
+    m_sourcePreview->color = QColor(255, 100, 100);  // 红色
+    emit sourceCloudProbed(filename, static_cast<qint64>(m_sourceSummary.pointCount));
+    return true;
+}
+
+bool RegistrationService::probeTargetCloud(const QString& filename)
+{
+    if (m_targetWatcher->isRunning()) {
+        emit cloudLoadError("目标点云正在加载中,请稍候...");
+        return false;
+    }
+    
+    clearTargetCloud();
+    m_targetFile = filename;
+    if (!probeCloud(filename, m_targetPreview, m_targetSummary)) {
+        return false;
+    }
+    
+    m_targetPreview->color = QColor(100, 100, 255);  // 蓝色
+    emit targetCloudProbed(filename, static_cast<qint64>(m_targetSummary.pointCount));
+    return true;
+}
+
+bool RegistrationService::loadSourceCloud(const QString& filename, size_t maxPoints, LASSampling sampling)
+{
+    if (m_sourceWatcher->isRunning()) {
+        emit cloudLoadError("源点云正在加载中,请稍候...");
+        return false;
     }
     
+    // 头部信息和预览点先同步显示，全部点在后台读取(不支持探查的格式只在后台读取)
+    probeSourceCloud(filename);
     m_sourceFile = filename;
     emit cloudLoadProgress("正在加载源点云，请稍候...");
     
-    // 异步加载
-    auto loadFunc = [filename, maxPoints]() -> PointCloud* {
+    // 异步加载(预计点数取头部点数，限制点数时不超过maxPoints)
+    const Eigen::AlignedBox3d bounds = m_sourceSummary.bounds;
+    qint64 expected = static_cast<qint64>(m_sourceSummary.pointCount);
+    if (maxPoints > 0) {
+        expected = std::min(expected, static_cast<qint64>(maxPoints));
+    }
+    auto loadFunc = [this, filename, maxPoints, sampling, bounds, expected]() -> PointCloud* {
         PointCloud* cloud = new PointCloud();
         cloud->color = QColor(255, 100, 100);  // 红色
+        emit sourceCloudStreamStarted(bounds, expected);
+        
+        // 分块解码完成时在工作线程中回调，信号以排队方式送达界面
+        int lastPercent = -1;
+        auto progress = [this, &lastPercent](size_t decoded, size_t total) {
+            int percent = static_cast<int>(decoded * 100 / total);
+            if (percent != lastPercent) {
+                lastPercent = percent;
+                emit cloudLoadProgress(QString("正在解码源点云: %1%").arg(percent));
+            }
+        };
+        
+        // 源点云会被保存为配准结果，读取全部属性以便写回时保留
+        LASReadOptions options;
+        options.maxPoints = maxPoints;
+        options.sampling = sampling;
+        options.attributes = LASAttribute::All;
+        options.progress = progress;
+        auto inFlight = std::make_shared<QSemaphore>(MAX_BATCHES_IN_FLIGHT);
+        options.chunkDecoded = [this, cloud, inFlight](size_t begin, size_t end) {
+            emit sourceCloudBatchLoaded(copyBatch(*cloud, begin, end, inFlight));
+        };
         
-        if (!LASIO::readLAS(filename.toStdString(), *cloud, maxPoints)) {
+        if (!PointCloudIO::read(filename.toStdString(), *cloud, options)) {
             delete cloud;
             return nullptr;
         }
@@ -90,6 +220,7 @@ void RegistrationService::onSourceCloudLoadFinished()
     
     // 保存原始源点云的副本
     if (m_originalSourceCloud) {
+        releasePickIndex(true);
         delete m_originalSourceCloud;
     }
     m_originalSourceCloud = new PointCloud();
@@ -97,30 +228,52 @@ void RegistrationService::onSourceCloudLoadFinished()
     m_originalSourceCloud->color = m_sourceCloud->color;
     m_originalSourceCloud->computeBounds();
     
-    emit sourceCloudLoaded(m_sourceFile, static_cast<int>(m_sourceCloud->size()));
+    emit sourceCloudLoaded(m_sourceFile, static_cast<qint64>(m_sourceCloud->size()));
 }
 
-bool RegistrationService::loadTargetCloud(const QString& filename, size_t maxPoints)
+bool RegistrationService::loadTargetCloud(const QString& filename, size_t maxPoints, LASSampling sampling)
 {
     if (m_targetWatcher->isRunning()) {
         emit cloudLoadError("目标点云正在加载中,请稍候...");
         return false;
     }
     
-    if (m_targetCloud) {
-        delete m_targetCloud;
-        m_targetCloud = nullptr;
-    }
-    
+    // 头部信息和预览点先同步显示，全部点在后台读取(不支持探查的格式只在后台读取)
+    probeTargetCloud(filename);
     m_targetFile = filename;
     emit cloudLoadProgress("正在加载目标点云，请稍候...");
     
-    // 异步加载
-    auto loadFunc = [filename, maxPoints]() -> PointCloud* {
+    // 异步加载(预计点数取头部点数，限制点数时不超过maxPoints)
+    const Eigen::AlignedBox3d bounds = m_targetSummary.bounds;
+    qint64 expected = static_cast<qint64>(m_targetSummary.pointCount);
+    if (maxPoints > 0) {
+        expected = std::min(expected, static_cast<qint64>(maxPoints));
+    }
+    auto loadFunc = [this, filename, maxPoints, sampling, bounds, expected]() -> PointCloud* {
         PointCloud* cloud = new PointCloud();
         cloud->color = QColor(100, 100, 255);  // 蓝色
+        emit targetCloudStreamStarted(bounds, expected);
+        
+        // 分块解码完成时在工作线程中回调，信号以排队方式送达界面
+        int lastPercent = -1;
+        auto progress = [this, &lastPercent](size_t decoded, size_t total) {
+            int percent = static_cast<int>(decoded * 100 / total);
+            if (percent != lastPercent) {
+                lastPercent = percent;
+                emit cloudLoadProgress(QString("正在解码目标点云: %1%").arg(percent));
+            }
+        };
+        
+        LASReadOptions options;
+        options.maxPoints = maxPoints;
+        options.sampling = sampling;
+        options.progress = progress;
+        auto inFlight = std::make_shared<QSemaphore>(MAX_BATCHES_IN_FLIGHT);
+        options.chunkDecoded = [this, cloud, inFlight](size_t begin, size_t end) {
+            emit targetCloudBatchLoaded(copyBatch(*cloud, begin, end, inFlight));
+        };
         
-        if (!LASIO::readLAS(filename.toStdString(), *cloud, maxPoints)) {
+        if (!PointCloudIO::read(filename.toStdString(), *cloud, options)) {
             delete cloud;
             return nullptr;
         }
@@ -143,7 +296,107 @@ void RegistrationService::onTargetCloudLoadFinished()
         return;
     }
     
-    emit targetCloudLoaded(m_targetFile, static_cast<int>(m_targetCloud->size()));
+    emit targetCloudLoaded(m_targetFile, static_cast<qint64>(m_targetCloud->size()));
+}
+
+bool RegistrationService::loadSourceTiles(const QStringList& paths, size_t memoryLimit)
+{
+    if (m_sourceWatcher->isRunning()) {
+        emit cloudLoadError("源点云正在加载中,请稍候...");
+        return false;
+    }
+    
+    clearSourceCloud();
+    m_sourceFile = paths.join("; ");
+    emit cloudLoadProgress("正在加载源点云分块，请稍候...");
+    
+    // 异步加载：解析各分块头部后合并解码到同一个点云
+    auto loadFunc = [this, paths, memoryLimit]() -> PointCloud* {
+        TileDataset dataset;
+        for (const QString& path : paths) {
+            dataset.add(path.toStdString());
+        }
+        
+        int lastPercent = -1;
+        TileLoadOptions options;
+        options.memoryLimit = memoryLimit;
+        options.attributes = LASAttribute::All;
+        options.progress = [this, &lastPercent](size_t decoded, size_t total) {
+            int percent = static_cast<int>(decoded * 100 / total);
+            if (percent != lastPercent) {
+                lastPercent = percent;
+                emit cloudLoadProgress(QString("正在解码源点云分块: %1%").arg(percent));
+            }
+        };
+        
+        PointCloud* cloud = new PointCloud();
+        cloud->color = QColor(255, 100, 100);  // 红色
+        auto inFlight = std::make_shared<QSemaphore>(MAX_BATCHES_IN_FLIGHT);
+        options.chunkDecoded = [this, cloud, inFlight](size_t begin, size_t end) {
+            emit sourceCloudBatchLoaded(copyBatch(*cloud, begin, end, inFlight));
+        };
+        emit sourceCloudStreamStarted(dataset.bounds(), static_cast<qint64>(dataset.pointCount()));
+        if (!dataset.load(*cloud, options)) {
+            delete cloud;
+            return nullptr;
+        }
+        
+        return cloud;
+    };
+    
+    QFuture<PointCloud*> future = QtConcurrent::run(loadFunc);
+    m_sourceWatcher->setFuture(future);
+    
+    return true;
+}
+
+bool RegistrationService::loadTargetTiles(const QStringList& paths, size_t memoryLimit)
+{
+    if (m_targetWatcher->isRunning()) {
+        emit cloudLoadError("目标点云正在加载中,请稍候...");
+        return false;
+    }
+    
+    clearTargetCloud();
+    m_targetFile = paths.join("; ");
+    emit cloudLoadProgress("正在加载目标点云分块，请稍候...");
+    
+    auto loadFunc = [this, paths, memoryLimit]() -> PointCloud* {
+        TileDataset dataset;
+        for (const QString& path : paths) {
+            dataset.add(path.toStdString());
+        }
+        
+        int lastPercent = -1;
+        TileLoadOptions options;
+        options.memoryLimit = memoryLimit;
+        options.progress = [this, &lastPercent](size_t decoded, size_t total) {
+            int percent = static_cast<int>(decoded * 100 / total);
+            if (percent != lastPercent) {
+                lastPercent = percent;
+                emit cloudLoadProgress(QString("正在解码目标点云分块: %1%").arg(percent));
+            }
+        };
+        
+        PointCloud* cloud = new PointCloud();
+        cloud->color = QColor(100, 100, 255);  // 蓝色
+        auto inFlight = std::make_shared<QSemaphore>(MAX_BATCHES_IN_FLIGHT);
+        options.chunkDecoded = [this, cloud, inFlight](size_t begin, size_t end) {
+            emit targetCloudBatchLoaded(copyBatch(*cloud, begin, end, inFlight));
+        };
+        emit targetCloudStreamStarted(dataset.bounds(), static_cast<qint64>(dataset.pointCount()));
+        if (!dataset.load(*cloud, options)) {
+            delete cloud;
+            return nullptr;
+        }
+        
+        return cloud;
+    };
+    
+    QFuture<PointCloud*> future = QtConcurrent::run(loadFunc);
+    m_targetWatcher->setFuture(future);
+    
+    return true;
 }
 
 bool RegistrationService::saveRegisteredCloud(const QString& filename)
@@ -161,8 +414,70 @@ bool RegistrationService::saveRegisteredCloud(const QString& filename)
     return true;
 }
 
+bool RegistrationService::exportFullResolution(const QString& filename)
+{
+    if (m_exportWatcher->isRunning()) {
+        emit exportFinished(false, "正在导出，请稍候...");
+        return false;
+    }
+    
+    const ICPResult result = m_icpEngine->getResult();
+    if (m_sourceFile.isEmpty() || !result.success) {
+        emit exportFinished(false, "没有可导出的配准结果");
+        return false;
+    }
+    
+    if (PointCloudIO::formatOf(m_sourceFile.toStdString()) != PointCloudIO::Format::LAS) {
+        emit exportFinished(false, "全分辨率导出只支持LAS/LAZ源文件，请使用保存配准结果");
+        return false;
+    }
+    
+    if (QFileInfo(filename).absoluteFilePath() == QFileInfo(m_sourceFile).absoluteFilePath()) {
+        emit exportFinished(false, "不能覆盖源点云文件");
+        return false;
+    }
+    
+    Eigen::Affine3d transform = Eigen::Affine3d::Identity();
+    for (int i = 0; i < 3; ++i) {
+        for (int j = 0; j < 3; ++j) {
+            transform.linear()(i, j) = result.finalR[i][j];
+        }
+        transform.translation()(i) = result.finalT[i];
+    }
+    
+    m_exportFile = filename;
+    
+    // 读取的是原始文件而不是内存中可能被降采样的点云，内存占用与文件大小无关
+    auto exportFunc = [this, transform, input = m_sourceFile.toStdString(), output = filename.toStdString()]() {
+        int lastPercent = -1;
+        auto progress = [this, &lastPercent](size_t done, size_t total) {
+            int percent = static_cast<int>(done * 100 / total);
+            if (percent != lastPercent) {
+                lastPercent = percent;
+                emit exportProgress(percent);
+            }
+        };
+        return LASIO::transformLAS(input, output, transform, progress);
+    };
+    
+    QFuture<bool> future = QtConcurrent::run(exportFunc);
+    m_exportWatcher->setFuture(future);
+    
+    return true;
+}
+
+void RegistrationService::onExportFinished()
+{
+    if (m_exportWatcher->result()) {
+        emit exportFinished(true, "全分辨率配准结果已导出到: " + m_exportFile);
+    } else {
+        emit exportFinished(false, "导出全分辨率结果失败: " + m_exportFile);
+    }
+}
+
 void RegistrationService::clearSourceCloud()
 {
+    releasePickIndex(true);
     if (m_sourceCloud) {
         delete m_sourceCloud;
         m_sourceCloud = nullptr;
@@ -171,15 +486,26 @@ void RegistrationService::clearSourceCloud()
         delete m_originalSourceCloud;
         m_originalSourceCloud = nullptr;
     }
+    if (m_sourcePreview) {
+        delete m_sourcePreview;
+        m_sourcePreview = nullptr;
+    }
+    m_sourceSummary = PointCloudSummary();
     m_sourceFile.clear();
 }
 
 void RegistrationService::clearTargetCloud()
 {
+    releasePickIndex(false);
     if (m_targetCloud) {
         delete m_targetCloud;
         m_targetCloud = nullptr;
     }
+    if (m_targetPreview) {
+        delete m_targetPreview;
+        m_targetPreview = nullptr;
+    }
+    m_targetSummary = PointCloudSummary();
     m_targetFile.clear();
 }
 
@@ -224,6 +550,96 @@ std::vector<IterationResult> RegistrationService::getIterationHistory() const
     return m_icpEngine->getResult().iterationHistory;
 }
 
+void RegistrationService::buildPickIndexes()
+{
+    if (m_pickIndexWatcher->isRunning()) {
+        m_pickIndexPending = true;
+        return;
+    }
+    
+    // 目标点云已有配准建立的八叉树时直接共享，单独建立的索引不再需要
+    const bool sharedTarget = m_icpEngine->targetIndex(m_targetCloud) != nullptr;
+    if (sharedTarget) {
+        m_targetPickIndex.reset();
+    }
+    const PointCloud* source = m_originalSourceCloud;
+    const PointCloud* target = m_targetCloud;
+    if (m_sourcePickIndex || !source || source->empty()) {
+        source = nullptr;
+    }
+    if (sharedTarget || m_targetPickIndex || !target || target->empty()) {
+        target = nullptr;
+    }
+    if (!source && !target) {
+        emit pickIndexReady();
+        return;
+    }
+    
+    m_pickSourceCloud = source;
+    m_pickTargetCloud = target;
+    QFuture<PickIndexes> future = QtConcurrent::run([source, target]() {
+        PickIndexes indexes;
+        if (source) {
+            indexes.source = std::make_shared<const Octree>(source->points, PICK_INDEX_LEAF_POINTS, PICK_INDEX_MAX_DEPTH);
+        }
+        if (target) {
+            indexes.target = std::make_shared<const Octree>(target->points, PICK_INDEX_LEAF_POINTS, PICK_INDEX_MAX_DEPTH);
+        }
+        return indexes;
+    });
+    m_pickIndexWatcher->setFuture(future);
+}
+
+std::shared_ptr<const Octree> RegistrationService::getTargetPickIndex() const
+{
+    std::shared_ptr<const Octree> index = m_icpEngine->targetIndex(m_targetCloud);
+    return index ? index : m_targetPickIndex;
+}
+
+void RegistrationService::onPickIndexFinished()
+{
+    // 建立期间释放过的点云的结果丢弃
+    const PickIndexes indexes = m_pickIndexWatcher->result();
+    if (indexes.source && m_pickSourceCloud && m_pickSourceCloud == m_originalSourceCloud) {
+        m_sourcePickIndex = indexes.source;
+    }
+    if (indexes.target && m_pickTargetCloud && m_pickTargetCloud == m_targetCloud) {
+        m_targetPickIndex = indexes.target;
+    }
+    m_pickSourceCloud = nullptr;
+    m_pickTargetCloud = nullptr;
+    
+    emit pickIndexReady();
+    if (m_pickIndexPending) {
+        m_pickIndexPending = false;
+        buildPickIndexes();
+    }
+}
+
+void RegistrationService::releasePickIndex(bool source)
+{
+    // 后台建立时会读取点云，释放点云前等待其完成
+    m_pickIndexWatcher->waitForFinished();
+    if (source) {
+        m_sourcePickIndex.reset();
+        m_pickSourceCloud = nullptr;
+    } else {
+        m_targetPickIndex.reset();
+        m_pickTargetCloud = nullptr;
+        m_icpEngine->releaseTargetIndex();
+    }
+    emit pickIndexReady();      // 查看器随之丢弃旧索引
+}
+
+std::shared_ptr<const std::vector<double>> RegistrationService::getResiduals(double* threshold) const
+{
+    const ICPResult result = m_icpEngine->getResult();
+    if (threshold) {
+        *threshold = result.residualThreshold;
+    }
+    return result.residuals;
+}
+
 void RegistrationService::onICPFinished(bool success, const QString& message)
 {
     // ICP引擎完成后的处理 - 这在工作线程中被调用
@@ -244,8 +660,8 @@ void RegistrationService::onRegistrationFinished()
         record.timestamp = QDateTime::currentDateTime();
         record.sourceFile = QFileInfo(m_sourceFile).fileName();
         record.targetFile = QFileInfo(m_targetFile).fileName();
-        record.sourcePoints = static_cast<int>(m_sourceCloud->size());
-        record.targetPoints = static_cast<int>(m_targetCloud->size());
+        record.sourcePoints = static_cast<qint64>(m_sourceCloud->size());
+        record.targetPoints = static_cast<qint64>(m_targetCloud->size());
         record.iterations = result.totalIterations;
         record.finalRMSE = result.finalRMSE;
         record.success = true;
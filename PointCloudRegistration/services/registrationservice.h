@@ -3,10 +3,18 @@
 
 #include <QObject>
 #include <QString>
+#include <QStringList>
 #include <QDateTime>
 #include <QFutureWatcher>
+#include <memory>
 #include "core/pointcloud.h"
 #include "core/icpengine.h"
+#include "core/lasio.h"
+#include "core/pointcloudio.h"
+
+// 加载时在工作线程中发出的流式信号以排队方式送达界面
+Q_DECLARE_METATYPE(PointBatch)
+Q_DECLARE_METATYPE(Eigen::AlignedBox3d)
 
 /**
  * @brief 配准历史记录
@@ -15,8 +23,8 @@ struct RegistrationRecord {
     QDateTime timestamp;
     QString sourceFile;
     QString targetFile;
-    int sourcePoints;
-    int targetPoints;
+    qint64 sourcePoints;
+    qint64 targetPoints;
     int iterations;
     double finalRMSE;
     bool success;
@@ -35,17 +43,43 @@ public:
     explicit RegistrationService(QObject *parent = nullptr);
     ~RegistrationService() override;
     
-    // 点云管理
-    bool loadSourceCloud(const QString& filename, size_t maxPoints = 0);
-    bool loadTargetCloud(const QString& filename, size_t maxPoints = 0);
+    // 点云管理(LAS/LAZ/PLY/PCD/XYZ，见PointCloudIO)
+    // 只解析头部并读取稀疏预览点(同步，毫秒级)，会清除已加载的点云，成功时发出sourceCloudProbed
+    bool probeSourceCloud(const QString& filename);
+    bool probeTargetCloud(const QString& filename);
+    
+    // 先探查文件，再在后台读取点，完成时发出sourceCloudLoaded
+    // maxPoints为0时读取全部点，否则按sampling对整个文件采样(非LAS格式等间隔保留)
+    bool loadSourceCloud(const QString& filename, size_t maxPoints = 0,
+                         LASSampling sampling = LASSampling::Voxel);
+    bool loadTargetCloud(const QString& filename, size_t maxPoints = 0,
+                         LASSampling sampling = LASSampling::Voxel);
+    
+    // 把多个LAS/LAZ分块(文件或目录)在后台合并为一个点云，超过memoryLimit字节时均匀抽稀(0表示不限制)
+    bool loadSourceTiles(const QStringList& paths, size_t memoryLimit = 0);
+    bool loadTargetTiles(const QStringList& paths, size_t memoryLimit = 0);
     bool saveRegisteredCloud(const QString& filename);
     
+    // 把最终变换流式应用到源点云的原始LAS/LAZ文件(全部点)，后台执行，完成时发出exportFinished
+    bool exportFullResolution(const QString& filename);
+    bool isExporting() const { return m_exportWatcher->isRunning(); }
+    
     void clearSourceCloud();
     void clearTargetCloud();
     
+    // 是否正在后台加载(加载期间点云以流式信号输出)
+    bool isLoadingSource() const { return m_sourceWatcher->isRunning(); }
+    bool isLoadingTarget() const { return m_targetWatcher->isRunning(); }
+    
     PointCloud* getSourceCloud() { return m_sourceCloud; }
     const PointCloud* getTargetCloud() const { return m_targetCloud; }
     
+    // 探查得到的文件概况和预览点(没有探查结果时预览为nullptr)
+    const PointCloudSummary& getSourceSummary() const { return m_sourceSummary; }
+    const PointCloudSummary& getTargetSummary() const { return m_targetSummary; }
+    const PointCloud* getSourcePreview() const { return m_sourcePreview; }
+    const PointCloud* getTargetPreview() const { return m_targetPreview; }
+    
     // 获取原始源点云(配准前的状态)
     const PointCloud* getOriginalSourceCloud() const { return m_originalSourceCloud; }
     
@@ -60,16 +94,35 @@ public:
     // 获取ICP迭代历史
     std::vector<IterationResult> getIterationHistory() const;
     
+    // 最后一次配准导出的逐点残差(与源点云同序，参数exportResiduals为false时为nullptr)和离群点阈值
+    std::shared_ptr<const std::vector<double>> getResiduals(double* threshold = nullptr) const;
+    
+    // 拾取用的空间索引，对应原始源点云和目标点云：目标点云优先共享配准时建立的八叉树，
+    // 其余在后台建立，完成时以及点云释放后发出pickIndexReady。释放点云前会等待进行中的建立完成
+    void buildPickIndexes();
+    std::shared_ptr<const Octree> getSourcePickIndex() const { return m_sourcePickIndex; }
+    std::shared_ptr<const Octree> getTargetPickIndex() const;
+    
     // 历史记录
     const QVector<RegistrationRecord>& getHistory() const { return m_history; }
     void clearHistory();
-    
+
 signals:
-    void sourceCloudLoaded(const QString& filename, int pointCount);
-    void targetCloudLoaded(const QString& filename, int pointCount);
+    void sourceCloudProbed(const QString& filename, qint64 pointCount);
+    void targetCloudProbed(const QString& filename, qint64 pointCount);
+    void sourceCloudLoaded(const QString& filename, qint64 pointCount);
+    void targetCloudLoaded(const QString& filename, qint64 pointCount);
     void cloudLoadError(const QString& message);
     void cloudLoadProgress(const QString& message);  // 新增：加载进度信号
     
+    // 后台加载的流式输出(工作线程中发出)：开始解码时给出预计的范围和点数(未知时包围盒为空、点数为0)，
+    // 之后每个分块解码完成时发出该段点的副本，全部分块之和即为最终的点云。
+    // 同时在途的副本数有上限，接收者应尽快处理并释放副本，否则解码会暂停
+    void sourceCloudStreamStarted(const Eigen::AlignedBox3d& bounds, qint64 expectedPoints);
+    void targetCloudStreamStarted(const Eigen::AlignedBox3d& bounds, qint64 expectedPoints);
+    void sourceCloudBatchLoaded(const PointBatch& batch);
+    void targetCloudBatchLoaded(const PointBatch& batch);
+    
     void registrationStarted();
     void registrationProgress(int iteration, int total, double rmse);
     void registrationIterationCompleted(const IterationResult& result);
@@ -78,16 +131,33 @@ signals:
     
     void historyUpdated(const QVector<RegistrationRecord>& history);
     
+    void exportProgress(int percent);
+    void exportFinished(bool success, const QString& message);
+
+    void pickIndexReady();
+    
 private slots:
     void onICPFinished(bool success, const QString& message);
     void onSourceCloudLoadFinished();
     void onTargetCloudLoadFinished();
     void onRegistrationFinished();
-    
+    void onExportFinished();
+    void onPickIndexFinished();
+
 private:
+    // 探查文件，成功时替换preview和summary
+    bool probeCloud(const QString& filename, PointCloud*& preview, PointCloudSummary& summary);
+    
+    // 点云释放或替换前丢弃对应的拾取索引
+    void releasePickIndex(bool source);
+    
     PointCloud* m_sourceCloud;
     PointCloud* m_targetCloud;
     PointCloud* m_originalSourceCloud;  // 保存原始源点云用于迭代回放
+    PointCloud* m_sourcePreview;        // 探查时读取的稀疏预览点
+    PointCloud* m_targetPreview;
+    PointCloudSummary m_sourceSummary;
+    PointCloudSummary m_targetSummary;
     ICPEngine* m_icpEngine;
     
     QString m_sourceFile;
@@ -102,6 +172,22 @@ private:
     
     // 异步配准
     QFutureWatcher<void>* m_registrationWatcher;
+    
+    // 异步导出全分辨率结果
+    QFutureWatcher<bool>* m_exportWatcher;
+    QString m_exportFile;
+    
+    // 拾取索引(后台建立)
+    struct PickIndexes {
+        std::shared_ptr<const Octree> source;
+        std::shared_ptr<const Octree> target;
+    };
+    QFutureWatcher<PickIndexes>* m_pickIndexWatcher;
+    std::shared_ptr<const Octree> m_sourcePickIndex;
+    std::shared_ptr<const Octree> m_targetPickIndex;    // 没有配准建立的八叉树时单独建立
+    const PointCloud* m_pickSourceCloud;                // 正在建立索引的点云，释放时清空以丢弃结果
+    const PointCloud* m_pickTargetCloud;
+    bool m_pickIndexPending;                            // 建立期间又有请求(例如加载了新的点云)
 };
 
 #endif // REGISTRATIONSERVICE_H
@@ -20,6 +20,7 @@ void SettingsService::load()
     m_settings.icpParams.sigmaMultiplier = m_qsettings->value("sigmaMultiplier", 3.0).toDouble();
     m_settings.icpParams.octreeMaxPoints = m_qsettings->value("octreeMaxPoints", 10).toInt();
     m_settings.icpParams.octreeMaxDepth = m_qsettings->value("octreeMaxDepth", 20).toInt();
+    m_settings.icpParams.exportResiduals = m_qsettings->value("exportResiduals", true).toBool();
     m_qsettings->endGroup();
     
     m_qsettings->beginGroup("Display");
@@ -29,6 +30,8 @@ void SettingsService::load()
     m_settings.targetColor = m_qsettings->value("targetColor", QColor(100, 100, 255)).value<QColor>();
     m_settings.showGrid = m_qsettings->value("showGrid", true).toBool();
     m_settings.smoothRendering = m_qsettings->value("smoothRendering", true).toBool();
+    m_settings.pointBudget = m_qsettings->value("pointBudget", 2.0).toDouble();
+    m_settings.showRenderStats = m_qsettings->value("showRenderStats", false).toBool();
     m_qsettings->endGroup();
     
     m_qsettings->beginGroup("Window");
@@ -46,6 +49,7 @@ void SettingsService::save()
     m_qsettings->setValue("sigmaMultiplier", m_settings.icpParams.sigmaMultiplier);
     m_qsettings->setValue("octreeMaxPoints", m_settings.icpParams.octreeMaxPoints);
     m_qsettings->setValue("octreeMaxDepth", m_settings.icpParams.octreeMaxDepth);
+    m_qsettings->setValue("exportResiduals", m_settings.icpParams.exportResiduals);
     m_qsettings->endGroup();
     
     m_qsettings->beginGroup("Display");
@@ -55,6 +59,8 @@ void SettingsService::save()
     m_qsettings->setValue("targetColor", m_settings.targetColor);
     m_qsettings->setValue("showGrid", m_settings.showGrid);
     m_qsettings->setValue("smoothRendering", m_settings.smoothRendering);
+    m_qsettings->setValue("pointBudget", m_settings.pointBudget);
+    m_qsettings->setValue("showRenderStats", m_settings.showRenderStats);
     m_qsettings->endGroup();
     
     m_qsettings->beginGroup("Window");
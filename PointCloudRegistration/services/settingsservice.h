@@ -20,6 +20,8 @@ struct AppSettings {
     QColor targetColor = QColor(100, 100, 255);  // 蓝色
     bool showGrid = true;
     bool smoothRendering = true;
+    double pointBudget = 2.0;   // 交互时每帧绘制的点数上限(百万点)，超过的点云按细节层次显示
+    bool showRenderStats = false;   // 在3D视图中叠加显示帧时间、点数和上传带宽
     
     // 窗口设置
     bool followSystemTheme = true;
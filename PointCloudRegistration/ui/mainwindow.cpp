@@ -119,6 +119,10 @@ void MainWindow::connectSignals()
             m_visualizationPage->updateViewer();
             // 加载迭代历史
             m_visualizationPage->loadIterationHistory(m_registrationService->getIterationHistory());
+            // 按配准时的点对距离给源点云着色(没有导出残差时恢复单色)
+            double threshold = 0.0;
+            auto residuals = m_registrationService->getResiduals(&threshold);
+            m_visualizationPage->getViewer()->setSourceResiduals(residuals, threshold);
         }
     });
     
@@ -130,6 +134,8 @@ void MainWindow::connectSignals()
         viewer->setShowGrid(settings.showGrid);
         viewer->setSmoothRendering(settings.smoothRendering);
         viewer->setPointSize(settings.sourcePointSize);
+        viewer->setPointBudget(static_cast<size_t>(settings.pointBudget * 1e6));
+        viewer->setShowStats(settings.showRenderStats);
         viewer->setSourceColor(settings.sourceColor);
         viewer->setTargetColor(settings.targetColor);
         
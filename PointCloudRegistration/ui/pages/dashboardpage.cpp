@@ -132,7 +132,7 @@ void DashboardPage::updateCloudInfo()
     
     // 更新源点云信息
     if (m_registrationService->getSourceCloud()) {
-        int points = static_cast<int>(m_registrationService->getSourceCloud()->size());
+        qint64 points = static_cast<qint64>(m_registrationService->getSourceCloud()->size());
         m_sourcePointsValue->setText(QString::number(points));
     } else {
         m_sourcePointsValue->setText("0");
@@ -140,7 +140,7 @@ void DashboardPage::updateCloudInfo()
     
     // 更新目标点云信息
     if (m_registrationService->getTargetCloud()) {
-        int points = static_cast<int>(m_registrationService->getTargetCloud()->size());
+        qint64 points = static_cast<qint64>(m_registrationService->getTargetCloud()->size());
         m_targetPointsValue->setText(QString::number(points));
     } else {
         m_targetPointsValue->setText("0");
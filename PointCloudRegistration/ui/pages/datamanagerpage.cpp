@@ -1,6 +1,7 @@
 #include "datamanagerpage.h"
 #include "ElaPushButton.h"
 #include "ElaText.h"
+#include "ElaToggleSwitch.h"
 #include <QVBoxLayout>
 #include <QHBoxLayout>
 #include <QGroupBox>
@@ -8,6 +9,21 @@
 #include <QFileDialog>
 #include <QMessageBox>
 #include <QFileInfo>
+#include "core/pointcloudio.h"
+
+namespace {
+
+// 分块目录合并后的内存上限，超出时所有分块等间隔抽稀
+constexpr size_t TILE_MEMORY_LIMIT = size_t(4) << 30;
+
+QString boundsText(const Eigen::Vector3d& min, const Eigen::Vector3d& max)
+{
+    return QString("边界: [%1, %2, %3] - [%4, %5, %6]")
+        .arg(min.x(), 0, 'f', 2).arg(min.y(), 0, 'f', 2).arg(min.z(), 0, 'f', 2)
+        .arg(max.x(), 0, 'f', 2).arg(max.y(), 0, 'f', 2).arg(max.z(), 0, 'f', 2);
+}
+
+} // namespace
 
 DataManagerPage::DataManagerPage(QWidget *parent)
     : QWidget(parent)
@@ -21,12 +37,22 @@ void DataManagerPage::setRegistrationService(RegistrationService* service)
     m_registrationService = service;
     
     if (m_registrationService) {
+        connect(m_registrationService, &RegistrationService::sourceCloudProbed,
+                this, &DataManagerPage::onSourceCloudProbed);
+        connect(m_registrationService, &RegistrationService::targetCloudProbed,
+                this, &DataManagerPage::onTargetCloudProbed);
         connect(m_registrationService, &RegistrationService::sourceCloudLoaded,
                 this, &DataManagerPage::onSourceCloudLoaded);
         connect(m_registrationService, &RegistrationService::targetCloudLoaded,
                 this, &DataManagerPage::onTargetCloudLoaded);
         connect(m_registrationService, &RegistrationService::cloudLoadError,
                 this, &DataManagerPage::onCloudLoadError);
+        connect(m_registrationService, &RegistrationService::registrationFinished,
+                this, &DataManagerPage::onRegistrationFinished);
+        connect(m_registrationService, &RegistrationService::exportProgress,
+                this, &DataManagerPage::onExportProgress);
+        connect(m_registrationService, &RegistrationService::exportFinished,
+                this, &DataManagerPage::onExportFinished);
     }
 }
 
@@ -41,24 +67,40 @@ void DataManagerPage::buildUI()
     titleText->setTextPixelSize(24);
     mainLayout->addWidget(titleText);
     
+    // 导入方式：关闭时只读取头部和预览点，需要时再加载全部点
+    QHBoxLayout* loadModeLayout = new QHBoxLayout();
+    m_loadFullSwitch = new ElaToggleSwitch(this);
+    m_loadFullSwitch->setIsToggled(true);
+    loadModeLayout->addWidget(new QLabel("导入时在后台加载全部点:"));
+    loadModeLayout->addWidget(m_loadFullSwitch);
+    loadModeLayout->addStretch();
+    mainLayout->addLayout(loadModeLayout);
+    
     // 源点云组
     QGroupBox* sourceGroup = new QGroupBox("源点云（待配准）");
     QVBoxLayout* sourceLayout = new QVBoxLayout();
     
     m_sourceFileLabel = new QLabel("文件: 未加载");
+    m_sourceFormatLabel = new QLabel("格式: -");
     m_sourcePointsLabel = new QLabel("点数: -");
     m_sourceBoundsLabel = new QLabel("边界: -");
     
     sourceLayout->addWidget(m_sourceFileLabel);
+    sourceLayout->addWidget(m_sourceFormatLabel);
     sourceLayout->addWidget(m_sourcePointsLabel);
     sourceLayout->addWidget(m_sourceBoundsLabel);
     
     QHBoxLayout* sourceButtonLayout = new QHBoxLayout();
     m_loadSourceButton = new ElaPushButton("导入源点云", this);
+    m_loadSourceFullButton = new ElaPushButton("加载全部点", this);
+    m_loadSourceFullButton->setEnabled(false);
+    m_loadSourceTilesButton = new ElaPushButton("导入分块目录", this);
     m_clearSourceButton = new ElaPushButton("清除", this);
     m_clearSourceButton->setEnabled(false);
     
     sourceButtonLayout->addWidget(m_loadSourceButton);
+    sourceButtonLayout->addWidget(m_loadSourceFullButton);
+    sourceButtonLayout->addWidget(m_loadSourceTilesButton);
     sourceButtonLayout->addWidget(m_clearSourceButton);
     sourceButtonLayout->addStretch();
     
@@ -71,19 +113,26 @@ void DataManagerPage::buildUI()
     QVBoxLayout* targetLayout = new QVBoxLayout();
     
     m_targetFileLabel = new QLabel("文件: 未加载");
+    m_targetFormatLabel = new QLabel("格式: -");
     m_targetPointsLabel = new QLabel("点数: -");
     m_targetBoundsLabel = new QLabel("边界: -");
     
     targetLayout->addWidget(m_targetFileLabel);
+    targetLayout->addWidget(m_targetFormatLabel);
     targetLayout->addWidget(m_targetPointsLabel);
     targetLayout->addWidget(m_targetBoundsLabel);
     
     QHBoxLayout* targetButtonLayout = new QHBoxLayout();
     m_loadTargetButton = new ElaPushButton("导入目标点云", this);
+    m_loadTargetFullButton = new ElaPushButton("加载全部点", this);
+    m_loadTargetFullButton->setEnabled(false);
+    m_loadTargetTilesButton = new ElaPushButton("导入分块目录", this);
     m_clearTargetButton = new ElaPushButton("清除", this);
     m_clearTargetButton->setEnabled(false);
     
     targetButtonLayout->addWidget(m_loadTargetButton);
+    targetButtonLayout->addWidget(m_loadTargetFullButton);
+    targetButtonLayout->addWidget(m_loadTargetTilesButton);
     targetButtonLayout->addWidget(m_clearTargetButton);
     targetButtonLayout->addStretch();
     
@@ -103,6 +152,17 @@ void DataManagerPage::buildUI()
     m_saveResultButton->setEnabled(false);
     resultLayout->addWidget(m_saveResultButton);
     
+    QLabel* exportLabel = new QLabel("导出全分辨率结果会把最终变换应用到源点云原始文件的全部点，其他属性保持不变");
+    exportLabel->setWordWrap(true);
+    resultLayout->addWidget(exportLabel);
+    
+    m_exportFullButton = new ElaPushButton("导出全分辨率结果", this);
+    m_exportFullButton->setEnabled(false);
+    resultLayout->addWidget(m_exportFullButton);
+    
+    m_exportStatusLabel = new QLabel("");
+    resultLayout->addWidget(m_exportStatusLabel);
+    
     resultGroup->setLayout(resultLayout);
     mainLayout->addWidget(resultGroup);
     
@@ -111,7 +171,12 @@ void DataManagerPage::buildUI()
     // 连接信号
     connect(m_loadSourceButton, &ElaPushButton::clicked, this, &DataManagerPage::onLoadSource);
     connect(m_loadTargetButton, &ElaPushButton::clicked, this, &DataManagerPage::onLoadTarget);
+    connect(m_loadSourceFullButton, &ElaPushButton::clicked, this, &DataManagerPage::onLoadSourceFull);
+    connect(m_loadSourceTilesButton, &ElaPushButton::clicked, this, &DataManagerPage::onLoadSourceTiles);
+    connect(m_loadTargetFullButton, &ElaPushButton::clicked, this, &DataManagerPage::onLoadTargetFull);
+    connect(m_loadTargetTilesButton, &ElaPushButton::clicked, this, &DataManagerPage::onLoadTargetTiles);
     connect(m_saveResultButton, &ElaPushButton::clicked, this, &DataManagerPage::onSaveResult);
+    connect(m_exportFullButton, &ElaPushButton::clicked, this, &DataManagerPage::onExportFullResolution);
     connect(m_clearSourceButton, &ElaPushButton::clicked, this, &DataManagerPage::onClearSource);
     connect(m_clearTargetButton, &ElaPushButton::clicked, this, &DataManagerPage::onClearTarget);
 }
@@ -122,17 +187,50 @@ void DataManagerPage::onLoadSource()
         this,
         "选择源点云文件",
         "",
-        "LAS Files (*.las);;All Files (*.*)"
+        PointCloudIO::fileFilter()
     );
     
-    if (filename.isEmpty()) {
+    if (filename.isEmpty() || !m_registrationService) {
         return;
     }
     
-    if (m_registrationService) {
+    // 只探查时不支持探查的格式仍然完整加载
+    m_sourceFileLabel->setText("正在加载...");
+    if (!m_loadFullSwitch->getIsToggled() && m_registrationService->probeSourceCloud(filename)) {
+        return;
+    }
+    // 加载过程中会先收到探查结果，之后再禁用按钮
+    m_registrationService->loadSourceCloud(filename);
+    m_loadSourceButton->setEnabled(false);
+    m_loadSourceFullButton->setEnabled(false);
+    m_loadSourceTilesButton->setEnabled(false);
+}
+
+void DataManagerPage::onLoadSourceFull()
+{
+    if (m_registrationService && !m_registrationService->getSourceFile().isEmpty()) {
+        m_registrationService->loadSourceCloud(m_registrationService->getSourceFile());
         m_loadSourceButton->setEnabled(false);
+        m_loadSourceFullButton->setEnabled(false);
+        m_loadSourceTilesButton->setEnabled(false);
+    }
+}
+
+void DataManagerPage::onLoadSourceTiles()
+{
+    QString directory = QFileDialog::getExistingDirectory(this, "选择源点云分块目录");
+    if (directory.isEmpty() || !m_registrationService) {
+        return;
+    }
+    
+    if (m_registrationService->loadSourceTiles(QStringList{directory}, TILE_MEMORY_LIMIT)) {
         m_sourceFileLabel->setText("正在加载...");
-        m_registrationService->loadSourceCloud(filename);
+        m_sourceFormatLabel->setText("格式: LAS/LAZ分块目录");
+        m_sourcePointsLabel->setText("点数: -");
+        m_sourceBoundsLabel->setText("边界: -");
+        m_loadSourceButton->setEnabled(false);
+        m_loadSourceFullButton->setEnabled(false);
+        m_loadSourceTilesButton->setEnabled(false);
     }
 }
 
@@ -142,17 +240,50 @@ void DataManagerPage::onLoadTarget()
         this,
         "选择目标点云文件",
         "",
-        "LAS Files (*.las);;All Files (*.*)"
+        PointCloudIO::fileFilter()
     );
     
-    if (filename.isEmpty()) {
+    if (filename.isEmpty() || !m_registrationService) {
         return;
     }
     
-    if (m_registrationService) {
+    // 只探查时不支持探查的格式仍然完整加载
+    m_targetFileLabel->setText("正在加载...");
+    if (!m_loadFullSwitch->getIsToggled() && m_registrationService->probeTargetCloud(filename)) {
+        return;
+    }
+    // 加载过程中会先收到探查结果，之后再禁用按钮
+    m_registrationService->loadTargetCloud(filename);
+    m_loadTargetButton->setEnabled(false);
+    m_loadTargetFullButton->setEnabled(false);
+    m_loadTargetTilesButton->setEnabled(false);
+}
+
+void DataManagerPage::onLoadTargetFull()
+{
+    if (m_registrationService && !m_registrationService->getTargetFile().isEmpty()) {
+        m_registrationService->loadTargetCloud(m_registrationService->getTargetFile());
         m_loadTargetButton->setEnabled(false);
+        m_loadTargetFullButton->setEnabled(false);
+        m_loadTargetTilesButton->setEnabled(false);
+    }
+}
+
+void DataManagerPage::onLoadTargetTiles()
+{
+    QString directory = QFileDialog::getExistingDirectory(this, "选择目标点云分块目录");
+    if (directory.isEmpty() || !m_registrationService) {
+        return;
+    }
+    
+    if (m_registrationService->loadTargetTiles(QStringList{directory}, TILE_MEMORY_LIMIT)) {
         m_targetFileLabel->setText("正在加载...");
-        m_registrationService->loadTargetCloud(filename);
+        m_targetFormatLabel->setText("格式: LAS/LAZ分块目录");
+        m_targetPointsLabel->setText("点数: -");
+        m_targetBoundsLabel->setText("边界: -");
+        m_loadTargetButton->setEnabled(false);
+        m_loadTargetFullButton->setEnabled(false);
+        m_loadTargetTilesButton->setEnabled(false);
     }
 }
 
@@ -167,7 +298,7 @@ void DataManagerPage::onSaveResult()
         this,
         "保存配准结果",
         "registered_result.las",
-        "LAS Files (*.las);;All Files (*.*)"
+        "LAS Files (*.las);;LAZ Files (*.laz);;All Files (*.*)"
     );
     
     if (filename.isEmpty()) {
@@ -181,15 +312,42 @@ void DataManagerPage::onSaveResult()
     }
 }
 
+void DataManagerPage::onExportFullResolution()
+{
+    if (!m_registrationService) {
+        return;
+    }
+    
+    QFileInfo source(m_registrationService->getSourceFile());
+    QString filename = QFileDialog::getSaveFileName(
+        this,
+        "导出全分辨率配准结果",
+        source.completeBaseName() + "_registered." + source.suffix(),
+        "LAS Files (*.las);;LAZ Files (*.laz);;All Files (*.*)"
+    );
+    
+    if (filename.isEmpty()) {
+        return;
+    }
+    
+    if (m_registrationService->exportFullResolution(filename)) {
+        m_exportFullButton->setEnabled(false);
+        m_exportStatusLabel->setText("正在导出: 0%");
+    }
+}
+
 void DataManagerPage::onClearSource()
 {
     if (m_registrationService) {
         m_registrationService->clearSourceCloud();
         m_sourceFileLabel->setText("文件: 未加载");
+        m_sourceFormatLabel->setText("格式: -");
         m_sourcePointsLabel->setText("点数: -");
         m_sourceBoundsLabel->setText("边界: -");
+        m_loadSourceFullButton->setEnabled(false);
         m_clearSourceButton->setEnabled(false);
         m_saveResultButton->setEnabled(false);
+        m_exportFullButton->setEnabled(false);
     }
 }
 
@@ -198,50 +356,111 @@ void DataManagerPage::onClearTarget()
     if (m_registrationService) {
         m_registrationService->clearTargetCloud();
         m_targetFileLabel->setText("文件: 未加载");
+        m_targetFormatLabel->setText("格式: -");
         m_targetPointsLabel->setText("点数: -");
         m_targetBoundsLabel->setText("边界: -");
+        m_loadTargetFullButton->setEnabled(false);
         m_clearTargetButton->setEnabled(false);
     }
 }
 
-void DataManagerPage::onSourceCloudLoaded(const QString& filename, int pointCount)
+void DataManagerPage::onSourceCloudProbed(const QString& filename, qint64 pointCount)
+{
+    const PointCloudSummary& summary = m_registrationService->getSourceSummary();
+    const PointCloud* preview = m_registrationService->getSourcePreview();
+    m_sourceFileLabel->setText(QString("文件: %1").arg(QFileInfo(filename).fileName()));
+    m_sourceFormatLabel->setText(QString("格式: %1").arg(QString::fromStdString(summary.format)));
+    m_sourcePointsLabel->setText(QString("点数: %1 (预览 %2 点)").arg(pointCount).arg(preview ? preview->size() : 0));
+    m_sourceBoundsLabel->setText(boundsText(summary.bounds.min(), summary.bounds.max()));
+    
+    m_clearSourceButton->setEnabled(true);
+    m_loadSourceFullButton->setEnabled(true);
+    m_saveResultButton->setEnabled(false);
+    m_exportFullButton->setEnabled(false);
+    emit fileLoaded();
+}
+
+void DataManagerPage::onTargetCloudProbed(const QString& filename, qint64 pointCount)
+{
+    const PointCloudSummary& summary = m_registrationService->getTargetSummary();
+    const PointCloud* preview = m_registrationService->getTargetPreview();
+    m_targetFileLabel->setText(QString("文件: %1").arg(QFileInfo(filename).fileName()));
+    m_targetFormatLabel->setText(QString("格式: %1").arg(QString::fromStdString(summary.format)));
+    m_targetPointsLabel->setText(QString("点数: %1 (预览 %2 点)").arg(pointCount).arg(preview ? preview->size() : 0));
+    m_targetBoundsLabel->setText(boundsText(summary.bounds.min(), summary.bounds.max()));
+    
+    m_clearTargetButton->setEnabled(true);
+    m_loadTargetFullButton->setEnabled(true);
+    emit fileLoaded();
+}
+
+void DataManagerPage::onSourceCloudLoaded(const QString& filename, qint64 pointCount)
 {
     m_sourceFileLabel->setText(QString("文件: %1").arg(QFileInfo(filename).fileName()));
     m_sourcePointsLabel->setText(QString("点数: %1").arg(pointCount));
     
+    // 读取时已经计算过边界
     if (m_registrationService && m_registrationService->getSourceCloud()) {
-        auto cloud = m_registrationService->getSourceCloud();
-        const_cast<PointCloud*>(cloud)->computeBounds();
-        m_sourceBoundsLabel->setText(QString("边界: [%1, %2, %3] - [%4, %5, %6]")
-            .arg(cloud->minX, 0, 'f', 2).arg(cloud->minY, 0, 'f', 2).arg(cloud->minZ, 0, 'f', 2)
-            .arg(cloud->maxX, 0, 'f', 2).arg(cloud->maxY, 0, 'f', 2).arg(cloud->maxZ, 0, 'f', 2));
+        const PointCloud* cloud = m_registrationService->getSourceCloud();
+        m_sourceBoundsLabel->setText(boundsText(Eigen::Vector3d(cloud->minX, cloud->minY, cloud->minZ),
+                                             Eigen::Vector3d(cloud->maxX, cloud->maxY, cloud->maxZ)));
     }
     
     m_loadSourceButton->setEnabled(true);
+    m_loadSourceFullButton->setEnabled(false);
+    m_loadSourceTilesButton->setEnabled(true);
     m_clearSourceButton->setEnabled(true);
     m_saveResultButton->setEnabled(true);
+    m_exportFullButton->setEnabled(false);   // 新的源点云需要重新配准
     emit fileLoaded();
 }
 
-void DataManagerPage::onTargetCloudLoaded(const QString& filename, int pointCount)
+void DataManagerPage::onTargetCloudLoaded(const QString& filename, qint64 pointCount)
 {
     m_targetFileLabel->setText(QString("文件: %1").arg(QFileInfo(filename).fileName()));
     m_targetPointsLabel->setText(QString("点数: %1").arg(pointCount));
     
+    // 读取时已经计算过边界
     if (m_registrationService && m_registrationService->getTargetCloud()) {
-        auto cloud = m_registrationService->getTargetCloud();
-        const_cast<PointCloud*>(cloud)->computeBounds();
-        m_targetBoundsLabel->setText(QString("边界: [%1, %2, %3] - [%4, %5, %6]")
-            .arg(cloud->minX, 0, 'f', 2).arg(cloud->minY, 0, 'f', 2).arg(cloud->minZ, 0, 'f', 2)
-            .arg(cloud->maxX, 0, 'f', 2).arg(cloud->maxY, 0, 'f', 2).arg(cloud->maxZ, 0, 'f', 2));
+        const PointCloud* cloud = m_registrationService->getTargetCloud();
+        m_targetBoundsLabel->setText(boundsText(Eigen::Vector3d(cloud->minX, cloud->minY, cloud->minZ),
+                                             Eigen::Vector3d(cloud->maxX, cloud->maxY, cloud->maxZ)));
     }
     
     m_loadTargetButton->setEnabled(true);
+    m_loadTargetFullButton->setEnabled(false);
+    m_loadTargetTilesButton->setEnabled(true);
     m_clearTargetButton->setEnabled(true);
     emit fileLoaded();
 }
 
 void DataManagerPage::onCloudLoadError(const QString& message)
 {
+    m_loadSourceButton->setEnabled(true);
+    m_loadTargetButton->setEnabled(true);
+    m_loadSourceTilesButton->setEnabled(true);
+    m_loadTargetTilesButton->setEnabled(true);
     QMessageBox::critical(this, "错误", message);
 }
+
+void DataManagerPage::onRegistrationFinished(bool success, const QString& message)
+{
+    Q_UNUSED(message);
+    m_exportFullButton->setEnabled(success && m_registrationService && !m_registrationService->isExporting());
+}
+
+void DataManagerPage::onExportProgress(int percent)
+{
+    m_exportStatusLabel->setText(QString("正在导出: %1%").arg(percent));
+}
+
+void DataManagerPage::onExportFinished(bool success, const QString& message)
+{
+    m_exportFullButton->setEnabled(true);
+    m_exportStatusLabel->setText(success ? "导出完成" : "");
+    if (success) {
+        QMessageBox::information(this, "成功", message);
+    } else {
+        QMessageBox::critical(this, "错误", message);
+    }
+}
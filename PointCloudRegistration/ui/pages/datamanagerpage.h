@@ -6,6 +6,7 @@
 
 class ElaPushButton;
 class ElaText;
+class ElaToggleSwitch;
 class QLabel;
 class QGroupBox;
 
@@ -22,20 +23,30 @@ public:
     explicit DataManagerPage(QWidget *parent = nullptr);
     
     void setRegistrationService(RegistrationService* service);
-    
+
 signals:
     void fileLoaded();
-    
+
 private slots:
     void onLoadSource();
     void onLoadTarget();
+    void onLoadSourceFull();
+    void onLoadTargetFull();
+    void onLoadSourceTiles();
+    void onLoadTargetTiles();
     void onSaveResult();
+    void onExportFullResolution();
     void onClearSource();
     void onClearTarget();
-    void onSourceCloudLoaded(const QString& filename, int pointCount);
-    void onTargetCloudLoaded(const QString& filename, int pointCount);
+    void onSourceCloudProbed(const QString& filename, qint64 pointCount);
+    void onTargetCloudProbed(const QString& filename, qint64 pointCount);
+    void onSourceCloudLoaded(const QString& filename, qint64 pointCount);
+    void onTargetCloudLoaded(const QString& filename, qint64 pointCount);
     void onCloudLoadError(const QString& message);
-    
+    void onRegistrationFinished(bool success, const QString& message);
+    void onExportProgress(int percent);
+    void onExportFinished(bool success, const QString& message);
+
 private:
     void buildUI();
     void updateFileInfo();
@@ -44,20 +55,31 @@ private:
     
     // 源点云信息
     QLabel* m_sourceFileLabel;
+    QLabel* m_sourceFormatLabel;
     QLabel* m_sourcePointsLabel;
     QLabel* m_sourceBoundsLabel;
     ElaPushButton* m_loadSourceButton;
+    ElaPushButton* m_loadSourceFullButton;
+    ElaPushButton* m_loadSourceTilesButton;
     ElaPushButton* m_clearSourceButton;
     
     // 目标点云信息
     QLabel* m_targetFileLabel;
+    QLabel* m_targetFormatLabel;
     QLabel* m_targetPointsLabel;
     QLabel* m_targetBoundsLabel;
     ElaPushButton* m_loadTargetButton;
+    ElaPushButton* m_loadTargetFullButton;
+    ElaPushButton* m_loadTargetTilesButton;
     ElaPushButton* m_clearTargetButton;
     
+    // 导入时是否在后台加载全部点(否则只探查头部和预览点)
+    ElaToggleSwitch* m_loadFullSwitch;
+    
     // 操作按钮
     ElaPushButton* m_saveResultButton;
+    ElaPushButton* m_exportFullButton;
+    QLabel* m_exportStatusLabel;
 };
 
 #endif // DATAMANAGERPAGE_H
@@ -77,6 +77,10 @@ void SettingsPage::buildUI()
     m_octreeMaxDepthSpinBox->setValue(20);
     icpLayout->addRow("八叉树最大深度:", m_octreeMaxDepthSpinBox);
     
+    m_exportResidualsSwitch = new ElaToggleSwitch(this);
+    m_exportResidualsSwitch->setIsToggled(true);
+    icpLayout->addRow("残差热图:", m_exportResidualsSwitch);
+    
     icpGroup->setLayout(icpLayout);
     scrollLayout->addWidget(icpGroup);
     
@@ -104,6 +108,17 @@ void SettingsPage::buildUI()
     m_smoothRenderingSwitch->setIsToggled(true);
     displayLayout->addRow("平滑渲染:", m_smoothRenderingSwitch);
     
+    m_pointBudgetSpinBox = new ElaDoubleSpinBox(this);
+    m_pointBudgetSpinBox->setRange(0.1, 50.0);
+    m_pointBudgetSpinBox->setValue(2.0);
+    m_pointBudgetSpinBox->setSingleStep(0.5);
+    m_pointBudgetSpinBox->setSuffix(" 百万点");
+    displayLayout->addRow("每帧点数预算:", m_pointBudgetSpinBox);
+    
+    m_renderStatsSwitch = new ElaToggleSwitch(this);
+    m_renderStatsSwitch->setIsToggled(false);
+    displayLayout->addRow("显示渲染统计:", m_renderStatsSwitch);
+    
     displayGroup->setLayout(displayLayout);
     scrollLayout->addWidget(displayGroup);
     
@@ -165,11 +180,14 @@ void SettingsPage::applySettings(const AppSettings& settings)
     m_sigmaMultiplierSpinBox->setValue(settings.icpParams.sigmaMultiplier);
     m_octreeMaxPointsSpinBox->setValue(settings.icpParams.octreeMaxPoints);
     m_octreeMaxDepthSpinBox->setValue(settings.icpParams.octreeMaxDepth);
+    m_exportResidualsSwitch->setIsToggled(settings.icpParams.exportResiduals);
     
     m_sourcePointSizeSpinBox->setValue(settings.sourcePointSize);
     m_targetPointSizeSpinBox->setValue(settings.targetPointSize);
     m_showGridSwitch->setIsToggled(settings.showGrid);
     m_smoothRenderingSwitch->setIsToggled(settings.smoothRendering);
+    m_pointBudgetSpinBox->setValue(settings.pointBudget);
+    m_renderStatsSwitch->setIsToggled(settings.showRenderStats);
     
     m_followSystemThemeSwitch->setIsToggled(settings.followSystemTheme);
     m_preferDarkModeSwitch->setIsToggled(settings.preferDarkMode);
@@ -188,12 +206,15 @@ void SettingsPage::onApplySettings()
     settings.icpParams.sigmaMultiplier = m_sigmaMultiplierSpinBox->value();
     settings.icpParams.octreeMaxPoints = m_octreeMaxPointsSpinBox->value();
     settings.icpParams.octreeMaxDepth = m_octreeMaxDepthSpinBox->value();
+    settings.icpParams.exportResiduals = m_exportResidualsSwitch->getIsToggled();
     
     // 显示设置
     settings.sourcePointSize = static_cast<float>(m_sourcePointSizeSpinBox->value());
     settings.targetPointSize = static_cast<float>(m_targetPointSizeSpinBox->value());
     settings.showGrid = m_showGridSwitch->getIsToggled();
     settings.smoothRendering = m_smoothRenderingSwitch->getIsToggled();
+    settings.pointBudget = m_pointBudgetSpinBox->value();
+    settings.showRenderStats = m_renderStatsSwitch->getIsToggled();
     
     // 窗口设置
     settings.followSystemTheme = m_followSystemThemeSwitch->getIsToggled();
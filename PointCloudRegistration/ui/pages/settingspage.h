@@ -45,12 +45,15 @@ private:
     ElaDoubleSpinBox* m_sigmaMultiplierSpinBox;
     ElaSpinBox* m_octreeMaxPointsSpinBox;
     ElaSpinBox* m_octreeMaxDepthSpinBox;
+    ElaToggleSwitch* m_exportResidualsSwitch;
     
     // 显示设置控件
     ElaDoubleSpinBox* m_sourcePointSizeSpinBox;
     ElaDoubleSpinBox* m_targetPointSizeSpinBox;
     ElaToggleSwitch* m_showGridSwitch;
     ElaToggleSwitch* m_smoothRenderingSwitch;
+    ElaDoubleSpinBox* m_pointBudgetSpinBox;
+    ElaToggleSwitch* m_renderStatsSwitch;
     
     // 窗口设置控件
     ElaToggleSwitch* m_followSystemThemeSwitch;
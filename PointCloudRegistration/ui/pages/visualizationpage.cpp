@@ -2,6 +2,7 @@
 #include "ElaPushButton.h"
 #include "ElaSlider.h"
 #include "ElaText.h"
+#include "ElaToggleSwitch.h"
 #include <QVBoxLayout>
 #include <QHBoxLayout>
 #include <QGroupBox>
@@ -17,6 +18,27 @@ VisualizationPage::VisualizationPage(QWidget *parent)
 void VisualizationPage::setRegistrationService(RegistrationService* service)
 {
     m_registrationService = service;
+    
+    // 后台加载时已解码的分块直接交给查看器流式显示
+    connect(service, &RegistrationService::sourceCloudStreamStarted, this,
+            [this](const Eigen::AlignedBox3d& bounds, qint64 expectedPoints) {
+        m_viewer->beginSourceStream(bounds, static_cast<size_t>(expectedPoints));
+    });
+    connect(service, &RegistrationService::targetCloudStreamStarted, this,
+            [this](const Eigen::AlignedBox3d& bounds, qint64 expectedPoints) {
+        m_viewer->beginTargetStream(bounds, static_cast<size_t>(expectedPoints));
+    });
+    connect(service, &RegistrationService::sourceCloudBatchLoaded, m_viewer, &PointCloudViewer::appendSourceStream);
+    connect(service, &RegistrationService::targetCloudBatchLoaded, m_viewer, &PointCloudViewer::appendTargetStream);
+    
+    // 每次迭代的累积变换直接作为源点云的模型矩阵，边配准边观察收敛情况
+    connect(service, &RegistrationService::registrationStarted, this, &VisualizationPage::onRegistrationStarted);
+    connect(service, &RegistrationService::registrationIterationCompleted,
+            this, &VisualizationPage::onRegistrationIteration);
+    connect(service, &RegistrationService::registrationFinished, this, &VisualizationPage::onRegistrationFinished);
+    
+    // 拾取索引在后台建立，完成或点云释放时更新查看器持有的索引
+    connect(service, &RegistrationService::pickIndexReady, this, &VisualizationPage::onPickIndexReady);
 }
 
 void VisualizationPage::buildUI()
@@ -37,6 +59,8 @@ void VisualizationPage::buildUI()
     
     connect(m_viewer, &PointCloudViewer::iterationChanged, 
             this, &VisualizationPage::onIterationChanged);
+    connect(m_viewer, &PointCloudViewer::pointPicked, this, &VisualizationPage::onPointPicked);
+    connect(m_viewer, &PointCloudViewer::distanceMeasured, this, &VisualizationPage::onDistanceMeasured);
     
     // 播放控制组
     QGroupBox* controlGroup = new QGroupBox("迭代回放控制");
@@ -46,13 +70,20 @@ void VisualizationPage::buildUI()
     QHBoxLayout* buttonLayout = new QHBoxLayout();
     m_firstButton = new ElaPushButton("上一迭代", this);
     m_lastButton = new ElaPushButton("下一迭代", this);
+    m_stopButton = new ElaPushButton("停止配准", this);
     
     m_firstButton->setMaximumWidth(120);
     m_lastButton->setMaximumWidth(120);
+    m_stopButton->setMaximumWidth(120);
+    m_stopButton->setEnabled(false);
+    m_measureSwitch = new ElaToggleSwitch(this);
     
     buttonLayout->addWidget(m_firstButton);
     buttonLayout->addWidget(m_lastButton);
     buttonLayout->addStretch();
+    buttonLayout->addWidget(new QLabel("测量距离:"));
+    buttonLayout->addWidget(m_measureSwitch);
+    buttonLayout->addWidget(m_stopButton);
     
     controlLayout->addLayout(buttonLayout);
     
@@ -77,10 +108,16 @@ void VisualizationPage::buildUI()
     m_iterationLabel = new QLabel("迭代: 初始状态");
     m_rmseLabel = new QLabel("RMSE: -");
     m_transformLabel = new QLabel("变换: 无");
+    m_pickLabel = new QLabel("拾取: -");
+    m_distanceLabel = new QLabel("距离: -");
+    m_pickLabel->setVisible(false);
+    m_distanceLabel->setVisible(false);
     
     infoLayout->addWidget(m_iterationLabel);
     infoLayout->addWidget(m_rmseLabel);
     infoLayout->addWidget(m_transformLabel);
+    infoLayout->addWidget(m_pickLabel);
+    infoLayout->addWidget(m_distanceLabel);
     
     infoGroup->setLayout(infoLayout);
     mainLayout->addWidget(infoGroup);
@@ -88,7 +125,9 @@ void VisualizationPage::buildUI()
     // 连接信号
     connect(m_firstButton, &ElaPushButton::clicked, this, &VisualizationPage::onFirstFrame);
     connect(m_lastButton, &ElaPushButton::clicked, this, &VisualizationPage::onLastFrame);
+    connect(m_stopButton, &ElaPushButton::clicked, this, &VisualizationPage::onStopRegistration);
     connect(m_iterationSlider, &ElaSlider::valueChanged, this, &VisualizationPage::onSliderChanged);
+    connect(m_measureSwitch, &ElaToggleSwitch::toggled, this, &VisualizationPage::onMeasureToggled);
     
     // 初始禁用控制
     updatePlaybackControls();
@@ -98,25 +137,39 @@ void VisualizationPage::updateViewer()
 {
     if (!m_registrationService) return;
     
-    // 使用原始源点云而不是变换后的源点云
+    // 使用原始源点云而不是变换后的源点云，全部点加载完成前显示探查时读取的预览点，
+    // 后台加载期间查看器显示流式分块，加载完成后再设置完整的点云
     const PointCloud* originalSource = m_registrationService->getOriginalSourceCloud();
-    if (originalSource) {
-        // 创建副本,因为viewer需要可修改的指针
-        PointCloud* sourceCopy = new PointCloud();
-        sourceCopy->points = originalSource->points;
-        sourceCopy->color = originalSource->color;
-        sourceCopy->computeBounds();
-        m_viewer->setSourceCloud(sourceCopy);
+    if (!originalSource) {
+        originalSource = m_registrationService->getSourcePreview();
+    }
+    if (originalSource && !m_registrationService->isLoadingSource()) {
+        // 查看器只读取点云，回放时在GPU上应用迭代变换
+        m_viewer->setSourceCloud(originalSource);
+    }
+    
+    const PointCloud* target = m_registrationService->getTargetCloud();
+    if (!target) {
+        target = m_registrationService->getTargetPreview();
+    }
+    if (!m_registrationService->isLoadingTarget()) {
+        m_viewer->setTargetCloud(target);
     }
     
-    m_viewer->setTargetCloud(const_cast<PointCloud*>(m_registrationService->getTargetCloud()));
+    // 新加载的点云在测量时补建索引
+    if (m_viewer->isPickingEnabled()) {
+        m_registrationService->buildPickIndexes();
+    }
 }
 
 void VisualizationPage::loadIterationHistory(const std::vector<IterationResult>& history)
 {
+    // 配准结束后停在最终结果，与实时显示的最后一帧一致
+    const int last = static_cast<int>(history.size()) - 1;
     m_viewer->setIterationHistory(history);
-    m_iterationSlider->setRange(-1, static_cast<int>(history.size()) - 1);
-    m_iterationSlider->setValue(-1);
+    m_iterationSlider->setRange(-1, last);
+    m_iterationSlider->setValue(last);
+    m_viewer->setCurrentIteration(last);
     updatePlaybackControls();
     updateIterationInfo();
 }
@@ -154,6 +207,97 @@ void VisualizationPage::onIterationChanged(int iteration)
     updateIterationInfo();
 }
 
+void VisualizationPage::onStopRegistration()
+{
+    if (m_registrationService) {
+        m_registrationService->stopRegistration();
+    }
+}
+
+void VisualizationPage::onRegistrationStarted()
+{
+    // 回放控制在配准期间不可用，源点云从初始位置开始实时更新
+    m_viewer->setLiveTransform(Eigen::Matrix4d::Identity());
+    m_firstButton->setEnabled(false);
+    m_lastButton->setEnabled(false);
+    m_iterationSlider->setEnabled(false);
+    m_stopButton->setEnabled(true);
+    m_iterationLabel->setText("迭代: 配准中");
+    m_rmseLabel->setText("RMSE: -");
+    m_transformLabel->setText("变换: 实时显示");
+}
+
+void VisualizationPage::onRegistrationIteration(const IterationResult& result)
+{
+    // 只在实时显示期间更新(配准开始信号之前或失败之后到达的迭代忽略)
+    if (!m_viewer->hasLiveTransform()) {
+        return;
+    }
+    m_viewer->setLiveTransform(result.transform);
+    m_iterationLabel->setText(QString("迭代: %1 (实时)").arg(result.iteration));
+    m_rmseLabel->setText(QString("RMSE: %1").arg(result.rmse, 0, 'f', 6));
+}
+
+void VisualizationPage::onRegistrationFinished(bool success, const QString& message)
+{
+    Q_UNUSED(message);
+    m_stopButton->setEnabled(false);
+    
+    // 成功时由迭代历史接管显示(loadIterationHistory)，失败或停止时源点云回到初始位置
+    if (!success) {
+        m_viewer->clearLiveTransform();
+        updatePlaybackControls();
+        updateIterationInfo();
+    }
+}
+
+void VisualizationPage::onMeasureToggled(bool enabled)
+{
+    // 索引只在需要测量时建立
+    m_viewer->setPickingEnabled(enabled);
+    m_pickLabel->setVisible(enabled);
+    m_distanceLabel->setVisible(enabled);
+    m_pickLabel->setText("拾取: -");
+    m_distanceLabel->setText("距离: -");
+    if (enabled && m_registrationService) {
+        m_pickLabel->setText("拾取: 正在建立索引...");
+        m_registrationService->buildPickIndexes();
+    }
+}
+
+void VisualizationPage::onPickIndexReady()
+{
+    m_viewer->setPickIndexes(m_registrationService->getSourcePickIndex(),
+                             m_registrationService->getTargetPickIndex());
+    if (m_viewer->isPickingEnabled()) {
+        m_pickLabel->setText("拾取: 单击点云选择测量起点");
+    }
+}
+
+void VisualizationPage::onPointPicked(const PointCloudViewer::PickResult& result)
+{
+    if (!result.hit) {
+        m_pickLabel->setText("拾取: 光标附近没有点");
+        return;
+    }
+    m_pickLabel->setText(QString("拾取: %1点云 #%2 (%3, %4, %5)")
+                         .arg(result.isSource ? "源" : "目标")
+                         .arg(result.index)
+                         .arg(result.position.x(), 0, 'f', 3)
+                         .arg(result.position.y(), 0, 'f', 3)
+                         .arg(result.position.z(), 0, 'f', 3));
+}
+
+void VisualizationPage::onDistanceMeasured(const Eigen::Vector3d& from, const Eigen::Vector3d& to)
+{
+    const Eigen::Vector3d delta = to - from;
+    m_distanceLabel->setText(QString("距离: %1 (dx %2, dy %3, dz %4)")
+                             .arg(delta.norm(), 0, 'f', 4)
+                             .arg(delta.x(), 0, 'f', 4)
+                             .arg(delta.y(), 0, 'f', 4)
+                             .arg(delta.z(), 0, 'f', 4));
+}
+
 void VisualizationPage::updatePlaybackControls()
 {
     bool hasHistory = m_viewer->getIterationCount() > 0;
@@ -9,6 +9,7 @@
 class ElaPushButton;
 class ElaSlider;
 class ElaText;
+class ElaToggleSwitch;
 class QLabel;
 
 /**
@@ -34,6 +35,18 @@ private slots:
     void onLastFrame();
     void onSliderChanged(int value);
     void onIterationChanged(int iteration);
+    void onStopRegistration();
+    
+    // 配准过程的实时显示
+    void onRegistrationStarted();
+    void onRegistrationIteration(const IterationResult& result);
+    void onRegistrationFinished(bool success, const QString& message);
+    
+    // 拾取和测量
+    void onMeasureToggled(bool enabled);
+    void onPickIndexReady();
+    void onPointPicked(const PointCloudViewer::PickResult& result);
+    void onDistanceMeasured(const Eigen::Vector3d& from, const Eigen::Vector3d& to);
     
 private:
     void buildUI();
@@ -46,12 +59,16 @@ private:
     // 播放控制
     ElaPushButton* m_firstButton;
     ElaPushButton* m_lastButton;
+    ElaPushButton* m_stopButton;        // 实时显示时提前停止配准
     ElaSlider* m_iterationSlider;
+    ElaToggleSwitch* m_measureSwitch;   // 开启后单击拾取点、测量两点距离
     
     // 信息显示
     QLabel* m_iterationLabel;
     QLabel* m_rmseLabel;
     QLabel* m_transformLabel;
+    QLabel* m_pickLabel;
+    QLabel* m_distanceLabel;
 };
 
 #endif // VISUALIZATIONPAGE_H
@@ -0,0 +1,61 @@
+#include "gluploadthread.h"
+#include <QOpenGLContext>
+#include <QOpenGLFunctions>
+#include <QOffscreenSurface>
+#include <QDebug>
+
+GLUploadThread::GLUploadThread(QOpenGLContext* shareContext)
+    : m_worker(nullptr)
+    , m_context(new QOpenGLContext())
+    , m_surface(new QOffscreenSurface())
+    , m_stopping(false)
+{
+    // 上下文和离屏表面都要在界面线程中创建，之后上下文移到上传线程
+    m_context->setFormat(shareContext->format());
+    m_context->setShareContext(shareContext);
+    if (!m_context->create() || !m_context->shareContext()) {
+        qWarning() << "无法创建共享的OpenGL上下文，顶点缓冲改在界面线程中上传";
+        return;
+    }
+    m_surface->setFormat(m_context->format());
+    m_surface->create();
+    if (!m_surface->isValid()) {
+        qWarning() << "无法创建离屏表面，顶点缓冲改在界面线程中上传";
+        return;
+    }
+    
+    m_worker = new QObject();
+    m_worker->moveToThread(&m_thread);
+    m_context->moveToThread(&m_thread);
+    m_thread.start();
+}
+
+GLUploadThread::~GLUploadThread()
+{
+    if (m_worker) {
+        // 排队中的任务直接跳过，最后一个任务释放上下文并结束事件循环
+        m_stopping = true;
+        QMetaObject::invokeMethod(m_worker, [this]() {
+            m_context->doneCurrent();
+            m_thread.quit();
+        }, Qt::QueuedConnection);
+        m_thread.wait();
+        delete m_worker;
+    }
+    delete m_context;
+    delete m_surface;
+}
+
+void GLUploadThread::post(QObject* receiver, Task task)
+{
+    QMetaObject::invokeMethod(m_worker, [this, receiver, task]() {
+        if (m_stopping || !m_context->makeCurrent(m_surface)) {
+            return;
+        }
+        std::function<void()> done = task();
+        m_context->functions()->glFinish();
+        if (done) {
+            QMetaObject::invokeMethod(receiver, done, Qt::QueuedConnection);
+        }
+    }, Qt::QueuedConnection);
+}
@@ -0,0 +1,42 @@
+#ifndef GLUPLOADTHREAD_H
+#define GLUPLOADTHREAD_H
+
+#include <QThread>
+#include <atomic>
+#include <functional>
+
+class QOpenGLContext;
+class QOffscreenSurface;
+
+/**
+ * @brief 后台OpenGL上传线程
+ *
+ * 持有一个与给定上下文共享对象的离屏上下文，提交的任务在独立线程中按提交顺序执行，
+ * 执行时该上下文为当前，可以创建和填充缓冲对象。每个任务之后先调用glFinish，
+ * 再把任务返回的回调排队到接收者所在的线程，回调执行时上传的数据对共享组中的其他上下文已经可用。
+ */
+class GLUploadThread
+{
+public:
+    // 在上传线程中执行，返回上传完成后在接收者线程中执行的回调(可为空)
+    using Task = std::function<std::function<void()>()>;
+    
+    // 在界面线程中创建，shareContext为需要使用上传结果的上下文
+    explicit GLUploadThread(QOpenGLContext* shareContext);
+    ~GLUploadThread();      // 丢弃尚未执行的任务，等待当前任务结束
+    
+    // 共享上下文是否创建成功(失败时调用者应在自己的上下文中上传)
+    bool isValid() const { return m_worker != nullptr; }
+    
+    // 提交任务(线程安全)，receiver须比本对象存在得更久
+    void post(QObject* receiver, Task task);
+    
+private:
+    QThread m_thread;
+    QObject* m_worker;              // 属于上传线程，任务排队到该线程的事件循环中执行
+    QOpenGLContext* m_context;
+    QOffscreenSurface* m_surface;
+    std::atomic<bool> m_stopping;
+};
+
+#endif // GLUPLOADTHREAD_H
@@ -1,16 +1,152 @@
 #include "pointcloudviewer.h"
+#include "gluploadthread.h"
+#include "core/parallel.h"
+#include "core/octree.h"
 #include <QOpenGLContext>
+#include <QOpenGLShaderProgram>
+#include <QOpenGLTimerQuery>
+#include <QFutureWatcher>
+#include <QtConcurrent>
+#include <QElapsedTimer>
+#include <QPainter>
+#include <QTimer>
+#include <QDebug>
+#include <algorithm>
 #include <cmath>
+#include <climits>
+#include <limits>
+
+namespace {
+
+// 点着色器：只做MVP变换和单色输出(GLSL 1.10 / ES 2.0)
+const char* const POINT_VERTEX_SHADER =
+    "attribute highp vec3 position;\n"
+    "uniform highp mat4 mvp;\n"
+    "void main()\n"
+    "{\n"
+    "    gl_Position = mvp * vec4(position, 1.0);\n"
+    "}\n";
+
+const char* const POINT_FRAGMENT_SHADER =
+    "uniform lowp vec4 color;\n"
+    "void main()\n"
+    "{\n"
+    "    gl_FragColor = color;\n"
+    "}\n";
+
+// 残差着色器：残差按离群点阈值归一化后映射到蓝-青-绿-黄-红色带，超过阈值的离群点为灰色
+const char* const RESIDUAL_VERTEX_SHADER =
+    "attribute highp vec3 position;\n"
+    "attribute highp float residual;\n"
+    "uniform highp mat4 mvp;\n"
+    "uniform highp float residualScale;\n"
+    "varying lowp vec4 fragColor;\n"
+    "void main()\n"
+    "{\n"
+    "    gl_Position = mvp * vec4(position, 1.0);\n"
+    "    highp float t = residual * residualScale;\n"
+    "    if (t > 1.0) {\n"
+    "        fragColor = vec4(0.5, 0.5, 0.5, 1.0);\n"
+    "    } else {\n"
+    "        fragColor = vec4(clamp(1.5 - abs(4.0 * t - vec3(3.0, 2.0, 1.0)), 0.0, 1.0), 1.0);\n"
+    "    }\n"
+    "}\n";
+
+const char* const RESIDUAL_FRAGMENT_SHADER =
+    "varying lowp vec4 fragColor;\n"
+    "void main()\n"
+    "{\n"
+    "    gl_FragColor = fragColor;\n"
+    "}\n";
+
+constexpr int POSITION_LOCATION = 0;
+constexpr int RESIDUAL_LOCATION = 1;
+
+// 上传时每个转换任务的最小点数
+constexpr size_t UPLOAD_MIN_CHUNK = 262144;
+
+// 垂直视角(度)
+constexpr float FIELD_OF_VIEW = 45.0f;
+
+// 交互时每帧默认绘制的点数，相机静止后最多放宽到该值的REFINE_MAX_FACTOR倍
+constexpr size_t DEFAULT_POINT_BUDGET = 2000000;
+constexpr size_t REFINE_MAX_FACTOR = 8;
+
+// 最后一次交互后开始细化的延迟，以及两次细化之间的间隔(毫秒)
+constexpr int REFINE_DELAY_MS = 200;
+constexpr int REFINE_INTERVAL_MS = 30;
+
+// 节点抽样间距约为立方体边长的1/128，投影半径小于64像素时点间距已不到1像素，不再细分
+constexpr float MIN_NODE_PIXELS = 64.0f;
+
+// 流式分块的交错步长：分块中的点按 i mod 16 分组排列，超出预算时只绘制每块的前一部分
+constexpr size_t STREAM_INTERLEAVE = 16;
+
+// 拾取半径(像素)，以及按下到松开移动不超过该距离时视为单击而不是旋转
+constexpr double PICK_RADIUS_PIXELS = 5.0;
+constexpr int PICK_CLICK_TOLERANCE = 4;
+
+// 把一段点转换为相对于origin的float顶点并交错重排，任意前缀都是这段点的均匀抽样
+void convertBatch(const std::vector<Point3D>& points, const Eigen::Vector3d& origin,
+                  std::vector<float>& vertices, Eigen::AlignedBox3f& bounds)
+{
+    vertices.resize(points.size() * 3);
+    float* out = vertices.data();
+    for (size_t phase = 0; phase < STREAM_INTERLEAVE; ++phase) {
+        for (size_t i = phase; i < points.size(); i += STREAM_INTERLEAVE) {
+            out[0] = static_cast<float>(points[i].x - origin.x());
+            out[1] = static_cast<float>(points[i].y - origin.y());
+            out[2] = static_cast<float>(points[i].z - origin.z());
+            bounds.extend(Eigen::Vector3f(out[0], out[1], out[2]));
+            out += 3;
+        }
+    }
+}
+
+// convertBatch的逆过程：把交错排列的count个顶点按原来的顺序写入out
+void deinterleave(const float* vertices, size_t count, float* out)
+{
+    for (size_t phase = 0; phase < STREAM_INTERLEAVE; ++phase) {
+        for (size_t i = phase; i < count; i += STREAM_INTERLEAVE) {
+            std::copy(vertices, vertices + 3, out + 3 * i);
+            vertices += 3;
+        }
+    }
+}
+
+// 编译链接点云着色器，失败时返回nullptr
+QOpenGLShaderProgram* createPointProgram(const char* vertexShader, const char* fragmentShader, const char* failure)
+{
+    QOpenGLShaderProgram* program = new QOpenGLShaderProgram();
+    program->bindAttributeLocation("position", POSITION_LOCATION);
+    program->bindAttributeLocation("residual", RESIDUAL_LOCATION);
+    
+    bool ok = program->addShaderFromSourceCode(QOpenGLShader::Vertex, vertexShader)
+           && program->addShaderFromSourceCode(QOpenGLShader::Fragment, fragmentShader)
+           && program->link();
+    if (!ok) {
+        qWarning() << failure << program->log();
+        delete program;
+        return nullptr;
+    }
+    return program;
+}
+
+} // namespace
 
 PointCloudViewer::PointCloudViewer(QWidget *parent)
     : QOpenGLWidget(parent)
     , m_sourceCloud(nullptr)
     , m_targetCloud(nullptr)
-    , m_originalSource(nullptr)
     , m_currentIteration(-1)
+    , m_liveTransform(Eigen::Matrix4d::Identity())
+    , m_hasLiveTransform(false)
+    , m_residualThreshold(0.0)
+    , m_residualsChanged(false)
     , m_cameraPos(0, 0, 5)
     , m_cameraTarget(0, 0, 0)
     , m_cameraUp(0, 1, 0)
+    , m_aspect(1.0f)
     , m_isRotating(false)
     , m_isPanning(false)
     , m_rotationX(0)
@@ -23,43 +159,63 @@ PointCloudViewer::PointCloudViewer(QWidget *parent)
     , m_sourceColor(255, 100, 100)
     , m_targetColor(100, 100, 255)
     , m_pointSize(2.0f)
-    , m_sceneCenter(0, 0, 0)
+    , m_pointProgram(nullptr)
+    , m_residualProgram(nullptr)
+    , m_uploader(nullptr)
+    , m_pointBudget(DEFAULT_POINT_BUDGET)
+    , m_frameBudget(DEFAULT_POINT_BUDGET)
+    , m_lodTruncated(false)
+    , m_refineTimer(new QTimer(this))
+    , m_showStats(false)
+    , m_frameTimers{nullptr, nullptr}
+    , m_frameTimerPending{false, false}
+    , m_frameTimerIndex(0)
+    , m_uploadedBytes(0)
+    , m_uploadNanos(0)
+    , m_pickingEnabled(false)
+    , m_sceneCenter(Eigen::Vector3d::Zero())
     , m_sceneRadius(1.0f)
 {
     setFocusPolicy(Qt::StrongFocus);
+    
+    m_refineTimer->setSingleShot(true);
+    connect(m_refineTimer, &QTimer::timeout, this, &PointCloudViewer::onRefine);
 }
 
 PointCloudViewer::~PointCloudViewer()
 {
-    if (m_originalSource) {
-        delete m_originalSource;
-    }
+    // 先停止上传线程，再在上下文为当前时释放显存资源
+    delete m_uploader;
+    makeCurrent();
+    m_sourceBuffer.chunks.clear();
+    m_targetBuffer.chunks.clear();
+    delete m_pointProgram;
+    delete m_residualProgram;
+    delete m_frameTimers[0];
+    delete m_frameTimers[1];
+    doneCurrent();
 }
 
-void PointCloudViewer::setSourceCloud(PointCloud* cloud)
+void PointCloudViewer::setSourceCloud(const PointCloud* cloud)
 {
-    m_sourceCloud = cloud;
-    
-    // 保存原始源点云副本用于迭代回放
-    if (m_originalSource) {
-        delete m_originalSource;
+    // 配准结束后会用同一个点云重新设置，残差仍然有效
+    if (cloud != m_sourceCloud) {
+        clearSourceResiduals();
+        m_sourceIndex.reset();
     }
-    if (cloud && !cloud->empty()) {
-        m_originalSource = new PointCloud();
-        m_originalSource->points = cloud->points;
-        m_originalSource->color = cloud->color;
-        m_originalSource->computeBounds();
-    } else {
-        m_originalSource = nullptr;
-    }
-    
+    m_sourceCloud = cloud;
+    setBufferCloud(cloud, m_sourceBuffer);
     fitToScreen();
     update();
 }
 
-void PointCloudViewer::setTargetCloud(PointCloud* cloud)
+void PointCloudViewer::setTargetCloud(const PointCloud* cloud)
 {
+    if (cloud != m_targetCloud) {
+        m_targetIndex.reset();
+    }
     m_targetCloud = cloud;
+    setBufferCloud(cloud, m_targetBuffer);
     fitToScreen();
     update();
 }
@@ -68,89 +224,300 @@ void PointCloudViewer::clearClouds()
 {
     m_sourceCloud = nullptr;
     m_targetCloud = nullptr;
-    if (m_originalSource) {
-        delete m_originalSource;
-        m_originalSource = nullptr;
-    }
     m_iterationHistory.clear();
     m_currentIteration = -1;
+    m_hasLiveTransform = false;
+    clearSourceResiduals();
+    m_sourceIndex.reset();
+    m_targetIndex.reset();
+    m_measurePoints.clear();
+    m_sourceBuffer.dirty = true;
+    m_sourceBuffer.streaming = false;
+    m_targetBuffer.dirty = true;
+    m_targetBuffer.streaming = false;
+    update();
+}
+
+void PointCloudViewer::beginSourceStream(const Eigen::AlignedBox3d& bounds, size_t expectedPoints)
+{
+    // 服务已经替换了点云，旧的指针和残差不再使用
+    m_sourceCloud = nullptr;
+    clearSourceResiduals();
+    m_sourceIndex.reset();
+    beginStream(m_sourceBuffer, bounds, expectedPoints);
+    fitToScreen();
     update();
 }
 
+void PointCloudViewer::beginTargetStream(const Eigen::AlignedBox3d& bounds, size_t expectedPoints)
+{
+    m_targetCloud = nullptr;
+    m_targetIndex.reset();
+    beginStream(m_targetBuffer, bounds, expectedPoints);
+    fitToScreen();
+    update();
+}
+
+void PointCloudViewer::appendSourceStream(const PointBatch& batch)
+{
+    appendStream(m_sourceBuffer, batch);
+}
+
+void PointCloudViewer::appendTargetStream(const PointBatch& batch)
+{
+    appendStream(m_targetBuffer, batch);
+}
+
 void PointCloudViewer::setIterationHistory(const std::vector<IterationResult>& history)
 {
     m_iterationHistory = history;
     m_currentIteration = -1;
+    m_hasLiveTransform = false;
+    update();
 }
 
-void PointCloudViewer::setCurrentIteration(int index)
+void PointCloudViewer::setLiveTransform(const Eigen::Matrix4d& transform)
 {
-    if (index < -1 || index >= static_cast<int>(m_iterationHistory.size())) {
-        return;
+    // 迭代比绘制慢得多，连续到达的变换在下一帧合并为一次重绘
+    m_liveTransform = transform;
+    m_hasLiveTransform = true;
+    update();
+}
+
+void PointCloudViewer::clearLiveTransform()
+{
+    m_hasLiveTransform = false;
+    update();
+}
+
+void PointCloudViewer::setSourceResiduals(std::shared_ptr<const std::vector<double>> residuals, double threshold)
+{
+    // 属性缓冲在下一帧(上下文为当前时)按当前的分块重新上传
+    m_residuals = std::move(residuals);
+    m_residualThreshold = threshold;
+    m_residualsChanged = true;
+    update();
+}
+
+void PointCloudViewer::clearSourceResiduals()
+{
+    if (!m_residuals) return;
+    m_residuals.reset();
+    m_residualsChanged = true;
+    update();
+}
+
+void PointCloudViewer::setPickIndexes(std::shared_ptr<const Octree> source, std::shared_ptr<const Octree> target)
+{
+    m_sourceIndex = std::move(source);
+    m_targetIndex = std::move(target);
+}
+
+void PointCloudViewer::setPickingEnabled(bool enabled)
+{
+    if (enabled == m_pickingEnabled) return;
+    m_pickingEnabled = enabled;
+    if (!enabled) {
+        clearMeasurement();
+    }
+}
+
+void PointCloudViewer::clearMeasurement()
+{
+    if (m_measurePoints.empty()) return;
+    m_measurePoints.clear();
+    update();
+}
+
+PointCloudViewer::PickResult PointCloudViewer::pick(const QPoint& pos) const
+{
+    PickResult result;
+    if (width() <= 0 || height() <= 0) {
+        return result;
     }
     
-    m_currentIteration = index;
+    // 由最近一帧的相机矩阵反投影出视线(相对于场景中心)，再换算到点云坐标
+    const Eigen::Matrix4d view = Eigen::Map<const Eigen::Matrix4f>(m_view.constData()).cast<double>();
+    const Eigen::Matrix4d viewProjection =
+        Eigen::Map<const Eigen::Matrix4f>((m_projection * m_view).constData()).cast<double>();
+    const Eigen::Vector3d eye = view.inverse().col(3).hnormalized();
+    const Eigen::Vector4d ndc(2.0 * pos.x() / width() - 1.0, 1.0 - 2.0 * pos.y() / height(), 1.0, 1.0);
+    const Eigen::Vector3d farPoint = (viewProjection.inverse() * ndc).hnormalized();
+    const Eigen::Vector3d direction = (farPoint - eye).normalized();
+    const Eigen::Vector3d origin = eye + m_sceneCenter;
+    
+    // 屏幕上的拾取半径对应的圆锥半角：深度d处一个像素约为 2*d*tan(fov/2)/height
+    const double tanHalfAngle = PICK_RADIUS_PIXELS * 2.0 * std::tan(FIELD_OF_VIEW * M_PI / 360.0) / height();
     
-    // 应用变换到源点云
-    if (m_sourceCloud && m_originalSource && !m_originalSource->empty()) {
-        m_sourceCloud->points = m_originalSource->points;
+    auto query = [&](const Octree* index, const PointCloud* cloud, const Eigen::Affine3d& transform, bool isSource) {
+        if (!index || !cloud) return;
         
-        if (index >= 0 && index < static_cast<int>(m_iterationHistory.size())) {
-            const auto& transform = m_iterationHistory[index].transform;
-            
-            // 转换Eigen矩阵为数组格式
-            double R[3][3], t[3];
-            for (int i = 0; i < 3; i++) {
-                for (int j = 0; j < 3; j++) {
-                    R[i][j] = transform(i, j);
-                }
-                t[i] = transform(i, 3);
-            }
-            
-            m_sourceCloud->applyTransform(R, t);
+        // 变换是刚体变换，点云坐标中的深度与场景坐标相同
+        const Eigen::Affine3d inverse = transform.inverse();
+        const Eigen::Vector3d localOrigin = inverse * origin;
+        const Eigen::Vector3d localDirection = (inverse.linear() * direction).normalized();
+        size_t idx = 0;
+        double depth = 0.0;
+        if (!index->pickRay(Point3D(localOrigin.x(), localOrigin.y(), localOrigin.z()),
+                            Point3D(localDirection.x(), localDirection.y(), localDirection.z()),
+                            tanHalfAngle, idx, depth)
+            || idx >= cloud->size() || (result.hit && depth >= result.depth)) {
+            return;
         }
+        const Point3D& p = cloud->points[idx];
+        result.hit = true;
+        result.isSource = isSource;
+        result.index = idx;
+        result.position = transform * Eigen::Vector3d(p.x, p.y, p.z);
+        result.depth = depth;
+    };
+    query(m_targetIndex.get(), m_targetCloud, Eigen::Affine3d::Identity(), false);
+    query(m_sourceIndex.get(), m_sourceCloud, currentSourceTransform(), true);
+    return result;
+}
+
+void PointCloudViewer::handlePick(const QPoint& pos)
+{
+    const PickResult result = pick(pos);
+    emit pointPicked(result);
+    if (!result.hit) return;
+    
+    // 已有完整的一段测量时重新开始
+    if (m_measurePoints.size() >= 2) {
+        m_measurePoints.clear();
+    }
+    m_measurePoints.push_back(result.position);
+    if (m_measurePoints.size() == 2) {
+        emit distanceMeasured(m_measurePoints[0], m_measurePoints[1]);
+    }
+    update();
+}
+
+Eigen::Affine3d PointCloudViewer::currentSourceTransform() const
+{
+    if (m_hasLiveTransform) {
+        return Eigen::Affine3d(m_liveTransform);
+    }
+    if (m_currentIteration >= 0 && m_currentIteration < static_cast<int>(m_iterationHistory.size())) {
+        return Eigen::Affine3d(m_iterationHistory[m_currentIteration].transform);
+    }
+    return Eigen::Affine3d::Identity();
+}
+
+void PointCloudViewer::setCurrentIteration(int index)
+{
+    if (index < -1 || index >= static_cast<int>(m_iterationHistory.size())) {
+        return;
     }
     
+    // 只切换绘制源点云时使用的模型矩阵，顶点缓冲和点云数据都不变
+    m_currentIteration = index;
+    
     emit iterationChanged(index);
     update();
 }
 
 void PointCloudViewer::setShowGrid(bool show)
 {
+    // 设置页每次应用都会重新设置全部显示选项，值不变时不重绘
+    if (m_showGrid == show) return;
     m_showGrid = show;
     update();
 }
 
 void PointCloudViewer::setShowAxes(bool show)
 {
+    if (m_showAxes == show) return;
     m_showAxes = show;
     update();
 }
 
 void PointCloudViewer::setSmoothRendering(bool smooth)
 {
+    if (m_smoothRendering == smooth) return;
     m_smoothRendering = smooth;
     update();
 }
 
 void PointCloudViewer::setSourceColor(const QColor& color)
 {
+    if (m_sourceColor == color) return;
     m_sourceColor = color;
     update();
 }
 
 void PointCloudViewer::setTargetColor(const QColor& color)
 {
+    if (m_targetColor == color) return;
     m_targetColor = color;
     update();
 }
 
 void PointCloudViewer::setPointSize(float size)
 {
+    if (m_pointSize == size) return;
     m_pointSize = size;
     update();
 }
 
+void PointCloudViewer::setShowStats(bool show)
+{
+    if (m_showStats == show) return;
+    m_showStats = show;
+    update();
+}
+
+PointCloudViewer::RenderStats PointCloudViewer::renderStats() const
+{
+    // 显存占用和上传量随时可能变化(上传线程)，查询时计算
+    RenderStats stats = m_stats;
+    stats.pointsResident = m_sourceBuffer.count + m_targetBuffer.count;
+    stats.chunksResident = m_sourceBuffer.chunks.size() + m_targetBuffer.chunks.size();
+    stats.gpuBufferBytes = stats.pointsResident * 3 * sizeof(float);
+    for (const PointChunk& chunk : m_sourceBuffer.chunks) {
+        if (chunk.residualVbo.isCreated()) {
+            stats.gpuBufferBytes += static_cast<size_t>(chunk.count) * sizeof(float);
+        }
+    }
+    stats.uploadedBytes = m_uploadedBytes.load();
+    stats.uploadTimeMs = m_uploadNanos.load() / 1e6;
+    return stats;
+}
+
+void PointCloudViewer::setPointBudget(size_t budget)
+{
+    budget = std::max<size_t>(budget, LODOctree::NODE_CAPACITY);
+    if (budget == m_pointBudget) return;
+    m_pointBudget = budget;
+    
+    // 没有构建细节层次的点云超出新的预算时重新上传
+    if (!m_sourceBuffer.streaming && m_sourceBuffer.lod.empty() && m_sourceBuffer.count > m_pointBudget) {
+        m_sourceBuffer.dirty = true;
+    }
+    if (!m_targetBuffer.streaming && m_targetBuffer.lod.empty() && m_targetBuffer.count > m_pointBudget) {
+        m_targetBuffer.dirty = true;
+    }
+    restartRefinement();
+    update();
+}
+
+void PointCloudViewer::restartRefinement()
+{
+    // 相机移动时回到交互预算，停止移动一段时间后再开始细化
+    m_frameBudget = m_pointBudget;
+    m_refineTimer->start(REFINE_DELAY_MS);
+}
+
+void PointCloudViewer::onRefine()
+{
+    const size_t maxBudget = m_pointBudget * REFINE_MAX_FACTOR;
+    if (!m_lodTruncated || m_frameBudget >= maxBudget) {
+        return;
+    }
+    m_frameBudget = std::min(m_frameBudget + m_pointBudget, maxBudget);
+    update();
+}
+
 void PointCloudViewer::resetView()
 {
     m_rotationX = 0;
@@ -158,14 +525,17 @@ void PointCloudViewer::resetView()
     m_zoom = 1.0f;
     m_panOffset = QVector3D(0, 0, 0);
     updateCamera();
+    restartRefinement();
     update();
 }
 
 void PointCloudViewer::fitToScreen()
 {
     // 计算场景边界
-    if (!m_sourceCloud && !m_targetCloud) {
-        m_sceneCenter = QVector3D(0, 0, 0);
+    const bool sourceStream = m_sourceBuffer.streaming && !m_sourceBuffer.streamBounds.isEmpty();
+    const bool targetStream = m_targetBuffer.streaming && !m_targetBuffer.streamBounds.isEmpty();
+    if (!m_sourceCloud && !m_targetCloud && !sourceStream && !targetStream) {
+        m_sceneCenter = Eigen::Vector3d::Zero();
         m_sceneRadius = 1.0f;
         return;
     }
@@ -174,8 +544,8 @@ void PointCloudViewer::fitToScreen()
     double minY = 1e10, maxY = -1e10;
     double minZ = 1e10, maxZ = -1e10;
     
+    // 加载点云时已经计算过边界
     if (m_sourceCloud && !m_sourceCloud->empty()) {
-        const_cast<PointCloud*>(m_sourceCloud)->computeBounds();
         minX = std::min(minX, m_sourceCloud->minX);
         maxX = std::max(maxX, m_sourceCloud->maxX);
         minY = std::min(minY, m_sourceCloud->minY);
@@ -185,7 +555,6 @@ void PointCloudViewer::fitToScreen()
     }
     
     if (m_targetCloud && !m_targetCloud->empty()) {
-        const_cast<PointCloud*>(m_targetCloud)->computeBounds();
         minX = std::min(minX, m_targetCloud->minX);
         maxX = std::max(maxX, m_targetCloud->maxX);
         minY = std::min(minY, m_targetCloud->minY);
@@ -194,16 +563,24 @@ void PointCloudViewer::fitToScreen()
         maxZ = std::max(maxZ, m_targetCloud->maxZ);
     }
     
-    m_sceneCenter = QVector3D(
-        static_cast<float>((minX + maxX) / 2.0),
-        static_cast<float>((minY + maxY) / 2.0),
-        static_cast<float>((minZ + maxZ) / 2.0)
-    );
+    // 流式加载中的点云还不完整，使用预计的包围盒
+    for (const PointBuffer* buffer : {&m_sourceBuffer, &m_targetBuffer}) {
+        if (buffer->streaming && !buffer->streamBounds.isEmpty()) {
+            minX = std::min(minX, buffer->streamBounds.min().x());
+            maxX = std::max(maxX, buffer->streamBounds.max().x());
+            minY = std::min(minY, buffer->streamBounds.min().y());
+            maxY = std::max(maxY, buffer->streamBounds.max().y());
+            minZ = std::min(minZ, buffer->streamBounds.min().z());
+            maxZ = std::max(maxZ, buffer->streamBounds.max().z());
+        }
+    }
+    
+    m_sceneCenter = Eigen::Vector3d((minX + maxX) / 2.0, (minY + maxY) / 2.0, (minZ + maxZ) / 2.0);
     
     double dx = maxX - minX;
     double dy = maxY - minY;
     double dz = maxZ - minZ;
-    m_sceneRadius = static_cast<float>(std::sqrt(dx*dx + dy*dy + dz*dz) / 2.0);
+    m_sceneRadius = std::max(static_cast<float>(std::sqrt(dx*dx + dy*dy + dz*dz) / 2.0), 1e-3f);
     
     // 重置视图
     resetView();
@@ -213,6 +590,62 @@ void PointCloudViewer::initializeGL()
 {
     initializeOpenGLFunctions();
     
+    // 上下文重建(例如窗口重新停靠)后旧的缓冲已经失效，需要重新上传，进行中的上传和流式显示都作废
+    for (PointBuffer* buffer : {&m_sourceBuffer, &m_targetBuffer}) {
+        buffer->chunks.clear();
+        buffer->dirty = true;
+        buffer->streaming = false;
+        ++buffer->generation;
+    }
+    initPointProgram();
+    
+    // GPU计时查询需要OpenGL 3.3或GL_ARB_timer_query，不支持时只统计CPU耗时
+    for (int k = 0; k < 2; ++k) {
+        delete m_frameTimers[k];
+        m_frameTimers[k] = new QOpenGLTimerQuery();
+        if (!m_frameTimers[k]->create()) {
+            delete m_frameTimers[k];
+            m_frameTimers[k] = nullptr;
+        }
+        m_frameTimerPending[k] = false;
+    }
+    if (!m_frameTimers[0] || !m_frameTimers[1]) {
+        delete m_frameTimers[0];
+        delete m_frameTimers[1];
+        m_frameTimers[0] = m_frameTimers[1] = nullptr;
+    }
+    
+    // 上传线程的上下文与本上下文共享缓冲对象，随上下文一起重建
+    delete m_uploader;
+    m_uploader = new GLUploadThread(context());
+    if (!m_uploader->isValid()) {
+        delete m_uploader;
+        m_uploader = nullptr;
+    }
+}
+
+void PointCloudViewer::initPointProgram()
+{
+    delete m_pointProgram;
+    delete m_residualProgram;
+    m_pointProgram = createPointProgram(POINT_VERTEX_SHADER, POINT_FRAGMENT_SHADER,
+                                        "点云着色器编译失败，改用固定管线绘制:");
+    m_residualProgram = m_pointProgram
+        ? createPointProgram(RESIDUAL_VERTEX_SHADER, RESIDUAL_FRAGMENT_SHADER, "残差着色器编译失败，不显示残差热图:")
+        : nullptr;
+}
+
+void PointCloudViewer::resizeGL(int w, int h)
+{
+    glViewport(0, 0, w, h);
+    
+    m_aspect = static_cast<float>(w) / static_cast<float>(h > 0 ? h : 1);
+    updateCamera();
+}
+
+void PointCloudViewer::applyRenderState()
+{
+    // 叠加显示用QPainter绘制后会重置深度测试和混合等状态，每帧开始时重新设置
     glClearColor(0.1f, 0.1f, 0.1f, 1.0f);
     glEnable(GL_DEPTH_TEST);
     
@@ -221,20 +654,38 @@ void PointCloudViewer::initializeGL()
         glHint(GL_POINT_SMOOTH_HINT, GL_NICEST);
         glEnable(GL_BLEND);
         glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+    } else {
+        glDisable(GL_POINT_SMOOTH);
+        glDisable(GL_BLEND);
     }
 }
 
-void PointCloudViewer::resizeGL(int w, int h)
-{
-    glViewport(0, 0, w, h);
-    
-    m_projection.setToIdentity();
-    float aspect = static_cast<float>(w) / static_cast<float>(h > 0 ? h : 1);
-    m_projection.perspective(45.0f, aspect, 0.1f, 1000.0f);
-}
-
 void PointCloudViewer::paintGL()
 {
+    QElapsedTimer frameTimer;
+    frameTimer.start();
+    
+    // 先读较早一帧的计时结果，结果还没有返回时不等待，要用的查询仍未完成时本帧不计GPU时间
+    const int timerIndex = m_frameTimerIndex;
+    if (m_frameTimers[0]) {
+        for (int k : {timerIndex, 1 - timerIndex}) {
+            if (m_frameTimerPending[k] && m_frameTimers[k]->isResultAvailable()) {
+                m_stats.gpuTimeMs = m_frameTimers[k]->waitForResult() / 1e6;
+                m_frameTimerPending[k] = false;
+            }
+        }
+    }
+    const bool gpuTiming = m_frameTimers[0] && !m_frameTimerPending[timerIndex];
+    if (gpuTiming) {
+        m_frameTimers[timerIndex]->begin();
+    }
+    
+    ++m_stats.frames;
+    m_stats.pointsVisible = 0;
+    m_stats.pointsDrawn = 0;
+    m_stats.chunksDrawn = 0;
+    
+    applyRenderState();
     glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
     
     updateCamera();
@@ -249,20 +700,95 @@ void PointCloudViewer::paintGL()
         drawAxes();
     }
     
+    // 点云变化后才重新上传顶点缓冲
+    if (m_targetBuffer.dirty) {
+        uploadPointCloud(m_targetCloud, m_targetBuffer);
+    }
+    if (m_sourceBuffer.dirty) {
+        uploadPointCloud(m_sourceCloud, m_sourceBuffer);
+    }
+    
+    // 后台构建完成的细节层次替换预览
+    if (m_targetBuffer.built) {
+        uploadBuiltLOD(m_targetBuffer);
+    }
+    if (m_sourceBuffer.built) {
+        uploadBuiltLOD(m_sourceBuffer);
+    }
+    
     // 设置点大小
     glPointSize(m_pointSize);
     
+    // 两个点云按点数分摊本帧的点数预算
+    const double totalPoints = static_cast<double>(m_targetBuffer.count) + m_sourceBuffer.count;
+    auto budgetShare = [&](const PointBuffer& buffer) {
+        return totalPoints > 0 ? static_cast<size_t>(m_frameBudget * (buffer.count / totalPoints)) : m_frameBudget;
+    };
+    m_lodTruncated = false;
+    
     // 绘制目标点云（蓝色）
-    if (m_targetCloud && !m_targetCloud->empty()) {
-        drawPointCloud(m_targetCloud, m_targetColor);
+    drawPointCloud(m_targetBuffer, m_targetColor, Eigen::Affine3d::Identity(), budgetShare(m_targetBuffer));
+    
+    // 绘制源点云（红色），配准过程中叠加最新的累积变换，回放时叠加当前迭代的累积变换
+    const Eigen::Affine3d sourceTransform = currentSourceTransform();
+    
+    // 残差对应最终配准结果，回放其他迭代和实时显示时用单色(残差属性仍提前上传)
+    const bool finalPose = !m_hasLiveTransform && !m_iterationHistory.empty()
+                           && m_currentIteration == static_cast<int>(m_iterationHistory.size()) - 1;
+    const bool heatmap = prepareResiduals(m_sourceBuffer) && finalPose;
+    drawPointCloud(m_sourceBuffer, m_sourceColor, sourceTransform, budgetShare(m_sourceBuffer), heatmap);
+    
+    // 还有节点因预算不足未绘制时，相机静止后继续细化
+    if (m_lodTruncated && !m_refineTimer->isActive() && m_frameBudget < m_pointBudget * REFINE_MAX_FACTOR) {
+        m_refineTimer->start(m_frameBudget == m_pointBudget ? REFINE_DELAY_MS : REFINE_INTERVAL_MS);
     }
     
-    // 绘制源点云（红色）
-    if (m_sourceCloud && !m_sourceCloud->empty()) {
-        drawPointCloud(m_sourceCloud, m_sourceColor);
+    if (!m_measurePoints.empty()) {
+        drawMeasurement();
+    }
+    
+    if (gpuTiming) {
+        m_frameTimers[timerIndex]->end();
+        m_frameTimerPending[timerIndex] = true;
+        m_frameTimerIndex = 1 - timerIndex;
+    }
+    m_stats.frameTimeMs = frameTimer.nsecsElapsed() / 1e6;
+    
+    if (m_showStats) {
+        drawStatsOverlay();
     }
 }
 
+void PointCloudViewer::drawStatsOverlay()
+{
+    const RenderStats stats = renderStats();
+    auto millions = [](size_t n) { return QString::number(n / 1e6, 'f', 2) + "M"; };
+    const QString text = QString("帧时间: %1 ms  GPU: %2\n"
+                                 "点数: 绘制 %3 / 可见 %4 / 显存中 %5\n"
+                                 "分块: 绘制 %6 / 显存中 %7  顶点缓冲: %8 MB\n"
+                                 "上传: %9 MB  %10 MB/s")
+        .arg(stats.frameTimeMs, 0, 'f', 2)
+        .arg(stats.gpuTimeMs < 0.0 ? QString("不支持") : QString::number(stats.gpuTimeMs, 'f', 2) + " ms")
+        .arg(millions(stats.pointsDrawn))
+        .arg(millions(stats.pointsVisible))
+        .arg(millions(stats.pointsResident))
+        .arg(stats.chunksDrawn)
+        .arg(stats.chunksResident)
+        .arg(stats.gpuBufferBytes / 1048576.0, 0, 'f', 1)
+        .arg(stats.uploadedBytes / 1048576.0, 0, 'f', 1)
+        .arg(stats.uploadBandwidthMBps(), 0, 'f', 0);
+    
+    // 只在已经需要重绘的帧上叠加，不会额外触发重绘
+    QPainter painter(this);
+    const QRect textRect = painter.fontMetrics().boundingRect(QRect(0, 0, width(), height()),
+                                                              Qt::AlignLeft | Qt::AlignTop, text);
+    const QRect box = textRect.translated(14, 12).adjusted(-6, -4, 6, 4);
+    painter.fillRect(box, QColor(0, 0, 0, 160));
+    painter.setPen(Qt::white);
+    painter.drawText(textRect.translated(14, 12), Qt::AlignLeft | Qt::AlignTop, text);
+    painter.end();
+}
+
 void PointCloudViewer::drawGrid()
 {
     glDisable(GL_DEPTH_TEST);
@@ -280,13 +806,13 @@ void PointCloudViewer::drawGrid()
     
     for (int i = -gridLines; i <= gridLines; i++) {
         float pos = i * step;
-        // X方向线
-        glVertex3f(m_sceneCenter.x() + pos, m_sceneCenter.y() - gridSize, m_sceneCenter.z());
-        glVertex3f(m_sceneCenter.x() + pos, m_sceneCenter.y() - gridSize, m_sceneCenter.z() + gridSize);
+        // X方向线(坐标相对于场景中心)
+        glVertex3f(pos, -gridSize, 0.0f);
+        glVertex3f(pos, -gridSize, gridSize);
         
         // Z方向线
-        glVertex3f(m_sceneCenter.x() - gridSize, m_sceneCenter.y() - gridSize, m_sceneCenter.z() + pos);
-        glVertex3f(m_sceneCenter.x(), m_sceneCenter.y() - gridSize, m_sceneCenter.z() + pos);
+        glVertex3f(-gridSize, -gridSize, pos);
+        glVertex3f(0.0f, -gridSize, pos);
     }
     
     glEnd();
@@ -303,45 +829,525 @@ void PointCloudViewer::drawAxes()
     glLineWidth(2.0f);
     glBegin(GL_LINES);
     
-    // X轴 - 红色
+    // X轴 - 红色(坐标轴画在场景中心)
     glColor3f(1.0f, 0.0f, 0.0f);
-    glVertex3f(m_sceneCenter.x(), m_sceneCenter.y(), m_sceneCenter.z());
-    glVertex3f(m_sceneCenter.x() + axisLength, m_sceneCenter.y(), m_sceneCenter.z());
+    glVertex3f(0.0f, 0.0f, 0.0f);
+    glVertex3f(axisLength, 0.0f, 0.0f);
     
     // Y轴 - 绿色
     glColor3f(0.0f, 1.0f, 0.0f);
-    glVertex3f(m_sceneCenter.x(), m_sceneCenter.y(), m_sceneCenter.z());
-    glVertex3f(m_sceneCenter.x(), m_sceneCenter.y() + axisLength, m_sceneCenter.z());
+    glVertex3f(0.0f, 0.0f, 0.0f);
+    glVertex3f(0.0f, axisLength, 0.0f);
     
     // Z轴 - 蓝色
     glColor3f(0.0f, 0.0f, 1.0f);
-    glVertex3f(m_sceneCenter.x(), m_sceneCenter.y(), m_sceneCenter.z());
-    glVertex3f(m_sceneCenter.x(), m_sceneCenter.y(), m_sceneCenter.z() + axisLength);
+    glVertex3f(0.0f, 0.0f, 0.0f);
+    glVertex3f(0.0f, 0.0f, axisLength);
     
     glEnd();
     glLineWidth(1.0f);
 }
 
-void PointCloudViewer::drawPointCloud(const PointCloud* cloud, const QColor& color)
+void PointCloudViewer::drawMeasurement()
 {
-    if (!cloud || cloud->empty()) return;
-    
+    // 测量点和连线画在点云之上，不被遮挡
+    glDisable(GL_DEPTH_TEST);
     QMatrix4x4 mvp = m_projection * m_view;
     glLoadMatrixf(mvp.constData());
     
-    glColor3f(color.redF(), color.greenF(), color.blueF());
-    
+    glColor3f(1.0f, 0.9f, 0.0f);
+    glPointSize(m_pointSize + 6.0f);
     glBegin(GL_POINTS);
-    for (const auto& p : cloud->points) {
-        glVertex3d(p.x, p.y, p.z);
+    for (const Eigen::Vector3d& point : m_measurePoints) {
+        const Eigen::Vector3f p = (point - m_sceneCenter).cast<float>();
+        glVertex3f(p.x(), p.y(), p.z());
     }
     glEnd();
+    
+    if (m_measurePoints.size() == 2) {
+        const Eigen::Vector3f a = (m_measurePoints[0] - m_sceneCenter).cast<float>();
+        const Eigen::Vector3f b = (m_measurePoints[1] - m_sceneCenter).cast<float>();
+        glLineWidth(2.0f);
+        glBegin(GL_LINES);
+        glVertex3f(a.x(), a.y(), a.z());
+        glVertex3f(b.x(), b.y(), b.z());
+        glEnd();
+        glLineWidth(1.0f);
+    }
+    
+    glPointSize(m_pointSize);
+    glEnable(GL_DEPTH_TEST);
+}
+
+void PointCloudViewer::uploadPointCloud(const PointCloud* cloud, PointBuffer& buffer)
+{
+    buffer.dirty = false;
+    buffer.chunks.clear();      // 上下文为当前时释放旧的缓冲
+    buffer.count = 0;
+    buffer.lod.clear();
+    buffer.order.clear();
+    buffer.built.reset();
+    buffer.streaming = false;
+    buffer.placeholder = false;
+    buffer.streamPieces.clear();
+    buffer.cloud = cloud;
+    buffer.cloudSize = cloud ? cloud->size() : 0;
+    ++buffer.generation;
+    if (!cloud || cloud->empty()) {
+        return;
+    }
+    
+    // 细节层次用32位索引记录节点区间
+    const size_t maxPoints = std::numeric_limits<uint32_t>::max();
+    const size_t n = std::min(cloud->size(), maxPoints);
+    if (n < cloud->size()) {
+        qWarning() << "点数超过细节层次的索引范围，只显示前" << n << "个点";
+    }
+    
+    // 减去场景中心后坐标量级很小，float足以精确显示
+    buffer.origin = m_sceneCenter;
+    std::vector<float> vertices(n * 3);
+    std::vector<Parallel::Range> ranges = Parallel::splitRange(n, UPLOAD_MIN_CHUNK);
+    std::vector<Eigen::AlignedBox3f> rangeBounds(ranges.size());
+    Parallel::forEach(ranges, [&](const Parallel::Range& range) {
+        Eigen::AlignedBox3f& box = rangeBounds[range.index];
+        for (size_t i = range.begin; i < range.end; ++i) {
+            const Point3D& p = cloud->points[i];
+            vertices[3 * i] = static_cast<float>(p.x - buffer.origin.x());
+            vertices[3 * i + 1] = static_cast<float>(p.y - buffer.origin.y());
+            vertices[3 * i + 2] = static_cast<float>(p.z - buffer.origin.z());
+            box.extend(Eigen::Vector3f(vertices[3 * i], vertices[3 * i + 1], vertices[3 * i + 2]));
+        }
+    });
+    
+    // 细节层次构建完成前整个点云作为一个分块
+    buffer.chunks.resize(1);
+    PointChunk& whole = buffer.chunks.front();
+    for (const Eigen::AlignedBox3f& box : rangeBounds) {
+        whole.bounds.extend(box);
+    }
+    
+    // 预算内的点云整体上传，超过预算时上传均匀抽稀的预览
+    if (n <= m_pointBudget) {
+        uploadChunk(whole, vertices.data(), n);
+    } else {
+        const size_t stride = (n + m_pointBudget - 1) / m_pointBudget;
+        std::vector<float> preview;
+        preview.reserve((n + stride - 1) / stride * 3);
+        for (size_t i = 0; i < n; i += stride) {
+            preview.insert(preview.end(), vertices.begin() + 3 * i, vertices.begin() + 3 * i + 3);
+        }
+        uploadChunk(whole, preview.data(), preview.size() / 3);
+    }
+    buffer.count = static_cast<size_t>(whole.count);
+    
+    // 超过一个节点容量的点云在后台构建细节层次，完成后替换为按节点划分的分块
+    if (n > LODOctree::NODE_CAPACITY) {
+        startLODBuild(buffer, std::move(vertices));
+    }
+}
+
+bool PointCloudViewer::uploadBuffer(QOpenGLBuffer& vbo, const void* data, int bytes)
+{
+    if (!vbo.isCreated() && !vbo.create()) {
+        qWarning() << "无法创建顶点缓冲";
+        return false;
+    }
+    QElapsedTimer timer;
+    timer.start();
+    vbo.setUsagePattern(QOpenGLBuffer::StaticDraw);
+    vbo.bind();
+    vbo.allocate(data, bytes);
+    vbo.release();
+    
+    // 统计驱动接收数据的耗时，上传线程中随后的glFinish不计入
+    m_uploadedBytes += static_cast<quint64>(bytes);
+    m_uploadNanos += static_cast<quint64>(timer.nsecsElapsed());
+    return true;
+}
+
+bool PointCloudViewer::uploadChunk(PointChunk& chunk, const float* vertices, size_t count)
+{
+    chunk.count = 0;
+    
+    // 单个缓冲的字节数受int限制
+    if (count > static_cast<size_t>(INT_MAX) / (3 * sizeof(float))) {
+        qWarning() << "分块点数超过单个顶点缓冲的容量:" << count;
+        return false;
+    }
+    if (!uploadBuffer(chunk.vbo, vertices, static_cast<int>(count * 3 * sizeof(float)))) {
+        return false;
+    }
+    chunk.count = static_cast<int>(count);
+    return true;
+}
+
+void PointCloudViewer::setBufferCloud(const PointCloud* cloud, PointBuffer& buffer)
+{
+    // 重复设置缓冲中已有的点云(例如配准结束或另一个点云加载后刷新显示)时保留已上传的分块和细节层次，
+    // 流式加载的结果则继续等待分块或构建
+    const size_t n = cloud ? cloud->size() : 0;
+    if (cloud && cloud == buffer.cloud && n == buffer.cloudSize && !buffer.dirty) {
+        return;
+    }
+    
+    // 加载结束时流式分块保留显示，全部到达后用它们的顶点构建细节层次。分块不完整(例如加载中途才显示查看器)、
+    // 不需要细节层次或超出索引范围时整体重新上传
+    const bool complete = buffer.streaming && n > 0 && buffer.streamPosted == n;
+    if (!complete || n <= LODOctree::NODE_CAPACITY || n > std::numeric_limits<uint32_t>::max()) {
+        buffer.dirty = true;
+        buffer.streaming = false;
+        buffer.streamPieces.clear();
+        return;
+    }
+    buffer.streamFinal = n;
+    buffer.cloud = cloud;
+    buffer.cloudSize = n;
+    if (buffer.streamReceived == n) {
+        startLODBuild(buffer, {}, std::move(buffer.streamPieces));
+        buffer.streamPieces.clear();
+    }
+}
+
+void PointCloudViewer::startLODBuild(PointBuffer& buffer, std::vector<float>&& vertices,
+                                     std::vector<StreamPiece>&& pieces)
+{
+    // 顶点数组由共享指针持有，后台任务和完成回调之间不复制
+    std::shared_ptr<LODBuild> build = std::make_shared<LODBuild>();
+    build->vertices = std::move(vertices);
+    auto streamPieces = std::make_shared<std::vector<StreamPiece>>(std::move(pieces));
+    
+    PointBuffer* target = &buffer;
+    const unsigned generation = buffer.generation;
+    const bool keepOrder = target == &m_sourceBuffer;
+    QFutureWatcher<bool>* watcher = new QFutureWatcher<bool>(this);
+    connect(watcher, &QFutureWatcher<bool>::finished, this, [this, watcher, target, generation, build]() {
+        watcher->deleteLater();
+        
+        // 构建期间点云已经更换或上下文已重建时丢弃结果
+        if (!watcher->result() || target->generation != generation) {
+            return;
+        }
+        if (!m_uploader) {
+            target->built = build;
+            update();
+            return;
+        }
+        
+        // 节点分块在上传线程中上传，界面线程只交换分块
+        m_uploader->post(this, [this, target, generation, build]() -> std::function<void()> {
+            auto chunks = std::make_shared<std::vector<PointChunk>>();
+            size_t count = 0;
+            if (!uploadNodes(*build, *chunks, count)) {
+                return nullptr;     // 保留预览
+            }
+            return [this, target, generation, build, chunks, count]() {
+                if (target->generation != generation) {
+                    return;
+                }
+                target->chunks.swap(*chunks);
+                target->count = count;
+                target->lod = std::move(build->lod);
+                target->order = std::move(build->order);
+                target->streaming = false;
+                target->placeholder = false;
+                update();
+            };
+        });
+    });
+    watcher->setFuture(QtConcurrent::run([build, streamPieces, keepOrder]() {
+        // 流式分块按起始序号拼接并撤销交错重排，逐块释放
+        if (!streamPieces->empty()) {
+            size_t n = 0;
+            for (const StreamPiece& piece : *streamPieces) {
+                n += piece.vertices.size() / 3;
+            }
+            build->vertices.resize(n * 3);
+            for (StreamPiece& piece : *streamPieces) {
+                const size_t count = piece.vertices.size() / 3;
+                if (piece.first + count > n) {
+                    return false;
+                }
+                deinterleave(piece.vertices.data(), count, &build->vertices[3 * piece.first]);
+                std::vector<float>().swap(piece.vertices);
+            }
+        }
+        return build->lod.build(build->vertices, keepOrder ? &build->order : nullptr);
+    }));
+}
+
+bool PointCloudViewer::uploadNodes(const LODBuild& build, std::vector<PointChunk>& chunks, size_t& count)
+{
+    // 顶点已按节点重排，每个节点的连续区间上传为一个分块
+    const std::vector<LODNode>& nodes = build.lod.nodes();
+    chunks.resize(nodes.size());
+    count = 0;
+    for (size_t k = 0; k < nodes.size(); ++k) {
+        chunks[k].bounds = nodes[k].bounds;
+        if (!uploadChunk(chunks[k], &build.vertices[3 * static_cast<size_t>(nodes[k].first)], nodes[k].count)) {
+            return false;
+        }
+        count += nodes[k].count;
+    }
+    return true;
+}
+
+void PointCloudViewer::uploadBuiltLOD(PointBuffer& buffer)
+{
+    std::shared_ptr<LODBuild> build = std::move(buffer.built);
+    std::vector<PointChunk> chunks;
+    size_t count = 0;
+    if (!uploadNodes(*build, chunks, count)) {
+        return;     // 保留预览
+    }
+    
+    // 交换后旧的预览缓冲随局部变量释放
+    buffer.chunks.swap(chunks);
+    buffer.count = count;
+    buffer.lod = std::move(build->lod);
+    buffer.order = std::move(build->order);
+    buffer.streaming = false;
+    buffer.placeholder = false;
+}
+
+void PointCloudViewer::beginStream(PointBuffer& buffer, const Eigen::AlignedBox3d& bounds, size_t expectedPoints)
+{
+    // 之前的上传、细节层次构建和流式分块都作废
+    ++buffer.generation;
+    buffer.dirty = false;
+    buffer.built.reset();
+    buffer.streaming = true;
+    buffer.streamExpected = expectedPoints;
+    buffer.streamBounds = bounds;
+    buffer.streamPieces.clear();
+    buffer.cloud = nullptr;
+    buffer.cloudSize = 0;
+    buffer.streamPosted = 0;
+    buffer.streamReceived = 0;
+    buffer.streamFinal = 0;
+    
+    // 没有细节层次的现有分块(探查预览)保留到第一个分块到达，流式分块沿用它的原点
+    buffer.placeholder = buffer.lod.empty() && !buffer.chunks.empty();
+    if (!buffer.placeholder) {
+        buffer.chunks.clear();
+        buffer.count = 0;
+        buffer.lod.clear();
+        buffer.order.clear();
+        buffer.origin = bounds.isEmpty() ? m_sceneCenter : bounds.center();
+    }
+}
+
+void PointCloudViewer::appendStream(PointBuffer& buffer, const PointBatch& batch)
+{
+    // 上下文还未初始化(查看器尚未显示)时不需要流式显示，加载完成后会整体上传
+    if (!buffer.streaming || !batch.points || batch.points->empty() || !isValid()) {
+        return;
+    }
+    buffer.streamPosted += batch.points->size();
+    
+    // 转换后的顶点保留到加载结束，用于构建细节层次，点的副本随上传任务释放
+    const Eigen::Vector3d origin = buffer.origin;
+    auto upload = [this, batch, origin](PointChunk& chunk, StreamPiece& piece) {
+        piece.first = batch.first;
+        convertBatch(*batch.points, origin, piece.vertices, chunk.bounds);
+        uploadChunk(chunk, piece.vertices.data(), batch.points->size());
+    };
+    if (!m_uploader) {
+        PointChunk chunk;
+        StreamPiece piece;
+        makeCurrent();
+        upload(chunk, piece);
+        addStreamChunk(buffer, chunk, std::move(piece));
+        doneCurrent();
+        return;
+    }
+    
+    // 转换和上传都在上传线程中进行，完成后回到界面线程加入分块，流已经结束或重新开始时丢弃
+    PointBuffer* target = &buffer;
+    const unsigned generation = buffer.generation;
+    m_uploader->post(this, [this, upload, target, generation]() -> std::function<void()> {
+        PointChunk chunk;
+        auto piece = std::make_shared<StreamPiece>();
+        upload(chunk, *piece);
+        return [this, chunk, piece, target, generation]() {
+            if (target->generation == generation) {
+                addStreamChunk(*target, chunk, std::move(*piece));
+            }
+        };
+    });
+}
+
+void PointCloudViewer::addStreamChunk(PointBuffer& buffer, const PointChunk& chunk, StreamPiece&& piece)
+{
+    if (!buffer.streaming) {
+        return;
+    }
+    
+    // 上传失败的分块不显示，顶点仍然用于构建细节层次
+    buffer.streamReceived += piece.vertices.size() / 3;
+    buffer.streamPieces.push_back(std::move(piece));
+    if (chunk.count > 0) {
+        // 第一个分块到达时替换占位的预览
+        if (buffer.placeholder) {
+            buffer.chunks.clear();
+            buffer.count = 0;
+            buffer.placeholder = false;
+        }
+        buffer.chunks.push_back(chunk);
+        buffer.count += static_cast<size_t>(chunk.count);
+        update();
+    }
+    
+    // 加载已经结束时，最后一个分块到达后开始构建细节层次
+    if (buffer.streamFinal != 0 && buffer.streamReceived == buffer.streamFinal) {
+        startLODBuild(buffer, {}, std::move(buffer.streamPieces));
+        buffer.streamPieces.clear();
+    }
+}
+
+bool PointCloudViewer::prepareResiduals(PointBuffer& buffer)
+{
+    // 残差更换后旧的属性缓冲作废，在上下文为当前时释放
+    if (m_residualsChanged) {
+        for (PointChunk& chunk : buffer.chunks) {
+            chunk.residualVbo.destroy();
+        }
+        m_residualsChanged = false;
+    }
+    if (!m_residuals || !m_residualProgram || buffer.streaming || buffer.chunks.empty()) {
+        return false;
+    }
+    
+    // 残差按原始点序排列：有细节层次时经重排顺序对应，否则只有整体上传的单个分块能直接对应
+    // (抽稀预览等细节层次构建完成后再显示热图)
+    const std::vector<double>& residuals = *m_residuals;
+    const bool reordered = !buffer.lod.empty();
+    if (reordered ? buffer.order.size() != residuals.size()
+                  : (buffer.chunks.size() != 1 || static_cast<size_t>(buffer.chunks.front().count) != residuals.size())) {
+        return false;
+    }
+    
+    // 只上传还没有残差属性的分块(细节层次替换预览后的新分块)
+    std::vector<float> values;
+    for (size_t k = 0; k < buffer.chunks.size(); ++k) {
+        PointChunk& chunk = buffer.chunks[k];
+        if (chunk.residualVbo.isCreated()) {
+            continue;
+        }
+        const size_t first = reordered ? buffer.lod.nodes()[k].first : 0;
+        values.resize(static_cast<size_t>(chunk.count));
+        for (size_t i = 0; i < values.size(); ++i) {
+            const double r = residuals[reordered ? buffer.order[first + i] : i];
+            values[i] = std::isfinite(r) ? static_cast<float>(r) : std::numeric_limits<float>::max();
+        }
+        if (!uploadBuffer(chunk.residualVbo, values.data(), static_cast<int>(values.size() * sizeof(float)))) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void PointCloudViewer::drawPointCloud(PointBuffer& buffer, const QColor& color, const Eigen::Affine3d& transform,
+                                      size_t budget, bool residualColors)
+{
+    if (buffer.count == 0) return;
+    
+    // 缓冲中的顶点q = p - origin，变换后相对于场景中心的坐标为 R*q + (R*origin + t - center)，
+    // 平移部分在双精度下计算，上传后场景中心变化(例如加载了另一个点云)也一并补偿
+    Eigen::Matrix<float, 4, 4, Eigen::RowMajor> model = Eigen::Matrix<float, 4, 4, Eigen::RowMajor>::Identity();
+    model.topLeftCorner<3, 3>() = transform.linear().cast<float>();
+    model.topRightCorner<3, 1>() = (transform.linear() * buffer.origin + transform.translation()
+                                    - m_sceneCenter).cast<float>();
+    QMatrix4x4 mvp = m_projection * m_view * QMatrix4x4(model.data());
+    
+    // 在CPU上选出可见分块：有细节层次时按节点可见性、投影大小和预算选取，否则逐块做视锥裁剪
+    const Eigen::Matrix4f modelView = Eigen::Map<const Eigen::Matrix4f>(m_view.constData()) * model;
+    const Eigen::Matrix4f projection = Eigen::Map<const Eigen::Matrix4f>(m_projection.constData());
+    std::vector<uint32_t> visible;
+    double fraction = 1.0;
+    if (buffer.lod.empty()) {
+        const ViewFrustum frustum(projection * modelView);
+        for (uint32_t k = 0; k < buffer.chunks.size(); ++k) {
+            if (frustum.intersects(buffer.chunks[k].bounds)) {
+                visible.push_back(k);
+            }
+        }
+        
+        // 流式分块的点交错存放，预计总点数超出预算时每块按比例只绘制前一部分
+        const size_t expected = std::max(buffer.streamExpected, buffer.count);
+        if (buffer.streaming && !buffer.placeholder && expected > budget) {
+            fraction = static_cast<double>(budget) / expected;
+            m_lodTruncated = true;
+        }
+    } else {
+        bool truncated = false;
+        visible = buffer.lod.select(modelView, projection, static_cast<float>(height()), budget,
+                                    MIN_NODE_PIXELS, &truncated);
+        m_lodTruncated = m_lodTruncated || truncated;
+    }
+    if (visible.empty()) return;
+    
+    auto drawCount = [fraction](const PointChunk& chunk) {
+        return fraction < 1.0 ? static_cast<GLsizei>(std::ceil(chunk.count * fraction)) : chunk.count;
+    };
+    for (uint32_t index : visible) {
+        m_stats.pointsVisible += static_cast<size_t>(buffer.chunks[index].count);
+        m_stats.pointsDrawn += static_cast<size_t>(drawCount(buffer.chunks[index]));
+    }
+    m_stats.chunksDrawn += visible.size();
+    
+    // 分块可能由上传线程的上下文创建，用本上下文的函数绑定
+    if (m_pointProgram) {
+        // 热图的颜色由逐点残差属性在着色器中计算
+        QOpenGLShaderProgram* program = residualColors ? m_residualProgram : m_pointProgram;
+        program->bind();
+        program->setUniformValue("mvp", mvp);
+        if (residualColors) {
+            program->setUniformValue("residualScale",
+                                     m_residualThreshold > 0.0 ? static_cast<float>(1.0 / m_residualThreshold) : 0.0f);
+            program->enableAttributeArray(RESIDUAL_LOCATION);
+        } else {
+            program->setUniformValue("color", color);
+        }
+        program->enableAttributeArray(POSITION_LOCATION);
+        for (uint32_t index : visible) {
+            const PointChunk& chunk = buffer.chunks[index];
+            glBindBuffer(GL_ARRAY_BUFFER, chunk.vbo.bufferId());
+            program->setAttributeBuffer(POSITION_LOCATION, GL_FLOAT, 0, 3);
+            if (residualColors) {
+                glBindBuffer(GL_ARRAY_BUFFER, chunk.residualVbo.bufferId());
+                program->setAttributeBuffer(RESIDUAL_LOCATION, GL_FLOAT, 0, 1);
+            }
+            glDrawArrays(GL_POINTS, 0, drawCount(chunk));
+        }
+        program->disableAttributeArray(POSITION_LOCATION);
+        if (residualColors) {
+            program->disableAttributeArray(RESIDUAL_LOCATION);
+        }
+        program->release();
+    } else {
+        glLoadMatrixf(mvp.constData());
+        glColor3f(color.redF(), color.greenF(), color.blueF());
+        glEnableClientState(GL_VERTEX_ARRAY);
+        for (uint32_t index : visible) {
+            const PointChunk& chunk = buffer.chunks[index];
+            glBindBuffer(GL_ARRAY_BUFFER, chunk.vbo.bufferId());
+            glVertexPointer(3, GL_FLOAT, 0, nullptr);
+            glDrawArrays(GL_POINTS, 0, drawCount(chunk));
+        }
+        glDisableClientState(GL_VERTEX_ARRAY);
+    }
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
 }
 
 void PointCloudViewer::updateCamera()
 {
     float distance = m_sceneRadius * 3.0f / m_zoom;
     
+    // 裁剪面随场景大小变化，米级到公里级的点云都不会被裁掉
+    m_projection.setToIdentity();
+    m_projection.perspective(FIELD_OF_VIEW, m_aspect, distance * 0.01f, distance + m_sceneRadius * 4.0f);
+    
     m_view.setToIdentity();
     
     // 先移动到观察位置
@@ -351,10 +1357,8 @@ void PointCloudViewer::updateCamera()
     m_view.rotate(m_rotationX, 1, 0, 0);
     m_view.rotate(m_rotationY, 0, 1, 0);
     
-    // 应用平移偏移
-    m_view.translate(-m_sceneCenter.x() - m_panOffset.x(), 
-                     -m_sceneCenter.y() - m_panOffset.y(), 
-                     -m_sceneCenter.z() - m_panOffset.z());
+    // 应用平移偏移(场景坐标已经相对于场景中心)
+    m_view.translate(-m_panOffset.x(), -m_panOffset.y(), -m_panOffset.z());
 }
 
 void PointCloudViewer::mousePressEvent(QMouseEvent *event)
@@ -363,6 +1367,7 @@ void PointCloudViewer::mousePressEvent(QMouseEvent *event)
     
     if (event->button() == Qt::LeftButton) {
         m_isRotating = true;
+        m_pressPos = event->pos();
     } else if (event->button() == Qt::RightButton || event->button() == Qt::MiddleButton) {
         m_isPanning = true;
     }
@@ -381,11 +1386,13 @@ void PointCloudViewer::mouseMoveEvent(QMouseEvent *event)
         if (m_rotationX > 89.0f) m_rotationX = 89.0f;
         if (m_rotationX < -89.0f) m_rotationX = -89.0f;
         
+        restartRefinement();
         update();
     } else if (m_isPanning) {
         float panSpeed = m_sceneRadius * 0.001f;
         m_panOffset.setX(m_panOffset.x() + delta.x() * panSpeed);
         m_panOffset.setY(m_panOffset.y() - delta.y() * panSpeed);
+        restartRefinement();
         update();
     }
 }
@@ -394,6 +1401,11 @@ void PointCloudViewer::mouseReleaseEvent(QMouseEvent *event)
 {
     if (event->button() == Qt::LeftButton) {
         m_isRotating = false;
+        
+        // 没有拖动的左键单击用于拾取
+        if (m_pickingEnabled && (event->pos() - m_pressPos).manhattanLength() <= PICK_CLICK_TOLERANCE) {
+            handlePick(event->pos());
+        }
     } else if (event->button() == Qt::RightButton || event->button() == Qt::MiddleButton) {
         m_isPanning = false;
     }
@@ -408,5 +1420,6 @@ void PointCloudViewer::wheelEvent(QWheelEvent *event)
     if (m_zoom < 0.1f) m_zoom = 0.1f;
     if (m_zoom > 10.0f) m_zoom = 10.0f;
     
+    restartRefinement();
     update();
 }
@@ -3,37 +3,86 @@
 
 #include <QOpenGLWidget>
 #include <QOpenGLFunctions>
+#include <QOpenGLBuffer>
 #include <QMatrix4x4>
 #include <QVector3D>
 #include <QMouseEvent>
 #include <QWheelEvent>
+#include <atomic>
+#include <memory>
 #include "core/pointcloud.h"
 #include "core/icpengine.h"
+#include "core/lodoctree.h"
+
+class QOpenGLShaderProgram;
+class QOpenGLTimerQuery;
+class Octree;
+class QTimer;
+class GLUploadThread;
 
 /**
  * @brief OpenGL点云查看器
  * 
- * 支持3D点云显示、交互控制和迭代回放
+ * 支持3D点云显示、交互控制和迭代回放(迭代的累积变换作为模型矩阵在GPU上应用)。
+ * 点坐标减去场景原点后以float上传到顶点缓冲，只在点云变化时重新上传，
+ * 场景原点用双精度保存，大地坐标也不会损失显示精度。
+ *
+ * 点云在后台构建细节层次八叉树(构建期间显示整体或均匀抽稀的预览)，每个节点单独上传为一个
+ * 带包围盒的顶点缓冲分块。每帧先在CPU上剔除视锥体外和投影不到一个像素的分块，再按投影大小
+ * 在点数预算内选取，交互时帧率与点云规模基本无关；相机停止移动后逐步增加预算，细化到完整密度。
+ *
+ * 顶点缓冲在与本上下文共享的后台上下文中上传(见GLUploadThread)。后台加载的点云可以流式显示：
+ * 每个已解码的分块到达后立即转换上传，加载完成前就能看到逐步填满的点云，加载完成后分块继续显示，
+ * 细节层次由分块的顶点在后台构建。
+ *
+ * 配准导出残差后，源点云可以按残差着色：残差作为逐点属性上传，颜色在着色器中按色带计算。
+ *
+ * 只在显示内容变化时重绘(设置的值不变时不触发重绘)。每帧记录渲染统计，可以叠加显示在视图左上角，
+ * 也可以通过renderStats()查询。
+ *
+ * 启用拾取后，左键单击沿视线在点云的八叉树中查询屏幕上最靠近光标、离相机最近的点，连续两次拾取测量距离。
+ * 索引由调用者提供(见RegistrationService::buildPickIndexes)，查询不读取显存。
  */
 class PointCloudViewer : public QOpenGLWidget, protected QOpenGLFunctions
 {
     Q_OBJECT
-
+    
 public:
     explicit PointCloudViewer(QWidget *parent = nullptr);
     ~PointCloudViewer() override;
     
-    // 点云数据
-    void setSourceCloud(PointCloud* cloud);
-    void setTargetCloud(PointCloud* cloud);
+    // 点云数据(只读，调用者保证在查看器使用期间有效)。重复设置已显示的点云(指针和点数相同)时不重新上传。
+    // 流式显示期间设置的点云视为加载结果，已显示的分块保留，全部分块到达后由它们的顶点在后台构建细节层次，
+    // 不再整体重新上传
+    void setSourceCloud(const PointCloud* cloud);
+    void setTargetCloud(const PointCloud* cloud);
     void clearClouds();
     
+    // 流式显示后台加载中的点云：开始时给出预计的包围盒和点数，之后逐块追加已解码的点，
+    // 设置加载结果或清空点云时结束。当前显示的预览保留到第一个分块到达
+    void beginSourceStream(const Eigen::AlignedBox3d& bounds, size_t expectedPoints);
+    void beginTargetStream(const Eigen::AlignedBox3d& bounds, size_t expectedPoints);
+    void appendSourceStream(const PointBatch& batch);
+    void appendTargetStream(const PointBatch& batch);
+    
     // 迭代历史
     void setIterationHistory(const std::vector<IterationResult>& history);
     void setCurrentIteration(int index);
     int getCurrentIteration() const { return m_currentIteration; }
     int getIterationCount() const { return static_cast<int>(m_iterationHistory.size()); }
     
+    // 配准过程中实时显示：源点云按最新一次迭代的累积变换绘制，只更新模型矩阵，不复制点。
+    // 优先于迭代回放，设置迭代历史或清空点云时结束
+    void setLiveTransform(const Eigen::Matrix4d& transform);
+    void clearLiveTransform();
+    bool hasLiveTransform() const { return m_hasLiveTransform; }
+    
+    // 残差热图：residuals与源点云同序(ICPResult::residuals)，threshold以上的离群点显示为灰色。
+    // 只在显示最终配准结果时生效，更换源点云时清除
+    void setSourceResiduals(std::shared_ptr<const std::vector<double>> residuals, double threshold);
+    void clearSourceResiduals();
+    bool hasSourceResiduals() const { return m_residuals != nullptr; }
+    
     // 显示设置
     void setShowGrid(bool show);
     void setShowAxes(bool show);
@@ -42,12 +91,62 @@ public:
     void setTargetColor(const QColor& color);
     void setPointSize(float size);
     
+    // 交互时每帧最多绘制的点数，相机静止后逐步放宽到该值的若干倍
+    void setPointBudget(size_t budget);
+    size_t getPointBudget() const { return m_pointBudget; }
+    
     // 视图控制
     void resetView();
     void fitToScreen();
     
+    /**
+     * @brief 渲染统计，点数和耗时都是最近一帧的，上传为累计值
+     */
+    struct RenderStats {
+        quint64 frames = 0;             // 已绘制的帧数
+        double frameTimeMs = 0.0;       // paintGL的CPU耗时(不含叠加显示)
+        double gpuTimeMs = -1.0;        // GPU执行绘制命令的耗时，结果异步读取，滞后一到两帧；不支持计时查询时为-1
+        size_t pointsResident = 0;      // 顶点缓冲中的点数
+        size_t pointsVisible = 0;       // 视锥裁剪和细节层次选取后的分块中的点数
+        size_t pointsDrawn = 0;         // 提交给glDrawArrays的点数(流式显示超出预算时少于可见点数)
+        size_t chunksDrawn = 0;         // 绘制的分块数
+        size_t chunksResident = 0;      // 顶点缓冲中的分块数(细节层次上传完成后每个节点一块)
+        size_t gpuBufferBytes = 0;      // 点云顶点缓冲占用的显存
+        quint64 uploadedBytes = 0;      // 累计上传到顶点缓冲的字节数(包括上传线程)
+        double uploadTimeMs = 0.0;      // 累计上传耗时
+        
+        double uploadBandwidthMBps() const { return uploadTimeMs > 0.0 ? uploadedBytes / (uploadTimeMs * 1e3) : 0.0; }
+    };
+    RenderStats renderStats() const;
+    
+    // 在视图左上角叠加显示渲染统计
+    void setShowStats(bool show);
+    bool showStats() const { return m_showStats; }
+    
+    /**
+     * @brief 拾取结果，位置为场景坐标(源点云已应用当前显示的变换)
+     */
+    struct PickResult {
+        bool hit = false;
+        bool isSource = false;          // 拾取到的是源点云还是目标点云
+        size_t index = 0;               // 点在点云中的序号
+        Eigen::Vector3d position = Eigen::Vector3d::Zero();
+        double depth = 0.0;             // 沿视线到相机的距离
+    };
+    
+    // 拾取用的空间索引(与当前显示的完整点云同序)，没有索引的点云不参与拾取。更换点云时清除
+    void setPickIndexes(std::shared_ptr<const Octree> source, std::shared_ptr<const Octree> target);
+    
+    // 启用后左键单击(不拖动)拾取点：第一次为测量起点，第二次为终点并发出distanceMeasured
+    void setPickingEnabled(bool enabled);
+    bool isPickingEnabled() const { return m_pickingEnabled; }
+    PickResult pick(const QPoint& pos) const;   // 按最近一帧的相机计算
+    void clearMeasurement();
+    
 signals:
     void iterationChanged(int iteration);
+    void pointPicked(const PointCloudViewer::PickResult& result);
+    void distanceMeasured(const Eigen::Vector3d& from, const Eigen::Vector3d& to);
     
 protected:
     void initializeGL() override;
@@ -59,21 +158,100 @@ protected:
     void mouseReleaseEvent(QMouseEvent *event) override;
     void wheelEvent(QWheelEvent *event) override;
     
+private slots:
+    void onRefine();
+    
 private:
+    void applyRenderState();
     void drawGrid();
     void drawAxes();
-    void drawPointCloud(const PointCloud* cloud, const QColor& color);
-    void drawTransformedSourceCloud();
+    void drawStatsOverlay();
+    void drawMeasurement();
+    void handlePick(const QPoint& pos);
+    Eigen::Affine3d currentSourceTransform() const;     // 实时显示或回放当前迭代的累积变换
+    
+    /**
+     * @brief 后台构建的细节层次(顶点已按节点重排)
+     */
+    struct LODBuild {
+        LODOctree lod;
+        std::vector<float> vertices;
+        std::vector<uint32_t> order;    // 只为源点云记录重排顺序
+    };
+    
+    /**
+     * @brief 一个流式分块的顶点(交错排列，与上传的内容相同)，加载结束后用于构建细节层次
+     */
+    struct StreamPiece {
+        size_t first = 0;               // 在点云中的起始序号
+        std::vector<float> vertices;
+    };
+    
+    /**
+     * @brief 一个空间分块的顶点缓冲
+     */
+    struct PointChunk {
+        QOpenGLBuffer vbo;
+        QOpenGLBuffer residualVbo;      // 逐点残差(float)，需要热图时才创建
+        int count = 0;
+        Eigen::AlignedBox3f bounds;     // 与顶点相同的坐标系(相对于点云的上传原点)
+    };
+    
+    /**
+     * @brief 一个点云在显存中的全部分块
+     */
+    struct PointBuffer {
+        std::vector<PointChunk> chunks;                     // 有细节层次时与节点一一对应，否则只有一块
+        size_t count = 0;                                   // 所有分块的点数之和
+        Eigen::Vector3d origin = Eigen::Vector3d::Zero();   // 上传时减去的原点
+        bool dirty = true;                                  // 点云变化后需要重新上传
+        const PointCloud* cloud = nullptr;                  // 缓冲中的点云及其点数，重复设置时不重新上传
+        size_t cloudSize = 0;
+        LODOctree lod;                                      // 为空时整块绘制
+        std::vector<uint32_t> order;                        // 细节层次重排后每个顶点的原始序号(只有源点云保留，用于排列残差)
+        std::shared_ptr<LODBuild> built;                    // 已构建完成、等待上传的细节层次(没有上传线程时)
+        unsigned generation = 0;                            // 每次重新上传加一，丢弃过期的构建和上传结果
+        bool streaming = false;                             // 正在接收流式分块
+        bool placeholder = false;                           // 现有分块只是占位的预览，第一个流式分块到达时清除
+        size_t streamExpected = 0;                          // 流式加载预计的总点数
+        Eigen::AlignedBox3d streamBounds;                   // 流式加载预计的包围盒
+        std::vector<StreamPiece> streamPieces;              // 已到达分块的顶点
+        size_t streamPosted = 0;                            // 已提交上传的流式点数
+        size_t streamReceived = 0;                          // 已到达的流式点数
+        size_t streamFinal = 0;                             // 加载结束后点云的点数(加载未结束时为0)
+    };
+    
+    void initPointProgram();
+    void uploadPointCloud(const PointCloud* cloud, PointBuffer& buffer);
+    bool uploadBuffer(QOpenGLBuffer& vbo, const void* data, int bytes);         // 可在上传线程中调用
+    bool uploadChunk(PointChunk& chunk, const float* vertices, size_t count);
+    bool uploadNodes(const LODBuild& build, std::vector<PointChunk>& chunks, size_t& count);
+    void setBufferCloud(const PointCloud* cloud, PointBuffer& buffer);
+    void startLODBuild(PointBuffer& buffer, std::vector<float>&& vertices, std::vector<StreamPiece>&& pieces = {});
+    void uploadBuiltLOD(PointBuffer& buffer);
+    void beginStream(PointBuffer& buffer, const Eigen::AlignedBox3d& bounds, size_t expectedPoints);
+    void appendStream(PointBuffer& buffer, const PointBatch& batch);
+    void addStreamChunk(PointBuffer& buffer, const PointChunk& chunk, StreamPiece&& piece);
+    bool prepareResiduals(PointBuffer& buffer);
+    void drawPointCloud(PointBuffer& buffer, const QColor& color, const Eigen::Affine3d& transform, size_t budget,
+                        bool residualColors = false);
     void updateCamera();
+    void restartRefinement();
     
     // 点云数据
-    PointCloud* m_sourceCloud;
-    PointCloud* m_targetCloud;
-    PointCloud* m_originalSource;  // 保存原始源点云用于迭代回放
+    const PointCloud* m_sourceCloud;    // 原始源点云，回放时只改变绘制用的模型矩阵
+    const PointCloud* m_targetCloud;
     
     // 迭代历史
     std::vector<IterationResult> m_iterationHistory;
     int m_currentIteration;
+    Eigen::Matrix4d m_liveTransform;
+    bool m_hasLiveTransform;
+    
+    // 残差热图
+    std::shared_ptr<const std::vector<double>> m_residuals;     // 与配准引擎共享，不复制
+    double m_residualThreshold;
+    bool m_residualsChanged;                // 已上传的残差属性需要释放
     
     // 相机参数
     QMatrix4x4 m_projection;
@@ -81,6 +259,7 @@ private:
     QVector3D m_cameraPos;
     QVector3D m_cameraTarget;
     QVector3D m_cameraUp;
+    float m_aspect;
     
     // 交互控制
     QPoint m_lastMousePos;
@@ -99,8 +278,37 @@ private:
     QColor m_targetColor;
     float m_pointSize;
     
-    // 场景边界
-    QVector3D m_sceneCenter;
+    // 顶点缓冲和着色器
+    PointBuffer m_sourceBuffer;
+    PointBuffer m_targetBuffer;
+    QOpenGLShaderProgram* m_pointProgram;   // 编译失败时为nullptr，改用固定管线绘制顶点缓冲
+    QOpenGLShaderProgram* m_residualProgram;    // 残差热图着色器，不可用时不显示热图
+    GLUploadThread* m_uploader;             // 无法创建共享上下文时为nullptr，在界面线程中上传
+    
+    // 细节层次：交互时的点数预算和当前帧的预算(静止后逐步增加)
+    size_t m_pointBudget;
+    size_t m_frameBudget;
+    bool m_lodTruncated;                    // 上一帧是否还有可见节点因预算不足未绘制
+    QTimer* m_refineTimer;
+    
+    // 渲染统计：两个GPU计时查询轮流使用，读取上一帧的结果时不等待
+    RenderStats m_stats;
+    bool m_showStats;
+    QOpenGLTimerQuery* m_frameTimers[2];    // 不支持计时查询时为nullptr
+    bool m_frameTimerPending[2];
+    int m_frameTimerIndex;
+    std::atomic<quint64> m_uploadedBytes;   // 界面线程和上传线程都会累加
+    std::atomic<quint64> m_uploadNanos;
+    
+    // 拾取和测量
+    std::shared_ptr<const Octree> m_sourceIndex;
+    std::shared_ptr<const Octree> m_targetIndex;
+    bool m_pickingEnabled;
+    QPoint m_pressPos;                          // 左键按下的位置，松开时移动很小才视为单击
+    std::vector<Eigen::Vector3d> m_measurePoints;   // 已拾取的测量点(最多两个，场景坐标)
+    
+    // 场景边界(绘制时所有坐标相对于场景中心)
+    Eigen::Vector3d m_sceneCenter;
     float m_sceneRadius;
 };
 
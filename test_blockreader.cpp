@@ -0,0 +1,116 @@
+#include <iostream>
+#include <fstream>
+#include <vector>
+#include <string>
+#include <cstdlib>
+#include <QThread>
+#include <QThreadPool>
+#include <QTemporaryDir>
+#include <QElapsedTimer>
+#include <QtConcurrent>
+#include "core/blockreader.h"
+
+using namespace std;
+
+// 测试文件的字节数、流水线块大小和等待读取完成的最长时间
+const size_t FILE_BYTES = (size_t(5) << 20) + 12345;
+const size_t BLOCK_BYTES = 65536;
+const int TIMEOUT_MS = 30000;
+
+int failures = 0;
+
+void check(bool condition, const string& message)
+{
+    cout << (condition ? "  通过: " : "  失败: ") << message << endl;
+    if (!condition) {
+        ++failures;
+    }
+}
+
+char patternByte(uint64_t offset)
+{
+    return static_cast<char>((offset * 31 + offset / 4099) % 251);
+}
+
+// 按块读取整个文件，校验每块的偏移、长度和内容；stopAfter > 0时读完该块数后要求停止
+bool readAndVerify(const string& filename, size_t queueDepth, size_t stopAfter, size_t& blocks, bool& contentOk)
+{
+    BlockReader reader(queueDepth);
+    if (!reader.open(filename)) {
+        return false;
+    }
+    
+    blocks = 0;
+    contentOk = true;
+    uint64_t expectedOffset = 0;
+    return reader.read(0, FILE_BYTES, BLOCK_BYTES, [&](const char* data, uint64_t offset, size_t length) {
+        if (offset != expectedOffset || length != min<uint64_t>(BLOCK_BYTES, FILE_BYTES - offset)) {
+            contentOk = false;
+        }
+        for (size_t i = 0; i < length && contentOk; ++i) {
+            contentOk = data[i] == patternByte(offset + i);
+        }
+        expectedOffset = offset + length;
+        ++blocks;
+        return stopAfter == 0 || blocks < stopAfter;
+    });
+}
+
+int main()
+{
+    cout << "BlockReader 流水线读取测试" << endl;
+    
+    QTemporaryDir dir;
+    if (!dir.isValid()) {
+        cout << "无法创建临时目录" << endl;
+        return 1;
+    }
+    const string filename = dir.path().toStdString() + "/blocks.bin";
+    {
+        vector<char> data(FILE_BYTES);
+        for (size_t i = 0; i < FILE_BYTES; ++i) {
+            data[i] = patternByte(i);
+        }
+        ofstream file(filename, ios::binary);
+        file.write(data.data(), static_cast<streamsize>(data.size()));
+    }
+    
+    const size_t numBlocks = (FILE_BYTES + BLOCK_BYTES - 1) / BLOCK_BYTES;
+    size_t blocks = 0;
+    bool contentOk = false;
+    
+    cout << "\n步骤1: 不同队列深度的顺序读取" << endl;
+    for (size_t depth : {1, 2, 4}) {
+        bool ok = readAndVerify(filename, depth, 0, blocks, contentOk);
+        check(ok && blocks == numBlocks && contentOk, "队列深度 " + to_string(depth) + " 读完全部块且内容一致");
+    }
+    
+    cout << "\n步骤2: 回调要求停止" << endl;
+    bool ok = readAndVerify(filename, 3, 5, blocks, contentOk);
+    check(!ok && blocks == 5 && contentOk, "读到第5块后停止并返回false");
+    
+    // 调用者本身就在只有一个线程的全局线程池中(与后台加载相同)，读取阶段不能依赖线程池
+    cout << "\n步骤3: 全局线程池只有一个线程时在线程池中读取" << endl;
+    QThreadPool::globalInstance()->setMaxThreadCount(1);
+    QFuture<bool> future = QtConcurrent::run([&]() {
+        size_t pooledBlocks = 0;
+        bool pooledContent = false;
+        bool pooledOk = readAndVerify(filename, 3, 0, pooledBlocks, pooledContent);
+        return pooledOk && pooledBlocks == numBlocks && pooledContent;
+    });
+    
+    QElapsedTimer timer;
+    timer.start();
+    while (!future.isFinished() && timer.elapsed() < TIMEOUT_MS) {
+        QThread::msleep(10);
+    }
+    if (!future.isFinished()) {
+        // 读取线程永远不会被调度，无法等待其结束，直接退出
+        cout << "  失败: 读取在 " << TIMEOUT_MS / 1000 << " 秒内没有完成(流水线死锁)" << endl;
+        std::_Exit(1);
+    }
+    check(future.result(), "线程池已满时读完全部块且内容一致");
+    
+    cout << "\n" << (failures == 0 ? "全部测试通过" : "存在失败的测试") << endl;
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,524 @@
+#include <iostream>
+#include <fstream>
+#include <vector>
+#include <string>
+#include <cmath>
+#include <cstring>
+#include <random>
+#include <memory>
+#include <algorithm>
+#include <iterator>
+#include <chrono>
+#include <filesystem>
+#include <mutex>
+#include <QTemporaryDir>
+#include "core/lasio.h"
+#include "core/laspointformats.h"
+#include "core/lazcodec.h"
+#include "core/lasindex.h"
+
+using namespace std;
+
+// 每个测试点云的点数和额外字节数
+const size_t NUM_POINTS = 5000;
+const uint16_t EXTRA_BYTES = 5;
+
+int failures = 0;
+
+void check(bool condition, const string& message)
+{
+    cout << (condition ? "  通过: " : "  失败: ") << message << endl;
+    if (!condition) {
+        ++failures;
+    }
+}
+
+// 在原始标准字段中按记录偏移写入一个字段
+template<typename T>
+void putField(vector<uint8_t>& fields, size_t point, size_t fieldsSize, int recordOffset, const T& value)
+{
+    memcpy(fields.data() + point * fieldsSize + (recordOffset - LASFormat::RECORD_FIELDS_OFFSET), &value, sizeof(T));
+}
+
+/**
+ * @brief 生成指定点格式的点云，所有属性列和原始标准字段都填入随机值
+ *
+ * 原始字段中与属性列重叠的字段写成与属性列相同的值，波形数据包写0(写出时不保留)，
+ * 因此读回的原始字段应与生成的完全一致。
+ */
+PointCloud makeCloud(uint8_t format, mt19937& rng)
+{
+    const LASFormat::FormatInfo info = LASFormat::formatInfo(format);
+    const size_t fieldsSize = info.recordFieldsSize();
+    const bool extended = format >= 6;
+    
+    auto encoding = make_shared<PointCloudEncoding>();
+    encoding->versionMinor = (extended || format % 2 == 1) ? 4 : 2;     // 部分旧格式也写成LAS 1.4
+    encoding->pointFormat = format;
+    encoding->recordFieldsSize = static_cast<uint16_t>(fieldsSize);
+    encoding->extraBytesSize = EXTRA_BYTES;
+    encoding->scale = Eigen::Vector3d(0.01, 0.001, 0.0005);
+    encoding->offset = Eigen::Vector3d(500000.0, 4000000.0, -50.0);
+    
+    PointCloud cloud;
+    cloud.encoding = encoding;
+    uniform_real_distribution<double> coord(-1000.0, 1000.0);
+    uniform_int_distribution<int> byte(0, 255);
+    
+    for (size_t i = 0; i < NUM_POINTS; ++i) {
+        Point3D p;
+        p.x = encoding->offset.x() + coord(rng);
+        p.y = encoding->offset.y() + coord(rng);
+        p.z = encoding->offset.z() + coord(rng) * 0.1;
+        cloud.points.push_back(p);
+    }
+    
+    cloud.recordFields.resize(NUM_POINTS * fieldsSize);
+    for (uint8_t& value : cloud.recordFields) {
+        value = static_cast<uint8_t>(byte(rng));
+    }
+    cloud.extraBytes.resize(NUM_POINTS * EXTRA_BYTES);
+    for (uint8_t& value : cloud.extraBytes) {
+        value = static_cast<uint8_t>(byte(rng));
+    }
+    
+    for (size_t i = 0; i < NUM_POINTS; ++i) {
+        uint16_t intensity = static_cast<uint16_t>(byte(rng) * 256 + byte(rng));
+        cloud.intensity.push_back(intensity);
+        putField(cloud.recordFields, i, fieldsSize, 12, intensity);
+        
+        // 旧格式的分类字节高3位是标志，分类号只占低5位
+        uint8_t classification = static_cast<uint8_t>(byte(rng));
+        const int classificationOffset = extended ? 16 : 15;
+        uint8_t stored = cloud.recordFields[i * fieldsSize + classificationOffset - LASFormat::RECORD_FIELDS_OFFSET];
+        if (!extended) {
+            classification &= 0x1F;
+            stored = static_cast<uint8_t>((stored & 0xE0) | classification);
+        } else {
+            stored = classification;
+        }
+        cloud.classification.push_back(classification);
+        putField(cloud.recordFields, i, fieldsSize, classificationOffset, stored);
+        
+        if (info.gpsTime >= 0) {
+            double gpsTime = 1.0e8 + static_cast<double>(i) * 0.001;
+            cloud.gpsTime.push_back(gpsTime);
+            putField(cloud.recordFields, i, fieldsSize, info.gpsTime, gpsTime);
+        }
+        if (info.rgb >= 0) {
+            PointColor color = {static_cast<uint16_t>(byte(rng) * 257), static_cast<uint16_t>(byte(rng) * 257),
+                                static_cast<uint16_t>(byte(rng) * 257)};
+            cloud.rgb.push_back(color);
+            putField(cloud.recordFields, i, fieldsSize, info.rgb, color);
+        }
+        if (info.wavePacket >= 0) {
+            memset(cloud.recordFields.data() + i * fieldsSize + (info.wavePacket - LASFormat::RECORD_FIELDS_OFFSET),
+                   0, info.recordLength - info.wavePacket);
+        }
+    }
+    cloud.computeBounds();
+    return cloud;
+}
+
+// 读回的坐标与写出的坐标之差不超过半个量化步长
+bool samePoints(const PointCloud& a, const PointCloud& b, const Eigen::Vector3d& scale)
+{
+    if (a.points.size() != b.points.size()) {
+        return false;
+    }
+    for (size_t i = 0; i < a.points.size(); ++i) {
+        if (fabs(a.points[i].x - b.points[i].x) > scale.x() * 0.5 + 1e-9
+            || fabs(a.points[i].y - b.points[i].y) > scale.y() * 0.5 + 1e-9
+            || fabs(a.points[i].z - b.points[i].z) > scale.z() * 0.5 + 1e-9) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool sameColors(const vector<PointColor>& a, const vector<PointColor>& b)
+{
+    return a.size() == b.size() && (a.empty() || memcmp(a.data(), b.data(), a.size() * sizeof(PointColor)) == 0);
+}
+
+// 按LAS头部布局读取文件中的点数字段
+void readCounts(const string& filename, uint32_t& legacyCount, uint64_t& extendedCount, uint8_t& versionMinor)
+{
+    char header[375] = {};
+    ifstream file(filename, ios::binary);
+    file.read(header, sizeof(header));
+    versionMinor = static_cast<uint8_t>(header[25]);
+    memcpy(&legacyCount, header + 107, sizeof(legacyCount));
+    extendedCount = 0;
+    if (versionMinor >= 4) {
+        memcpy(&extendedCount, header + 247, sizeof(extendedCount));
+    }
+}
+
+// 读取整个文件的字节
+vector<char> readBytes(const string& filename)
+{
+    ifstream file(filename, ios::binary);
+    return vector<char>(istreambuf_iterator<char>(file), istreambuf_iterator<char>());
+}
+
+// 在文件末尾追加一个EVLR并更新LAS 1.4头部中的EVLR起始偏移和个数
+void appendEVLR(const string& filename, const vector<char>& payload)
+{
+    vector<char> bytes = readBytes(filename);
+    const uint64_t start = bytes.size();
+    const uint32_t count = 1;
+    memcpy(bytes.data() + 235, &start, sizeof(start));
+    memcpy(bytes.data() + 243, &count, sizeof(count));
+    
+    char header[60] = {};
+    memcpy(header + 2, "PCRTest", 7);
+    const uint16_t recordId = 42;
+    const uint64_t length = payload.size();
+    memcpy(header + 18, &recordId, sizeof(recordId));
+    memcpy(header + 20, &length, sizeof(length));
+    bytes.insert(bytes.end(), header, header + sizeof(header));
+    bytes.insert(bytes.end(), payload.begin(), payload.end());
+    ofstream(filename, ios::binary).write(bytes.data(), static_cast<streamsize>(bytes.size()));
+}
+
+void testFormat(uint8_t format, const string& dir, const string& extension, mt19937& rng)
+{
+    cout << "\n点格式 " << static_cast<int>(format) << " (" << extension << ")" << endl;
+    const PointCloud cloud = makeCloud(format, rng);
+    const string filename = dir + "/format" + to_string(format) + extension;
+    if (!LASIO::writeLAS(filename, cloud)) {
+        check(false, "写出文件");
+        return;
+    }
+    
+    // 流水线读取和直接从映射区解码都要读回相同的内容
+    for (size_t depth : {size_t(2), size_t(0)}) {
+        LASReadOptions options;
+        options.attributes = LASAttribute::All;
+        options.useCache = false;
+        options.readQueueDepth = depth;
+        PointCloud loaded;
+        const string mode = depth > 0 ? "(流水线)" : "(映射区)";
+        if (!LASIO::readLAS(filename, loaded, options)) {
+            check(false, "读回文件" + mode);
+            continue;
+        }
+        
+        check(loaded.encoding && loaded.encoding->pointFormat == format
+              && loaded.encoding->scale.isApprox(cloud.encoding->scale)
+              && loaded.encoding->offset.isApprox(cloud.encoding->offset), "点格式、缩放和偏移不变" + mode);
+        check(samePoints(cloud, loaded, cloud.encoding->scale), "坐标在量化误差内一致" + mode);
+        check(loaded.intensity == cloud.intensity && loaded.classification == cloud.classification
+              && loaded.gpsTime == cloud.gpsTime && sameColors(loaded.rgb, cloud.rgb), "属性列一致" + mode);
+        check(loaded.recordFields == cloud.recordFields, "原始标准字段逐字节一致" + mode);
+        check(loaded.encoding && loaded.encoding->extraBytesSize == EXTRA_BYTES && loaded.extraBytes == cloud.extraBytes,
+              "额外字节一致" + mode);
+    }
+    
+    // LAZ文件头由LASzip写出
+    if (extension != ".las") {
+        return;
+    }
+    uint32_t legacyCount = 0;
+    uint64_t extendedCount = 0;
+    uint8_t versionMinor = 0;
+    readCounts(filename, legacyCount, extendedCount, versionMinor);
+    if (format >= 6) {
+        check(versionMinor == 4 && legacyCount == 0 && extendedCount == NUM_POINTS, "LAS 1.4只写64位点数");
+    } else if (versionMinor == 4) {
+        check(legacyCount == NUM_POINTS && extendedCount == NUM_POINTS, "LAS 1.4旧格式同时写旧点数和64位点数");
+    } else {
+        check(versionMinor == 2 && legacyCount == NUM_POINTS, "LAS 1.2旧点数字段");
+    }
+}
+
+int main()
+{
+    cout << "LAS 写出/读回测试" << endl;
+    
+    QTemporaryDir dir;
+    if (!dir.isValid()) {
+        cout << "无法创建临时目录" << endl;
+        return 1;
+    }
+    const string path = dir.path().toStdString();
+    mt19937 rng(20240517);
+    
+    cout << "\n步骤1: 点格式0-10逐一写出再读回" << endl;
+    for (int format = 0; format <= 10; ++format) {
+        testFormat(static_cast<uint8_t>(format), path, ".las", rng);
+    }
+    if (LAZCodec::isAvailable()) {
+        for (int format = 0; format <= 10; ++format) {
+            testFormat(static_cast<uint8_t>(format), path, ".laz", rng);
+        }
+    }
+    
+    cout << "\n步骤2: 修改属性列后写出，分类标志和其余原始字段保留" << endl;
+    {
+        PointCloud cloud = makeCloud(1, rng);
+        for (size_t i = 0; i < cloud.size(); ++i) {
+            cloud.classification[i] = static_cast<uint8_t>((cloud.classification[i] + 1) & 0x1F);
+            cloud.intensity[i] = static_cast<uint16_t>(i);
+        }
+        const string filename = path + "/modified.las";
+        LASReadOptions options;
+        options.attributes = LASAttribute::All;
+        options.useCache = false;
+        PointCloud loaded;
+        bool ok = LASIO::writeLAS(filename, cloud) && LASIO::readLAS(filename, loaded, options);
+        check(ok && loaded.classification == cloud.classification && loaded.intensity == cloud.intensity,
+              "读回修改后的属性列");
+        
+        bool fieldsKept = ok && loaded.recordFields.size() == cloud.recordFields.size();
+        const size_t fieldsSize = cloud.encoding->recordFieldsSize;
+        for (size_t i = 0; fieldsKept && i < cloud.size(); ++i) {
+            const uint8_t* before = cloud.recordFields.data() + i * fieldsSize;
+            const uint8_t* after = loaded.recordFields.data() + i * fieldsSize;
+            // 偏移14回波、15分类字节高3位、16扫描角、17用户数据、18点源ID、20GPS时间
+            fieldsKept = before[2] == after[2] && (before[3] & 0xE0) == (after[3] & 0xE0)
+                      && memcmp(before + 4, after + 4, fieldsSize - 4) == 0;
+        }
+        check(fieldsKept, "回波、分类标志、扫描角、用户数据、点源ID不变");
+    }
+    
+    cout << "\n步骤3: 没有来源编码的点云" << endl;
+    {
+        PointCloud cloud;
+        for (size_t i = 0; i < 100; ++i) {
+            Point3D p;
+            p.x = 1.0e6 + static_cast<double>(i);
+            p.y = -2.0e6 + static_cast<double>(i) * 0.5;
+            p.z = static_cast<double>(i) * 0.25;
+            cloud.points.push_back(p);
+            cloud.rgb.push_back({static_cast<uint16_t>(i), 0, 65535});
+            cloud.gpsTime.push_back(static_cast<double>(i));
+        }
+        cloud.computeBounds();
+        const string filename = path + "/plain.las";
+        LASReadOptions options;
+        options.attributes = LASAttribute::All;
+        options.useCache = false;
+        PointCloud loaded;
+        bool ok = LASIO::writeLAS(filename, cloud) && LASIO::readLAS(filename, loaded, options);
+        check(ok && loaded.encoding && loaded.encoding->pointFormat == 3, "按已有属性选择点格式3");
+        check(ok && samePoints(cloud, loaded, loaded.encoding->scale) && sameColors(loaded.rgb, cloud.rgb)
+              && loaded.gpsTime == cloud.gpsTime, "坐标和属性列一致");
+        bool singleReturn = ok && loaded.recordFields.size() == loaded.size() * loaded.encoding->recordFieldsSize;
+        for (size_t i = 0; singleReturn && i < loaded.size(); ++i) {
+            singleReturn = loaded.recordFields[i * loaded.encoding->recordFieldsSize + 2] == 0x09;
+        }
+        check(singleReturn, "回波号和回波数写为1/1");
+    }
+    
+    cout << "\n步骤4: 坐标超出原偏移的32位表示范围" << endl;
+    {
+        PointCloud cloud = makeCloud(6, rng);
+        for (Point3D& p : cloud.points) {
+            p.x += 5.0e7;
+        }
+        cloud.computeBounds();
+        const string filename = path + "/shifted.las";
+        LASReadOptions options;
+        options.attributes = LASAttribute::All;
+        options.useCache = false;
+        PointCloud loaded;
+        bool ok = LASIO::writeLAS(filename, cloud) && LASIO::readLAS(filename, loaded, options);
+        check(ok && loaded.encoding && !loaded.encoding->offset.isApprox(cloud.encoding->offset), "改用新的偏移");
+        check(ok && samePoints(cloud, loaded, cloud.encoding->scale), "坐标在量化误差内一致");
+        check(ok && loaded.recordFields == cloud.recordFields, "原始标准字段逐字节一致");
+    }
+    
+    cout << "\n步骤5: 空间旁路索引" << endl;
+    {
+        // 按扫描行顺序排列的地表点，与采集顺序下的文件相同
+        PointCloud cloud;
+        const int side = 640;
+        for (int row = 0; row < side; ++row) {
+            for (int col = 0; col < side; ++col) {
+                Point3D p;
+                p.x = col * 0.5;
+                p.y = row * 0.5;
+                p.z = sin(col * 0.05) + cos(row * 0.05);
+                cloud.points.push_back(p);
+            }
+        }
+        cloud.computeBounds();
+        const string filename = path + "/indexed.las";
+        bool ok = LASIO::writeLAS(filename, cloud) && LASIO::buildSpatialIndex(filename);
+        
+        ifstream sidecar(LASSpatialIndex::sidecarPath(filename), ios::binary | ios::ate);
+        const double bytesPerPoint = ok && sidecar ? static_cast<double>(sidecar.tellg()) / cloud.size() : 1e9;
+        cout << "  索引大小: " << bytesPerPoint << " 字节/点" << endl;
+        check(ok && bytesPerPoint < 0.1, "索引小于每点0.1字节");
+        
+        const Eigen::AlignedBox3d box(Eigen::Vector3d(40.0, 100.0, -10.0), Eigen::Vector3d(120.0, 150.0, 10.0));
+        size_t expected = 0;
+        for (const Point3D& p : cloud.points) {
+            expected += box.contains(Eigen::Vector3d(p.x, p.y, p.z)) ? 1 : 0;
+        }
+        PointCloud region;
+        ok = ok && LASIO::readRegion(filename, region, box);
+        check(ok && region.size() == expected, "区域读取与逐点裁剪的点数一致");
+        
+        PointCloud coarse;
+        ok = ok && LASIO::readRegion(filename, coarse, box, 0);
+        check(ok && !coarse.empty() && coarse.size() < expected / 4, "只读根层级时得到稀疏采样");
+    }
+    
+    cout << "\n步骤6: 把刚体变换应用到整个文件" << endl;
+    {
+        PointCloud cloud = makeCloud(6, rng);
+        const string input = path + "/untransformed.las";
+        const string output = path + "/transformed.las";
+        bool ok = LASIO::writeLAS(input, cloud);
+        appendEVLR(input, vector<char>(100, 'e'));
+        
+        Eigen::Affine3d transform = Eigen::Translation3d(250.0, -120.0, 3.5)
+                                  * Eigen::AngleAxisd(0.4, Eigen::Vector3d::UnitZ());
+        ok = ok && LASIO::transformLAS(input, output, transform);
+        check(ok, "写出变换后的文件");
+        
+        // 与读回的输入比较，输入的量化误差经旋转后会混到其它轴上
+        LASReadOptions options;
+        options.useCache = false;
+        PointCloud expected, loaded;
+        ok = ok && LASIO::readLAS(input, expected, options) && LASIO::readLAS(output, loaded, options);
+        expected.applyTransform(transform, true);
+        check(ok && samePoints(expected, loaded, cloud.encoding->scale), "坐标等于变换后的输入(量化误差内)");
+        
+        // 头部只有偏移和边界(155-226)改变，VLR、每条记录XYZ之后的字节和EVLR逐字节一致
+        const vector<char> before = readBytes(input);
+        const vector<char> after = readBytes(output);
+        uint32_t dataOffset = 0;
+        uint16_t recordLength = 0;
+        memcpy(&dataOffset, before.data() + 96, sizeof(dataOffset));
+        memcpy(&recordLength, before.data() + 105, sizeof(recordLength));
+        const size_t dataEnd = dataOffset + NUM_POINTS * recordLength;
+        bool bytesKept = ok && before.size() == after.size() && before.size() > dataEnd
+                      && equal(before.begin(), before.begin() + 155, after.begin())
+                      && equal(before.begin() + 227, before.begin() + dataOffset, after.begin() + 227)
+                      && equal(before.begin() + dataEnd, before.end(), after.begin() + dataEnd);
+        for (size_t i = 0; bytesKept && i < NUM_POINTS; ++i) {
+            const size_t record = dataOffset + i * recordLength;
+            bytesKept = equal(before.begin() + record + 12, before.begin() + record + recordLength,
+                              after.begin() + record + 12);
+        }
+        check(bytesKept, "其余头部字节、VLR、非XYZ记录字节和EVLR不变");
+        
+        double patched[9] = {};
+        if (after.size() >= 227) {
+            memcpy(patched, after.data() + 155, sizeof(patched));
+        }
+        const Eigen::Vector3d offset(patched[0], patched[1], patched[2]);
+        const Eigen::AlignedBox3d box = loaded.boundingBox();
+        const double tolerance = 1e-9;
+        check(ok && loaded.encoding && loaded.encoding->offset.isApprox(offset)
+              && fabs(patched[3] - box.max().x()) < cloud.encoding->scale.x() + tolerance
+              && fabs(patched[4] - box.min().x()) < cloud.encoding->scale.x() + tolerance
+              && fabs(patched[5] - box.max().y()) < cloud.encoding->scale.y() + tolerance
+              && fabs(patched[6] - box.min().y()) < cloud.encoding->scale.y() + tolerance
+              && fabs(patched[7] - box.max().z()) < cloud.encoding->scale.z() + tolerance
+              && fabs(patched[8] - box.min().z()) < cloud.encoding->scale.z() + tolerance,
+              "回填偏移和变换后的边界");
+        
+        // 头部边界清零(过期)时，按头部选出的偏移装不下实际的点，应导出失败而不是写出回绕的坐标
+        vector<char> stale = before;
+        fill(stale.begin() + 179, stale.begin() + 227, 0);
+        const string staleInput = path + "/stale.las";
+        ofstream(staleInput, ios::binary).write(stale.data(), static_cast<streamsize>(stale.size()));
+        const Eigen::Affine3d far(Eigen::Translation3d(3.0e7, 0.0, 0.0));
+        const string staleOutput = path + "/stale_transformed.las";
+        check(!LASIO::transformLAS(staleInput, staleOutput, far) && !ifstream(staleOutput).good(),
+              "头部边界过期导致坐标溢出时导出失败");
+        if (LAZCodec::isAvailable()) {
+            const string lazOutput = path + "/stale_transformed.laz";
+            check(!LASIO::transformLAS(staleInput, lazOutput, far) && !ifstream(lazOutput).good(),
+                  "LAZ输出同样导出失败");
+            
+            PointCloud compressed;
+            ok = LASIO::transformLAS(input, path + "/transformed.laz", transform)
+              && LASIO::readLAS(path + "/transformed.laz", compressed, options);
+            check(ok && samePoints(expected, compressed, cloud.encoding->scale), "LAZ输出的坐标等于变换后的输入");
+        }
+    }
+    
+    cout << "\n步骤7: 同一路径重新导出后旧的空间索引失效" << endl;
+    {
+        PointCloud cloud;
+        for (int row = 0; row < 300; ++row) {
+            for (int col = 0; col < 300; ++col) {
+                Point3D p;
+                p.x = col * 0.5;
+                p.y = row * 0.5;
+                p.z = 0.0;
+                cloud.points.push_back(p);
+            }
+        }
+        cloud.computeBounds();
+        const string source = path + "/reexport_source.las";
+        const string exported = path + "/reexported.las";
+        bool ok = LASIO::writeLAS(source, cloud)
+               && LASIO::transformLAS(source, exported, Eigen::Affine3d::Identity())
+               && LASIO::buildSpatialIndex(exported);
+        
+        // 平移后重新导出到同一路径：文件大小和点数不变，修改时间不同(显式推后，避免时间戳精度不足)
+        const auto firstTime = filesystem::last_write_time(exported);
+        const Eigen::Affine3d shift(Eigen::Translation3d(60.0, 0.0, 0.0));
+        ok = ok && LASIO::transformLAS(source, exported, shift);
+        filesystem::last_write_time(exported, firstTime + chrono::seconds(2));
+        
+        LASFile file;
+        LASSpatialIndex index;
+        check(ok && file.open(exported) && !index.loadSidecar(file), "大小相同但修改时间不同的索引被拒绝");
+        
+        const Eigen::AlignedBox3d box(Eigen::Vector3d(100.0, 20.0, -1.0), Eigen::Vector3d(180.0, 60.0, 1.0));
+        size_t expected = 0;
+        for (const Point3D& p : cloud.points) {
+            expected += box.contains(Eigen::Vector3d(p.x + 60.0, p.y, p.z)) ? 1 : 0;
+        }
+        PointCloud region;
+        check(ok && LASIO::readRegion(exported, region, box) && region.size() == expected,
+              "区域读取返回新的几何");
+    }
+    
+    cout << "\n步骤8: 分块解码回调的区间大小有上限(包括读取缓存)" << endl;
+    {
+        PointCloud cloud;
+        const size_t count = LAS_CHUNK_REPORT_POINTS * 3 / 2;
+        for (size_t i = 0; i < count; ++i) {
+            Point3D p;
+            p.x = static_cast<double>(i % 1000);
+            p.y = static_cast<double>(i / 1000);
+            p.z = 0.0;
+            cloud.points.push_back(p);
+        }
+        cloud.computeBounds();
+        const string filename = path + "/reported.las";
+        bool ok = LASIO::writeLAS(filename, cloud);
+        
+        // 第一次读取时写入缓存，第二次从缓存加载
+        for (const char* mode : {"解码", "缓存"}) {
+            mutex rangesMutex;
+            vector<size_t> hits(count, 0);
+            size_t largest = 0;
+            LASReadOptions options;
+            options.chunkDecoded = [&](size_t begin, size_t end) {
+                lock_guard<mutex> lock(rangesMutex);
+                largest = max(largest, end - begin);
+                for (size_t i = begin; i < end && i < count; ++i) {
+                    ++hits[i];
+                }
+            };
+            PointCloud loaded;
+            const bool read = ok && LASIO::readLAS(filename, loaded, options);
+            check(read && largest <= LAS_CHUNK_REPORT_POINTS
+                  && all_of(hits.begin(), hits.end(), [](size_t h) { return h == 1; }),
+                  string("每个点恰好报告一次且区间不超过上限(") + mode + ")");
+        }
+    }
+    
+    cout << "\n" << (failures == 0 ? "全部测试通过" : "存在失败的测试") << endl;
+    return failures == 0 ? 0 : 1;
+}